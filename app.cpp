@@ -1,9 +1,13 @@
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <chrono>
 
 #include <string>
 #include <vector>
 #include <stack>
+#include <algorithm>
 
 #include <glload/gl_3_3.h>
 #include <glutil/glutil.h>
@@ -14,8 +18,19 @@
 
 #include "framework/framework.h"
 #include "framework/Mesh.h"
+#include "framework/FileWatcher.h"
 #include "framework/MousePole.h"
-#include "framework/Timer.h"
+#include "framework/FrameLoop.h"
+#include "framework/TripleBuffer.h"
+#include "framework/SimulationThread.h"
+#include "framework/WorkerPool.h"
+#include "framework/Headless.h"
+#include "framework/InputLog.h"
+#include "framework/FrameStats.h"
+#include "framework/Profiler.h"
+#include "framework/Collision.h"
+#include "framework/ClusteredLights.h"
+#include "framework/Fleet.h"
 
 #include "app.h"
 
@@ -24,6 +39,7 @@ float zFar = 1000.0f;
 
 ProgramData program;
 SimpleProgramData lightProgram;
+FleetProgramData fleetProgram;
 
 Framework::Mesh *planeMesh = NULL;
 Framework::Mesh *sunMesh = NULL;
@@ -32,6 +48,11 @@ Framework::Mesh *ufoLightMesh = NULL;
 Framework::Mesh *cubeMesh = NULL;
 Framework::Mesh *cylinderMesh = NULL;
 Framework::Mesh *sphereMesh = NULL;
+Framework::Mesh *fleetMesh = NULL;
+
+// Made by watchFiles; NULL while hot reload is off.
+Framework::FileWatcher *fileWatcher = NULL;
+Framework::FrameStats frameStats;
 
 glutil::ViewData initialViewData = {
     glm::vec3(0.0f, 0.0f, 0.0f),
@@ -49,15 +70,17 @@ glutil::ViewScale viewScale = {
 glutil::ViewPole viewPole = glutil::ViewPole(initialViewData, viewScale,
         glutil::MB_LEFT_BTN);
 
-glm::vec3 ufoPosition(0.0f, 0.5f, 0.0f);
+// Simulation state, kept at the last two ticks so frames can be drawn between
+// them.
+Framework::Interpolated<glm::vec3> ufoPosition(glm::vec3(0.0f, 0.5f, 0.0f));
+Framework::Interpolated<float> ufoAngleInDegrees(0.0f);
 glm::vec3 ufoLightPosition(0.0f, 0.5f, 6.0f);
 glm::vec3 cubePosition = glm::vec3(9.0f, 0.0f, 19.0f);
 glm::vec3 cylinderPosition = glm::vec3(23.0f, -0.5f, -26.0f);
 glm::vec3 spherePosition = glm::vec3(-20.0f, 1.5f, -12.0f);
-float ufoAngleInDegrees = 0.0f;
 
 glutil::ObjectData ufoObjectData = {
-    ufoPosition,
+    glm::vec3(0.0f, 0.5f, 0.0f),
     glm::fquat(1.0f, 0.0f, 0.0f, 0.0f)
 };
 
@@ -84,18 +107,55 @@ glm::vec3 sphereColor = glm::vec3(0.9f, 0.2f, 0.7f);
 
 float sunLightRadius = 50.0f;
 float sunLightMaxHeight = 120.0f;
-Framework::Timer sunLightTimer(Framework::Timer::TT_LOOP, 30.0f);
+float sunLightLoopSeconds = 30.0f;
 
 float ufoRadius = 6.71f;
-float cubePlusUfoRadius = 7.0711f + ufoRadius;
-float cylinderPlusUfoRadius = 3.0f + ufoRadius;
-float spherePlusUfoRadius = 4.5f + ufoRadius;
+float ufoSpeed = 15.0f;
+float ufoClimbSpeed = 30.0f;
+float ufoTurnDegreesPerSecond = 150.0f;
+float arenaHalfSize = 50.0f;
+Framework::CollisionWorld obstacleWorld;
 
 static float g_fSunAttenuation = 0.001f;
 static float g_fUfoAttenuation = 0.05f;
 
-glm::vec4 calculateSunPosition() {
-    float currentLoopTime = sunLightTimer.GetAlpha();
+// Small colored lights circling the arena, culled into clusters. 'l' cycles
+// through these counts.
+const size_t dynamicLightCounts[] = {0, 64, 256, 1024};
+size_t dynamicLightCountIx = 2;
+Framework::ClusteredLights *lightClusters = NULL;
+
+// A flock of small craft over the arena, drawn with one instanced call. 'f'
+// cycles through these sizes.
+const size_t fleetSizes[] = {0, 1000, 4000};
+size_t fleetSizeIx = 1;
+const unsigned int fleetSeed = 1234;
+float fleetScale = 0.15f;
+Framework::Fleet fleet;
+GLuint fleetInstanceBuffer = 0;
+glm::vec3 fleetColor = glm::vec3(0.8f, 0.8f, 0.85f);
+
+// Ticks 60 times a second and draws at most 60 frames a second.
+Framework::FrameLoop frameLoop(60.0, 60.0);
+bool frameTimerPending = false;
+bool heldKeys[256] = {false};
+
+// Records or replays input and the simulation's clock, for --record and
+// --replay.
+Framework::InputLog &inputLog = Framework::GetInputLog();
+bool replayDiverged = false;
+
+// Without --sim-thread, display steps the simulation into serialSnapshot and
+// draws that. With it, the simulation thread publishes snapshots and display
+// draws the latest one, so neither waits for the other.
+Framework::SimulationThread simulationThread(60.0);
+Framework::TripleBuffer<FrameSnapshot> snapshots;
+FrameSnapshot serialSnapshot;
+std::vector<Framework::InputEvent> simulationInput;
+
+glm::vec4 calculateSunPosition(float seconds) {
+    float currentLoopTime = fmodf(seconds, sunLightLoopSeconds)
+        / sunLightLoopSeconds;
 
     float sunX = cosf(currentLoopTime * M_PI * 2.0f) * sunLightRadius;
     float factor;
@@ -117,44 +177,148 @@ glm::vec4 calculateSunPosition() {
     return glm::vec4(sunX, sunY, sunZ, 1.0f);
 }
 
-static void calculateUfoLightPosition() {
-    float angleInRadians = Framework::DegToRad(ufoAngleInDegrees);
-    ufoLightPosition = glm::vec3(ufoPosition.x + 6.0f * sinf(angleInRadians),
-            ufoPosition.y, ufoPosition.z + 6.0f * cosf(angleInRadians));
-}
-
-static bool newUfoPositionIsFine(glm::vec3 pos) {
-    float cubeUfoDistance = sqrtf(
-            powf(pos.x - cubePosition.x, 2.0f)
-            + powf(pos.y - cubePosition.y, 2.0f)
-            + powf(pos.z - cubePosition.z, 2.0f));
-    float cylinderUfoDistance = sqrtf(
-            powf(pos.x - cylinderPosition.x, 2.0f)
-            + powf(pos.y - cylinderPosition.y, 2.0f)
-            + powf(pos.z - cylinderPosition.z, 2.0f));
-    float sphereUfoDistance = sqrtf(
-            powf(pos.x - spherePosition.x, 2.0f)
-            + powf(pos.y - spherePosition.y, 2.0f)
-            + powf(pos.z - spherePosition.z, 2.0f));
-    return cubeUfoDistance - cubePlusUfoRadius > 0.0f
-        && cylinderUfoDistance - cylinderPlusUfoRadius > 0.0f
-        && sphereUfoDistance - spherePlusUfoRadius > 0.0f
-        && pos.x <= 50.0f - ufoRadius
-        && pos.x >= ufoRadius - 50.0f
-        && pos.y <= 50.0f - ufoRadius
-        && pos.y >= 0.0f
-        && pos.z <= 50.0f - ufoRadius
-        && pos.z >= ufoRadius - 50.0f;
-}
-
-static void calculateUfoPosition(float direction, float height_change) {
-    float angleInRadians = Framework::DegToRad(ufoAngleInDegrees);
-    glm::vec3 pos;
-    pos.z = ufoPosition.z + direction * 0.5f * cosf(angleInRadians);
-    pos.x = ufoPosition.x + direction * 0.5f * sinf(angleInRadians);
-    pos.y = ufoPosition.y + height_change;
-    if (newUfoPositionIsFine(pos)) {
-        ufoPosition = pos;
+static void calculateUfoLightPosition(const glm::vec3 &position,
+        float angleInDegrees) {
+    float angleInRadians = Framework::DegToRad(angleInDegrees);
+    ufoLightPosition = glm::vec3(position.x + 6.0f * sinf(angleInRadians),
+            position.y, position.z + 6.0f * cosf(angleInRadians));
+}
+
+static void initializeObstacles() {
+    // Shaped like the meshes: the cube is 10 units wide and tall, the
+    // cylinder 3, and the sphere has a radius of 4.5. The cylinder's rounded
+    // ends reach a little past its caps.
+    obstacleWorld.AddBody(Framework::CollisionShape::Aabb(
+            cubePosition + glm::vec3(-5.0f, 0.0f, -5.0f),
+            cubePosition + glm::vec3(5.0f, 10.0f, 5.0f)));
+    obstacleWorld.AddBody(Framework::CollisionShape::Capsule(
+            cylinderPosition + glm::vec3(1.5f, 0.0f, 1.5f),
+            cylinderPosition + glm::vec3(1.5f, 3.0f, 1.5f), 1.5f));
+    obstacleWorld.AddBody(Framework::CollisionShape::Sphere(spherePosition,
+            4.5f));
+
+    // The arena's walls and ceiling. The UFO's center may go down to the
+    // ground, so the floor is one radius below it.
+    const float wall = 10.0f;
+    const float size = arenaHalfSize + wall;
+    obstacleWorld.AddBody(Framework::CollisionShape::Aabb(
+            glm::vec3(arenaHalfSize, -size, -size), glm::vec3(size)));
+    obstacleWorld.AddBody(Framework::CollisionShape::Aabb(glm::vec3(-size),
+            glm::vec3(-arenaHalfSize, size, size)));
+    obstacleWorld.AddBody(Framework::CollisionShape::Aabb(
+            glm::vec3(-size, -size, arenaHalfSize), glm::vec3(size)));
+    obstacleWorld.AddBody(Framework::CollisionShape::Aabb(glm::vec3(-size),
+            glm::vec3(size, size, -arenaHalfSize)));
+    obstacleWorld.AddBody(Framework::CollisionShape::Aabb(
+            glm::vec3(-size, arenaHalfSize, -size), glm::vec3(size)));
+    obstacleWorld.AddBody(Framework::CollisionShape::Aabb(glm::vec3(-size),
+            glm::vec3(size, -ufoRadius, size)));
+
+    obstacleWorld.Update();
+}
+
+static void calculateUfoPosition(float distance, float height_change) {
+    float angleInRadians = Framework::DegToRad(ufoAngleInDegrees.Get());
+    glm::vec3 delta(distance * sinf(angleInRadians), height_change,
+            distance * cosf(angleInRadians));
+
+    // Stops the UFO where it touches an obstacle, rather than refusing the move.
+    Framework::SweepHit hit;
+    glm::vec3 &position = ufoPosition.Get();
+    if (obstacleWorld.SweepSphere(position, ufoRadius, delta, hit)) {
+        position = hit.position;
+    } else {
+        position += delta;
+    }
+}
+
+static float heldAxis(unsigned char positiveKey, unsigned char negativeKey) {
+    return (heldKeys[positiveKey] ? 1.0f : 0.0f)
+        - (heldKeys[negativeKey] ? 1.0f : 0.0f);
+}
+
+// One fixed step of the simulation. The UFO moves while its keys are held.
+static void simulate(double tickSeconds) {
+    PROFILE_SCOPE("simulate");
+    float seconds = (float) tickSeconds;
+    ufoPosition.BeginTick();
+    ufoAngleInDegrees.BeginTick();
+
+    ufoAngleInDegrees.Get() += heldAxis('a', 'd') * ufoTurnDegreesPerSecond
+        * seconds;
+
+    float distance = heldAxis('w', 's') * ufoSpeed * seconds;
+    float climb = heldAxis('e', 'q') * ufoClimbSpeed * seconds;
+    if (distance != 0.0f || climb != 0.0f) {
+        calculateUfoPosition(distance, climb);
+    }
+
+    fleet.Step(seconds);
+}
+
+// Every fourth light is a spot light shining down; the rest are point lights.
+// Where each one is follows from its index and the time, so replays match.
+static void updateDynamicLights(float seconds,
+        std::vector<Framework::Light> &dynamicLights) {
+    size_t count = dynamicLightCounts[dynamicLightCountIx];
+    dynamicLights.clear();
+    for (size_t i = 0; i < count; ++i) {
+        float fraction = (i + 0.5f) / count;
+        float orbitRadius = 8.0f + (arenaHalfSize - 10.0f) * fmodf(i * 0.618034f, 1.0f);
+        float angle = fraction * 2.0f * M_PI
+            + seconds * (0.2f + 0.3f * fmodf(i * 0.414214f, 1.0f));
+        glm::vec3 position(orbitRadius * cosf(angle),
+                2.0f + 10.0f * fmodf(i * 0.732051f, 1.0f),
+                orbitRadius * sinf(angle));
+
+        float hue = fmodf(i * 0.381966f, 1.0f) * 6.0f;
+        glm::vec3 color = glm::clamp(glm::vec3(fabsf(hue - 3.0f) - 1.0f,
+                    2.0f - fabsf(hue - 2.0f), 2.0f - fabsf(hue - 4.0f)),
+                0.0f, 1.0f);
+
+        if (i % 4 == 3) {
+            dynamicLights.push_back(Framework::Light::Spot(
+                        position + glm::vec3(0.0f, 6.0f, 0.0f),
+                        glm::vec3(0.0f, -1.0f, 0.0f), 20.0f, 20.0f, 30.0f,
+                        color * 3.0f));
+        } else {
+            dynamicLights.push_back(Framework::Light::Point(position, 10.0f,
+                        color * 2.0f));
+        }
+    }
+}
+
+static double inputLogClock() {
+    return inputLog.GetElapsedSeconds();
+}
+
+// Compares the simulation with the recording's, to catch a replay that has
+// stopped matching it.
+static void checkReplay() {
+    struct {
+        float ufo[4];
+        unsigned long long fleet;
+    } state = {{ufoPosition.Get().x, ufoPosition.Get().y, ufoPosition.Get().z,
+        ufoAngleInDegrees.Get()}, fleet.Hash()};
+    if (!inputLog.CheckState(&state, sizeof(state)) && !replayDiverged) {
+        replayDiverged = true;
+        printf("The replay stopped matching its recording at frame %u.\n",
+                inputLog.GetFrame());
+    }
+}
+
+static void onFrameTimer(int) {
+    frameTimerPending = false;
+    glutPostRedisplay();
+}
+
+// Asks for the next frame when it is due, so the main loop sleeps until then
+// instead of redrawing at once.
+static void scheduleNextFrame() {
+    if (!frameTimerPending) {
+        frameTimerPending = true;
+        glutTimerFunc((unsigned int) (frameLoop.GetTimeUntilNextFrame()
+                    * 1000.0), onFrameTimer, 0);
     }
 }
 
@@ -229,10 +393,24 @@ ProgramData initializeProgram(std::string vertexShader,
     return programData;
 }
 
+// The fleet's shader lights its craft as the scene's is, in world space.
+FleetProgramData initializeFleetProgram(std::string vertexShader,
+        std::string fragmentShader) {
+    FleetProgramData programData;
+    static_cast<ProgramData &>(programData) = initializeProgram(vertexShader,
+            fragmentShader);
+    programData.instanceScaleUniform = glGetUniformLocation(
+            programData.theProgram, "instanceScale");
+    return programData;
+}
+
 void initializeProgramsAndMeshes() {
+    PROFILE_SCOPE("initializeProgramsAndMeshes");
     program = initializeProgram("VertexShader.vert", "FragmentShader.frag");
     lightProgram = initializeSimpleProgram("LightVertexShader.vert",
             "LightFragmentShader.frag");
+    fleetProgram = initializeFleetProgram("FleetVertexShader.vert",
+            "FragmentShader.frag");
 
     try {
         planeMesh = new Framework::Mesh("Plane.xml");
@@ -242,35 +420,326 @@ void initializeProgramsAndMeshes() {
         cubeMesh = new Framework::Mesh("Cube.xml");
         cylinderMesh = new Framework::Mesh("Cylinder.xml");
         sphereMesh = new Framework::Mesh("BigSphere.xml");
+        fleetMesh = new Framework::Mesh("Ship.xml");
     } catch (std::exception &e) {
         printf("%s\n", e.what());
         throw;
     }
 }
 
+// Watches the shaders and meshes for hot reload. If they cannot be watched,
+// the program runs on without it, as a scene does.
+static void watchFiles() {
+    const char *shaders[] = {"VertexShader.vert", "FleetVertexShader.vert",
+        "FragmentShader.frag", "LightVertexShader.vert",
+        "LightFragmentShader.frag"};
+    Framework::Mesh *meshes[] = {planeMesh, sunMesh, ufoBodyMesh, ufoLightMesh,
+        cubeMesh, cylinderMesh, sphereMesh, fleetMesh};
+    try {
+        fileWatcher = new Framework::FileWatcher();
+        for (size_t i = 0; i < ARRAY_COUNT(shaders); ++i) {
+            fileWatcher->AddFile(Framework::FindFileOrThrow(shaders[i]));
+        }
+        for (size_t i = 0; i < ARRAY_COUNT(meshes); ++i) {
+            fileWatcher->AddFile(
+                    Framework::FindFileOrThrow(meshes[i]->GetFilename()));
+        }
+    } catch (std::exception &e) {
+        printf("Could not watch the shaders and meshes; hot reload is off.\n"
+                "%s\n", e.what());
+        delete fileWatcher;
+        fileWatcher = NULL;
+    }
+}
+
+static bool fileChanged(const std::vector<std::string> &changedFiles,
+        const std::string &filename) {
+    return std::find(changedFiles.begin(), changedFiles.end(),
+            Framework::FindFileOrThrow(filename)) != changedFiles.end();
+}
+
+static void reloadChangedFiles() {
+    if (!fileWatcher) {
+        return;
+    }
+
+    std::vector<std::string> changedFiles;
+    fileWatcher->GetChangedFiles(changedFiles);
+    if (changedFiles.empty()) {
+        return;
+    }
+
+    Framework::Mesh *meshes[] = {planeMesh, sunMesh, ufoBodyMesh, ufoLightMesh,
+        cubeMesh, cylinderMesh, sphereMesh, fleetMesh};
+    for (size_t i = 0; i < ARRAY_COUNT(meshes); ++i) {
+        if (!fileChanged(changedFiles, meshes[i]->GetFilename())) {
+            continue;
+        }
+        try {
+            meshes[i]->Reload();
+        } catch (std::exception &e) {
+            printf("%s\n", e.what());
+        }
+    }
+
+    // A shader that fails to build leaves the last good program in use.
+    if (fileChanged(changedFiles, "VertexShader.vert")
+            || fileChanged(changedFiles, "FragmentShader.frag")) {
+        try {
+            ProgramData newProgram = initializeProgram("VertexShader.vert",
+                    "FragmentShader.frag");
+            glDeleteProgram(program.theProgram);
+            program = newProgram;
+            lightClusters->SetProgramUniforms(program.theProgram);
+            glUseProgram(0);
+        } catch (std::exception &e) {
+            printf("%s\n", e.what());
+        }
+    }
+
+    if (fileChanged(changedFiles, "FleetVertexShader.vert")
+            || fileChanged(changedFiles, "FragmentShader.frag")) {
+        try {
+            FleetProgramData newFleetProgram = initializeFleetProgram(
+                    "FleetVertexShader.vert", "FragmentShader.frag");
+            glDeleteProgram(fleetProgram.theProgram);
+            fleetProgram = newFleetProgram;
+            lightClusters->SetProgramUniforms(fleetProgram.theProgram);
+            glUseProgram(0);
+        } catch (std::exception &e) {
+            printf("%s\n", e.what());
+        }
+    }
+
+    if (fileChanged(changedFiles, "LightVertexShader.vert")
+            || fileChanged(changedFiles, "LightFragmentShader.frag")) {
+        try {
+            SimpleProgramData newLightProgram = initializeSimpleProgram(
+                    "LightVertexShader.vert", "LightFragmentShader.frag");
+            glDeleteProgram(lightProgram.theProgram);
+            lightProgram = newLightProgram;
+        } catch (std::exception &e) {
+            printf("%s\n", e.what());
+        }
+    }
+}
+
+static void pressKey(unsigned char key) {
+    switch (key) {
+        case 'w':
+        case 's':
+        case 'e':
+        case 'q':
+        case 'a':
+        case 'd':
+            heldKeys[key] = true;
+            return;
+        case 'l':
+            dynamicLightCountIx = (dynamicLightCountIx + 1)
+                % ARRAY_COUNT(dynamicLightCounts);
+            printf("%u dynamic lights.\n",
+                    (unsigned int) dynamicLightCounts[dynamicLightCountIx]);
+            return;
+        case 'f':
+            fleetSizeIx = (fleetSizeIx + 1) % ARRAY_COUNT(fleetSizes);
+            fleet.Clear();
+            fleet.Spawn(fleetSizes[fleetSizeIx], fleetSeed);
+            printf("%u craft in the fleet, %d at a time.\n",
+                    (unsigned int) fleet.GetCount(),
+                    Framework::Fleet::GetSimdWidth());
+            return;
+    }
+
+    // The simulation thread leaves these to the GL thread.
+    if (!Framework::IsSimulationThreadRequested()) {
+        pressViewKey(key);
+    }
+}
+
+// Keys that only change what is drawn or reported. Returns false for others.
+static bool pressViewKey(unsigned char key) {
+    switch (key) {
+        case 't':
+            frameStats.SetEnabled(!frameStats.IsEnabled());
+            printf("Frame statistics %s.\n", frameStats.IsEnabled() ? "on" : "off");
+            return true;
+        case 'p':
+            frameStats.WriteCsv(std::cout);
+            return true;
+        case 'h':
+            frameLoop.WriteHistograms(std::cout);
+            if (simulationThread.IsRunning()) {
+                std::cout << "\n";
+                simulationThread.WriteHistograms(std::cout,
+                        frameLoop.GetWorkTimes());
+            }
+            return true;
+        case 'b':
+            Framework::WriteLightAssignmentBenchmark(std::cout, *lightClusters,
+                    2.0f * arenaHalfSize);
+            return true;
+    }
+    return false;
+}
+
+// Acts on input, whether it is live or replayed from the input log.
+static void applyInput(const Framework::InputEvent &event) {
+    switch (event.type) {
+        case Framework::InputEvent::KEY_DOWN:
+            pressKey(event.key);
+            break;
+        case Framework::InputEvent::KEY_UP:
+            heldKeys[event.key] = false;
+            break;
+        case Framework::InputEvent::MOUSE_BUTTON:
+            Framework::ForwardMouseButton(viewPole, event.button, event.state,
+                    event.x, event.y);
+            break;
+        case Framework::InputEvent::MOUSE_MOTION:
+            Framework::ForwardMouseMotion(viewPole, event.x, event.y);
+            break;
+        case Framework::InputEvent::MOUSE_WHEEL:
+            Framework::ForwardMouseWheel(viewPole, event.button, event.state,
+                    event.x, event.y);
+            break;
+        default:
+            break;
+    }
+}
+
 namespace {
+    // Live input is ignored while a replay runs.
+    void handleInput(const Framework::InputEvent &event) {
+        if (inputLog.Capture(event)) {
+            applyInput(event);
+        }
+    }
+
+    // Input goes to whichever thread runs the simulation.
+    void postInput(const Framework::InputEvent &event) {
+        if (simulationThread.IsRunning()) {
+            simulationThread.PostInput(event);
+        } else {
+            handleInput(event);
+        }
+    }
+
     void MouseMotion(int x, int y) {
-        Framework::ForwardMouseMotion(viewPole, x, y);
+        postInput(Framework::InputEvent::MouseMotion(x, y));
         glutPostRedisplay();
     }
 
     void MouseButton(int button, int state, int x, int y) {
-        Framework::ForwardMouseButton(viewPole, button, state, x, y);
+        postInput(Framework::InputEvent::MouseButton(button, state, x, y));
         glutPostRedisplay();
     }
 
     void MouseWheel(int wheel, int direction, int x, int y) {
-        Framework::ForwardMouseWheel(viewPole, wheel, direction, x, y);
+        postInput(Framework::InputEvent::MouseWheel(wheel, direction, x, y));
         glutPostRedisplay();
     }
+
+    void KeyboardUp(unsigned char key, int x, int y) {
+        postInput(Framework::InputEvent::KeyUp(key, x, y));
+    }
+}
+
+// Copies what display needs from the simulation. The UFO keeps both of its
+// last ticks, so the GL thread can blend them as late as it draws.
+static void captureSnapshot(const Framework::FrameLoop &loop,
+        FrameSnapshot &snapshot) {
+    PROFILE_SCOPE("captureSnapshot");
+    snapshot.worldToCamera = viewPole.CalcMatrix();
+    snapshot.ufoObjectMatrix = ufoObjectPole.CalcMatrix();
+    snapshot.ufoPosition = ufoPosition;
+    snapshot.ufoAngleInDegrees = ufoAngleInDegrees;
+    snapshot.alpha = loop.GetAlpha();
+    snapshot.interpolatedTime = loop.GetInterpolatedTime();
+    snapshot.tickInterval = loop.GetTickInterval();
+    snapshot.published = std::chrono::steady_clock::now();
+    updateDynamicLights((float) snapshot.interpolatedTime, snapshot.lights);
+    fleet.WriteInstances(snapshot.fleetInstances);
+}
+
+// One frame of the simulation: its input, the ticks that are due, and the
+// snapshot to draw.
+static void stepSimulation(Framework::FrameLoop &loop,
+        FrameSnapshot &snapshot) {
+    if (inputLog.IsReplayFinished()) {
+        inputLog.Stop();
+        printf("The replay has finished.\n");
+    }
+    inputLog.BeginFrame(applyInput);
+    loop.BeginFrame(simulate);
+    checkReplay();
+    captureSnapshot(loop, snapshot);
+}
+
+// Runs on the simulation thread. Input posted since the last step counts as
+// arriving between frames, as it does from GLUT.
+static void simulationThreadStep(Framework::FrameLoop &loop) {
+    simulationThread.TakeInput(simulationInput);
+    for (size_t i = 0; i < simulationInput.size(); ++i) {
+        handleInput(simulationInput[i]);
+    }
+    stepSimulation(loop, snapshots.GetWriteBuffer());
+    snapshots.Publish();
+    loop.EndFrame();
+}
+
+// Stopped before the globals it uses are destroyed, however the program ends.
+static void stopSimulationThread() {
+    try {
+        simulationThread.Stop();
+    } catch (std::exception &e) {
+        printf("%s\n", e.what());
+    }
 }
 
 void init() {
     initializeProgramsAndMeshes();
+    watchFiles();
+    initializeObstacles();
+    lightClusters = new Framework::ClusteredLights();
+    fleet.Spawn(fleetSizes[fleetSizeIx], fleetSeed);
+    glGenBuffers(1, &fleetInstanceBuffer);
+
+    // The simulation takes its time from the input log, so a replay ticks
+    // exactly as its recording did.
+    if (Framework::IsSimulationThreadRequested()) {
+        // The first snapshot is made here, so display always has one. Frames
+        // then show whichever snapshot is newest, so they are not repeatable,
+        // though a replay's simulation still is.
+        Framework::FrameLoop &simulationLoop = simulationThread.GetFrameLoop();
+        simulationLoop.SetSimulationClock(inputLogClock);
+        simulationThreadStep(simulationLoop);
+        snapshots.Acquire();
+
+        // Created first, so the pool outlives the thread at exit.
+        Framework::GetWorkerPool();
+        atexit(stopSimulationThread);
+        simulationThread.Start(simulationThreadStep);
+        frameLoop.SetPaused(true);
+    } else {
+        frameLoop.SetSimulationClock(inputLogClock);
+    }
 
-    glutMouseFunc(MouseButton);
-    glutMotionFunc(MouseMotion);
-    glutMouseWheelFunc(MouseWheel);
+    if (Framework::IsHeadless()) {
+        // Drawn as fast as possible. Without an input log to repeat the
+        // clock, each frame is one tick, so every run of a benchmark shows the
+        // same frames.
+        frameLoop.SetTargetFrameRate(0.0);
+        if (!inputLog.IsRecording() && !inputLog.IsReplaying()
+                && !simulationThread.IsRunning()) {
+            frameLoop.SetFixedFrameTime(frameLoop.GetTickInterval());
+        }
+    } else {
+        glutMouseFunc(MouseButton);
+        glutMotionFunc(MouseMotion);
+        glutMouseWheelFunc(MouseWheel);
+        glutKeyboardUpFunc(KeyboardUp);
+        glutIgnoreKeyRepeat(1);
+    }
 
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
@@ -299,11 +768,36 @@ void init() {
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
+// Sets the lights that change each frame, leaving the program in use.
+void setLightUniforms(const ProgramData &programData,
+        const glm::vec4& sunLightPositionInCameraSpace,
+        const glm::vec4& ufoLightPositionInCameraSpace) {
+    glUseProgram(programData.theProgram);
+    Framework::CountProgramBind();
+    glUniform4fv(programData.sunLightIntensityUniform, 1,
+            glm::value_ptr(glm::vec4(sunLightIntensity, 1.0f)));
+    glUniform3fv(programData.cameraSpaceSunPosition, 1,
+            glm::value_ptr(sunLightPositionInCameraSpace));
+    glUniform4fv(programData.sunAmbientIntensityUniform, 1,
+            glm::value_ptr(glm::vec4(sunAmbientIntensity, 1.0f)));
+
+    glUniform4fv(programData.ufoLightIntensityUniform, 1,
+            glm::value_ptr(glm::vec4(ufoLightIntensity, 1.0f)));
+    glUniform3fv(programData.cameraSpaceUfoPosition, 1,
+            glm::value_ptr(ufoLightPositionInCameraSpace));
+    glUniform4fv(programData.ufoAmbientIntensityUniform, 1,
+            glm::value_ptr(glm::vec4(ufoAmbientIntensity, 1.0f)));
+    glUniform1f(programData.sunAttenuationUnif, g_fSunAttenuation);
+    glUniform1f(programData.ufoAttenuationUnif, g_fUfoAttenuation);
+    glUseProgram(0);
+}
+
 void renderMesh(const Framework::Mesh* mesh,
         const glutil::MatrixStack& modelMatrix,
         const glm::vec4& sunLightPositionInCameraSpace,
         const glm::vec4& ufoLightPositionInCameraSpace,
         const glm::vec3& color) {
+    PROFILE_SCOPE("renderMesh");
 
     glm::mat4 invertedModelMatrix = glm::inverse(modelMatrix.Top());
     glm::vec4 sunLightPositionInModelSpace = invertedModelMatrix
@@ -312,6 +806,7 @@ void renderMesh(const Framework::Mesh* mesh,
         * ufoLightPositionInCameraSpace;
 
     glUseProgram(program.theProgram);
+    Framework::CountProgramBind();
     glUniformMatrix4fv(program.modelToCameraMatrixUniform, 1, GL_FALSE,
             glm::value_ptr(modelMatrix.Top()));
     glUniform3fv(program.sunLightPositionInModelSpaceUniform, 1,
@@ -324,9 +819,51 @@ void renderMesh(const Framework::Mesh* mesh,
     glUseProgram(0);
 }
 
+// Draws every craft of the fleet in one call. The craft are in world space, so
+// the lights' model space positions are their world space ones.
+void renderFleet(const std::vector<float> &fleetInstances,
+        const glutil::MatrixStack& modelMatrix,
+        const glm::vec4& sunLightPositionInCameraSpace,
+        const glm::vec4& ufoLightPositionInCameraSpace) {
+    PROFILE_SCOPE("renderFleet");
+    if (fleetInstances.empty()) {
+        return;
+    }
+
+    size_t instanceBytes = fleetInstances.size() * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, fleetInstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instanceBytes, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instanceBytes, &fleetInstances[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    Framework::CountUpload(instanceBytes);
+
+    // Set every frame, as reloading the mesh replaces its vertex array.
+    fleetMesh->SetInstanceAttribute(3, fleetInstanceBuffer, 3,
+            6 * sizeof(float), 0);
+    fleetMesh->SetInstanceAttribute(4, fleetInstanceBuffer, 3,
+            6 * sizeof(float), 3 * sizeof(float));
+
+    glm::mat4 cameraToWorld = glm::inverse(modelMatrix.Top());
+    glUseProgram(fleetProgram.theProgram);
+    Framework::CountProgramBind();
+    glUniformMatrix4fv(fleetProgram.modelToCameraMatrixUniform, 1, GL_FALSE,
+            glm::value_ptr(modelMatrix.Top()));
+    glUniform3fv(fleetProgram.sunLightPositionInModelSpaceUniform, 1,
+            glm::value_ptr(cameraToWorld * sunLightPositionInCameraSpace));
+    glUniform3fv(fleetProgram.ufoLightPositionInModelSpaceUniform, 1,
+            glm::value_ptr(cameraToWorld * ufoLightPositionInCameraSpace));
+    glUniform4fv(fleetProgram.objectColorUniform, 1,
+            glm::value_ptr(glm::vec4(fleetColor, 1.0f)));
+    glUniform1f(fleetProgram.instanceScaleUniform, fleetScale);
+    fleetMesh->RenderInstanced((int) (fleetInstances.size() / 6));
+    glUseProgram(0);
+}
+
 void renderLightMesh(const Framework::Mesh *mesh,
         const glutil::MatrixStack& modelMatrix, const glm::vec3& color) {
+    PROFILE_SCOPE("renderLightMesh");
     glUseProgram(lightProgram.theProgram);
+    Framework::CountProgramBind();
     glUniformMatrix4fv(lightProgram.modelToCameraMatrixUniform, 1, GL_FALSE,
             glm::value_ptr(modelMatrix.Top()));
     glUniform4fv(lightProgram.objectColorUniform, 1,
@@ -335,42 +872,64 @@ void renderLightMesh(const Framework::Mesh *mesh,
     glUseProgram(0);
 }
 
+// Where between its last two ticks the snapshot should be drawn. A snapshot
+// from the simulation thread is drawn later than it was made, so it is moved
+// on by the time since, up to the current tick.
+static float snapshotAlpha(const FrameSnapshot &snapshot) {
+    double late = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - snapshot.published).count();
+    return std::min(snapshot.alpha + (float) (late / snapshot.tickInterval),
+            1.0f);
+}
+
 void display() {
-    sunLightTimer.Update();
+    PROFILE_SCOPE("display");
+    frameLoop.WaitForNextFrame();
+    const FrameSnapshot *snapshot = &serialSnapshot;
+    float alpha = 0.0f;
+    if (simulationThread.IsRunning()) {
+        frameLoop.BeginFrame(Framework::FrameLoop::TickFunc());
+        snapshots.Acquire();
+        simulationThread.CountHiddenTime();
+        snapshot = &snapshots.GetReadBuffer();
+        alpha = snapshotAlpha(*snapshot);
+    } else {
+        stepSimulation(frameLoop, serialSnapshot);
+        alpha = serialSnapshot.alpha;
+    }
+    frameStats.BeginFrame();
+    reloadChangedFiles();
+
+    double drawnTime = snapshot->interpolatedTime
+        + (alpha - snapshot->alpha) * snapshot->tickInterval;
+    glm::vec3 drawnUfoPosition = snapshot->ufoPosition.Lerp(alpha);
+    float drawnUfoAngle = snapshot->ufoAngleInDegrees.Lerp(alpha);
+    calculateUfoLightPosition(drawnUfoPosition, drawnUfoAngle);
 
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     glClearDepth(1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     if (ufoBodyMesh && planeMesh && ufoLightMesh && cubeMesh && cylinderMesh
-            && sphereMesh) {
+            && sphereMesh && fleetMesh) {
         glutil::MatrixStack modelMatrix;
-        modelMatrix.SetMatrix(viewPole.CalcMatrix());
+        modelMatrix.SetMatrix(snapshot->worldToCamera);
 
-        glm::vec4 sunPosition = calculateSunPosition();
+        glm::vec4 sunPosition = calculateSunPosition((float) drawnTime);
         const glm::vec4 &sunLightPositionInCameraSpace = modelMatrix.Top()
             * sunPosition;
         const glm::vec4 &ufoLightPositionInCameraSpace = modelMatrix.Top()
             * glm::vec4(ufoLightPosition, 1.0f);
-        printf("%s\n", glm::to_string(ufoLightPositionInCameraSpace).c_str());
-
-        glUseProgram(program.theProgram);
-        glUniform4fv(program.sunLightIntensityUniform, 1,
-                glm::value_ptr(glm::vec4(sunLightIntensity, 1.0f)));
-        glUniform3fv(program.cameraSpaceSunPosition, 1,
-                glm::value_ptr(sunLightPositionInCameraSpace));
-        glUniform4fv(program.sunAmbientIntensityUniform, 1,
-                glm::value_ptr(glm::vec4(sunAmbientIntensity, 1.0f)));
-
-        glUniform4fv(program.ufoLightIntensityUniform, 1,
-                glm::value_ptr(glm::vec4(ufoLightIntensity, 1.0f)));
-        glUniform3fv(program.cameraSpaceUfoPosition, 1,
-                glm::value_ptr(ufoLightPositionInCameraSpace));
-        glUniform4fv(program.ufoAmbientIntensityUniform, 1,
-                glm::value_ptr(glm::vec4(ufoAmbientIntensity, 1.0f)));
-        glUniform1f(program.sunAttenuationUnif, g_fSunAttenuation);
-        glUniform1f(program.ufoAttenuationUnif, g_fUfoAttenuation);
-        glUseProgram(0);
+
+        lightClusters->Assign(snapshot->lights, modelMatrix.Top());
+        lightClusters->Upload();
+
+        frameStats.BeginPass("scene");
+        lightClusters->BindTextures();
+        setLightUniforms(program, sunLightPositionInCameraSpace,
+                ufoLightPositionInCameraSpace);
+        setLightUniforms(fleetProgram, sunLightPositionInCameraSpace,
+                ufoLightPositionInCameraSpace);
 
         {
             glutil::PushStack push(modelMatrix);
@@ -386,9 +945,9 @@ void display() {
 
         {
             glutil::PushStack push(modelMatrix);
-            modelMatrix.ApplyMatrix(ufoObjectPole.CalcMatrix());
-            modelMatrix.Translate(ufoPosition);
-            modelMatrix.RotateY(ufoAngleInDegrees);
+            modelMatrix.ApplyMatrix(snapshot->ufoObjectMatrix);
+            modelMatrix.Translate(drawnUfoPosition);
+            modelMatrix.RotateY(drawnUfoAngle);
             renderMesh(ufoBodyMesh, modelMatrix, sunLightPositionInCameraSpace,
                     ufoLightPositionInCameraSpace, ufoBodyColor);
         }
@@ -420,9 +979,19 @@ void display() {
             renderMesh(sphereMesh, modelMatrix, sunLightPositionInCameraSpace,
                     ufoLightPositionInCameraSpace, sphereColor);
         }
+
+        renderFleet(snapshot->fleetInstances, modelMatrix,
+                sunLightPositionInCameraSpace, ufoLightPositionInCameraSpace);
+        frameStats.EndPass();
+    }
+    frameStats.EndFrame();
+    if (Framework::IsHeadless()) {
+        frameLoop.EndFrame();
+        return;
     }
-    glutPostRedisplay();
     glutSwapBuffers();
+    frameLoop.EndFrame();
+    scheduleNextFrame();
 }
 
 void reshape(int width, int height) {
@@ -443,43 +1012,49 @@ void reshape(int width, int height) {
     glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(UnProjectionBlock),
             &unprojData);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    Framework::CountUpload(sizeof(ProjectionBlock) + sizeof(UnProjectionBlock));
+
+    lightClusters->SetProjection(45.0f, (width / (float) height), zNear, zFar);
+    lightClusters->SetProgramUniforms(program.theProgram);
+    lightClusters->SetProgramUniforms(fleetProgram.theProgram);
+    glUseProgram(0);
 
     glViewport(0, 0, (GLsizei) width, (GLsizei) height);
-    glutPostRedisplay();
+    if (!Framework::IsHeadless()) {
+        glutPostRedisplay();
+    }
 }
 
 void keyboard(unsigned char key, int x, int y) {
     switch (key) {
         case 27:
+            // The simulation thread uses the input log and writes to the
+            // profiler, so it is joined before either is touched.
+            stopSimulationThread();
+            if (Framework::profile::WriteChromeTrace("trace.json")) {
+                printf("Wrote the CPU profile to trace.json.\n");
+            }
+            inputLog.Stop();
+            delete fileWatcher;
             delete planeMesh;
             delete ufoBodyMesh;
             delete ufoLightMesh;
             delete cubeMesh;
             delete cylinderMesh;
             delete sphereMesh;
+            delete fleetMesh;
+            delete lightClusters;
+            glDeleteBuffers(1, &fleetInstanceBuffer);
             glutLeaveMainLoop();
             return;
-        case 'w':
-            calculateUfoPosition(1.0f, 0.0f);
-            break;
-        case 's':
-            calculateUfoPosition(-1.0f, 0.0f);
-            break;
-        case 'e':
-            calculateUfoPosition(0, 1.0f);
-            break;
-        case 'q':
-            calculateUfoPosition(0, -1.0f);
-            break;
-        case 'a':
-            ufoAngleInDegrees += 5.0f;
-            break;
-        case 'd':
-            ufoAngleInDegrees -= 5.0f;
-            break;
     }
-    calculateUfoLightPosition();
-    glutPostRedisplay();
+
+    // With the simulation on its own thread, keys for the GL thread are not
+    // sent to it.
+    if (simulationThread.IsRunning() && pressViewKey(key)) {
+        return;
+    }
+    postInput(Framework::InputEvent::KeyDown(key, x, y));
 }
 
 unsigned int defaults(unsigned int displayMode, int &width, int &height) {
@@ -1,9 +1,33 @@
 #ifndef _APP_H_
 #define _APP_H_
 
-static void calculateUfoLightPosition();
-static bool newUfoPositionIsFine(glm::vec3 pos);
-static void calculateUfoPosition(float direction, float height_change);
+struct FrameSnapshot;
+
+static void calculateUfoLightPosition(const glm::vec3 &position,
+        float angleInDegrees);
+static void initializeObstacles();
+static void calculateUfoPosition(float distance, float height_change);
+static float heldAxis(unsigned char positiveKey, unsigned char negativeKey);
+static void simulate(double tickSeconds);
+static void updateDynamicLights(float seconds,
+        std::vector<Framework::Light> &dynamicLights);
+static double inputLogClock();
+static void checkReplay();
+static void onFrameTimer(int value);
+static void scheduleNextFrame();
+static bool fileChanged(const std::vector<std::string> &changedFiles,
+        const std::string &filename);
+static void reloadChangedFiles();
+static void pressKey(unsigned char key);
+static bool pressViewKey(unsigned char key);
+static void applyInput(const Framework::InputEvent &event);
+static void captureSnapshot(const Framework::FrameLoop &loop,
+        FrameSnapshot &snapshot);
+static void stepSimulation(Framework::FrameLoop &loop,
+        FrameSnapshot &snapshot);
+static void simulationThreadStep(Framework::FrameLoop &loop);
+static void stopSimulationThread();
+static float snapshotAlpha(const FrameSnapshot &snapshot);
 
 struct SimpleProgramData {
     GLuint theProgram;
@@ -25,6 +49,10 @@ struct ProgramData: SimpleProgramData {
     GLuint sunAttenuationUnif;
 };
 
+struct FleetProgramData: ProgramData {
+    GLuint instanceScaleUniform;
+};
+
 struct ProjectionBlock {
     glm::mat4 cameraToClipMatrix;
 };
@@ -34,5 +62,25 @@ struct UnProjectionBlock {
     glm::ivec2 windowSize;
 };
 
+// Everything display draws that the simulation decides. The simulation
+// thread fills one while the GL thread draws another.
+struct FrameSnapshot {
+    FrameSnapshot() : alpha(0.0f), interpolatedTime(0.0), tickInterval(1.0) {}
+
+    glm::mat4 worldToCamera;
+    glm::mat4 ufoObjectMatrix;
+    Framework::Interpolated<glm::vec3> ufoPosition;
+    Framework::Interpolated<float> ufoAngleInDegrees;
+
+    // The simulation's frame loop when the snapshot was made.
+    float alpha;
+    double interpolatedTime;
+    double tickInterval;
+    std::chrono::steady_clock::time_point published;
+
+    std::vector<Framework::Light> lights;
+    std::vector<float> fleetInstances;
+};
+
 #endif
 
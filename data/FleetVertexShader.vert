@@ -0,0 +1,38 @@
+#version 330
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+
+// Per craft of a Framework::Fleet: where it is, and the unit direction it flies.
+layout(location = 3) in vec3 instancePosition;
+layout(location = 4) in vec3 instanceHeading;
+
+uniform vec4 objectColor;
+out vec3 vertexNormal;
+out vec3 positionInModelSpace;
+out vec3 cameraSpaceNormal;
+
+// The craft are placed in world space, so this is the world to camera matrix,
+// and the fragment shader's model space is world space.
+uniform mat4 modelToCameraMatrix;
+uniform float instanceScale;
+
+uniform Projection
+{
+	mat4 cameraToClipMatrix;
+};
+
+void main()
+{
+	// The mesh's +z turns to the heading, keeping its +y as near to up as it can.
+	vec3 side = cross(vec3(0.0, 1.0, 0.0), instanceHeading);
+	side = dot(side, side) > 1.0e-6 ? normalize(side) : vec3(1.0, 0.0, 0.0);
+	mat3 instanceToWorld = mat3(side, cross(instanceHeading, side), instanceHeading);
+
+	vec3 worldPosition = instancePosition + instanceToWorld * (position * instanceScale);
+	gl_Position = cameraToClipMatrix * (modelToCameraMatrix * vec4(worldPosition, 1.0));
+
+	positionInModelSpace = worldPosition;
+	vertexNormal = instanceToWorld * normal;
+	cameraSpaceNormal = mat3(modelToCameraMatrix) * vertexNormal;
+}
@@ -3,6 +3,7 @@
 uniform vec4 objectColor;
 in vec3 vertexNormal;
 in vec3 positionInModelSpace;
+in vec3 cameraSpaceNormal;
 
 out vec4 outputColor;
 
@@ -24,6 +25,16 @@ uniform UnProjection
     ivec2 windowSize;
 };
 
+// Clustered lights, as Framework::ClusteredLights uploads them. Each light is
+// three texels: camera space position and radius, intensity and the cosine of
+// the inner angle, then camera space direction and the cosine of the outer
+// angle, which is -2 for point lights.
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterIndices;
+uniform ivec3 clusterCounts;
+uniform vec2 clusterSliceScaleBias;
+
 vec3 CalcCameraSpacePosition() {
     vec4 ndcPos;
     ndcPos.xy = ((gl_FragCoord.xy / windowSize.xy) * 2.0) - 1.0;
@@ -55,6 +66,47 @@ float calculateCosAngleIncidence(vec3 lightPositionInModelSpace) {
 	return cosAngleIncidence;
 }
 
+int CalcCluster(in vec3 cameraSpacePosition) {
+    ivec2 tile = ivec2(gl_FragCoord.xy * clusterCounts.xy / windowSize.xy);
+    tile = clamp(tile, ivec2(0), clusterCounts.xy - 1);
+    int slice = int(log(-cameraSpacePosition.z) * clusterSliceScaleBias.x
+            + clusterSliceScaleBias.y);
+    slice = clamp(slice, 0, clusterCounts.z - 1);
+    return (slice * clusterCounts.y + tile.y) * clusterCounts.x + tile.x;
+}
+
+vec4 ApplyClusteredLights(in vec3 cameraSpacePosition) {
+    vec3 normal = normalize(cameraSpaceNormal);
+    uvec2 range = texelFetch(clusterRanges, CalcCluster(cameraSpacePosition)).xy;
+
+    vec3 total = vec3(0.0);
+    for (uint i = 0u; i < range.y; ++i) {
+        int lightIx = int(texelFetch(clusterIndices, int(range.x + i)).x) * 3;
+        vec4 positionRadius = texelFetch(clusterLights, lightIx);
+        vec4 intensityInner = texelFetch(clusterLights, lightIx + 1);
+        vec4 directionOuter = texelFetch(clusterLights, lightIx + 2);
+
+        vec3 toLight = positionRadius.xyz - cameraSpacePosition;
+        float distanceSqr = dot(toLight, toLight);
+        float radiusSqr = positionRadius.w * positionRadius.w;
+        vec3 lightDirection = toLight * inversesqrt(max(distanceSqr, 1e-8));
+
+        // Inverse square falloff, windowed so it reaches zero at the radius.
+        float window = clamp(1.0 - (distanceSqr * distanceSqr)
+                / (radiusSqr * radiusSqr), 0.0, 1.0);
+        float attenuation = window * window / (1.0 + 25.0 * distanceSqr / radiusSqr);
+
+        if (directionOuter.w > -1.5) {
+            attenuation *= smoothstep(directionOuter.w, intensityInner.w,
+                    dot(-lightDirection, directionOuter.xyz));
+        }
+
+        total += intensityInner.rgb * attenuation
+            * clamp(dot(normal, lightDirection), 0.0, 1.0);
+    }
+    return vec4(total, 0.0);
+}
+
 void main() {
     vec3 cameraSpacePosition = CalcCameraSpacePosition();
 
@@ -69,5 +121,6 @@ void main() {
 	outputColor =
         (objectColor * attenIntensityUfo * cosUfoAngleIncidence) +
 		(objectColor * attenIntensitySun * cosSunAngleIncidence) +
+		(objectColor * ApplyClusteredLights(cameraSpacePosition)) +
 		(objectColor * ufoAmbientIntensity);
 }
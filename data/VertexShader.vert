@@ -6,6 +6,7 @@ layout(location = 1) in vec3 normal;
 uniform vec4 objectColor;
 out vec3 vertexNormal;
 out vec3 positionInModelSpace;
+out vec3 cameraSpaceNormal;
 
 uniform mat4 modelToCameraMatrix;
 
@@ -20,4 +21,5 @@ void main()
 
 	positionInModelSpace = position;
 	vertexNormal = normal;
+	cameraSpaceNormal = mat3(modelToCameraMatrix) * normal;
 }
@@ -0,0 +1,590 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <math.h>
+#include <assert.h>
+#include <algorithm>
+#include "Bvh.h"
+#include "Profiler.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRAMEWORK_BVH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Framework
+{
+	namespace
+	{
+		const int NUM_BINS = 16;
+		const unsigned int MAX_LEAF_PRIMS = 4;
+
+		//Ranges at this depth become leaves, however many primitives they hold. Only
+		//pathological inputs get this deep, but it bounds the tree: each level of the collapsed
+		//tree can push three nodes, so this also bounds the traversal stack.
+		const int MAX_BUILD_DEPTH = 48;
+		const int TRAVERSAL_STACK_SIZE = MAX_BUILD_DEPTH * 3 + 4;
+
+		//Relative to the cost of intersecting one primitive.
+		const float TRAVERSAL_COST = 1.0f;
+
+		float SurfaceArea(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+		{
+			glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+			return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+		}
+
+		struct BuildNode
+		{
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			int left;			//Negative for leaves.
+			int right;
+			unsigned int begin;
+			unsigned int count;
+		};
+
+		struct Bin
+		{
+			Bin() : boundsMin(FLT_MAX), boundsMax(-FLT_MAX), count(0) {}
+
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			unsigned int count;
+		};
+
+		class BinaryBuilder
+		{
+		public:
+			BinaryBuilder(const std::vector<glm::vec3> &primMins, const std::vector<glm::vec3> &primMaxs,
+				std::vector<unsigned int> &primOrder)
+				: m_primMins(primMins)
+				, m_primMaxs(primMaxs)
+				, m_primOrder(primOrder)
+			{
+				m_centroids.resize(primMins.size());
+				for(size_t primIx = 0; primIx < primMins.size(); ++primIx)
+					m_centroids[primIx] = (primMins[primIx] + primMaxs[primIx]) * 0.5f;
+			}
+
+			int BuildRange(unsigned int begin, unsigned int end, int depth)
+			{
+				BuildNode node;
+				node.boundsMin = glm::vec3(FLT_MAX);
+				node.boundsMax = glm::vec3(-FLT_MAX);
+				glm::vec3 centroidMin(FLT_MAX);
+				glm::vec3 centroidMax(-FLT_MAX);
+				for(unsigned int orderIx = begin; orderIx < end; ++orderIx)
+				{
+					const unsigned int primIx = m_primOrder[orderIx];
+					node.boundsMin = glm::min(node.boundsMin, m_primMins[primIx]);
+					node.boundsMax = glm::max(node.boundsMax, m_primMaxs[primIx]);
+					centroidMin = glm::min(centroidMin, m_centroids[primIx]);
+					centroidMax = glm::max(centroidMax, m_centroids[primIx]);
+				}
+
+				node.left = -1;
+				node.right = -1;
+				node.begin = begin;
+				node.count = end - begin;
+
+				const int nodeIx = (int)m_nodes.size();
+				m_nodes.push_back(node);
+				if(node.count <= 1 || depth >= MAX_BUILD_DEPTH)
+					return nodeIx;
+
+				unsigned int mid = FindSahSplit(begin, end, node, centroidMin, centroidMax);
+
+				if(mid == begin || mid == end)
+				{
+					if(node.count <= MAX_LEAF_PRIMS)
+						return nodeIx;
+
+					//Nothing separates them, so any split is as good as another.
+					mid = begin + node.count / 2;
+				}
+
+				const int left = BuildRange(begin, mid, depth + 1);
+				const int right = BuildRange(mid, end, depth + 1);
+				m_nodes[nodeIx].left = left;
+				m_nodes[nodeIx].right = right;
+				return nodeIx;
+			}
+
+			const std::vector<BuildNode> &GetNodes() const {return m_nodes;}
+
+		private:
+			const std::vector<glm::vec3> &m_primMins;
+			const std::vector<glm::vec3> &m_primMaxs;
+			std::vector<unsigned int> &m_primOrder;
+			std::vector<glm::vec3> m_centroids;
+			std::vector<BuildNode> m_nodes;
+
+			//Returns where the range was partitioned, or begin if staying a leaf is cheaper.
+			unsigned int FindSahSplit(unsigned int begin, unsigned int end, const BuildNode &node,
+				const glm::vec3 &centroidMin, const glm::vec3 &centroidMax)
+			{
+				float bestCost = FLT_MAX;
+				int bestAxis = -1;
+				int bestBin = 0;
+
+				for(int axis = 0; axis < 3; ++axis)
+				{
+					const float extent = centroidMax[axis] - centroidMin[axis];
+					if(extent <= 0.0f)
+						continue;
+
+					const float binScale = NUM_BINS / extent;
+					Bin bins[NUM_BINS];
+					for(unsigned int orderIx = begin; orderIx < end; ++orderIx)
+					{
+						const unsigned int primIx = m_primOrder[orderIx];
+						Bin &bin = bins[BinIndex(m_centroids[primIx][axis], centroidMin[axis], binScale)];
+						bin.boundsMin = glm::min(bin.boundsMin, m_primMins[primIx]);
+						bin.boundsMax = glm::max(bin.boundsMax, m_primMaxs[primIx]);
+						++bin.count;
+					}
+
+					//The cost of everything right of each split, swept from the right.
+					float rightCosts[NUM_BINS];
+					Bin accum;
+					for(int binIx = NUM_BINS - 1; binIx > 0; --binIx)
+					{
+						accum.boundsMin = glm::min(accum.boundsMin, bins[binIx].boundsMin);
+						accum.boundsMax = glm::max(accum.boundsMax, bins[binIx].boundsMax);
+						accum.count += bins[binIx].count;
+						rightCosts[binIx] = accum.count ? accum.count * SurfaceArea(accum.boundsMin, accum.boundsMax) : 0.0f;
+					}
+
+					accum = Bin();
+					for(int split = 1; split < NUM_BINS; ++split)
+					{
+						accum.boundsMin = glm::min(accum.boundsMin, bins[split - 1].boundsMin);
+						accum.boundsMax = glm::max(accum.boundsMax, bins[split - 1].boundsMax);
+						accum.count += bins[split - 1].count;
+						if(accum.count == 0 || accum.count == node.count)
+							continue;
+
+						float cost = accum.count * SurfaceArea(accum.boundsMin, accum.boundsMax) + rightCosts[split];
+						if(cost < bestCost)
+						{
+							bestCost = cost;
+							bestAxis = axis;
+							bestBin = split;
+						}
+					}
+				}
+
+				if(bestAxis == -1)
+					return begin;
+
+				const float nodeArea = SurfaceArea(node.boundsMin, node.boundsMax);
+				const float leafCost = node.count * nodeArea;
+				const float splitCost = TRAVERSAL_COST * nodeArea + bestCost;
+				if(node.count <= MAX_LEAF_PRIMS && leafCost <= splitCost)
+					return begin;
+
+				const float binScale = NUM_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+				std::vector<unsigned int>::iterator midIt = std::partition(
+					m_primOrder.begin() + begin, m_primOrder.begin() + end, InLeftBins(*this, bestAxis,
+					centroidMin[bestAxis], binScale, bestBin));
+				return (unsigned int)(midIt - m_primOrder.begin());
+			}
+
+			static int BinIndex(float centroid, float centroidMin, float binScale)
+			{
+				return std::min((int)((centroid - centroidMin) * binScale), NUM_BINS - 1);
+			}
+
+			struct InLeftBins
+			{
+				InLeftBins(const BinaryBuilder &builder, int axis, float centroidMin, float binScale, int split)
+					: m_builder(builder), m_axis(axis), m_centroidMin(centroidMin), m_binScale(binScale), m_split(split) {}
+
+				bool operator()(unsigned int primIx) const
+				{
+					return BinIndex(m_builder.m_centroids[primIx][m_axis], m_centroidMin, m_binScale) < m_split;
+				}
+
+				const BinaryBuilder &m_builder;
+				int m_axis;
+				float m_centroidMin;
+				float m_binScale;
+				int m_split;
+			};
+		};
+
+		//Pulls the grandchildren of the largest inner children up until there are four.
+		int Collapse(const std::vector<BuildNode> &buildNodes, int buildIx, std::vector<Bvh4::Node> &nodes)
+		{
+			int children[4] = {buildIx, -1, -1, -1};
+			int numChildren = 1;
+			if(buildNodes[buildIx].left >= 0)
+			{
+				children[0] = buildNodes[buildIx].left;
+				children[1] = buildNodes[buildIx].right;
+				numChildren = 2;
+			}
+
+			while(numChildren < 4)
+			{
+				int bestChild = -1;
+				float bestArea = -1.0f;
+				for(int childIx = 0; childIx < numChildren; ++childIx)
+				{
+					const BuildNode &child = buildNodes[children[childIx]];
+					float area = SurfaceArea(child.boundsMin, child.boundsMax);
+					if(child.left >= 0 && area > bestArea)
+					{
+						bestArea = area;
+						bestChild = childIx;
+					}
+				}
+
+				if(bestChild == -1)
+					break;
+
+				const BuildNode &expanded = buildNodes[children[bestChild]];
+				children[bestChild] = expanded.left;
+				children[numChildren++] = expanded.right;
+			}
+
+			const int nodeIx = (int)nodes.size();
+			nodes.push_back(Bvh4::Node());
+			for(int lane = 0; lane < 4; ++lane)
+			{
+				Bvh4::Node &node = nodes[nodeIx];
+				node.minX[lane] = node.minY[lane] = node.minZ[lane] = FLT_MAX;
+				node.maxX[lane] = node.maxY[lane] = node.maxZ[lane] = -FLT_MAX;
+				node.child[lane] = -1;
+				node.count[lane] = 0;
+			}
+
+			for(int lane = 0; lane < numChildren; ++lane)
+			{
+				const BuildNode &child = buildNodes[children[lane]];
+				int childRef = ~(int)child.begin;
+				if(child.left >= 0)
+					childRef = Collapse(buildNodes, children[lane], nodes);
+
+				Bvh4::Node &node = nodes[nodeIx];
+				node.minX[lane] = child.boundsMin.x;
+				node.minY[lane] = child.boundsMin.y;
+				node.minZ[lane] = child.boundsMin.z;
+				node.maxX[lane] = child.boundsMax.x;
+				node.maxY[lane] = child.boundsMax.y;
+				node.maxZ[lane] = child.boundsMax.z;
+				node.child[lane] = childRef;
+				node.count[lane] = child.left >= 0 ? 0 : child.count;
+			}
+
+			return nodeIx;
+		}
+
+		//Calls leafFunc(firstPrim, primCount, tMax) for each leaf the ray reaches, nearest
+		//boxes first. leafFunc may shorten tMax.
+		template<typename LeafFunc>
+		void Traverse(const Bvh4 &bvh, const Ray &ray, float &tMax, LeafFunc &leafFunc)
+		{
+			if(bvh.empty())
+				return;
+
+			//Huge rather than infinite, so a zero offset times it stays zero.
+			float invDir[3];
+			for(int axis = 0; axis < 3; ++axis)
+			{
+				float dir = ray.direction[axis];
+				if(fabsf(dir) < 1.0e-30f)
+					dir = dir < 0.0f ? -1.0e-30f : 1.0e-30f;
+				invDir[axis] = 1.0f / dir;
+			}
+
+			const std::vector<Bvh4::Node> &nodes = bvh.GetNodes();
+			int stackNodes[TRAVERSAL_STACK_SIZE];
+			float stackDists[TRAVERSAL_STACK_SIZE];
+			int stackSize = 1;
+			stackNodes[0] = 0;
+			stackDists[0] = 0.0f;
+
+#ifdef FRAMEWORK_BVH_SSE2
+			const __m128 originX = _mm_set1_ps(ray.origin.x);
+			const __m128 originY = _mm_set1_ps(ray.origin.y);
+			const __m128 originZ = _mm_set1_ps(ray.origin.z);
+			const __m128 invDirX = _mm_set1_ps(invDir[0]);
+			const __m128 invDirY = _mm_set1_ps(invDir[1]);
+			const __m128 invDirZ = _mm_set1_ps(invDir[2]);
+#endif
+
+			while(stackSize > 0)
+			{
+				--stackSize;
+				if(stackDists[stackSize] > tMax)
+					continue;
+
+				const Bvh4::Node &node = nodes[stackNodes[stackSize]];
+				float entryDists[4];
+				int hitMask = 0;
+
+#ifdef FRAMEWORK_BVH_SSE2
+				__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), originX), invDirX);
+				__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), originX), invDirX);
+				__m128 entry = _mm_max_ps(_mm_min_ps(t0, t1), _mm_setzero_ps());
+				__m128 exit = _mm_min_ps(_mm_max_ps(t0, t1), _mm_set1_ps(tMax));
+
+				t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), originY), invDirY);
+				t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), originY), invDirY);
+				entry = _mm_max_ps(entry, _mm_min_ps(t0, t1));
+				exit = _mm_min_ps(exit, _mm_max_ps(t0, t1));
+
+				t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), originZ), invDirZ);
+				t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), originZ), invDirZ);
+				entry = _mm_max_ps(entry, _mm_min_ps(t0, t1));
+				exit = _mm_min_ps(exit, _mm_max_ps(t0, t1));
+
+				hitMask = _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+				_mm_storeu_ps(entryDists, entry);
+#else
+				for(int lane = 0; lane < 4; ++lane)
+				{
+					const float mins[3] = {node.minX[lane], node.minY[lane], node.minZ[lane]};
+					const float maxs[3] = {node.maxX[lane], node.maxY[lane], node.maxZ[lane]};
+					float entry = 0.0f;
+					float exit = tMax;
+					for(int axis = 0; axis < 3; ++axis)
+					{
+						float t0 = (mins[axis] - ray.origin[axis]) * invDir[axis];
+						float t1 = (maxs[axis] - ray.origin[axis]) * invDir[axis];
+						entry = std::max(entry, std::min(t0, t1));
+						exit = std::min(exit, std::max(t0, t1));
+					}
+
+					entryDists[lane] = entry;
+					if(entry <= exit)
+						hitMask |= 1 << lane;
+				}
+#endif
+
+				//Leaves are tested right away; inner nodes are pushed farthest first.
+				int innerLanes[4];
+				int numInner = 0;
+				for(int lane = 0; lane < 4; ++lane)
+				{
+					if(!(hitMask & (1 << lane)))
+						continue;
+
+					if(node.child[lane] >= 0)
+						innerLanes[numInner++] = lane;
+					else if(node.count[lane] > 0)
+						leafFunc((unsigned int)~node.child[lane], node.count[lane], tMax);
+				}
+
+				for(int sortIx = 1; sortIx < numInner; ++sortIx)
+				{
+					int lane = innerLanes[sortIx];
+					int insertIx = sortIx;
+					for(; insertIx > 0 && entryDists[innerLanes[insertIx - 1]] < entryDists[lane]; --insertIx)
+						innerLanes[insertIx] = innerLanes[insertIx - 1];
+					innerLanes[insertIx] = lane;
+				}
+
+				assert(stackSize + numInner <= TRAVERSAL_STACK_SIZE);
+				for(int innerIx = 0; innerIx < numInner; ++innerIx)
+				{
+					stackNodes[stackSize] = node.child[innerLanes[innerIx]];
+					stackDists[stackSize] = entryDists[innerLanes[innerIx]];
+					++stackSize;
+				}
+			}
+		}
+
+		glm::vec3 TransformPoint(const glm::mat4 &matrix, const glm::vec3 &point)
+		{
+			return glm::vec3(matrix * glm::vec4(point, 1.0f));
+		}
+	}
+
+	void Bvh4::Build( const std::vector<glm::vec3> &primMins, const std::vector<glm::vec3> &primMaxs )
+	{
+		PROFILE_SCOPE("Bvh4::Build");
+		m_nodes.clear();
+		m_primOrder.resize(primMins.size());
+		m_boundsMin = glm::vec3(0.0f);
+		m_boundsMax = glm::vec3(0.0f);
+		if(primMins.empty())
+			return;
+
+		for(size_t primIx = 0; primIx < primMins.size(); ++primIx)
+			m_primOrder[primIx] = (unsigned int)primIx;
+
+		BinaryBuilder builder(primMins, primMaxs, m_primOrder);
+		builder.BuildRange(0, (unsigned int)primMins.size(), 0);
+
+		const std::vector<BuildNode> &buildNodes = builder.GetNodes();
+		m_boundsMin = buildNodes[0].boundsMin;
+		m_boundsMax = buildNodes[0].boundsMax;
+		m_nodes.reserve(buildNodes.size() / 2 + 1);
+		Collapse(buildNodes, 0, m_nodes);
+	}
+
+	MeshBvh::MeshBvh( const MeshGeometry &geometry )
+	{
+		const size_t numTriangles = geometry.triangles.size() / 3;
+		std::vector<glm::vec3> triMins(numTriangles);
+		std::vector<glm::vec3> triMaxs(numTriangles);
+		for(size_t triIx = 0; triIx < numTriangles; ++triIx)
+		{
+			const glm::vec3 &v0 = geometry.positions[geometry.triangles[triIx * 3]];
+			const glm::vec3 &v1 = geometry.positions[geometry.triangles[triIx * 3 + 1]];
+			const glm::vec3 &v2 = geometry.positions[geometry.triangles[triIx * 3 + 2]];
+			triMins[triIx] = glm::min(v0, glm::min(v1, v2));
+			triMaxs[triIx] = glm::max(v0, glm::max(v1, v2));
+		}
+
+		m_bvh.Build(triMins, triMaxs);
+
+		const std::vector<unsigned int> &order = m_bvh.GetPrimOrder();
+		m_triangles.resize(numTriangles);
+		for(size_t orderIx = 0; orderIx < order.size(); ++orderIx)
+		{
+			const unsigned int triIx = order[orderIx];
+			const glm::vec3 &v0 = geometry.positions[geometry.triangles[triIx * 3]];
+			Triangle &tri = m_triangles[orderIx];
+			tri.v0 = v0;
+			tri.edge1 = geometry.positions[geometry.triangles[triIx * 3 + 1]] - v0;
+			tri.edge2 = geometry.positions[geometry.triangles[triIx * 3 + 2]] - v0;
+			tri.index = triIx;
+		}
+	}
+
+	namespace
+	{
+		//Moller-Trumbore, hitting both sides. Templated only because the triangle type is private.
+		template<typename TriangleType>
+		struct TriangleLeaf
+		{
+			TriangleLeaf(const Ray &_ray, const std::vector<TriangleType> &_triangles, RayHit &_hit)
+				: ray(_ray), triangles(_triangles), hit(_hit), bHit(false) {}
+
+			void operator()(unsigned int first, unsigned int count, float &tMax)
+			{
+				for(unsigned int triIx = first; triIx < first + count; ++triIx)
+				{
+					const TriangleType &tri = triangles[triIx];
+					glm::vec3 pvec = glm::cross(ray.direction, tri.edge2);
+					float det = glm::dot(tri.edge1, pvec);
+					if(fabsf(det) < 1.0e-20f)
+						continue;
+
+					float invDet = 1.0f / det;
+					glm::vec3 tvec = ray.origin - tri.v0;
+					float u = glm::dot(tvec, pvec) * invDet;
+					if(u < 0.0f || u > 1.0f)
+						continue;
+
+					glm::vec3 qvec = glm::cross(tvec, tri.edge1);
+					float v = glm::dot(ray.direction, qvec) * invDet;
+					if(v < 0.0f || u + v > 1.0f)
+						continue;
+
+					float t = glm::dot(tri.edge2, qvec) * invDet;
+					if(t < 0.0f || t >= tMax)
+						continue;
+
+					tMax = t;
+					hit.t = t;
+					hit.triangle = tri.index;
+					hit.u = u;
+					hit.v = v;
+					bHit = true;
+				}
+			}
+
+			const Ray &ray;
+			const std::vector<TriangleType> &triangles;
+			RayHit &hit;
+			bool bHit;
+		};
+	}
+
+	bool MeshBvh::Intersect( const Ray &ray, RayHit &hit ) const
+	{
+		float tMax = std::min(ray.tMax, hit.t);
+		TriangleLeaf<Triangle> leaf(ray, m_triangles, hit);
+		Traverse(m_bvh, ray, tMax, leaf);
+		return leaf.bHit;
+	}
+
+	void InstanceBvh::Build( const std::vector<Instance> &instances )
+	{
+		PROFILE_SCOPE("InstanceBvh::Build");
+		std::vector<glm::vec3> instMins;
+		std::vector<glm::vec3> instMaxs;
+		std::vector<PlacedInstance> placed;
+		for(size_t instIx = 0; instIx < instances.size(); ++instIx)
+		{
+			const Instance &inst = instances[instIx];
+			const glm::vec3 &boundsMin = inst.pMesh->GetBoundsMin();
+			const glm::vec3 &boundsMax = inst.pMesh->GetBoundsMax();
+			if(glm::any(glm::greaterThan(boundsMin, boundsMax)) || boundsMin == boundsMax)
+				continue;
+
+			glm::vec3 worldMin(FLT_MAX);
+			glm::vec3 worldMax(-FLT_MAX);
+			for(int cornerIx = 0; cornerIx < 8; ++cornerIx)
+			{
+				glm::vec3 corner(
+					(cornerIx & 1) ? boundsMax.x : boundsMin.x,
+					(cornerIx & 2) ? boundsMax.y : boundsMin.y,
+					(cornerIx & 4) ? boundsMax.z : boundsMin.z);
+				corner = TransformPoint(inst.modelToWorld, corner);
+				worldMin = glm::min(worldMin, corner);
+				worldMax = glm::max(worldMax, corner);
+			}
+
+			PlacedInstance placedInst;
+			placedInst.pMesh = inst.pMesh;
+			placedInst.worldToModel = glm::inverse(inst.modelToWorld);
+			placedInst.index = (unsigned int)instIx;
+			placed.push_back(placedInst);
+			instMins.push_back(worldMin);
+			instMaxs.push_back(worldMax);
+		}
+
+		m_bvh.Build(instMins, instMaxs);
+
+		const std::vector<unsigned int> &order = m_bvh.GetPrimOrder();
+		m_instances.resize(placed.size());
+		for(size_t orderIx = 0; orderIx < order.size(); ++orderIx)
+			m_instances[orderIx] = placed[order[orderIx]];
+	}
+
+	bool InstanceBvh::Intersect( const Ray &ray, RayHit &hit ) const
+	{
+		float tMax = std::min(ray.tMax, hit.t);
+		bool bHit = false;
+
+		//Directions are transformed without normalizing, so distances carry over unchanged.
+		auto leafFunc = [&](unsigned int first, unsigned int count, float &leafTMax)
+		{
+			for(unsigned int instIx = first; instIx < first + count; ++instIx)
+			{
+				const PlacedInstance &inst = m_instances[instIx];
+				Ray localRay(TransformPoint(inst.worldToModel, ray.origin),
+					glm::mat3(inst.worldToModel) * ray.direction, leafTMax);
+
+				RayHit localHit;
+				if(inst.pMesh->Intersect(localRay, localHit))
+				{
+					leafTMax = localHit.t;
+					hit = localHit;
+					hit.instance = inst.index;
+					bHit = true;
+				}
+			}
+		};
+
+		Traverse(m_bvh, ray, tMax, leafFunc);
+		return bHit;
+	}
+}
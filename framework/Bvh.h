@@ -0,0 +1,130 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_BVH_H
+#define FRAMEWORK_BVH_H
+
+#include <float.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+
+namespace Framework
+{
+	struct Ray
+	{
+		Ray(const glm::vec3 &_origin, const glm::vec3 &_direction, float _tMax = FLT_MAX)
+			: origin(_origin), direction(_direction), tMax(_tMax) {}
+
+		glm::vec3 origin;
+		glm::vec3 direction;	//Need not be normalized; distances are in units of its length.
+		float tMax;
+	};
+
+	struct RayHit
+	{
+		RayHit() : t(FLT_MAX), instance(NO_HIT), triangle(NO_HIT), u(0.0f), v(0.0f) {}
+
+		enum {NO_HIT = 0xFFFFFFFF};
+
+		bool IsHit() const {return triangle != NO_HIT;}
+
+		float t;
+		unsigned int instance;	//Only set by InstanceBvh.
+		unsigned int triangle;	//Index of the triangle in its MeshGeometry.
+		float u;				//Weight of the triangle's second vertex.
+		float v;				//Weight of the triangle's third vertex.
+	};
+
+	/**
+	A bounding volume hierarchy with four children per node.
+
+	It is built top-down with a binned surface area heuristic, as a binary tree that is then
+	collapsed so each node holds four child boxes side by side. Traversal tests a ray against
+	all four at once with SSE. Leaves hold up to four primitives, except where the tree
+	reaches its depth limit, which only pathological inputs do.
+	**/
+	class Bvh4
+	{
+	public:
+		struct Node
+		{
+			float minX[4], minY[4], minZ[4];
+			float maxX[4], maxY[4], maxZ[4];
+			int child[4];			//An inner node's index, or the complement of a leaf's first primitive.
+			unsigned int count[4];	//Primitives in a leaf child. Zero for inner and empty children.
+		};
+
+		//Primitives are given as boxes. Afterwards, GetPrimOrder lists them in leaf order.
+		void Build(const std::vector<glm::vec3> &primMins, const std::vector<glm::vec3> &primMaxs);
+
+		const std::vector<Node> &GetNodes() const {return m_nodes;}
+		const std::vector<unsigned int> &GetPrimOrder() const {return m_primOrder;}
+
+		bool empty() const {return m_nodes.empty();}
+		const glm::vec3 &GetBoundsMin() const {return m_boundsMin;}
+		const glm::vec3 &GetBoundsMax() const {return m_boundsMax;}
+
+	private:
+		std::vector<Node> m_nodes;
+		std::vector<unsigned int> m_primOrder;
+		glm::vec3 m_boundsMin;
+		glm::vec3 m_boundsMax;
+	};
+
+	//Finds the nearest triangle of one mesh along a ray, in the mesh's model space.
+	class MeshBvh
+	{
+	public:
+		explicit MeshBvh(const MeshGeometry &geometry);
+
+		//Only hits closer than both ray.tMax and hit.t are reported. Returns true if hit changed.
+		bool Intersect(const Ray &ray, RayHit &hit) const;
+
+		const glm::vec3 &GetBoundsMin() const {return m_bvh.GetBoundsMin();}
+		const glm::vec3 &GetBoundsMax() const {return m_bvh.GetBoundsMax();}
+
+	private:
+		//Stored in leaf order, ready for the intersection test.
+		struct Triangle
+		{
+			glm::vec3 v0;
+			glm::vec3 edge1;
+			glm::vec3 edge2;
+			unsigned int index;
+		};
+
+		Bvh4 m_bvh;
+		std::vector<Triangle> m_triangles;
+	};
+
+	//Finds the nearest triangle among placed copies of meshes.
+	class InstanceBvh
+	{
+	public:
+		struct Instance
+		{
+			const MeshBvh *pMesh;	//Unmanaged; must outlive the next Build.
+			glm::mat4 modelToWorld;
+		};
+
+		void Build(const std::vector<Instance> &instances);
+
+		//Sets hit.instance to the index of the instance in the array given to Build.
+		bool Intersect(const Ray &ray, RayHit &hit) const;
+
+	private:
+		struct PlacedInstance
+		{
+			const MeshBvh *pMesh;
+			glm::mat4 worldToModel;
+			unsigned int index;
+		};
+
+		Bvh4 m_bvh;
+		std::vector<PlacedInstance> m_instances;	//In leaf order.
+	};
+}
+
+#endif //FRAMEWORK_BVH_H
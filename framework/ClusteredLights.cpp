@@ -0,0 +1,484 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+#include <glload/gl_3_3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "framework.h"
+#include "ClusteredLights.h"
+#include "FrameStats.h"
+#include "Profiler.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRAMEWORK_CLUSTERED_LIGHTS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Framework
+{
+	namespace
+	{
+		//Padding columns are placed here, so the distance to them overflows to infinity.
+		const float FAR_AWAY = 1.0e30f;
+
+		//Spot lights with a cosine of their outer angle below this are point lights to the shader.
+		const float POINT_LIGHT_COS = -2.0f;
+
+		int ClampIndex(float value, int count)
+		{
+			if(value < 0.0f)
+				return 0;
+			if(value >= (float)count)
+				return count - 1;
+			return (int)value;
+		}
+
+		//The tiles an interval of NDC, from -1 to 1, touches. False if it is off-screen.
+		bool GetTileRange(float ndcMin, float ndcMax, int tiles, int &first, int &last)
+		{
+			if(ndcMax < -1.0f || ndcMin > 1.0f)
+				return false;
+
+			first = ClampIndex((ndcMin + 1.0f) * 0.5f * tiles, tiles);
+			last = ClampIndex((ndcMax + 1.0f) * 0.5f * tiles, tiles);
+			return true;
+		}
+
+		float Squared(float value)
+		{
+			return value * value;
+		}
+
+		//How far a value is outside of an interval.
+		float DistanceOutside(float value, float minValue, float maxValue)
+		{
+			return std::max(std::max(minValue - value, value - maxValue), 0.0f);
+		}
+
+		//The smallest sphere around the cone a spot light lights.
+		void GetSpotBounds(const Light &light, glm::vec3 &center, float &radius)
+		{
+			float cosAngle = light.cosOuterAngle;
+			if(cosAngle <= 0.0f)
+			{
+				center = light.position;
+				radius = light.radius;
+			}
+			else if(cosAngle < 0.70710678f)
+			{
+				//Wider than 45 degrees: the cap's rim bounds it.
+				center = light.position + light.direction * (light.radius * cosAngle);
+				radius = light.radius * sqrtf(1.0f - cosAngle * cosAngle);
+			}
+			else
+			{
+				//Narrower: the sphere through the apex and the cap's rim.
+				radius = light.radius / (2.0f * cosAngle);
+				center = light.position + light.direction * radius;
+			}
+		}
+	}
+
+	Light Light::Point( const glm::vec3 &position, float radius, const glm::vec3 &intensity )
+	{
+		Light light;
+		light.type = POINT;
+		light.position = position;
+		light.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+		light.radius = radius;
+		light.cosInnerAngle = -1.0f;
+		light.cosOuterAngle = -1.0f;
+		light.intensity = intensity;
+		return light;
+	}
+
+	Light Light::Spot( const glm::vec3 &position, const glm::vec3 &direction, float radius,
+		float innerAngle, float outerAngle, const glm::vec3 &intensity )
+	{
+		if(innerAngle > outerAngle)
+			throw std::runtime_error("A spot light's inner angle cannot be wider than its outer angle.");
+
+		Light light = Point(position, radius, intensity);
+		light.type = SPOT;
+		light.direction = glm::normalize(direction);
+		light.cosInnerAngle = cosf(DegToRad(innerAngle));
+		light.cosOuterAngle = cosf(DegToRad(outerAngle));
+		return light;
+	}
+
+	ClusteredLights::ClusteredLights( int tilesX, int tilesY, int slices, GLuint firstTextureUnit )
+		: m_tilesX(tilesX)
+		, m_tilesY(tilesY)
+		, m_slices(slices)
+		, m_firstTextureUnit(firstTextureUnit)
+		, m_zNear(1.0f)
+		, m_zFar(1000.0f)
+		, m_projectionX(1.0f)
+		, m_projectionY(1.0f)
+		, m_paddedTilesX((tilesX + 3) & ~3)
+		, m_visibleLights(0)
+	{
+		if(tilesX <= 0 || tilesY <= 0 || slices <= 0)
+			throw std::runtime_error("Light clusters need at least one tile and one slice.");
+
+		for(int bufferIx = 0; bufferIx < NUM_TEXTURE_UNITS; ++bufferIx)
+		{
+			m_buffers[bufferIx] = 0;
+			m_textures[bufferIx] = 0;
+		}
+
+		m_clusterRanges.assign(GetClusterCount() * 2, 0);
+		SetProjection(45.0f, 1.0f, m_zNear, m_zFar);
+	}
+
+	ClusteredLights::~ClusteredLights()
+	{
+		if(m_buffers[0])
+		{
+			glDeleteTextures(NUM_TEXTURE_UNITS, m_textures);
+			glDeleteBuffers(NUM_TEXTURE_UNITS, m_buffers);
+		}
+	}
+
+	void ClusteredLights::SetProjection( float fovY, float aspectRatio, float zNear, float zFar )
+	{
+		if(zNear <= 0.0f || zFar <= zNear)
+			throw std::runtime_error("Light clusters need a near plane in front of the camera, and a far plane past it.");
+
+		float focalLength = 1.0f / tanf(DegToRad(fovY) * 0.5f);
+		m_projectionX = focalLength / aspectRatio;
+		m_projectionY = focalLength;
+		m_zNear = zNear;
+		m_zFar = zFar;
+		BuildClusterBounds();
+	}
+
+	void ClusteredLights::BuildClusterBounds()
+	{
+		m_sliceDepths.resize(m_slices + 1);
+		for(int sliceIx = 0; sliceIx <= m_slices; ++sliceIx)
+			m_sliceDepths[sliceIx] = m_zNear * powf(m_zFar / m_zNear, sliceIx / (float)m_slices);
+
+		m_columnMinX.assign(m_slices * m_paddedTilesX, FAR_AWAY);
+		m_columnMaxX.assign(m_slices * m_paddedTilesX, FAR_AWAY);
+		m_rowMinY.resize(m_slices * m_tilesY);
+		m_rowMaxY.resize(m_slices * m_tilesY);
+
+		//A tile's sides lean outwards, so its box is widest at whichever end is farther.
+		for(int sliceIx = 0; sliceIx < m_slices; ++sliceIx)
+		{
+			float nearDepth = m_sliceDepths[sliceIx];
+			float farDepth = m_sliceDepths[sliceIx + 1];
+
+			for(int column = 0; column < m_tilesX; ++column)
+			{
+				float ndcMin = -1.0f + 2.0f * column / m_tilesX;
+				float ndcMax = -1.0f + 2.0f * (column + 1) / m_tilesX;
+				int boundsIx = sliceIx * m_paddedTilesX + column;
+				m_columnMinX[boundsIx] = ndcMin * (ndcMin < 0.0f ? farDepth : nearDepth) / m_projectionX;
+				m_columnMaxX[boundsIx] = ndcMax * (ndcMax > 0.0f ? farDepth : nearDepth) / m_projectionX;
+			}
+
+			for(int row = 0; row < m_tilesY; ++row)
+			{
+				float ndcMin = -1.0f + 2.0f * row / m_tilesY;
+				float ndcMax = -1.0f + 2.0f * (row + 1) / m_tilesY;
+				int boundsIx = sliceIx * m_tilesY + row;
+				m_rowMinY[boundsIx] = ndcMin * (ndcMin < 0.0f ? farDepth : nearDepth) / m_projectionY;
+				m_rowMaxY[boundsIx] = ndcMax * (ndcMax > 0.0f ? farDepth : nearDepth) / m_projectionY;
+			}
+		}
+	}
+
+	void ClusteredLights::Assign( const std::vector<Light> &lights, const glm::mat4 &worldToCamera )
+	{
+		PROFILE_SCOPE("ClusteredLights::Assign");
+
+		if(lights.size() > MAX_LIGHTS)
+			throw std::runtime_error("Too many lights to cluster.");
+
+		m_hitClusters.clear();
+		m_hitLights.clear();
+		m_visibleLights = 0;
+
+		m_lightTexels.resize(lights.size() * TEXELS_PER_LIGHT);
+		glm::mat3 rotation(worldToCamera);
+		for(size_t lightIx = 0; lightIx < lights.size(); ++lightIx)
+		{
+			const Light &light = lights[lightIx];
+			glm::vec3 position(worldToCamera * glm::vec4(light.position, 1.0f));
+			glm::vec3 direction = rotation * light.direction;
+
+			glm::vec4 *pTexels = &m_lightTexels[lightIx * TEXELS_PER_LIGHT];
+			pTexels[0] = glm::vec4(position, light.radius);
+			pTexels[1] = glm::vec4(light.intensity, light.cosInnerAngle);
+			pTexels[2] = glm::vec4(direction,
+				light.type == Light::SPOT ? light.cosOuterAngle : POINT_LIGHT_COS);
+
+			glm::vec3 center = position;
+			float radius = light.radius;
+			if(light.type == Light::SPOT)
+			{
+				Light cameraLight = light;
+				cameraLight.position = position;
+				cameraLight.direction = direction;
+				GetSpotBounds(cameraLight, center, radius);
+			}
+
+			AssignSphere((unsigned short)lightIx, center, radius);
+		}
+
+		//Counting sort by cluster. Each cluster's lights stay in the order they were given.
+		int clusterCount = GetClusterCount();
+		std::fill(m_clusterRanges.begin(), m_clusterRanges.end(), 0);
+		for(size_t hitIx = 0; hitIx < m_hitClusters.size(); ++hitIx)
+			++m_clusterRanges[m_hitClusters[hitIx] * 2 + 1];
+
+		unsigned int start = 0;
+		for(int clusterIx = 0; clusterIx < clusterCount; ++clusterIx)
+		{
+			m_clusterRanges[clusterIx * 2] = start;
+			start += m_clusterRanges[clusterIx * 2 + 1];
+		}
+
+		m_indices.resize(m_hitClusters.size());
+		for(size_t hitIx = 0; hitIx < m_hitClusters.size(); ++hitIx)
+		{
+			unsigned int &next = m_clusterRanges[m_hitClusters[hitIx] * 2];
+			m_indices[next++] = m_hitLights[hitIx];
+		}
+
+		//The starts were moved past each cluster's lights; move them back.
+		for(int clusterIx = 0; clusterIx < clusterCount; ++clusterIx)
+			m_clusterRanges[clusterIx * 2] -= m_clusterRanges[clusterIx * 2 + 1];
+	}
+
+	void ClusteredLights::AssignSphere( unsigned short lightIx, const glm::vec3 &center, float radius )
+	{
+		//Depths are positive distances in front of the camera, which looks down -Z.
+		float minDepth = std::max(-center.z - radius, m_zNear);
+		float maxDepth = std::min(-center.z + radius, m_zFar);
+		if(minDepth > maxDepth)
+			return;
+
+		++m_visibleLights;
+
+		float sliceScale = m_slices / logf(m_zFar / m_zNear);
+		int firstSlice = ClampIndex(logf(minDepth / m_zNear) * sliceScale, m_slices);
+		int lastSlice = ClampIndex(logf(maxDepth / m_zNear) * sliceScale, m_slices);
+		float radiusSqr = radius * radius;
+
+#ifdef FRAMEWORK_CLUSTERED_LIGHTS_SSE2
+		const __m128 centerX = _mm_set1_ps(center.x);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 radiusSqrSimd = _mm_set1_ps(radiusSqr);
+#endif
+
+		for(int sliceIx = firstSlice; sliceIx <= lastSlice; ++sliceIx)
+		{
+			//The part of the sphere's box in this slice, projected conservatively.
+			float nearDepth = std::max(m_sliceDepths[sliceIx], minDepth);
+			float farDepth = std::min(m_sliceDepths[sliceIx + 1], maxDepth);
+
+			float minX = center.x - radius;
+			float maxX = center.x + radius;
+			float minY = center.y - radius;
+			float maxY = center.y + radius;
+			int firstColumn, lastColumn, firstRow, lastRow;
+			if(!GetTileRange(m_projectionX * std::min(minX / nearDepth, minX / farDepth),
+					m_projectionX * std::max(maxX / nearDepth, maxX / farDepth),
+					m_tilesX, firstColumn, lastColumn) ||
+				!GetTileRange(m_projectionY * std::min(minY / nearDepth, minY / farDepth),
+					m_projectionY * std::max(maxY / nearDepth, maxY / farDepth),
+					m_tilesY, firstRow, lastRow))
+			{
+				continue;
+			}
+
+			float depthDistSqr = Squared(DistanceOutside(-center.z,
+				m_sliceDepths[sliceIx], m_sliceDepths[sliceIx + 1]));
+			const float *pMinX = &m_columnMinX[sliceIx * m_paddedTilesX];
+			const float *pMaxX = &m_columnMaxX[sliceIx * m_paddedTilesX];
+
+			for(int row = firstRow; row <= lastRow; ++row)
+			{
+				int boundsIx = sliceIx * m_tilesY + row;
+				float rowDistSqr = depthDistSqr +
+					Squared(DistanceOutside(center.y, m_rowMinY[boundsIx], m_rowMaxY[boundsIx]));
+				if(rowDistSqr > radiusSqr)
+					continue;
+
+				unsigned int rowCluster = GetClusterIndex(0, row, sliceIx);
+
+#ifdef FRAMEWORK_CLUSTERED_LIGHTS_SSE2
+				//Four columns at a time, from a multiple of four. Columns outside the range are
+				//masked off, so the results match the scalar path.
+				const __m128 rowDist = _mm_set1_ps(rowDistSqr);
+				for(int column = firstColumn & ~3; column <= lastColumn; column += 4)
+				{
+					__m128 below = _mm_sub_ps(_mm_loadu_ps(pMinX + column), centerX);
+					__m128 above = _mm_sub_ps(centerX, _mm_loadu_ps(pMaxX + column));
+					__m128 dist = _mm_max_ps(_mm_max_ps(below, above), zero);
+					__m128 distSqr = _mm_add_ps(_mm_mul_ps(dist, dist), rowDist);
+					int mask = _mm_movemask_ps(_mm_cmple_ps(distSqr, radiusSqrSimd));
+					if(column < firstColumn)
+						mask &= ~((1 << (firstColumn - column)) - 1);
+					if(column + 3 > lastColumn)
+						mask &= (1 << (lastColumn - column + 1)) - 1;
+					for(; mask; mask &= mask - 1)
+					{
+						int lane = 0;
+						while(!(mask & (1 << lane)))
+							++lane;
+						m_hitClusters.push_back(rowCluster + column + lane);
+						m_hitLights.push_back(lightIx);
+					}
+				}
+#else
+				for(int column = firstColumn; column <= lastColumn; ++column)
+				{
+					float distSqr = rowDistSqr +
+						Squared(DistanceOutside(center.x, pMinX[column], pMaxX[column]));
+					if(distSqr <= radiusSqr)
+					{
+						m_hitClusters.push_back(rowCluster + column);
+						m_hitLights.push_back(lightIx);
+					}
+				}
+#endif
+			}
+		}
+	}
+
+	const unsigned short *ClusteredLights::GetClusterLights( int clusterIx, size_t &count ) const
+	{
+		count = m_clusterRanges[clusterIx * 2 + 1];
+		return count ? &m_indices[m_clusterRanges[clusterIx * 2]] : NULL;
+	}
+
+	void ClusteredLights::Upload()
+	{
+		PROFILE_SCOPE("ClusteredLights::Upload");
+
+		if(!m_buffers[0])
+		{
+			const GLenum formats[NUM_TEXTURE_UNITS] = {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+			glGenBuffers(NUM_TEXTURE_UNITS, m_buffers);
+			glGenTextures(NUM_TEXTURE_UNITS, m_textures);
+			for(int bufferIx = 0; bufferIx < NUM_TEXTURE_UNITS; ++bufferIx)
+			{
+				glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[bufferIx]);
+				glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+				glBindTexture(GL_TEXTURE_BUFFER, m_textures[bufferIx]);
+				glTexBuffer(GL_TEXTURE_BUFFER, formats[bufferIx], m_buffers[bufferIx]);
+			}
+			glBindTexture(GL_TEXTURE_BUFFER, 0);
+		}
+
+		const void *data[NUM_TEXTURE_UNITS] = {
+			m_lightTexels.empty() ? NULL : &m_lightTexels[0],
+			&m_clusterRanges[0],
+			m_indices.empty() ? NULL : &m_indices[0],
+		};
+		const size_t bytes[NUM_TEXTURE_UNITS] = {
+			m_lightTexels.size() * sizeof(glm::vec4),
+			m_clusterRanges.size() * sizeof(unsigned int),
+			m_indices.size() * sizeof(unsigned short),
+		};
+
+		//Orphans the old storage, so drawing from it does not stall the upload. Buffer textures
+		//cannot be empty, so there is always a little.
+		for(int bufferIx = 0; bufferIx < NUM_TEXTURE_UNITS; ++bufferIx)
+		{
+			glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[bufferIx]);
+			glBufferData(GL_TEXTURE_BUFFER, std::max(bytes[bufferIx], (size_t)16), NULL, GL_STREAM_DRAW);
+			if(bytes[bufferIx])
+				glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes[bufferIx], data[bufferIx]);
+			CountUpload(bytes[bufferIx]);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	void ClusteredLights::BindTextures() const
+	{
+		for(int bufferIx = 0; bufferIx < NUM_TEXTURE_UNITS; ++bufferIx)
+		{
+			glActiveTexture(GL_TEXTURE0 + m_firstTextureUnit + bufferIx);
+			glBindTexture(GL_TEXTURE_BUFFER, m_textures[bufferIx]);
+			CountTextureBind();
+		}
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	void ClusteredLights::SetProgramUniforms( GLuint program ) const
+	{
+		const char *samplers[NUM_TEXTURE_UNITS] = {"clusterLights", "clusterRanges", "clusterIndices"};
+
+		glUseProgram(program);
+		for(int bufferIx = 0; bufferIx < NUM_TEXTURE_UNITS; ++bufferIx)
+			glUniform1i(glGetUniformLocation(program, samplers[bufferIx]), m_firstTextureUnit + bufferIx);
+
+		//The shader finds its slice as log(depth) * scale + bias.
+		float sliceScale = m_slices / logf(m_zFar / m_zNear);
+		glUniform3i(glGetUniformLocation(program, "clusterCounts"), m_tilesX, m_tilesY, m_slices);
+		glUniform2f(glGetUniformLocation(program, "clusterSliceScaleBias"),
+			sliceScale, -logf(m_zNear) * sliceScale);
+	}
+
+	void WriteLightAssignmentBenchmark( std::ostream &out, ClusteredLights &clusters, float sceneSize )
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		out << "lights,visible,indices,assign-ms\n";
+		for(size_t lightCount = 16; lightCount <= 4096; lightCount *= 2)
+		{
+			//The same lights every run: a simple LCG, not rand(), which varies by platform.
+			std::vector<Light> lights;
+			unsigned int seed = 12345;
+			for(size_t lightIx = 0; lightIx < lightCount; ++lightIx)
+			{
+				float values[6];
+				for(int valueIx = 0; valueIx < 6; ++valueIx)
+				{
+					seed = seed * 1664525u + 1013904223u;
+					values[valueIx] = (seed >> 8) / 16777216.0f;
+				}
+
+				glm::vec3 position((values[0] - 0.5f) * sceneSize, (values[1] - 0.5f) * sceneSize,
+					-values[2] * sceneSize);
+				float radius = sceneSize * (0.02f + 0.06f * values[3]);
+				glm::vec3 intensity(1.0f);
+				if(lightIx % 4 == 3)
+				{
+					glm::vec3 direction(values[4] - 0.5f, -1.0f, values[5] - 0.5f);
+					lights.push_back(Light::Spot(position, direction, radius, 20.0f, 30.0f, intensity));
+				}
+				else
+					lights.push_back(Light::Point(position, radius, intensity));
+			}
+
+			//Enough runs for the clock's resolution not to matter.
+			int runs = 0;
+			Clock::time_point start = Clock::now();
+			Clock::duration elapsed;
+			do
+			{
+				clusters.Assign(lights, glm::mat4(1.0f));
+				++runs;
+				elapsed = Clock::now() - start;
+			} while(runs < 5 || elapsed < std::chrono::milliseconds(50));
+
+			out << lightCount << "," << clusters.GetVisibleLightCount() << "," <<
+				clusters.GetLightIndexCount() << "," <<
+				std::chrono::duration<double, std::milli>(elapsed).count() / runs << "\n";
+		}
+	}
+}
@@ -0,0 +1,153 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_CLUSTERED_LIGHTS_H
+#define FRAMEWORK_CLUSTERED_LIGHTS_H
+
+#include <vector>
+#include <ostream>
+#include <glm/glm.hpp>
+
+namespace Framework
+{
+	//A point or spot light, which lights nothing past its radius.
+	struct Light
+	{
+		enum Type
+		{
+			POINT,
+			SPOT,
+		};
+
+		static Light Point(const glm::vec3 &position, float radius, const glm::vec3 &intensity);
+
+		//The angles are from the direction to the edge of the cone, in degrees. The light fades
+		//out between the inner and outer angles.
+		static Light Spot(const glm::vec3 &position, const glm::vec3 &direction, float radius,
+			float innerAngle, float outerAngle, const glm::vec3 &intensity);
+
+		Type type;
+		glm::vec3 position;
+		glm::vec3 direction;
+		float radius;
+		float cosInnerAngle;
+		float cosOuterAngle;
+		glm::vec3 intensity;
+	};
+
+	/**
+	Finds the lights that can reach each part of the view, so a forward shader only has to
+	loop over those.
+
+	The view frustum is cut into clusters: a grid of tiles on screen, and slices in depth that
+	get exponentially thicker with distance. Each light's bounding sphere is tested against
+	the boxes around the clusters it might touch, four tiles at a time with SSE2 where it is
+	available. The results are a list of light indices per cluster.
+
+	Upload puts the lights, the clusters' ranges in the index list, and the index list itself
+	in buffer textures. A fragment shader finds its cluster from gl_FragCoord and its camera
+	space depth, as data/FragmentShader.frag does. The lights are uploaded in camera space.
+
+	Assign uses no OpenGL, so it can be tested and timed without a context.
+	**/
+	class ClusteredLights
+	{
+	public:
+		enum
+		{
+			//The buffer textures are bound to this many units, from the first one given.
+			NUM_TEXTURE_UNITS = 3,
+
+			//Texels of RGBA32F per light.
+			TEXELS_PER_LIGHT = 3,
+
+			//Light indices are uploaded as 16-bit integers.
+			MAX_LIGHTS = 65535,
+		};
+
+		ClusteredLights(int tilesX = 16, int tilesY = 9, int slices = 24,
+			GLuint firstTextureUnit = 4);
+		~ClusteredLights();
+
+		//Must match the projection used to draw. The field of view is vertical, in degrees.
+		void SetProjection(float fovY, float aspectRatio, float zNear, float zFar);
+
+		//Finds the clusters each light reaches. The lights are in world space.
+		void Assign(const std::vector<Light> &lights, const glm::mat4 &worldToCamera);
+
+		int GetTilesX() const {return m_tilesX;}
+		int GetTilesY() const {return m_tilesY;}
+		int GetSlices() const {return m_slices;}
+		int GetClusterCount() const {return m_tilesX * m_tilesY * m_slices;}
+
+		//Clusters are ordered by tile column, then tile row, then slice. Tile 0, 0 is at the
+		//bottom left of the screen, and slice 0 is nearest.
+		int GetClusterIndex(int tileX, int tileY, int slice) const
+		{
+			return (slice * m_tilesY + tileY) * m_tilesX + tileX;
+		}
+
+		//The lights reaching a cluster, as indices into the lights given to Assign.
+		const unsigned short *GetClusterLights(int clusterIx, size_t &count) const;
+
+		//The number of lights Assign was given that are in front of the camera, and the total
+		//length of the clusters' light lists.
+		size_t GetVisibleLightCount() const {return m_visibleLights;}
+		size_t GetLightIndexCount() const {return m_indices.size();}
+
+		//Writes the results of the last Assign to the buffer textures.
+		void Upload();
+
+		//Binds the buffer textures to their units.
+		void BindTextures() const;
+
+		//Sets the program's sampler units and cluster uniforms. Call after linking the program,
+		//and again after SetProjection. Leaves the program in use.
+		void SetProgramUniforms(GLuint program) const;
+
+	private:
+		int m_tilesX;
+		int m_tilesY;
+		int m_slices;
+		GLuint m_firstTextureUnit;
+
+		float m_zNear;
+		float m_zFar;
+		float m_projectionX;	//Camera space x over depth, times this, is NDC x.
+		float m_projectionY;
+
+		//Camera space bounds of the clusters, by the index each depends on. Tile columns are
+		//padded to a multiple of four per slice.
+		int m_paddedTilesX;
+		std::vector<float> m_sliceDepths;	//slices + 1 boundaries, as positive distances.
+		std::vector<float> m_columnMinX;
+		std::vector<float> m_columnMaxX;
+		std::vector<float> m_rowMinY;
+		std::vector<float> m_rowMaxY;
+
+		std::vector<glm::vec4> m_lightTexels;
+		std::vector<unsigned int> m_hitClusters;
+		std::vector<unsigned short> m_hitLights;
+		std::vector<unsigned int> m_clusterRanges;	//Start and count for each cluster.
+		std::vector<unsigned short> m_indices;
+		size_t m_visibleLights;
+
+		GLuint m_buffers[NUM_TEXTURE_UNITS];
+		GLuint m_textures[NUM_TEXTURE_UNITS];
+
+		void BuildClusterBounds();
+		void AssignSphere(unsigned short lightIx, const glm::vec3 &center, float radius);
+
+		//Prevent copying.
+		ClusteredLights(const ClusteredLights &);
+		ClusteredLights &operator=(const ClusteredLights &);
+	};
+
+	//Times Assign for light counts from 16 to 4096, with lights scattered through a cube of
+	//the given size in front of the camera. Writes a CSV row per count.
+	void WriteLightAssignmentBenchmark(std::ostream &out, ClusteredLights &clusters,
+		float sceneSize);
+}
+
+#endif //FRAMEWORK_CLUSTERED_LIGHTS_H
@@ -0,0 +1,916 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <exception>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+#include "Collision.h"
+#include "WorkerPool.h"
+#include "Profiler.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRAMEWORK_COLLISION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Framework
+{
+	namespace
+	{
+		//A body that spans more cells than this is tested against every query instead.
+		const float MAX_BODY_CELLS = 64.0f;
+
+		//A query that spans more cells than this tests every body instead.
+		const float MAX_QUERY_CELLS = 4096.0f;
+
+		//Keeps cell coordinates well inside the range of an int.
+		const float MAX_CELL_COORD = 1.0e9f;
+
+		//How close a sweep comes to a body before it counts as touching it.
+		const float SWEEP_SKIN = 1.0e-3f;
+		const int MAX_SWEEP_STEPS = 64;
+
+		//Padding spheres are placed here, so the distance to them overflows to infinity.
+		const float FAR_AWAY = 1.0e30f;
+
+		float Clamp01(float value)
+		{
+			return std::min(std::max(value, 0.0f), 1.0f);
+		}
+
+		glm::vec3 ClosestPointOnSegment(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &point)
+		{
+			glm::vec3 dir = p1 - p0;
+			float lengthSq = glm::dot(dir, dir);
+			if(lengthSq <= 0.0f)
+				return p0;
+			return p0 + dir * Clamp01(glm::dot(point - p0, dir) / lengthSq);
+		}
+
+		//The closest points between the segments p0-p1 and q0-q1, after Ericson's "Real-Time
+		//Collision Detection".
+		float SegmentDistanceSq(const glm::vec3 &p0, const glm::vec3 &p1,
+			const glm::vec3 &q0, const glm::vec3 &q1)
+		{
+			glm::vec3 dirP = p1 - p0;
+			glm::vec3 dirQ = q1 - q0;
+			glm::vec3 offset = p0 - q0;
+			float lengthSqP = glm::dot(dirP, dirP);
+			float lengthSqQ = glm::dot(dirQ, dirQ);
+			float f = glm::dot(dirQ, offset);
+
+			float s = 0.0f;
+			float t = 0.0f;
+			if(lengthSqP <= 0.0f && lengthSqQ <= 0.0f)
+				return glm::dot(offset, offset);
+
+			if(lengthSqP <= 0.0f)
+				t = Clamp01(f / lengthSqQ);
+			else
+			{
+				float c = glm::dot(dirP, offset);
+				if(lengthSqQ <= 0.0f)
+					s = Clamp01(-c / lengthSqP);
+				else
+				{
+					float b = glm::dot(dirP, dirQ);
+					float denom = lengthSqP * lengthSqQ - b * b;
+
+					//Parallel segments may pick any s.
+					if(denom > 1.0e-6f * lengthSqP * lengthSqQ)
+						s = Clamp01((b * f - c * lengthSqQ) / denom);
+
+					t = (b * s + f) / lengthSqQ;
+					if(t < 0.0f)
+					{
+						t = 0.0f;
+						s = Clamp01(-c / lengthSqP);
+					}
+					else if(t > 1.0f)
+					{
+						t = 1.0f;
+						s = Clamp01((b - c) / lengthSqP);
+					}
+				}
+			}
+
+			glm::vec3 diff = (p0 + dirP * s) - (q0 + dirQ * t);
+			return glm::dot(diff, diff);
+		}
+
+		glm::vec3 ToBoxSpace(const CollisionShape &box, const glm::vec3 &point)
+		{
+			//The axes are orthonormal, so the transpose inverts them.
+			return (point - box.p0) * box.axes;
+		}
+
+		float PointBoxDistanceSq(const glm::vec3 &local, const glm::vec3 &halfExtents)
+		{
+			glm::vec3 outside = glm::max(glm::abs(local) - halfExtents, glm::vec3(0.0f));
+			return glm::dot(outside, outside);
+		}
+
+		//Slab test of a segment given in the box's space.
+		bool SegmentHitsBox(const glm::vec3 &start, const glm::vec3 &end, const glm::vec3 &halfExtents)
+		{
+			glm::vec3 dir = end - start;
+			float tMin = 0.0f;
+			float tMax = 1.0f;
+			for(int axis = 0; axis < 3; ++axis)
+			{
+				if(fabsf(dir[axis]) < 1.0e-12f)
+				{
+					if(fabsf(start[axis]) > halfExtents[axis])
+						return false;
+					continue;
+				}
+
+				float t0 = (-halfExtents[axis] - start[axis]) / dir[axis];
+				float t1 = (halfExtents[axis] - start[axis]) / dir[axis];
+				tMin = std::max(tMin, std::min(t0, t1));
+				tMax = std::min(tMax, std::max(t0, t1));
+				if(tMin > tMax)
+					return false;
+			}
+
+			return true;
+		}
+
+		//The distance to a box along a segment is convex, so a golden section search finds its
+		//least value. It stops early once the distance is no more than stopAtOrBelow.
+		float SegmentBoxDistanceSq(const CollisionShape &box, const glm::vec3 &p0, const glm::vec3 &p1,
+			float stopAtOrBelow)
+		{
+			glm::vec3 start = ToBoxSpace(box, p0);
+			glm::vec3 end = ToBoxSpace(box, p1);
+			const glm::vec3 &halfExtents = box.p1;
+
+			if(SegmentHitsBox(start, end, halfExtents))
+				return 0.0f;
+
+			glm::vec3 dir = end - start;
+			float best = std::min(PointBoxDistanceSq(start, halfExtents), PointBoxDistanceSq(end, halfExtents));
+			if(best <= stopAtOrBelow || glm::dot(dir, dir) <= 0.0f)
+				return best;
+
+			const float INV_PHI = 0.618034f;
+			float lo = 0.0f;
+			float hi = 1.0f;
+			float t0 = hi - INV_PHI;
+			float t1 = lo + INV_PHI;
+			float d0 = PointBoxDistanceSq(start + dir * t0, halfExtents);
+			float d1 = PointBoxDistanceSq(start + dir * t1, halfExtents);
+			for(int iteration = 0; iteration < 24; ++iteration)
+			{
+				best = std::min(best, std::min(d0, d1));
+				if(best <= stopAtOrBelow)
+					break;
+
+				if(d0 < d1)
+				{
+					hi = t1;
+					t1 = t0;
+					d1 = d0;
+					t0 = hi - (hi - lo) * INV_PHI;
+					d0 = PointBoxDistanceSq(start + dir * t0, halfExtents);
+				}
+				else
+				{
+					lo = t0;
+					t0 = t1;
+					d0 = d1;
+					t1 = lo + (hi - lo) * INV_PHI;
+					d1 = PointBoxDistanceSq(start + dir * t1, halfExtents);
+				}
+			}
+
+			return std::min(best, std::min(d0, d1));
+		}
+
+		//Separating axis test over the 15 candidate axes, after Ericson.
+		bool BoxesOverlap(const CollisionShape &first, const CollisionShape &second)
+		{
+			const glm::vec3 &extA = first.p1;
+			const glm::vec3 &extB = second.p1;
+
+			//The second box's axes in the first one's space. The epsilon keeps the cross product
+			//axes of near-parallel edges from being trusted.
+			float rot[3][3];
+			float absRot[3][3];
+			for(int i = 0; i < 3; ++i)
+			{
+				for(int j = 0; j < 3; ++j)
+				{
+					rot[i][j] = glm::dot(first.axes[i], second.axes[j]);
+					absRot[i][j] = fabsf(rot[i][j]) + 1.0e-6f;
+				}
+			}
+
+			glm::vec3 offset = ToBoxSpace(first, second.p0);
+
+			for(int i = 0; i < 3; ++i)
+			{
+				float radiusB = extB[0] * absRot[i][0] + extB[1] * absRot[i][1] + extB[2] * absRot[i][2];
+				if(fabsf(offset[i]) > extA[i] + radiusB)
+					return false;
+			}
+
+			for(int j = 0; j < 3; ++j)
+			{
+				float radiusA = extA[0] * absRot[0][j] + extA[1] * absRot[1][j] + extA[2] * absRot[2][j];
+				float distance = offset[0] * rot[0][j] + offset[1] * rot[1][j] + offset[2] * rot[2][j];
+				if(fabsf(distance) > radiusA + extB[j])
+					return false;
+			}
+
+			for(int i = 0; i < 3; ++i)
+			{
+				int i1 = (i + 1) % 3;
+				int i2 = (i + 2) % 3;
+				for(int j = 0; j < 3; ++j)
+				{
+					int j1 = (j + 1) % 3;
+					int j2 = (j + 2) % 3;
+					float radiusA = extA[i1] * absRot[i2][j] + extA[i2] * absRot[i1][j];
+					float radiusB = extB[j1] * absRot[i][j2] + extB[j2] * absRot[i][j1];
+					float distance = offset[i2] * rot[i1][j] - offset[i1] * rot[i2][j];
+					if(fabsf(distance) > radiusA + radiusB)
+						return false;
+				}
+			}
+
+			return true;
+		}
+
+		//Signed distance from a point to the shape's surface, with the outward normal there.
+		float PointDistance(const CollisionShape &shape, const glm::vec3 &point, glm::vec3 &normal)
+		{
+			if(shape.type == CollisionShape::BOX)
+			{
+				const glm::vec3 &halfExtents = shape.p1;
+				glm::vec3 local = ToBoxSpace(shape, point);
+				glm::vec3 outside = glm::max(glm::abs(local) - halfExtents, glm::vec3(0.0f));
+				float outsideSq = glm::dot(outside, outside);
+				if(outsideSq > 0.0f)
+				{
+					float distance = sqrtf(outsideSq);
+					glm::vec3 closest = glm::clamp(local, -halfExtents, halfExtents);
+					normal = shape.axes * ((local - closest) / distance);
+					return distance;
+				}
+
+				//Inside, the nearest face decides.
+				int face = 0;
+				float depth = halfExtents[0] - fabsf(local[0]);
+				for(int axis = 1; axis < 3; ++axis)
+				{
+					float axisDepth = halfExtents[axis] - fabsf(local[axis]);
+					if(axisDepth < depth)
+					{
+						face = axis;
+						depth = axisDepth;
+					}
+				}
+
+				normal = shape.axes[face] * (local[face] < 0.0f ? -1.0f : 1.0f);
+				return -depth;
+			}
+
+			glm::vec3 offset = point - ClosestPointOnSegment(shape.p0, shape.p1, point);
+			float length = glm::length(offset);
+			normal = length > 0.0f ? offset / length : glm::vec3(0.0f, 1.0f, 0.0f);
+			return length - shape.radius;
+		}
+
+		glm::vec4 GetBoundingSphere(const CollisionShape &shape)
+		{
+			if(shape.type == CollisionShape::BOX)
+				return glm::vec4(shape.p0, sqrtf(glm::dot(shape.p1, shape.p1)));
+
+			glm::vec3 axis = shape.p1 - shape.p0;
+			return glm::vec4((shape.p0 + shape.p1) * 0.5f, sqrtf(glm::dot(axis, axis)) * 0.5f + shape.radius);
+		}
+
+		bool BoundsOverlap(const glm::vec3 &minA, const glm::vec3 &maxA,
+			const glm::vec3 &minB, const glm::vec3 &maxB)
+		{
+			return minA.x <= maxB.x && minB.x <= maxA.x &&
+				minA.y <= maxB.y && minB.y <= maxA.y &&
+				minA.z <= maxB.z && minB.z <= maxA.z;
+		}
+
+		//Bit i of the result is set if sphere i touches the given sphere. The four spheres are
+		//either xs[indices[i]], and so on, or xs[i] when indices is NULL.
+		unsigned int TouchingSpheres(const float *xs, const float *ys, const float *zs, const float *radii,
+			const unsigned int *indices, const glm::vec4 &sphere)
+		{
+#ifdef FRAMEWORK_COLLISION_SSE2
+			__m128 x, y, z, radius;
+			if(indices)
+			{
+				x = _mm_set_ps(xs[indices[3]], xs[indices[2]], xs[indices[1]], xs[indices[0]]);
+				y = _mm_set_ps(ys[indices[3]], ys[indices[2]], ys[indices[1]], ys[indices[0]]);
+				z = _mm_set_ps(zs[indices[3]], zs[indices[2]], zs[indices[1]], zs[indices[0]]);
+				radius = _mm_set_ps(radii[indices[3]], radii[indices[2]], radii[indices[1]], radii[indices[0]]);
+			}
+			else
+			{
+				x = _mm_loadu_ps(xs);
+				y = _mm_loadu_ps(ys);
+				z = _mm_loadu_ps(zs);
+				radius = _mm_loadu_ps(radii);
+			}
+
+			__m128 dx = _mm_sub_ps(x, _mm_set1_ps(sphere.x));
+			__m128 dy = _mm_sub_ps(y, _mm_set1_ps(sphere.y));
+			__m128 dz = _mm_sub_ps(z, _mm_set1_ps(sphere.z));
+			__m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			__m128 reach = _mm_add_ps(radius, _mm_set1_ps(sphere.w));
+			return (unsigned int)_mm_movemask_ps(_mm_cmple_ps(distanceSq, _mm_mul_ps(reach, reach)));
+#else
+			unsigned int mask = 0;
+			for(int lane = 0; lane < 4; ++lane)
+			{
+				unsigned int index = indices ? indices[lane] : lane;
+				float dx = xs[index] - sphere.x;
+				float dy = ys[index] - sphere.y;
+				float dz = zs[index] - sphere.z;
+				float reach = radii[index] + sphere.w;
+				if(dx * dx + dy * dy + dz * dz <= reach * reach)
+					mask |= 1 << lane;
+			}
+			return mask;
+#endif
+		}
+
+		unsigned int LaneMask(size_t lanes)
+		{
+			return lanes >= 4 ? 0xF : (1u << lanes) - 1;
+		}
+
+		typedef std::pair<unsigned int, unsigned int> BodyPair;
+	}
+
+	CollisionShape CollisionShape::Sphere( const glm::vec3 &center, float radius )
+	{
+		CollisionShape shape;
+		shape.type = SPHERE;
+		shape.p0 = center;
+		shape.p1 = center;
+		shape.radius = radius;
+		return shape;
+	}
+
+	CollisionShape CollisionShape::Capsule( const glm::vec3 &end0, const glm::vec3 &end1, float radius )
+	{
+		CollisionShape shape;
+		shape.type = CAPSULE;
+		shape.p0 = end0;
+		shape.p1 = end1;
+		shape.radius = radius;
+		return shape;
+	}
+
+	CollisionShape CollisionShape::Aabb( const glm::vec3 &boundsMin, const glm::vec3 &boundsMax )
+	{
+		return Obb((boundsMin + boundsMax) * 0.5f, (boundsMax - boundsMin) * 0.5f, glm::mat3(1.0f));
+	}
+
+	CollisionShape CollisionShape::Obb( const glm::vec3 &center, const glm::vec3 &halfExtents,
+		const glm::mat3 &axes )
+	{
+		CollisionShape shape;
+		shape.type = BOX;
+		shape.p0 = center;
+		shape.p1 = halfExtents;
+		shape.radius = 0.0f;
+		shape.axes = axes;
+		return shape;
+	}
+
+	void CollisionShape::GetBounds( glm::vec3 &boundsMin, glm::vec3 &boundsMax ) const
+	{
+		if(type == BOX)
+		{
+			glm::mat3 absAxes(glm::abs(axes[0]), glm::abs(axes[1]), glm::abs(axes[2]));
+			glm::vec3 extent = absAxes * p1;
+			boundsMin = p0 - extent;
+			boundsMax = p0 + extent;
+		}
+		else
+		{
+			boundsMin = glm::min(p0, p1) - glm::vec3(radius);
+			boundsMax = glm::max(p0, p1) + glm::vec3(radius);
+		}
+	}
+
+	bool ShapesOverlap( const CollisionShape &first, const CollisionShape &second )
+	{
+		if(first.type == CollisionShape::BOX)
+		{
+			if(second.type == CollisionShape::BOX)
+				return BoxesOverlap(first, second);
+
+			float radiusSq = second.radius * second.radius;
+			return SegmentBoxDistanceSq(first, second.p0, second.p1, radiusSq) <= radiusSq;
+		}
+
+		if(second.type == CollisionShape::BOX)
+		{
+			float radiusSq = first.radius * first.radius;
+			return SegmentBoxDistanceSq(second, first.p0, first.p1, radiusSq) <= radiusSq;
+		}
+
+		float reach = first.radius + second.radius;
+		return SegmentDistanceSq(first.p0, first.p1, second.p0, second.p1) <= reach * reach;
+	}
+
+	CollisionWorld::CollisionWorld( float cellSize )
+		: m_cellSize(cellSize)
+		, m_bDirty(true)
+	{
+		if(cellSize <= 0.0f)
+			throw std::runtime_error("The collision cell size must be positive.");
+	}
+
+	Handle CollisionWorld::AddBody( const CollisionShape &shape, unsigned int layers )
+	{
+		Body body;
+		body.shape = shape;
+		body.layers = layers;
+		m_bDirty = true;
+		return m_bodies.Insert(body);
+	}
+
+	bool CollisionWorld::RemoveBody( Handle body )
+	{
+		if(!m_bodies.Remove(body))
+			return false;
+
+		m_bDirty = true;
+		return true;
+	}
+
+	bool CollisionWorld::SetShape( Handle body, const CollisionShape &shape )
+	{
+		Body *pBody = m_bodies.Get(body);
+		if(!pBody)
+			return false;
+
+		pBody->shape = shape;
+		m_bDirty = true;
+		return true;
+	}
+
+	const CollisionShape * CollisionWorld::GetShape( Handle body ) const
+	{
+		const Body *pBody = m_bodies.Get(body);
+		return pBody ? &pBody->shape : NULL;
+	}
+
+	void CollisionWorld::SetCellSize( float cellSize )
+	{
+		if(cellSize <= 0.0f)
+			throw std::runtime_error("The collision cell size must be positive.");
+
+		m_cellSize = cellSize;
+		m_bDirty = true;
+	}
+
+	CollisionWorld::Cell CollisionWorld::GetCell( const glm::vec3 &point ) const
+	{
+		const float scale = 1.0f / m_cellSize;
+
+		Cell cell;
+		cell.x = (int)std::min(std::max(floorf(point.x * scale), -MAX_CELL_COORD), MAX_CELL_COORD);
+		cell.y = (int)std::min(std::max(floorf(point.y * scale), -MAX_CELL_COORD), MAX_CELL_COORD);
+		cell.z = (int)std::min(std::max(floorf(point.z * scale), -MAX_CELL_COORD), MAX_CELL_COORD);
+		return cell;
+	}
+
+	size_t CollisionWorld::GetBucket( const Cell &cell ) const
+	{
+		unsigned int hash = ((unsigned int)cell.x * 73856093u) ^
+			((unsigned int)cell.y * 19349663u) ^
+			((unsigned int)cell.z * 83492791u);
+		return hash & (unsigned int)(m_bucketStarts.size() - 2);
+	}
+
+	void CollisionWorld::ThrowIfDirty() const
+	{
+		if(m_bDirty)
+			throw std::runtime_error("The collision world changed since it was last updated.");
+	}
+
+	void CollisionWorld::Update()
+	{
+		PROFILE_SCOPE("CollisionWorld::Update");
+
+		const size_t bodyCount = m_bodies.size();
+		const size_t paddedCount = (bodyCount + 3) & ~(size_t)3;
+
+		m_boundsMins.resize(bodyCount);
+		m_boundsMaxs.resize(bodyCount);
+		m_sphereX.assign(paddedCount, FAR_AWAY);
+		m_sphereY.assign(paddedCount, FAR_AWAY);
+		m_sphereZ.assign(paddedCount, FAR_AWAY);
+		m_sphereRadius.assign(paddedCount, 0.0f);
+
+		m_cellRanges.resize(bodyCount);
+		m_entryStarts.resize(bodyCount + 1);
+
+		ParallelFor(GetWorkerPool(), bodyCount, 4096,
+			[&](size_t begin, size_t end)
+		{
+			for(size_t bodyIx = begin; bodyIx < end; ++bodyIx)
+			{
+				const CollisionShape &shape = m_bodies[bodyIx].shape;
+				shape.GetBounds(m_boundsMins[bodyIx], m_boundsMaxs[bodyIx]);
+
+				glm::vec4 sphere = GetBoundingSphere(shape);
+				m_sphereX[bodyIx] = sphere.x;
+				m_sphereY[bodyIx] = sphere.y;
+				m_sphereZ[bodyIx] = sphere.z;
+				m_sphereRadius[bodyIx] = sphere.w;
+
+				CellRange &range = m_cellRanges[bodyIx];
+				range.cellMin = GetCell(m_boundsMins[bodyIx]);
+				range.cellMax = GetCell(m_boundsMaxs[bodyIx]);
+				float cells = (range.cellMax.x - range.cellMin.x + 1.0f) *
+					(range.cellMax.y - range.cellMin.y + 1.0f) * (range.cellMax.z - range.cellMin.z + 1.0f);
+				range.count = cells > MAX_BODY_CELLS ? 0 : (unsigned int)cells;
+			}
+		});
+
+		m_largeBodies.clear();
+		m_entryStarts[0] = 0;
+		for(size_t bodyIx = 0; bodyIx < bodyCount; ++bodyIx)
+		{
+			if(m_cellRanges[bodyIx].count == 0)
+				m_largeBodies.push_back((unsigned int)bodyIx);
+			m_entryStarts[bodyIx + 1] = m_entryStarts[bodyIx] + m_cellRanges[bodyIx].count;
+		}
+
+		const size_t entryCount = m_entryStarts[bodyCount];
+		size_t bucketCount = 16;
+		while(bucketCount < entryCount)
+			bucketCount *= 2;
+
+		//Every entry's cell and bucket, in body order.
+		m_unsortedCells.resize(entryCount);
+		m_unsortedBuckets.resize(entryCount);
+		m_bucketStarts.assign(bucketCount + 1, 0);
+		ParallelFor(GetWorkerPool(), bodyCount, 4096,
+			[&](size_t begin, size_t end)
+		{
+			for(size_t bodyIx = begin; bodyIx < end; ++bodyIx)
+			{
+				const CellRange &range = m_cellRanges[bodyIx];
+				if(range.count == 0)
+					continue;
+
+				unsigned int entryIx = m_entryStarts[bodyIx];
+				Cell cell;
+				for(cell.z = range.cellMin.z; cell.z <= range.cellMax.z; ++cell.z)
+				{
+					for(cell.y = range.cellMin.y; cell.y <= range.cellMax.y; ++cell.y)
+					{
+						for(cell.x = range.cellMin.x; cell.x <= range.cellMax.x; ++cell.x)
+						{
+							m_unsortedCells[entryIx] = cell;
+							m_unsortedBuckets[entryIx] = (unsigned int)GetBucket(cell);
+							++entryIx;
+						}
+					}
+				}
+			}
+		});
+
+		//A counting sort of the entries by bucket.
+		for(size_t entryIx = 0; entryIx < entryCount; ++entryIx)
+			++m_bucketStarts[m_unsortedBuckets[entryIx] + 1];
+
+		for(size_t bucketIx = 1; bucketIx <= bucketCount; ++bucketIx)
+			m_bucketStarts[bucketIx] += m_bucketStarts[bucketIx - 1];
+
+		m_cursors.assign(m_bucketStarts.begin(), m_bucketStarts.end() - 1);
+		m_entryBodies.resize(entryCount);
+		m_entryCells.resize(entryCount);
+		for(size_t bodyIx = 0; bodyIx < bodyCount; ++bodyIx)
+		{
+			for(unsigned int entryIx = m_entryStarts[bodyIx]; entryIx < m_entryStarts[bodyIx + 1]; ++entryIx)
+			{
+				unsigned int sortedIx = m_cursors[m_unsortedBuckets[entryIx]]++;
+				m_entryBodies[sortedIx] = (unsigned int)bodyIx;
+				m_entryCells[sortedIx] = m_unsortedCells[entryIx];
+			}
+		}
+
+		m_bDirty = false;
+	}
+
+	void CollisionWorld::GatherCandidates( const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+		std::vector<unsigned int> &candidates ) const
+	{
+		candidates.clear();
+
+		Cell cellMin = GetCell(boundsMin);
+		Cell cellMax = GetCell(boundsMax);
+		float cells = (cellMax.x - cellMin.x + 1.0f) * (cellMax.y - cellMin.y + 1.0f) *
+			(cellMax.z - cellMin.z + 1.0f);
+
+		if(cells > MAX_QUERY_CELLS)
+		{
+			for(size_t bodyIx = 0; bodyIx < m_boundsMins.size(); ++bodyIx)
+			{
+				if(BoundsOverlap(boundsMin, boundsMax, m_boundsMins[bodyIx], m_boundsMaxs[bodyIx]))
+					candidates.push_back((unsigned int)bodyIx);
+			}
+			return;
+		}
+
+		Cell cell;
+		for(cell.z = cellMin.z; cell.z <= cellMax.z; ++cell.z)
+		{
+			for(cell.y = cellMin.y; cell.y <= cellMax.y; ++cell.y)
+			{
+				for(cell.x = cellMin.x; cell.x <= cellMax.x; ++cell.x)
+				{
+					size_t bucketIx = GetBucket(cell);
+					for(unsigned int entryIx = m_bucketStarts[bucketIx];
+						entryIx < m_bucketStarts[bucketIx + 1];
+						++entryIx)
+					{
+						unsigned int bodyIx = m_entryBodies[entryIx];
+						if(m_entryCells[entryIx] == cell &&
+							BoundsOverlap(boundsMin, boundsMax, m_boundsMins[bodyIx], m_boundsMaxs[bodyIx]))
+						{
+							candidates.push_back(bodyIx);
+						}
+					}
+				}
+			}
+		}
+
+		//A body is listed once for each cell it is in.
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+		for(size_t largeIx = 0; largeIx < m_largeBodies.size(); ++largeIx)
+		{
+			unsigned int bodyIx = m_largeBodies[largeIx];
+			if(BoundsOverlap(boundsMin, boundsMax, m_boundsMins[bodyIx], m_boundsMaxs[bodyIx]))
+				candidates.push_back(bodyIx);
+		}
+	}
+
+	void CollisionWorld::FindOverlaps( const CollisionShape &shape, unsigned int layers,
+		bool bStopAtFirst, std::vector<unsigned int> &bodies ) const
+	{
+		ThrowIfDirty();
+
+		glm::vec3 boundsMin, boundsMax;
+		shape.GetBounds(boundsMin, boundsMax);
+
+		std::vector<unsigned int> candidates;
+		GatherCandidates(boundsMin, boundsMax, candidates);
+
+		bodies.clear();
+		glm::vec4 sphere = GetBoundingSphere(shape);
+		for(size_t firstIx = 0; firstIx < candidates.size(); firstIx += 4)
+		{
+			size_t lanes = std::min(candidates.size() - firstIx, (size_t)4);
+			unsigned int indices[4] = {0, 0, 0, 0};
+			std::copy(candidates.begin() + firstIx, candidates.begin() + firstIx + lanes, indices);
+
+			unsigned int mask = TouchingSpheres(&m_sphereX[0], &m_sphereY[0], &m_sphereZ[0],
+				&m_sphereRadius[0], indices, sphere) & LaneMask(lanes);
+			for(size_t lane = 0; mask; ++lane, mask >>= 1)
+			{
+				if(!(mask & 1))
+					continue;
+
+				const Body &body = m_bodies[indices[lane]];
+				if((body.layers & layers) && ShapesOverlap(shape, body.shape))
+				{
+					bodies.push_back(indices[lane]);
+					if(bStopAtFirst)
+						return;
+				}
+			}
+		}
+	}
+
+	bool CollisionWorld::Overlaps( const CollisionShape &shape, unsigned int layers ) const
+	{
+		std::vector<unsigned int> bodies;
+		FindOverlaps(shape, layers, true, bodies);
+		return !bodies.empty();
+	}
+
+	void CollisionWorld::Query( const CollisionShape &shape, std::vector<Handle> &bodies,
+		unsigned int layers ) const
+	{
+		std::vector<unsigned int> found;
+		FindOverlaps(shape, layers, false, found);
+
+		bodies.clear();
+		for(size_t foundIx = 0; foundIx < found.size(); ++foundIx)
+			bodies.push_back(m_bodies.GetHandle(found[foundIx]));
+	}
+
+	void CollisionWorld::QueryBatch( const std::vector<CollisionShape> &shapes,
+		std::vector<std::vector<Handle> > &results, unsigned int layers ) const
+	{
+		PROFILE_SCOPE("CollisionWorld::QueryBatch");
+		ThrowIfDirty();
+
+		results.resize(shapes.size());
+		ParallelFor(GetWorkerPool(), shapes.size(), 64,
+			[&](size_t begin, size_t end)
+		{
+			for(size_t shapeIx = begin; shapeIx < end; ++shapeIx)
+				Query(shapes[shapeIx], results[shapeIx], layers);
+		});
+	}
+
+	void CollisionWorld::FindOverlappingPairs( std::vector<std::pair<Handle, Handle> > &pairs ) const
+	{
+		PROFILE_SCOPE("CollisionWorld::FindOverlappingPairs");
+		ThrowIfDirty();
+
+		std::mutex foundMutex;
+		std::vector<BodyPair> found;
+
+		//Bodies that share a cell. A pair that shares several cells is only reported from the
+		//one holding the low corner of where their bounds overlap.
+		ParallelFor(GetWorkerPool(), m_bucketStarts.size() - 1, 1024,
+			[&](size_t begin, size_t end)
+		{
+			std::vector<BodyPair> rangeFound;
+			for(size_t bucketIx = begin; bucketIx < end; ++bucketIx)
+			{
+				const unsigned int entriesEnd = m_bucketStarts[bucketIx + 1];
+				for(unsigned int entryIx = m_bucketStarts[bucketIx]; entryIx < entriesEnd; ++entryIx)
+				{
+					const unsigned int bodyIx = m_entryBodies[entryIx];
+					const Cell &cell = m_entryCells[entryIx];
+					const Body &body = m_bodies[bodyIx];
+					glm::vec4 sphere(m_sphereX[bodyIx], m_sphereY[bodyIx], m_sphereZ[bodyIx], m_sphereRadius[bodyIx]);
+
+					for(unsigned int otherIx = entryIx + 1; otherIx < entriesEnd; otherIx += 4)
+					{
+						size_t lanes = std::min(entriesEnd - otherIx, 4u);
+						unsigned int indices[4] = {bodyIx, bodyIx, bodyIx, bodyIx};
+						std::copy(m_entryBodies.begin() + otherIx, m_entryBodies.begin() + otherIx + lanes, indices);
+
+						unsigned int mask = TouchingSpheres(&m_sphereX[0], &m_sphereY[0], &m_sphereZ[0],
+							&m_sphereRadius[0], indices, sphere) & LaneMask(lanes);
+						for(size_t lane = 0; mask; ++lane, mask >>= 1)
+						{
+							if(!(mask & 1) || !(m_entryCells[otherIx + lane] == cell))
+								continue;
+
+							unsigned int otherBodyIx = indices[lane];
+							if(!BoundsOverlap(m_boundsMins[bodyIx], m_boundsMaxs[bodyIx],
+								m_boundsMins[otherBodyIx], m_boundsMaxs[otherBodyIx]))
+							{
+								continue;
+							}
+
+							if(!(GetCell(glm::max(m_boundsMins[bodyIx], m_boundsMins[otherBodyIx])) == cell))
+								continue;
+
+							const Body &other = m_bodies[otherBodyIx];
+							if((body.layers & other.layers) && ShapesOverlap(body.shape, other.shape))
+							{
+								rangeFound.push_back(BodyPair(std::min(bodyIx, otherBodyIx),
+									std::max(bodyIx, otherBodyIx)));
+							}
+						}
+					}
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(foundMutex);
+			found.insert(found.end(), rangeFound.begin(), rangeFound.end());
+		});
+
+		//Large bodies, against every body four at a time. Two large bodies are only tested from
+		//the first of them.
+		if(!m_largeBodies.empty())
+		{
+			ParallelFor(GetWorkerPool(), m_sphereX.size() / 4, 256,
+				[&](size_t begin, size_t end)
+			{
+				std::vector<BodyPair> rangeFound;
+				for(size_t largeIx = 0; largeIx < m_largeBodies.size(); ++largeIx)
+				{
+					const unsigned int bodyIx = m_largeBodies[largeIx];
+					const Body &body = m_bodies[bodyIx];
+					glm::vec4 sphere(m_sphereX[bodyIx], m_sphereY[bodyIx], m_sphereZ[bodyIx], m_sphereRadius[bodyIx]);
+
+					for(size_t groupIx = begin; groupIx < end; ++groupIx)
+					{
+						const size_t firstIx = groupIx * 4;
+						unsigned int mask = TouchingSpheres(&m_sphereX[firstIx], &m_sphereY[firstIx],
+							&m_sphereZ[firstIx], &m_sphereRadius[firstIx], NULL, sphere);
+						for(size_t lane = 0; mask; ++lane, mask >>= 1)
+						{
+							const unsigned int otherBodyIx = (unsigned int)(firstIx + lane);
+							if(!(mask & 1) || otherBodyIx == bodyIx)
+								continue;
+
+							if(otherBodyIx < bodyIx &&
+								std::binary_search(m_largeBodies.begin(), m_largeBodies.end(), otherBodyIx))
+							{
+								continue;
+							}
+
+							if(!BoundsOverlap(m_boundsMins[bodyIx], m_boundsMaxs[bodyIx],
+								m_boundsMins[otherBodyIx], m_boundsMaxs[otherBodyIx]))
+							{
+								continue;
+							}
+
+							const Body &other = m_bodies[otherBodyIx];
+							if((body.layers & other.layers) && ShapesOverlap(body.shape, other.shape))
+							{
+								rangeFound.push_back(BodyPair(std::min(bodyIx, otherBodyIx),
+									std::max(bodyIx, otherBodyIx)));
+							}
+						}
+					}
+				}
+
+				std::lock_guard<std::mutex> lock(foundMutex);
+				found.insert(found.end(), rangeFound.begin(), rangeFound.end());
+			});
+		}
+
+		std::sort(found.begin(), found.end());
+
+		pairs.clear();
+		pairs.reserve(found.size());
+		for(size_t pairIx = 0; pairIx < found.size(); ++pairIx)
+		{
+			pairs.push_back(std::make_pair(m_bodies.GetHandle(found[pairIx].first),
+				m_bodies.GetHandle(found[pairIx].second)));
+		}
+	}
+
+	bool CollisionWorld::SweepSphere( const glm::vec3 &start, float radius, const glm::vec3 &delta,
+		SweepHit &hit, unsigned int layers ) const
+	{
+		//Only bodies the whole path touches can be hit.
+		std::vector<unsigned int> bodies;
+		FindOverlaps(CollisionShape::Capsule(start, start + delta, radius), layers, false, bodies);
+
+		const float deltaLength = glm::length(delta);
+		if(deltaLength <= 0.0f)
+			return false;
+
+		bool bHit = false;
+		float bestFraction = 1.0f;
+		for(size_t foundIx = 0; foundIx < bodies.size(); ++foundIx)
+		{
+			const CollisionShape &shape = m_bodies[bodies[foundIx]].shape;
+
+			//Conservative advancement: the sphere can always move as far as it is from the shape.
+			//Along a line, the distance to a convex shape only falls and then rises, so once the
+			//sphere touches the shape without moving into it, it never will.
+			float fraction = 0.0f;
+			for(int step = 0; step < MAX_SWEEP_STEPS && fraction < bestFraction; ++step)
+			{
+				glm::vec3 normal;
+				float distance = PointDistance(shape, start + delta * fraction, normal) - radius;
+				if(distance <= SWEEP_SKIN)
+				{
+					if(glm::dot(normal, delta) < 0.0f)
+					{
+						bHit = true;
+						bestFraction = fraction;
+						hit.body = m_bodies.GetHandle(bodies[foundIx]);
+						hit.normal = normal;
+					}
+					break;
+				}
+
+				fraction += (distance - SWEEP_SKIN * 0.5f) / deltaLength;
+			}
+		}
+
+		if(!bHit)
+			return false;
+
+		hit.fraction = bestFraction;
+		hit.position = start + delta * bestFraction;
+		return true;
+	}
+}
@@ -0,0 +1,178 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_COLLISION_H
+#define FRAMEWORK_COLLISION_H
+
+#include <vector>
+#include <utility>
+#include <glm/glm.hpp>
+#include "SlotMap.h"
+
+namespace Framework
+{
+	struct CollisionShape
+	{
+		//A sphere is a capsule whose ends meet, and an AABB is a box with the identity as its axes.
+		enum Type
+		{
+			SPHERE,
+			CAPSULE,
+			BOX,
+		};
+
+		static CollisionShape Sphere(const glm::vec3 &center, float radius);
+		static CollisionShape Capsule(const glm::vec3 &end0, const glm::vec3 &end1, float radius);
+		static CollisionShape Aabb(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+		static CollisionShape Obb(const glm::vec3 &center, const glm::vec3 &halfExtents,
+			const glm::mat3 &axes);
+
+		void GetBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) const;
+
+		Type type;
+		glm::vec3 p0;		//A sphere's center, a capsule's first end, or a box's center.
+		glm::vec3 p1;		//A capsule's second end, or a box's half extents. p0 for a sphere.
+		float radius;		//Zero for a box.
+		glm::mat3 axes;		//A box's axes, as orthonormal columns.
+	};
+
+	//Shapes that touch overlap. Tests against a capsule's segment and a box are exact to within
+	//a small fraction of the segment's length.
+	bool ShapesOverlap(const CollisionShape &first, const CollisionShape &second);
+
+	struct SweepHit
+	{
+		SweepHit() : fraction(1.0f) {}
+
+		float fraction;		//Of the sweep's delta, travelled before the first contact.
+		Handle body;
+		glm::vec3 position;	//Of the sphere's center at the contact.
+		glm::vec3 normal;	//Points from the body towards the sphere.
+	};
+
+	/**
+	Bodies made of simple shapes, found by where they are.
+
+	The broad phase is a uniform grid that is hashed rather than stored, so the world has no
+	bounds. Each body is listed in every cell its bounding box touches, and a query only looks
+	at the cells its own box touches. A body that would span too many cells, such as a wall or
+	floor, is kept apart and tested against every query instead.
+
+	Candidates are then culled by bounding sphere, four at a time with SSE, before the exact
+	test between the two shapes.
+
+	Bodies are meant to move every frame: change their shapes, then call Update to rebuild the
+	grid. Queries throw if bodies changed since the last Update. Queries only read the world, so
+	any number of them can run at once; the batch functions spread theirs across the worker pool.
+
+	The cell size is best a little larger than a typical body.
+	**/
+	class CollisionWorld
+	{
+	public:
+		enum {ALL_LAYERS = 0xFFFFFFFF};
+
+		explicit CollisionWorld(float cellSize = 8.0f);
+
+		//A query only finds bodies that share one of its layers.
+		Handle AddBody(const CollisionShape &shape, unsigned int layers = 1);
+
+		//These return false if the handle is stale.
+		bool RemoveBody(Handle body);
+		bool SetShape(Handle body, const CollisionShape &shape);
+
+		//NULL if the handle is stale.
+		const CollisionShape *GetShape(Handle body) const;
+
+		size_t GetBodyCount() const {return m_bodies.size();}
+
+		void SetCellSize(float cellSize);
+		float GetCellSize() const {return m_cellSize;}
+
+		void Update();
+
+		bool Overlaps(const CollisionShape &shape, unsigned int layers = ALL_LAYERS) const;
+
+		//Replaces the contents of bodies with those that overlap the shape.
+		void Query(const CollisionShape &shape, std::vector<Handle> &bodies,
+			unsigned int layers = ALL_LAYERS) const;
+
+		//Resizes results to match shapes. Runs on the worker pool.
+		void QueryBatch(const std::vector<CollisionShape> &shapes,
+			std::vector<std::vector<Handle> > &results, unsigned int layers = ALL_LAYERS) const;
+
+		//Every pair of overlapping bodies that share a layer, each once. Runs on the worker pool.
+		void FindOverlappingPairs(std::vector<std::pair<Handle, Handle> > &pairs) const;
+
+		//Moves a sphere along delta and finds the first body it would touch. Bodies the sphere
+		//already overlaps only stop it if it moves further into them, so a sphere that starts
+		//inside something can still leave. Returns false if nothing is in the way.
+		bool SweepSphere(const glm::vec3 &start, float radius, const glm::vec3 &delta,
+			SweepHit &hit, unsigned int layers = ALL_LAYERS) const;
+
+	private:
+		struct Body
+		{
+			CollisionShape shape;
+			unsigned int layers;
+		};
+
+		struct Cell
+		{
+			bool operator==(const Cell &other) const
+			{return x == other.x && y == other.y && z == other.z;}
+
+			int x, y, z;
+		};
+
+		SlotMap<Body> m_bodies;
+		float m_cellSize;
+		bool m_bDirty;
+
+		//Rebuilt by Update, and indexed like the SlotMap's dense array.
+		std::vector<glm::vec3> m_boundsMins;
+		std::vector<glm::vec3> m_boundsMaxs;
+
+		//Bounding spheres, padded to a multiple of four with spheres that touch nothing.
+		std::vector<float> m_sphereX;
+		std::vector<float> m_sphereY;
+		std::vector<float> m_sphereZ;
+		std::vector<float> m_sphereRadius;
+
+		//The grid. Bucket i's entries are [m_bucketStarts[i], m_bucketStarts[i + 1]).
+		std::vector<unsigned int> m_bucketStarts;
+		std::vector<unsigned int> m_entryBodies;
+		std::vector<Cell> m_entryCells;
+		std::vector<unsigned int> m_largeBodies;
+
+		//Scratch space for Update, kept so it is not reallocated every frame.
+		struct CellRange
+		{
+			Cell cellMin;
+			Cell cellMax;
+			unsigned int count;		//Zero for a large body.
+		};
+
+		std::vector<CellRange> m_cellRanges;
+		std::vector<unsigned int> m_entryStarts;
+		std::vector<Cell> m_unsortedCells;
+		std::vector<unsigned int> m_unsortedBuckets;
+		std::vector<unsigned int> m_cursors;
+
+		Cell GetCell(const glm::vec3 &point) const;
+		size_t GetBucket(const Cell &cell) const;
+
+		void ThrowIfDirty() const;
+		void GatherCandidates(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+			std::vector<unsigned int> &candidates) const;
+		void FindOverlaps(const CollisionShape &shape, unsigned int layers, bool bStopAtFirst,
+			std::vector<unsigned int> &bodies) const;
+
+		//Prevent copying.
+		CollisionWorld(const CollisionWorld &);
+		CollisionWorld &operator=(const CollisionWorld &);
+	};
+}
+
+#endif //FRAMEWORK_COLLISION_H
@@ -0,0 +1,226 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <glload/gl_all.h>
+#include <glm/gtc/type_ptr.hpp>
+#include "CommandList.h"
+#include "FrameStats.h"
+#include "Profiler.h"
+#include "SceneBinders.h"
+#include "Mesh.h"
+
+namespace Framework
+{
+	void GLCommandBackend::UseProgram( GLuint program )
+	{
+		glUseProgram(program);
+		CountProgramBind();
+	}
+
+	void GLCommandBackend::SetMatrix4( GLint location, const float *pMatrix )
+	{
+		glUniformMatrix4fv(location, 1, GL_FALSE, pMatrix);
+	}
+
+	void GLCommandBackend::SetMatrix3( GLint location, const float *pMatrix )
+	{
+		glUniformMatrix3fv(location, 1, GL_FALSE, pMatrix);
+	}
+
+	void GLCommandBackend::SetFloat( GLint location, float value )
+	{
+		glUniform1f(location, value);
+	}
+
+	void GLCommandBackend::BindTexture( GLuint texUnit, GLenum target, GLuint texture, GLuint sampler )
+	{
+		glActiveTexture(GL_TEXTURE0 + texUnit);
+		glBindTexture(target, texture);
+		glBindSampler(texUnit, sampler);
+		CountTextureBind();
+	}
+
+	void GLCommandBackend::BindState( const StateBinder *pBinder, GLuint program )
+	{
+		pBinder->BindState(program);
+	}
+
+	void GLCommandBackend::UnbindState( const StateBinder *pBinder, GLuint program )
+	{
+		pBinder->UnbindState(program);
+	}
+
+	void GLCommandBackend::DrawMesh( const Mesh *pMesh )
+	{
+		pMesh->Render();
+	}
+
+	void NullCommandBackend::Reset()
+	{
+		numPrograms = 0;
+		numMatrices = 0;
+		numFloats = 0;
+		numTextures = 0;
+		numStates = 0;
+		numDraws = 0;
+		drawnMeshes.clear();
+	}
+
+	void NullCommandBackend::UseProgram( GLuint )
+	{
+		++numPrograms;
+	}
+
+	void NullCommandBackend::SetMatrix4( GLint, const float * )
+	{
+		++numMatrices;
+	}
+
+	void NullCommandBackend::SetMatrix3( GLint, const float * )
+	{
+		++numMatrices;
+	}
+
+	void NullCommandBackend::SetFloat( GLint, float )
+	{
+		++numFloats;
+	}
+
+	void NullCommandBackend::BindTexture( GLuint, GLenum, GLuint, GLuint )
+	{
+		++numTextures;
+	}
+
+	void NullCommandBackend::BindState( const StateBinder *, GLuint )
+	{
+		++numStates;
+	}
+
+	void NullCommandBackend::UnbindState( const StateBinder *, GLuint )
+	{
+		++numStates;
+	}
+
+	void NullCommandBackend::DrawMesh( const Mesh *pMesh )
+	{
+		++numDraws;
+		drawnMeshes.push_back(pMesh);
+	}
+
+	void CommandList::Clear()
+	{
+		m_commands.clear();
+		m_data.clear();
+	}
+
+	CommandList::Command &CommandList::AddCommand( CommandType type )
+	{
+		m_commands.push_back(Command());
+		Command &cmd = m_commands.back();
+		cmd.type = type;
+		cmd.location = -1;
+		cmd.object = 0;
+		cmd.target = 0;
+		cmd.sampler = 0;
+		cmd.dataOffset = 0;
+		cmd.pObject = NULL;
+		return cmd;
+	}
+
+	void CommandList::UseProgram( GLuint program )
+	{
+		AddCommand(CMD_USE_PROGRAM).object = program;
+	}
+
+	void CommandList::SetMatrix4( GLint location, const glm::mat4 &matrix )
+	{
+		Command &cmd = AddCommand(CMD_SET_MATRIX4);
+		cmd.location = location;
+		cmd.dataOffset = (unsigned int)m_data.size();
+		m_data.insert(m_data.end(), glm::value_ptr(matrix), glm::value_ptr(matrix) + 16);
+	}
+
+	void CommandList::SetMatrix3( GLint location, const glm::mat3 &matrix )
+	{
+		Command &cmd = AddCommand(CMD_SET_MATRIX3);
+		cmd.location = location;
+		cmd.dataOffset = (unsigned int)m_data.size();
+		m_data.insert(m_data.end(), glm::value_ptr(matrix), glm::value_ptr(matrix) + 9);
+	}
+
+	void CommandList::SetFloat( GLint location, float value )
+	{
+		Command &cmd = AddCommand(CMD_SET_FLOAT);
+		cmd.location = location;
+		cmd.dataOffset = (unsigned int)m_data.size();
+		m_data.push_back(value);
+	}
+
+	void CommandList::BindTexture( GLuint texUnit, GLenum target, GLuint texture, GLuint sampler )
+	{
+		Command &cmd = AddCommand(CMD_BIND_TEXTURE);
+		cmd.location = (GLint)texUnit;
+		cmd.target = target;
+		cmd.object = texture;
+		cmd.sampler = sampler;
+	}
+
+	void CommandList::BindState( const StateBinder *pBinder, GLuint program )
+	{
+		Command &cmd = AddCommand(CMD_BIND_STATE);
+		cmd.object = program;
+		cmd.pObject = pBinder;
+	}
+
+	void CommandList::UnbindState( const StateBinder *pBinder, GLuint program )
+	{
+		Command &cmd = AddCommand(CMD_UNBIND_STATE);
+		cmd.object = program;
+		cmd.pObject = pBinder;
+	}
+
+	void CommandList::DrawMesh( const Mesh *pMesh )
+	{
+		AddCommand(CMD_DRAW_MESH).pObject = pMesh;
+	}
+
+	void CommandList::Execute( CommandBackend &backend ) const
+	{
+		PROFILE_SCOPE("CommandList::Execute");
+		const float *pData = m_data.empty() ? NULL : &m_data[0];
+		for(std::vector<Command>::const_iterator cmdIt = m_commands.begin();
+			cmdIt != m_commands.end();
+			++cmdIt)
+		{
+			const Command &cmd = *cmdIt;
+			switch(cmd.type)
+			{
+			case CMD_USE_PROGRAM:
+				backend.UseProgram(cmd.object);
+				break;
+			case CMD_SET_MATRIX4:
+				backend.SetMatrix4(cmd.location, pData + cmd.dataOffset);
+				break;
+			case CMD_SET_MATRIX3:
+				backend.SetMatrix3(cmd.location, pData + cmd.dataOffset);
+				break;
+			case CMD_SET_FLOAT:
+				backend.SetFloat(cmd.location, pData[cmd.dataOffset]);
+				break;
+			case CMD_BIND_TEXTURE:
+				backend.BindTexture((GLuint)cmd.location, cmd.target, cmd.object, cmd.sampler);
+				break;
+			case CMD_BIND_STATE:
+				backend.BindState(static_cast<const StateBinder *>(cmd.pObject), cmd.object);
+				break;
+			case CMD_UNBIND_STATE:
+				backend.UnbindState(static_cast<const StateBinder *>(cmd.pObject), cmd.object);
+				break;
+			case CMD_DRAW_MESH:
+				backend.DrawMesh(static_cast<const Mesh *>(cmd.pObject));
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,138 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_COMMAND_LIST_H
+#define FRAMEWORK_COMMAND_LIST_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Framework
+{
+	class Mesh;
+	class StateBinder;
+
+	/**
+	Carries out the commands in a CommandList.
+
+	GLCommandBackend makes the actual OpenGL calls. NullCommandBackend makes none, so
+	recording can be checked, or timed, without a context.
+	**/
+	class CommandBackend
+	{
+	public:
+		virtual ~CommandBackend() {}
+
+		virtual void UseProgram(GLuint program) = 0;
+		virtual void SetMatrix4(GLint location, const float *pMatrix) = 0;
+		virtual void SetMatrix3(GLint location, const float *pMatrix) = 0;
+		virtual void SetFloat(GLint location, float value) = 0;
+		virtual void BindTexture(GLuint texUnit, GLenum target, GLuint texture, GLuint sampler) = 0;
+		virtual void BindState(const StateBinder *pBinder, GLuint program) = 0;
+		virtual void UnbindState(const StateBinder *pBinder, GLuint program) = 0;
+		virtual void DrawMesh(const Mesh *pMesh) = 0;
+	};
+
+	class GLCommandBackend : public CommandBackend
+	{
+	public:
+		virtual void UseProgram(GLuint program);
+		virtual void SetMatrix4(GLint location, const float *pMatrix);
+		virtual void SetMatrix3(GLint location, const float *pMatrix);
+		virtual void SetFloat(GLint location, float value);
+		virtual void BindTexture(GLuint texUnit, GLenum target, GLuint texture, GLuint sampler);
+		virtual void BindState(const StateBinder *pBinder, GLuint program);
+		virtual void UnbindState(const StateBinder *pBinder, GLuint program);
+		virtual void DrawMesh(const Mesh *pMesh);
+	};
+
+	//Counts what it is asked to do, and nothing else.
+	class NullCommandBackend : public CommandBackend
+	{
+	public:
+		NullCommandBackend() {Reset();}
+
+		void Reset();
+
+		virtual void UseProgram(GLuint program);
+		virtual void SetMatrix4(GLint location, const float *pMatrix);
+		virtual void SetMatrix3(GLint location, const float *pMatrix);
+		virtual void SetFloat(GLint location, float value);
+		virtual void BindTexture(GLuint texUnit, GLenum target, GLuint texture, GLuint sampler);
+		virtual void BindState(const StateBinder *pBinder, GLuint program);
+		virtual void UnbindState(const StateBinder *pBinder, GLuint program);
+		virtual void DrawMesh(const Mesh *pMesh);
+
+		size_t numPrograms;
+		size_t numMatrices;
+		size_t numFloats;
+		size_t numTextures;
+		size_t numStates;
+		size_t numDraws;
+		std::vector<const Mesh *> drawnMeshes;		//In draw order.
+	};
+
+	/**
+	A compact, backend-neutral record of draws and the state they need.
+
+	Recording touches no OpenGL, so separate lists can be recorded on separate threads.
+	Only Execute must happen on the thread that owns the context, when the backend uses GL.
+	Matrices are copied into the list; binders and meshes are referenced, so they must
+	outlive it.
+	**/
+	class CommandList
+	{
+	public:
+		//Empties the list, but keeps its memory for the next recording.
+		void Clear();
+
+		void UseProgram(GLuint program);
+		void SetMatrix4(GLint location, const glm::mat4 &matrix);
+		void SetMatrix3(GLint location, const glm::mat3 &matrix);
+		void SetFloat(GLint location, float value);
+
+		//A texture of 0 unbinds the unit.
+		void BindTexture(GLuint texUnit, GLenum target, GLuint texture, GLuint sampler);
+		void BindState(const StateBinder *pBinder, GLuint program);
+		void UnbindState(const StateBinder *pBinder, GLuint program);
+		void DrawMesh(const Mesh *pMesh);
+
+		void Execute(CommandBackend &backend) const;
+
+		size_t size() const {return m_commands.size();}
+		bool empty() const {return m_commands.empty();}
+
+	private:
+		enum CommandType
+		{
+			CMD_USE_PROGRAM,
+			CMD_SET_MATRIX4,
+			CMD_SET_MATRIX3,
+			CMD_SET_FLOAT,
+			CMD_BIND_TEXTURE,
+			CMD_BIND_STATE,
+			CMD_UNBIND_STATE,
+			CMD_DRAW_MESH,
+		};
+
+		//What the fields mean depends on the type.
+		struct Command
+		{
+			CommandType type;
+			GLint location;			//Uniform location or texture unit.
+			GLuint object;			//Program or texture.
+			GLenum target;
+			GLuint sampler;
+			unsigned int dataOffset;	//Into m_data, for matrices and floats.
+			const void *pObject;	//StateBinder or Mesh.
+		};
+
+		std::vector<Command> m_commands;
+		std::vector<float> m_data;
+
+		Command &AddCommand(CommandType type);
+	};
+}
+
+#endif //FRAMEWORK_COMMAND_LIST_H
@@ -0,0 +1,227 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "FileWatcher.h"
+
+#ifdef LOAD_X11
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif //LOAD_X11
+
+namespace Framework
+{
+	namespace
+	{
+		void SplitPathname(const std::string &pathname, std::string &dir, std::string &filename)
+		{
+			size_t slashLoc = pathname.find_last_of("/\\");
+			if(slashLoc == std::string::npos)
+			{
+				dir = ".";
+				filename = pathname;
+			}
+			else
+			{
+				dir = pathname.substr(0, slashLoc);
+				filename = pathname.substr(slashLoc + 1);
+			}
+		}
+	}
+
+#ifdef LOAD_X11
+	class FileWatcherImpl
+	{
+	public:
+		FileWatcherImpl()
+			: m_inotifyFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+		{
+			if(m_inotifyFd == -1)
+				throw std::runtime_error("Could not create an inotify instance.");
+		}
+
+		~FileWatcherImpl()
+		{
+			close(m_inotifyFd);
+		}
+
+		void AddFile(const std::string &pathname)
+		{
+			std::string dir, filename;
+			SplitPathname(pathname, dir, filename);
+
+			//Editors commonly replace the file rather than writing into it, so watch the
+			//directory for anything that leaves a complete file with that name.
+			int watchDesc = inotify_add_watch(m_inotifyFd, dir.c_str(),
+				IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+			if(watchDesc == -1)
+				throw std::runtime_error("Could not watch the directory " + dir);
+
+			m_watched[std::make_pair(watchDesc, filename)] = pathname;
+		}
+
+		void RemoveFile(const std::string &pathname)
+		{
+			int watchDesc = -1;
+			for(WatchMap::iterator theIt = m_watched.begin(); theIt != m_watched.end(); ++theIt)
+			{
+				if(theIt->second == pathname)
+				{
+					watchDesc = theIt->first.first;
+					m_watched.erase(theIt);
+					break;
+				}
+			}
+
+			if(watchDesc == -1)
+				return;
+
+			//The directory's watch is shared by every file in it.
+			for(WatchMap::const_iterator theIt = m_watched.begin(); theIt != m_watched.end(); ++theIt)
+			{
+				if(theIt->first.first == watchDesc)
+					return;
+			}
+
+			inotify_rm_watch(m_inotifyFd, watchDesc);
+		}
+
+		void Clear()
+		{
+			std::set<int> watchDescs;
+			for(WatchMap::const_iterator theIt = m_watched.begin(); theIt != m_watched.end(); ++theIt)
+				watchDescs.insert(theIt->first.first);
+
+			for(std::set<int>::const_iterator theIt = watchDescs.begin(); theIt != watchDescs.end(); ++theIt)
+				inotify_rm_watch(m_inotifyFd, *theIt);
+
+			m_watched.clear();
+		}
+
+		void GetChangedFiles(std::vector<std::string> &changedFiles)
+		{
+			std::set<std::string> changed;
+
+			//Large enough for many events at once; they are variable-sized.
+			char eventBuffer[16 * 1024]
+				__attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+			for(;;)
+			{
+				ssize_t bytesRead = read(m_inotifyFd, eventBuffer, sizeof(eventBuffer));
+				if(bytesRead <= 0)
+					break;
+
+				for(char *pCurr = eventBuffer; pCurr < eventBuffer + bytesRead; )
+				{
+					const struct inotify_event *pEvent =
+						reinterpret_cast<const struct inotify_event *>(pCurr);
+					pCurr += sizeof(struct inotify_event) + pEvent->len;
+
+					if(!pEvent->len)
+						continue;
+
+					WatchMap::const_iterator theIt =
+						m_watched.find(std::make_pair(pEvent->wd, std::string(pEvent->name)));
+					if(theIt != m_watched.end())
+						changed.insert(theIt->second);
+				}
+			}
+
+			changedFiles.insert(changedFiles.end(), changed.begin(), changed.end());
+		}
+
+	private:
+		typedef std::map<std::pair<int, std::string>, std::string> WatchMap;
+
+		int m_inotifyFd;
+		WatchMap m_watched;		//(directory watch, filename) to the pathname we were given.
+	};
+#else //LOAD_X11
+	class FileWatcherImpl
+	{
+	public:
+		void AddFile(const std::string &pathname)
+		{
+			if(m_watched.find(pathname) == m_watched.end())
+				m_watched[pathname] = GetModifiedTime(pathname);
+		}
+
+		void RemoveFile(const std::string &pathname)
+		{
+			m_watched.erase(pathname);
+		}
+
+		void Clear()
+		{
+			m_watched.clear();
+		}
+
+		void GetChangedFiles(std::vector<std::string> &changedFiles)
+		{
+			for(WatchMap::iterator theIt = m_watched.begin(); theIt != m_watched.end(); ++theIt)
+			{
+				time_t modTime = GetModifiedTime(theIt->first);
+				if(modTime != theIt->second)
+				{
+					theIt->second = modTime;
+					changedFiles.push_back(theIt->first);
+				}
+			}
+		}
+
+	private:
+		typedef std::map<std::string, time_t> WatchMap;
+
+		WatchMap m_watched;
+
+		static time_t GetModifiedTime(const std::string &pathname)
+		{
+			struct stat fileInfo;
+			if(stat(pathname.c_str(), &fileInfo) != 0)
+				return 0;
+
+			return fileInfo.st_mtime;
+		}
+	};
+#endif //LOAD_X11
+
+	FileWatcher::FileWatcher()
+		: m_pImpl(new FileWatcherImpl)
+	{}
+
+	FileWatcher::~FileWatcher()
+	{
+		delete m_pImpl;
+	}
+
+	void FileWatcher::AddFile( const std::string &pathname )
+	{
+		m_pImpl->AddFile(pathname);
+	}
+
+	void FileWatcher::RemoveFile( const std::string &pathname )
+	{
+		m_pImpl->RemoveFile(pathname);
+	}
+
+	void FileWatcher::Clear()
+	{
+		m_pImpl->Clear();
+	}
+
+	void FileWatcher::GetChangedFiles( std::vector<std::string> &changedFiles )
+	{
+		m_pImpl->GetChangedFiles(changedFiles);
+	}
+}
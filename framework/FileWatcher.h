@@ -0,0 +1,50 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_FILE_WATCHER_H
+#define FRAMEWORK_FILE_WATCHER_H
+
+#include <string>
+#include <vector>
+
+namespace Framework
+{
+	class FileWatcherImpl;
+
+	/**
+	Reports when watched files are written.
+
+	On Linux, this uses inotify on the directory of each file, so that editors which save by
+	writing a new file and renaming it over the old one are still seen. Elsewhere, it compares
+	modification times whenever it is polled.
+	**/
+	class FileWatcher
+	{
+	public:
+		FileWatcher();
+		~FileWatcher();
+
+		//The pathname is reported back exactly as given, so pass what FindFileOrThrow returned.
+		//Watching the same file twice has no further effect.
+		void AddFile(const std::string &pathname);
+
+		//Stops watching the file. Changes to it that were not yet reported are dropped.
+		void RemoveFile(const std::string &pathname);
+
+		//Stops watching everything.
+		void Clear();
+
+		//Appends each watched file that has changed since the last call, once. Never blocks.
+		void GetChangedFiles(std::vector<std::string> &changedFiles);
+
+	private:
+		FileWatcherImpl *m_pImpl;
+
+		//Prevent copying.
+		FileWatcher(const FileWatcher &);
+		FileWatcher &operator=(const FileWatcher &);
+	};
+}
+
+#endif //FRAMEWORK_FILE_WATCHER_H
@@ -0,0 +1,600 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+#include "Fleet.h"
+#include "WorkerPool.h"
+#include "Profiler.h"
+
+#if defined(__AVX__)
+#define FRAMEWORK_FLEET_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRAMEWORK_FLEET_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Framework
+{
+	namespace
+	{
+		//Grids bigger than this mean the neighbor radius is far too small for the bounds.
+		const size_t MAX_GRID_CELLS = 1 << 24;
+
+		//Keeps divisions by lengths finite. Lanes where it matters are discarded anyway.
+		const float TINY = 1.0e-20f;
+
+		//Positions and velocities have this many unused values after the last craft, so the
+		//neighbor scan can load whole vectors at the end of the arrays.
+		const size_t PADDING = 8;
+
+		//The operations the steering and integration kernels are written in, so each is written
+		//once. Element-wise operations give the same bits at every width; only Sum, which adds
+		//the lanes together, depends on it.
+		struct ScalarOps
+		{
+			typedef float Floats;
+			typedef bool Mask;
+			enum {LANES = 1};
+
+			static Floats Load(const float *pValues) {return *pValues;}
+			static void Store(float *pValues, Floats values) {*pValues = values;}
+			static Floats Set(float value) {return value;}
+			static Floats LaneIndices() {return 0.0f;}
+			static Floats Add(Floats a, Floats b) {return a + b;}
+			static Floats Sub(Floats a, Floats b) {return a - b;}
+			static Floats Mul(Floats a, Floats b) {return a * b;}
+			static Floats Div(Floats a, Floats b) {return a / b;}
+			static Floats Max(Floats a, Floats b) {return a > b ? a : b;}
+			static Floats Sqrt(Floats a) {return sqrtf(a);}
+			static Mask Less(Floats a, Floats b) {return a < b;}
+			static Mask Greater(Floats a, Floats b) {return a > b;}
+			static Mask And(Mask a, Mask b) {return a && b;}
+			static Floats Select(Mask mask, Floats a, Floats b) {return mask ? a : b;}
+			static float Sum(Floats values) {return values;}
+		};
+
+#ifdef FRAMEWORK_FLEET_AVX
+		struct SimdOps
+		{
+			typedef __m256 Floats;
+			typedef __m256 Mask;
+			enum {LANES = 8};
+
+			static Floats Load(const float *pValues) {return _mm256_loadu_ps(pValues);}
+			static void Store(float *pValues, Floats values) {_mm256_storeu_ps(pValues, values);}
+			static Floats Set(float value) {return _mm256_set1_ps(value);}
+			static Floats LaneIndices() {return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);}
+			static Floats Add(Floats a, Floats b) {return _mm256_add_ps(a, b);}
+			static Floats Sub(Floats a, Floats b) {return _mm256_sub_ps(a, b);}
+			static Floats Mul(Floats a, Floats b) {return _mm256_mul_ps(a, b);}
+			static Floats Div(Floats a, Floats b) {return _mm256_div_ps(a, b);}
+			static Floats Max(Floats a, Floats b) {return _mm256_max_ps(a, b);}
+			static Floats Sqrt(Floats a) {return _mm256_sqrt_ps(a);}
+			static Mask Less(Floats a, Floats b) {return _mm256_cmp_ps(a, b, _CMP_LT_OQ);}
+			static Mask Greater(Floats a, Floats b) {return _mm256_cmp_ps(a, b, _CMP_GT_OQ);}
+			static Mask And(Mask a, Mask b) {return _mm256_and_ps(a, b);}
+
+			//Not blendv: compilers may rewrite it as a sign test, which AVX without AVX2 has to
+			//do a lane at a time.
+			static Floats Select(Mask mask, Floats a, Floats b)
+			{
+				return _mm256_or_ps(_mm256_and_ps(mask, a), _mm256_andnot_ps(mask, b));
+			}
+
+			static float Sum(Floats values)
+			{
+				float lanes[LANES];
+				_mm256_storeu_ps(lanes, values);
+				float total = lanes[0];
+				for(int laneIx = 1; laneIx < LANES; ++laneIx)
+					total += lanes[laneIx];
+				return total;
+			}
+		};
+#elif defined(FRAMEWORK_FLEET_SSE2)
+		struct SimdOps
+		{
+			typedef __m128 Floats;
+			typedef __m128 Mask;
+			enum {LANES = 4};
+
+			static Floats Load(const float *pValues) {return _mm_loadu_ps(pValues);}
+			static void Store(float *pValues, Floats values) {_mm_storeu_ps(pValues, values);}
+			static Floats Set(float value) {return _mm_set1_ps(value);}
+			static Floats LaneIndices() {return _mm_setr_ps(0, 1, 2, 3);}
+			static Floats Add(Floats a, Floats b) {return _mm_add_ps(a, b);}
+			static Floats Sub(Floats a, Floats b) {return _mm_sub_ps(a, b);}
+			static Floats Mul(Floats a, Floats b) {return _mm_mul_ps(a, b);}
+			static Floats Div(Floats a, Floats b) {return _mm_div_ps(a, b);}
+			static Floats Max(Floats a, Floats b) {return _mm_max_ps(a, b);}
+			static Floats Sqrt(Floats a) {return _mm_sqrt_ps(a);}
+			static Mask Less(Floats a, Floats b) {return _mm_cmplt_ps(a, b);}
+			static Mask Greater(Floats a, Floats b) {return _mm_cmpgt_ps(a, b);}
+			static Mask And(Mask a, Mask b) {return _mm_and_ps(a, b);}
+
+			static Floats Select(Mask mask, Floats a, Floats b)
+			{
+				return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+			}
+
+			static float Sum(Floats values)
+			{
+				float lanes[LANES];
+				_mm_storeu_ps(lanes, values);
+				float total = lanes[0];
+				for(int laneIx = 1; laneIx < LANES; ++laneIx)
+					total += lanes[laneIx];
+				return total;
+			}
+		};
+#else
+		typedef ScalarOps SimdOps;
+#endif
+
+		//What a craft's neighbors add up to.
+		template<typename Ops>
+		struct NeighborSums
+		{
+			typename Ops::Floats count;
+			typename Ops::Floats posX, posY, posZ;
+			typename Ops::Floats velX, velY, velZ;
+			typename Ops::Floats awayX, awayY, awayZ;	//Separation: away from each, by 1 / distance.
+
+			NeighborSums()
+			{
+				count = posX = posY = posZ = velX = velY = velZ = awayX = awayY = awayZ = Ops::Set(0.0f);
+			}
+		};
+
+		struct CraftArrays
+		{
+			const float *pPosX, *pPosY, *pPosZ;
+			const float *pVelX, *pVelY, *pVelZ;
+		};
+
+		//Adds the craft in [begin, end) that are within the neighbor radius. The last vector
+		//may run past the end, into the next cell or the padding; lanes there are masked off.
+		//A craft is never its own neighbor, as it is no distance away.
+		template<typename Ops>
+		void SumNeighbors(const CraftArrays &craft, size_t begin, size_t end, const glm::vec3 &position,
+			float radiusSqr, float separationRadiusSqr, NeighborSums<Ops> &sums)
+		{
+			typedef typename Ops::Floats Floats;
+			typedef typename Ops::Mask Mask;
+
+			const Floats x = Ops::Set(position.x);
+			const Floats y = Ops::Set(position.y);
+			const Floats z = Ops::Set(position.z);
+			const Floats zero = Ops::Set(0.0f);
+			const Floats one = Ops::Set(1.0f);
+			const Floats radius = Ops::Set(radiusSqr);
+			const Floats separation = Ops::Set(separationRadiusSqr);
+			const Floats lanes = Ops::LaneIndices();
+
+			for(size_t craftIx = begin; craftIx < end; craftIx += Ops::LANES)
+			{
+				Floats otherX = Ops::Load(craft.pPosX + craftIx);
+				Floats otherY = Ops::Load(craft.pPosY + craftIx);
+				Floats otherZ = Ops::Load(craft.pPosZ + craftIx);
+				Floats diffX = Ops::Sub(x, otherX);
+				Floats diffY = Ops::Sub(y, otherY);
+				Floats diffZ = Ops::Sub(z, otherZ);
+				Floats distSqr = Ops::Add(Ops::Add(Ops::Mul(diffX, diffX), Ops::Mul(diffY, diffY)),
+					Ops::Mul(diffZ, diffZ));
+
+				Mask isOther = Ops::And(Ops::Greater(distSqr, zero),
+					Ops::Less(lanes, Ops::Set((float)(end - craftIx))));
+				Mask isNear = Ops::And(Ops::Less(distSqr, radius), isOther);
+				sums.count = Ops::Add(sums.count, Ops::Select(isNear, one, zero));
+				sums.posX = Ops::Add(sums.posX, Ops::Select(isNear, otherX, zero));
+				sums.posY = Ops::Add(sums.posY, Ops::Select(isNear, otherY, zero));
+				sums.posZ = Ops::Add(sums.posZ, Ops::Select(isNear, otherZ, zero));
+				sums.velX = Ops::Add(sums.velX, Ops::Select(isNear, Ops::Load(craft.pVelX + craftIx), zero));
+				sums.velY = Ops::Add(sums.velY, Ops::Select(isNear, Ops::Load(craft.pVelY + craftIx), zero));
+				sums.velZ = Ops::Add(sums.velZ, Ops::Select(isNear, Ops::Load(craft.pVelZ + craftIx), zero));
+
+				Mask isClose = Ops::And(Ops::Less(distSqr, separation), isOther);
+				Floats invDistSqr = Ops::Div(one, Ops::Max(distSqr, Ops::Set(TINY)));
+				sums.awayX = Ops::Add(sums.awayX, Ops::Select(isClose, Ops::Mul(diffX, invDistSqr), zero));
+				sums.awayY = Ops::Add(sums.awayY, Ops::Select(isClose, Ops::Mul(diffY, invDistSqr), zero));
+				sums.awayZ = Ops::Add(sums.awayZ, Ops::Select(isClose, Ops::Mul(diffZ, invDistSqr), zero));
+			}
+		}
+
+		struct IntegrateArrays
+		{
+			float *pPosX, *pPosY, *pPosZ;
+			float *pVelX, *pVelY, *pVelZ;
+			float *pHeadX, *pHeadY, *pHeadZ;
+			const float *pAccelX, *pAccelY, *pAccelZ;
+		};
+
+		//Clamps the acceleration and speed, then moves the craft, a whole number of lanes at a
+		//time. Returns where it stopped. A craft that stops keeps its last heading.
+		template<typename Ops>
+		size_t IntegrateCraft(const IntegrateArrays &craft, size_t begin, size_t end,
+			const FleetSettings &settings, float seconds)
+		{
+			typedef typename Ops::Floats Floats;
+			typedef typename Ops::Mask Mask;
+
+			const Floats zero = Ops::Set(0.0f);
+			const Floats one = Ops::Set(1.0f);
+			const Floats tiny = Ops::Set(TINY);
+			const Floats dt = Ops::Set(seconds);
+			const Floats maxAccel = Ops::Set(settings.maxAcceleration);
+			const Floats minSpeed = Ops::Set(settings.minSpeed);
+			const Floats maxSpeed = Ops::Set(settings.maxSpeed);
+
+			size_t craftIx = begin;
+			for(; craftIx + Ops::LANES <= end; craftIx += Ops::LANES)
+			{
+				Floats accelX = Ops::Load(craft.pAccelX + craftIx);
+				Floats accelY = Ops::Load(craft.pAccelY + craftIx);
+				Floats accelZ = Ops::Load(craft.pAccelZ + craftIx);
+				Floats accel = Ops::Sqrt(Ops::Add(Ops::Add(Ops::Mul(accelX, accelX),
+					Ops::Mul(accelY, accelY)), Ops::Mul(accelZ, accelZ)));
+				Floats accelScale = Ops::Select(Ops::Greater(accel, maxAccel),
+					Ops::Div(maxAccel, Ops::Max(accel, tiny)), one);
+				Floats scaledDt = Ops::Mul(accelScale, dt);
+
+				Floats velX = Ops::Add(Ops::Load(craft.pVelX + craftIx), Ops::Mul(accelX, scaledDt));
+				Floats velY = Ops::Add(Ops::Load(craft.pVelY + craftIx), Ops::Mul(accelY, scaledDt));
+				Floats velZ = Ops::Add(Ops::Load(craft.pVelZ + craftIx), Ops::Mul(accelZ, scaledDt));
+
+				Floats speed = Ops::Sqrt(Ops::Add(Ops::Add(Ops::Mul(velX, velX), Ops::Mul(velY, velY)),
+					Ops::Mul(velZ, velZ)));
+				Mask isMoving = Ops::Greater(speed, zero);
+				Floats safeSpeed = Ops::Max(speed, tiny);
+				Floats speedScale = Ops::Select(Ops::Greater(speed, maxSpeed), Ops::Div(maxSpeed, safeSpeed),
+					Ops::Select(Ops::And(Ops::Less(speed, minSpeed), isMoving), Ops::Div(minSpeed, safeSpeed), one));
+				velX = Ops::Mul(velX, speedScale);
+				velY = Ops::Mul(velY, speedScale);
+				velZ = Ops::Mul(velZ, speedScale);
+
+				Floats invSpeed = Ops::Div(one, Ops::Max(Ops::Mul(speed, speedScale), tiny));
+				Ops::Store(craft.pHeadX + craftIx, Ops::Select(isMoving, Ops::Mul(velX, invSpeed),
+					Ops::Load(craft.pHeadX + craftIx)));
+				Ops::Store(craft.pHeadY + craftIx, Ops::Select(isMoving, Ops::Mul(velY, invSpeed),
+					Ops::Load(craft.pHeadY + craftIx)));
+				Ops::Store(craft.pHeadZ + craftIx, Ops::Select(isMoving, Ops::Mul(velZ, invSpeed),
+					Ops::Load(craft.pHeadZ + craftIx)));
+
+				Ops::Store(craft.pVelX + craftIx, velX);
+				Ops::Store(craft.pVelY + craftIx, velY);
+				Ops::Store(craft.pVelZ + craftIx, velZ);
+				Ops::Store(craft.pPosX + craftIx, Ops::Add(Ops::Load(craft.pPosX + craftIx), Ops::Mul(velX, dt)));
+				Ops::Store(craft.pPosY + craftIx, Ops::Add(Ops::Load(craft.pPosY + craftIx), Ops::Mul(velY, dt)));
+				Ops::Store(craft.pPosZ + craftIx, Ops::Add(Ops::Load(craft.pPosZ + craftIx), Ops::Mul(velZ, dt)));
+			}
+
+			return craftIx;
+		}
+
+		int ClampCell(float coord, int size)
+		{
+			if(!(coord >= 0.0f))
+				return 0;
+			if(coord >= (float)size)
+				return size - 1;
+			return (int)coord;
+		}
+
+		float NextRandom(unsigned int &seed)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return (seed >> 8) / 16777216.0f;
+		}
+
+		//Keeps the padding after the craft.
+		void Permute(std::vector<float> &values, const std::vector<unsigned int> &order,
+			std::vector<float> &scratch)
+		{
+			scratch.resize(values.size());
+			for(size_t craftIx = 0; craftIx < order.size(); ++craftIx)
+				scratch[craftIx] = values[order[craftIx]];
+			std::fill(scratch.begin() + order.size(), scratch.end(), 0.0f);
+			values.swap(scratch);
+		}
+	}
+
+	Fleet::Fleet( const FleetSettings &settings )
+		: m_count(0)
+		, m_cellSize(1.0f)
+	{
+		SetSettings(settings);
+	}
+
+	void Fleet::SetSettings( const FleetSettings &settings )
+	{
+		if(settings.neighborRadius <= 0.0f || settings.separationRadius > settings.neighborRadius)
+			throw std::runtime_error("The fleet's separation radius must be within a positive neighbor radius.");
+		if(settings.minSpeed < 0.0f || settings.maxSpeed < settings.minSpeed)
+			throw std::runtime_error("The fleet's speed limits are out of order.");
+		if(glm::any(glm::lessThan(settings.boundsMax, settings.boundsMin)))
+			throw std::runtime_error("The fleet's bounds are inside out.");
+
+		m_settings = settings;
+		BuildGrid();
+	}
+
+	void Fleet::BuildGrid()
+	{
+		//A border of a cell on every side catches craft that stray out of bounds. Those further
+		//out are clamped into it, which keeps neighbors within a cell of each other.
+		m_cellSize = m_settings.neighborRadius;
+		m_gridOrigin = m_settings.boundsMin - glm::vec3(m_cellSize);
+
+		size_t cellCount = 1;
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			float extent = m_settings.boundsMax[axis] - m_settings.boundsMin[axis];
+			float size = ceilf(extent / m_cellSize) + 2.0f;
+			if(size > (float)MAX_GRID_CELLS)
+				throw std::runtime_error("The fleet's neighbor radius is too small for its bounds.");
+			m_gridSize[axis] = (int)size;
+			cellCount *= m_gridSize[axis];
+			if(cellCount > MAX_GRID_CELLS)
+				throw std::runtime_error("The fleet's neighbor radius is too small for its bounds.");
+		}
+
+		m_cellStarts.assign(cellCount + 1, 0);
+	}
+
+	void Fleet::Spawn( size_t count, unsigned int seed )
+	{
+		glm::vec3 extent = m_settings.boundsMax - m_settings.boundsMin;
+		float speed = 0.5f * (m_settings.minSpeed + m_settings.maxSpeed);
+		size_t firstIx = m_count;
+		Resize(m_count + count);
+		for(size_t craftIx = firstIx; craftIx < m_count; ++craftIx)
+		{
+			glm::vec3 position = m_settings.boundsMin + extent *
+				glm::vec3(NextRandom(seed), NextRandom(seed), NextRandom(seed));
+
+			//A direction leaning no more than 30 degrees from level.
+			float yaw = NextRandom(seed) * 6.2831853f;
+			float pitch = (NextRandom(seed) - 0.5f) * 1.0471976f;
+			glm::vec3 heading(sinf(yaw) * cosf(pitch), sinf(pitch), cosf(yaw) * cosf(pitch));
+
+			m_posX[craftIx] = position.x;
+			m_posY[craftIx] = position.y;
+			m_posZ[craftIx] = position.z;
+			m_velX[craftIx] = heading.x * speed;
+			m_velY[craftIx] = heading.y * speed;
+			m_velZ[craftIx] = heading.z * speed;
+			m_headX[craftIx] = heading.x;
+			m_headY[craftIx] = heading.y;
+			m_headZ[craftIx] = heading.z;
+		}
+	}
+
+	void Fleet::Clear()
+	{
+		Resize(0);
+	}
+
+	void Fleet::Resize( size_t count )
+	{
+		std::vector<float> *arrays[] = {
+			&m_posX, &m_posY, &m_posZ,
+			&m_velX, &m_velY, &m_velZ,
+			&m_headX, &m_headY, &m_headZ,
+			&m_accelX, &m_accelY, &m_accelZ,
+		};
+
+		for(size_t arrayIx = 0; arrayIx < sizeof(arrays) / sizeof(arrays[0]); ++arrayIx)
+		{
+			arrays[arrayIx]->resize(count + PADDING);
+			std::fill(arrays[arrayIx]->begin() + count, arrays[arrayIx]->end(), 0.0f);
+		}
+		m_count = count;
+	}
+
+	void Fleet::Step( float seconds )
+	{
+		Step(seconds, GetWorkerPool());
+	}
+
+	void Fleet::Step( float seconds, WorkerPool &pool )
+	{
+		PROFILE_SCOPE("Fleet::Step");
+		if(m_count == 0)
+			return;
+
+		SortByCell();
+
+		{
+			PROFILE_SCOPE("Fleet::Steer");
+			ParallelFor(pool, m_count, 256, [this](size_t begin, size_t end) {Steer(begin, end);});
+		}
+
+		{
+			PROFILE_SCOPE("Fleet::Integrate");
+			ParallelFor(pool, m_count, 4096,
+				[this, seconds](size_t begin, size_t end) {Integrate(begin, end, seconds);});
+		}
+	}
+
+	void Fleet::SortByCell()
+	{
+		PROFILE_SCOPE("Fleet::SortByCell");
+
+		//A counting sort, which keeps craft in the same cell in the order they were in.
+		m_cells.resize(m_count);
+		std::fill(m_cellStarts.begin(), m_cellStarts.end(), 0);
+		float invCellSize = 1.0f / m_cellSize;
+		for(size_t craftIx = 0; craftIx < m_count; ++craftIx)
+		{
+			int cellX = ClampCell((m_posX[craftIx] - m_gridOrigin.x) * invCellSize, m_gridSize[0]);
+			int cellY = ClampCell((m_posY[craftIx] - m_gridOrigin.y) * invCellSize, m_gridSize[1]);
+			int cellZ = ClampCell((m_posZ[craftIx] - m_gridOrigin.z) * invCellSize, m_gridSize[2]);
+			unsigned int cell = (cellZ * m_gridSize[1] + cellY) * m_gridSize[0] + cellX;
+			m_cells[craftIx] = cell;
+			++m_cellStarts[cell + 1];
+		}
+
+		for(size_t cellIx = 1; cellIx < m_cellStarts.size(); ++cellIx)
+			m_cellStarts[cellIx] += m_cellStarts[cellIx - 1];
+
+		//Places each craft after the ones already in its cell, then moves the starts back.
+		m_order.resize(m_count);
+		for(size_t craftIx = 0; craftIx < m_count; ++craftIx)
+			m_order[m_cellStarts[m_cells[craftIx]]++] = (unsigned int)craftIx;
+		for(size_t cellIx = m_cellStarts.size() - 1; cellIx > 0; --cellIx)
+			m_cellStarts[cellIx] = m_cellStarts[cellIx - 1];
+		m_cellStarts[0] = 0;
+
+		Permute(m_posX, m_order, m_scratch);
+		Permute(m_posY, m_order, m_scratch);
+		Permute(m_posZ, m_order, m_scratch);
+		Permute(m_velX, m_order, m_scratch);
+		Permute(m_velY, m_order, m_scratch);
+		Permute(m_velZ, m_order, m_scratch);
+		Permute(m_headX, m_order, m_scratch);
+		Permute(m_headY, m_order, m_scratch);
+		Permute(m_headZ, m_order, m_scratch);
+
+		//The cells are now in order, and the starts give each one's run.
+		for(size_t cellIx = 0; cellIx + 1 < m_cellStarts.size(); ++cellIx)
+		{
+			for(unsigned int craftIx = m_cellStarts[cellIx]; craftIx < m_cellStarts[cellIx + 1]; ++craftIx)
+				m_cells[craftIx] = (unsigned int)cellIx;
+		}
+	}
+
+	void Fleet::Steer( size_t begin, size_t end )
+	{
+		CraftArrays craft = {&m_posX[0], &m_posY[0], &m_posZ[0], &m_velX[0], &m_velY[0], &m_velZ[0]};
+		float radiusSqr = m_settings.neighborRadius * m_settings.neighborRadius;
+		float separationRadiusSqr = m_settings.separationRadius * m_settings.separationRadius;
+		int rowCells = m_gridSize[0];
+		int layerCells = m_gridSize[0] * m_gridSize[1];
+
+		for(size_t craftIx = begin; craftIx < end; ++craftIx)
+		{
+			glm::vec3 position(m_posX[craftIx], m_posY[craftIx], m_posZ[craftIx]);
+			int cell = m_cells[craftIx];
+			int cellX = cell % rowCells;
+			int cellY = (cell / rowCells) % m_gridSize[1];
+			int cellZ = cell / layerCells;
+			int firstX = std::max(cellX - 1, 0);
+			int lastX = std::min(cellX + 1, m_gridSize[0] - 1);
+
+			//Each row of three cells is one run of craft, as the grid is sorted along x first.
+			NeighborSums<SimdOps> sums;
+			for(int z = std::max(cellZ - 1, 0); z <= std::min(cellZ + 1, m_gridSize[2] - 1); ++z)
+			{
+				for(int y = std::max(cellY - 1, 0); y <= std::min(cellY + 1, m_gridSize[1] - 1); ++y)
+				{
+					int rowStart = z * layerCells + y * rowCells;
+					size_t runBegin = m_cellStarts[rowStart + firstX];
+					size_t runEnd = m_cellStarts[rowStart + lastX + 1];
+
+					SumNeighbors(craft, runBegin, runEnd, position, radiusSqr, separationRadiusSqr, sums);
+				}
+			}
+
+			float count = SimdOps::Sum(sums.count);
+			glm::vec3 velocity(m_velX[craftIx], m_velY[craftIx], m_velZ[craftIx]);
+			glm::vec3 accel(0.0f);
+			if(count > 0.0f)
+			{
+				glm::vec3 sumPos(SimdOps::Sum(sums.posX), SimdOps::Sum(sums.posY), SimdOps::Sum(sums.posZ));
+				glm::vec3 sumVel(SimdOps::Sum(sums.velX), SimdOps::Sum(sums.velY), SimdOps::Sum(sums.velZ));
+				glm::vec3 away(SimdOps::Sum(sums.awayX), SimdOps::Sum(sums.awayY), SimdOps::Sum(sums.awayZ));
+
+				accel += away * m_settings.separationWeight;
+				accel += (sumVel / count - velocity) * m_settings.alignmentWeight;
+				accel += (sumPos / count - position) * m_settings.cohesionWeight;
+			}
+
+			glm::vec3 inside = glm::clamp(position, m_settings.boundsMin, m_settings.boundsMax);
+			accel += (inside - position) * m_settings.boundsWeight;
+
+			m_accelX[craftIx] = accel.x;
+			m_accelY[craftIx] = accel.y;
+			m_accelZ[craftIx] = accel.z;
+		}
+	}
+
+	void Fleet::Integrate( size_t begin, size_t end, float seconds )
+	{
+		IntegrateArrays craft = {
+			&m_posX[0], &m_posY[0], &m_posZ[0],
+			&m_velX[0], &m_velY[0], &m_velZ[0],
+			&m_headX[0], &m_headY[0], &m_headZ[0],
+			&m_accelX[0], &m_accelY[0], &m_accelZ[0],
+		};
+
+		size_t tail = IntegrateCraft<SimdOps>(craft, begin, end, m_settings, seconds);
+		IntegrateCraft<ScalarOps>(craft, tail, end, m_settings, seconds);
+	}
+
+	glm::vec3 Fleet::GetPosition( size_t craftIx ) const
+	{
+		return glm::vec3(m_posX[craftIx], m_posY[craftIx], m_posZ[craftIx]);
+	}
+
+	glm::vec3 Fleet::GetVelocity( size_t craftIx ) const
+	{
+		return glm::vec3(m_velX[craftIx], m_velY[craftIx], m_velZ[craftIx]);
+	}
+
+	glm::vec3 Fleet::GetHeading( size_t craftIx ) const
+	{
+		return glm::vec3(m_headX[craftIx], m_headY[craftIx], m_headZ[craftIx]);
+	}
+
+	void Fleet::WriteInstances( std::vector<float> &instances ) const
+	{
+		PROFILE_SCOPE("Fleet::WriteInstances");
+		instances.resize(m_count * 6);
+		for(size_t craftIx = 0; craftIx < m_count; ++craftIx)
+		{
+			float *pInstance = &instances[craftIx * 6];
+			pInstance[0] = m_posX[craftIx];
+			pInstance[1] = m_posY[craftIx];
+			pInstance[2] = m_posZ[craftIx];
+			pInstance[3] = m_headX[craftIx];
+			pInstance[4] = m_headY[craftIx];
+			pInstance[5] = m_headZ[craftIx];
+		}
+	}
+
+	unsigned long long Fleet::Hash() const
+	{
+		const std::vector<float> *arrays[] = {&m_posX, &m_posY, &m_posZ, &m_velX, &m_velY, &m_velZ};
+
+		//64-bit FNV-1a over the bits of every value.
+		unsigned long long hash = 14695981039346656037ULL;
+		for(size_t arrayIx = 0; arrayIx < sizeof(arrays) / sizeof(arrays[0]); ++arrayIx)
+		{
+			for(size_t craftIx = 0; craftIx < m_count; ++craftIx)
+			{
+				unsigned int bits;
+				memcpy(&bits, &(*arrays[arrayIx])[craftIx], sizeof(bits));
+				for(int byteIx = 0; byteIx < 4; ++byteIx)
+				{
+					hash ^= (bits >> (byteIx * 8)) & 0xFF;
+					hash *= 1099511628211ULL;
+				}
+			}
+		}
+		return hash;
+	}
+
+	int Fleet::GetSimdWidth()
+	{
+		return SimdOps::LANES;
+	}
+}
@@ -0,0 +1,123 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_FLEET_H
+#define FRAMEWORK_FLEET_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Framework
+{
+	class WorkerPool;
+
+	struct FleetSettings
+	{
+		FleetSettings()
+			: neighborRadius(6.0f)
+			, separationRadius(2.5f)
+			, separationWeight(20.0f)
+			, alignmentWeight(1.5f)
+			, cohesionWeight(0.6f)
+			, boundsWeight(4.0f)
+			, minSpeed(4.0f)
+			, maxSpeed(12.0f)
+			, maxAcceleration(30.0f)
+			, boundsMin(-45.0f, 2.0f, -45.0f)
+			, boundsMax(45.0f, 30.0f, 45.0f)
+		{}
+
+		float neighborRadius;		//Craft closer than this steer with each other.
+		float separationRadius;		//Craft closer than this steer apart.
+		float separationWeight;
+		float alignmentWeight;		//Towards the neighbors' mean velocity.
+		float cohesionWeight;		//Towards the neighbors' mean position.
+		float boundsWeight;			//Back into the bounds, per unit outside them.
+		float minSpeed;
+		float maxSpeed;
+		float maxAcceleration;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	/**
+	A flock of craft steering by separation, alignment and cohesion.
+
+	The craft are stored as structures of arrays. Every step, they are sorted by cell of a grid
+	whose cells are as wide as the neighbor radius, so each craft's neighbors lie in nine
+	contiguous runs: one per row of three cells around it. The runs are scanned, and the craft
+	integrated, eight at a time with AVX when it is compiled in (premake's --avx option), four
+	at a time with SSE2 otherwise.
+
+	Both passes are split across the worker pool. Each craft only reads the state from the
+	start of the step, and sums its neighbors in a fixed order, so the results do not depend on
+	the number of threads. They do depend on the instruction set, which changes the order sums
+	are made in.
+
+	The sort changes the order of the craft each step; they have no identity.
+	**/
+	class Fleet
+	{
+	public:
+		explicit Fleet(const FleetSettings &settings = FleetSettings());
+
+		void SetSettings(const FleetSettings &settings);
+		const FleetSettings &GetSettings() const {return m_settings;}
+
+		//Adds craft at random places inside the bounds, flying in random directions. The same
+		//seed always gives the same craft.
+		void Spawn(size_t count, unsigned int seed);
+		void Clear();
+
+		size_t GetCount() const {return m_count;}
+
+		//Steps every craft on the shared worker pool, or the given one.
+		void Step(float seconds);
+		void Step(float seconds, WorkerPool &pool);
+
+		glm::vec3 GetPosition(size_t craftIx) const;
+		glm::vec3 GetVelocity(size_t craftIx) const;
+
+		//The unit direction of the velocity.
+		glm::vec3 GetHeading(size_t craftIx) const;
+
+		//The position, then the heading, of each craft, as six floats: the instance data for
+		//drawing the fleet.
+		void WriteInstances(std::vector<float> &instances) const;
+
+		//A hash of every position and velocity, for checking that runs match.
+		unsigned long long Hash() const;
+
+		//The SIMD width the build uses: 8 for AVX, 4 for SSE2 and 1 otherwise.
+		static int GetSimdWidth();
+
+	private:
+		FleetSettings m_settings;
+		size_t m_count;
+
+		//Indexed by craft, in the order of the last sort, with some padding after the last one.
+		std::vector<float> m_posX, m_posY, m_posZ;
+		std::vector<float> m_velX, m_velY, m_velZ;
+		std::vector<float> m_headX, m_headY, m_headZ;
+		std::vector<float> m_accelX, m_accelY, m_accelZ;
+
+		//The sort's scratch space, kept to avoid reallocating.
+		std::vector<float> m_scratch;
+		std::vector<unsigned int> m_cells;
+		std::vector<unsigned int> m_order;
+		std::vector<unsigned int> m_cellStarts;	//One past the end of the grid, too.
+
+		glm::vec3 m_gridOrigin;
+		float m_cellSize;
+		int m_gridSize[3];
+
+		void Resize(size_t count);
+		void BuildGrid();
+		void SortByCell();
+		void Steer(size_t begin, size_t end);
+		void Integrate(size_t begin, size_t end, float seconds);
+	};
+}
+
+#endif //FRAMEWORK_FLEET_H
@@ -0,0 +1,264 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+
+#include "FrameLoop.h"
+#include "Profiler.h"
+
+namespace Framework
+{
+	namespace
+	{
+		//Sleeps end this far before the deadline; the rest is spent yielding.
+		const std::chrono::microseconds SLEEP_MARGIN(1500);
+
+		float ToMilliseconds(std::chrono::steady_clock::duration duration)
+		{
+			return std::chrono::duration<float, std::milli>(duration).count();
+		}
+
+		void WriteSummary(std::ostream &out, const char *name, const FrameTimeHistogram &histogram)
+		{
+			out << name << "," << histogram.GetSampleCount() << "," << histogram.GetMean() << "," <<
+				histogram.GetPercentile(0.50f) << "," << histogram.GetPercentile(0.95f) << "," <<
+				histogram.GetPercentile(0.99f) << "," << histogram.GetMax() << "\n";
+		}
+	}
+
+	FrameTimeHistogram::FrameTimeHistogram( float bucketMs, size_t bucketCount )
+		: m_bucketMs(bucketMs)
+		, m_buckets(bucketCount, 0)
+		, m_samples(0)
+		, m_total(0.0)
+		, m_max(0.0f)
+	{
+		if(bucketMs <= 0.0f || bucketCount == 0)
+			throw std::runtime_error("A frame time histogram needs at least one bucket of positive width.");
+	}
+
+	void FrameTimeHistogram::Add( float ms )
+	{
+		ms = std::max(ms, 0.0f);
+		size_t bucketIx = std::min((size_t)(ms / m_bucketMs), m_buckets.size() - 1);
+		++m_buckets[bucketIx];
+		++m_samples;
+		m_total += ms;
+		m_max = std::max(m_max, ms);
+	}
+
+	void FrameTimeHistogram::Clear()
+	{
+		std::fill(m_buckets.begin(), m_buckets.end(), 0);
+		m_samples = 0;
+		m_total = 0.0;
+		m_max = 0.0f;
+	}
+
+	float FrameTimeHistogram::GetMean() const
+	{
+		return m_samples ? (float)(m_total / m_samples) : 0.0f;
+	}
+
+	float FrameTimeHistogram::GetPercentile( float fraction ) const
+	{
+		if(m_samples == 0)
+			return 0.0f;
+
+		size_t wanted = std::max((size_t)ceil(fraction * m_samples), (size_t)1);
+		size_t counted = 0;
+		for(size_t bucketIx = 0; bucketIx < m_buckets.size(); ++bucketIx)
+		{
+			counted += m_buckets[bucketIx];
+			if(counted >= wanted)
+				return std::min((bucketIx + 1) * m_bucketMs, m_max);
+		}
+
+		return m_max;
+	}
+
+	void FrameTimeHistogram::WriteCsv( std::ostream &out ) const
+	{
+		for(size_t bucketIx = 0; bucketIx < m_buckets.size(); ++bucketIx)
+		{
+			if(m_buckets[bucketIx])
+				out << bucketIx * m_bucketMs << "," << m_buckets[bucketIx] << "\n";
+		}
+	}
+
+	FrameLoop::FrameLoop( double ticksPerSecond, double targetFrameRate )
+		: m_tickInterval(0.0)
+		, m_targetFrameRate(0.0)
+		, m_maxTicksPerFrame(8)
+		, m_fixedFrameTime(0.0)
+		, m_lastClockTime(0.0)
+		, m_bHasClockTime(false)
+		, m_bPaused(false)
+		, m_accumulator(0.0)
+		, m_tickCount(0)
+		, m_bHasFrameStart(false)
+		, m_bInFrame(false)
+		, m_bHasDeadline(false)
+	{
+		SetTicksPerSecond(ticksPerSecond);
+		SetTargetFrameRate(targetFrameRate);
+	}
+
+	void FrameLoop::SetTicksPerSecond( double ticksPerSecond )
+	{
+		if(ticksPerSecond <= 0.0)
+			throw std::runtime_error("The simulation must tick a positive number of times per second.");
+
+		m_tickInterval = 1.0 / ticksPerSecond;
+	}
+
+	void FrameLoop::SetTargetFrameRate( double framesPerSecond )
+	{
+		if(framesPerSecond < 0.0)
+			throw std::runtime_error("The target frame rate cannot be negative.");
+
+		m_targetFrameRate = framesPerSecond;
+	}
+
+	void FrameLoop::SetSimulationClock( const ClockFunc &clock )
+	{
+		m_simulationClock = clock;
+		m_bHasClockTime = false;
+	}
+
+	unsigned int FrameLoop::BeginFrame( const TickFunc &tick )
+	{
+		PROFILE_SCOPE("FrameLoop::BeginFrame");
+
+		Clock::time_point now = Clock::now();
+		double elapsed = 0.0;
+		if(m_bHasFrameStart)
+		{
+			elapsed = std::chrono::duration<double>(now - m_frameStart).count();
+			m_frameTimes.Add(ToMilliseconds(now - m_frameStart));
+		}
+		m_frameStart = now;
+		m_bHasFrameStart = true;
+		m_bInFrame = true;
+
+		//The clock is read even when paused, so the pause is not counted on resuming.
+		if(m_simulationClock && m_fixedFrameTime <= 0.0)
+		{
+			double clockTime = m_simulationClock();
+			elapsed = m_bHasClockTime ? clockTime - m_lastClockTime : 0.0;
+			m_lastClockTime = clockTime;
+			m_bHasClockTime = true;
+		}
+
+		if(m_bPaused)
+			return 0;
+
+		m_accumulator += m_fixedFrameTime > 0.0 ? m_fixedFrameTime : elapsed;
+		unsigned int ticks = 0;
+		while(m_accumulator >= m_tickInterval)
+		{
+			if(ticks == m_maxTicksPerFrame)
+			{
+				m_accumulator = fmod(m_accumulator, m_tickInterval);
+				break;
+			}
+
+			tick(m_tickInterval);
+			m_accumulator -= m_tickInterval;
+			++m_tickCount;
+			++ticks;
+		}
+
+		return ticks;
+	}
+
+	void FrameLoop::EndFrame()
+	{
+		if(!m_bInFrame)
+			return;
+
+		m_workTimes.Add(ToMilliseconds(Clock::now() - m_frameStart));
+		m_bInFrame = false;
+	}
+
+	float FrameLoop::GetAlpha() const
+	{
+		return (float)std::min(m_accumulator / m_tickInterval, 1.0);
+	}
+
+	double FrameLoop::GetInterpolatedTime() const
+	{
+		if(m_tickCount == 0)
+			return 0.0;
+
+		return ((double)m_tickCount - 1.0 + GetAlpha()) * m_tickInterval;
+	}
+
+	FrameLoop::Clock::duration FrameLoop::GetFramePeriod() const
+	{
+		return std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double>(1.0 / m_targetFrameRate));
+	}
+
+	double FrameLoop::GetTimeUntilNextFrame() const
+	{
+		if(m_targetFrameRate <= 0.0 || !m_bHasDeadline)
+			return 0.0;
+
+		Clock::duration remaining = m_deadline + GetFramePeriod() - Clock::now();
+		return std::max(std::chrono::duration<double>(remaining).count(), 0.0);
+	}
+
+	void FrameLoop::WaitForNextFrame()
+	{
+		if(m_targetFrameRate <= 0.0)
+			return;
+
+		PROFILE_SCOPE("FrameLoop::WaitForNextFrame");
+
+		Clock::time_point now = Clock::now();
+		if(!m_bHasDeadline)
+		{
+			m_deadline = now;
+			m_bHasDeadline = true;
+			return;
+		}
+
+		m_deadline += GetFramePeriod();
+		if(m_deadline <= now)
+		{
+			m_deadline = now;
+			return;
+		}
+
+		if(m_deadline - now > SLEEP_MARGIN)
+			std::this_thread::sleep_for(m_deadline - now - SLEEP_MARGIN);
+
+		while(Clock::now() < m_deadline)
+			std::this_thread::yield();
+	}
+
+	void FrameLoop::WriteHistograms( std::ostream &out ) const
+	{
+		out << "histogram,samples,mean,p50,p95,p99,max\n";
+		WriteSummary(out, "frame-ms", m_frameTimes);
+		WriteSummary(out, "work-ms", m_workTimes);
+
+		out << "\nframe-ms,count\n";
+		m_frameTimes.WriteCsv(out);
+		out << "\nwork-ms,count\n";
+		m_workTimes.WriteCsv(out);
+	}
+
+	void FrameLoop::ClearHistograms()
+	{
+		m_frameTimes.Clear();
+		m_workTimes.Clear();
+	}
+}
@@ -0,0 +1,179 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_FRAME_LOOP_H
+#define FRAMEWORK_FRAME_LOOP_H
+
+#include <vector>
+#include <ostream>
+#include <chrono>
+#include <functional>
+
+namespace Framework
+{
+	//A value as of the last two ticks, so it can be drawn in between them.
+	template<typename ValueType>
+	class Interpolated
+	{
+	public:
+		Interpolated() {}
+		explicit Interpolated(const ValueType &value) : m_previous(value), m_current(value) {}
+
+		//Call at the start of every tick, before changing the value.
+		void BeginTick() {m_previous = m_current;}
+
+		//Sets both values, so the change is not blended over a tick.
+		void Reset(const ValueType &value) {m_previous = value; m_current = value;}
+
+		ValueType &Get() {return m_current;}
+		const ValueType &Get() const {return m_current;}
+		const ValueType &GetPrevious() const {return m_previous;}
+
+		ValueType Lerp(float alpha) const {return m_previous + (m_current - m_previous) * alpha;}
+
+	private:
+		ValueType m_previous;
+		ValueType m_current;
+	};
+
+	//Counts of times in milliseconds, in buckets of a fixed width. Times past the last bucket
+	//are counted in it.
+	class FrameTimeHistogram
+	{
+	public:
+		explicit FrameTimeHistogram(float bucketMs = 0.5f, size_t bucketCount = 100);
+
+		void Add(float ms);
+		void Clear();
+
+		size_t GetSampleCount() const {return m_samples;}
+		float GetMean() const;
+		float GetMax() const {return m_max;}
+
+		//The upper edge of the bucket holding the given fraction of the samples.
+		float GetPercentile(float fraction) const;
+
+		float GetBucketWidth() const {return m_bucketMs;}
+		const std::vector<size_t> &GetBuckets() const {return m_buckets;}
+
+		//One line per non-empty bucket: its lower edge in milliseconds, then its count.
+		void WriteCsv(std::ostream &out) const;
+
+	private:
+		float m_bucketMs;
+		std::vector<size_t> m_buckets;
+		size_t m_samples;
+		double m_total;
+		float m_max;
+	};
+
+	/**
+	Steps a simulation at a fixed rate, however often frames are drawn.
+
+	BeginFrame adds the real time since the last frame to an accumulator, then runs ticks of
+	exactly GetTickInterval() seconds while it holds enough. The simulation thus steps the same
+	way at any frame rate. What is left over, as a fraction of a tick, is GetAlpha(): drawn state
+	should be blended that far from the previous tick's state towards the current one. What is
+	drawn is up to a tick behind the simulation, in exchange for smooth motion.
+
+	After a long stall, such as a breakpoint, at most maxTicksPerFrame ticks are run and the rest
+	of the time is dropped, rather than spending the next frames catching up.
+
+	With a target frame rate, WaitForNextFrame sleeps until the next frame is due instead of
+	drawing as fast as possible. It sleeps most of the way and yields for the rest, as sleeps
+	can overshoot by a millisecond or more. A loop that falls behind does not try to catch up.
+
+	The time between frames, and the time from BeginFrame to EndFrame, are kept in histograms.
+	**/
+	class FrameLoop
+	{
+	public:
+		//Called with the tick's length in seconds.
+		typedef std::function<void(double)> TickFunc;
+
+		//Returns a time in seconds.
+		typedef std::function<double()> ClockFunc;
+
+		//A target frame rate of zero disables pacing.
+		explicit FrameLoop(double ticksPerSecond = 60.0, double targetFrameRate = 60.0);
+
+		void SetTicksPerSecond(double ticksPerSecond);
+		double GetTickInterval() const {return m_tickInterval;}
+
+		void SetTargetFrameRate(double framesPerSecond);
+		double GetTargetFrameRate() const {return m_targetFrameRate;}
+
+		void SetMaxTicksPerFrame(unsigned int maxTicks) {m_maxTicksPerFrame = maxTicks;}
+
+		//Advances every frame by exactly this many seconds instead of the time that really
+		//passed, so runs are repeatable. Zero goes back to the real clock.
+		void SetFixedFrameTime(double seconds) {m_fixedFrameTime = seconds;}
+
+		//Takes the time the simulation advances by from this clock, such as a replayed one,
+		//instead of the real one. Pacing and the histograms still use real time. An empty
+		//function goes back to the real clock.
+		void SetSimulationClock(const ClockFunc &clock);
+
+		//Paused, no ticks are run and time does not accumulate. Frames are still paced.
+		void SetPaused(bool paused) {m_bPaused = paused;}
+		bool IsPaused() const {return m_bPaused;}
+
+		//Starts a frame and runs the ticks that are due. Returns how many were run.
+		unsigned int BeginFrame(const TickFunc &tick);
+		void EndFrame();
+
+		//In [0, 1): how far the accumulator is into the next tick.
+		float GetAlpha() const;
+
+		unsigned long long GetTickCount() const {return m_tickCount;}
+
+		//Seconds of simulation, as of the last tick.
+		double GetSimulationTime() const {return m_tickCount * m_tickInterval;}
+
+		//The simulation time that drawn state, blended by GetAlpha(), stands for.
+		double GetInterpolatedTime() const;
+
+		//Seconds until the next frame is due. Zero if it already is, or pacing is off.
+		double GetTimeUntilNextFrame() const;
+
+		void WaitForNextFrame();
+
+		const FrameTimeHistogram &GetFrameTimes() const {return m_frameTimes;}
+		const FrameTimeHistogram &GetWorkTimes() const {return m_workTimes;}
+
+		//A summary of both histograms, then their buckets.
+		void WriteHistograms(std::ostream &out) const;
+
+		void ClearHistograms();
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		double m_tickInterval;
+		double m_targetFrameRate;
+		unsigned int m_maxTicksPerFrame;
+		double m_fixedFrameTime;
+		ClockFunc m_simulationClock;
+		double m_lastClockTime;
+		bool m_bHasClockTime;
+		bool m_bPaused;
+
+		double m_accumulator;
+		unsigned long long m_tickCount;
+
+		Clock::time_point m_frameStart;
+		bool m_bHasFrameStart;
+		bool m_bInFrame;
+
+		Clock::time_point m_deadline;
+		bool m_bHasDeadline;
+
+		FrameTimeHistogram m_frameTimes;
+		FrameTimeHistogram m_workTimes;
+
+		Clock::duration GetFramePeriod() const;
+	};
+}
+
+#endif //FRAMEWORK_FRAME_LOOP_H
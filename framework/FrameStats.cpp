@@ -0,0 +1,255 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include <glload/gl_all.h>
+#include "FrameStats.h"
+
+namespace Framework
+{
+	FrameCounters *g_pFrameCounters = NULL;
+
+	namespace
+	{
+		//Results older than this many frames are waited for.
+		const size_t MAX_PENDING_FRAMES = 4;
+
+		float Percentile(const std::vector<float> &sorted, float fraction)
+		{
+			size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5f);
+			return sorted[std::min(index, sorted.size() - 1)];
+		}
+	}
+
+	FrameStats::FrameStats( size_t historyFrames )
+		: m_historyFrames(historyFrames)
+		, m_bEnabled(false)
+		, m_bInFrame(false)
+		, m_bTimerQueries(false)
+		, m_bHasFrameStart(false)
+		, m_bInPass(false)
+	{}
+
+	FrameStats::~FrameStats()
+	{
+		SetEnabled(false);
+	}
+
+	void FrameStats::SetEnabled( bool enabled )
+	{
+		if(enabled == m_bEnabled)
+			return;
+
+		if(enabled)
+		{
+			if(g_pFrameCounters)
+				throw std::runtime_error("Another FrameStats is already enabled.");
+
+			//glload only loads the 3.2 core functions, so even on 3.3 the query functions are only
+			//there if ARB_timer_query loaded them.
+			m_bTimerQueries = glext_ARB_timer_query && glGetQueryObjectui64v;
+			g_pFrameCounters = &m_counters;
+		}
+		else
+		{
+			if(m_bInPass)
+				EndPass();
+			DeleteQueries();
+			g_pFrameCounters = NULL;
+			m_bInFrame = false;
+			m_bHasFrameStart = false;
+		}
+
+		m_bEnabled = enabled;
+	}
+
+	void FrameStats::BeginFrame()
+	{
+		if(!m_bEnabled)
+			return;
+
+		Clock::time_point now = Clock::now();
+		if(m_bHasFrameStart)
+			AddSample("cpu-frame-ms", std::chrono::duration<float, std::milli>(now - m_frameStart).count());
+		m_frameStart = now;
+		m_bHasFrameStart = true;
+
+		m_counters.Reset();
+		m_bInFrame = true;
+	}
+
+	void FrameStats::EndFrame()
+	{
+		if(!m_bEnabled || !m_bInFrame)
+			return;
+
+		if(m_bInPass)
+			EndPass();
+
+		m_lastFrame = m_counters;
+		AddSample("draws", (float)m_counters.draws);
+		AddSample("triangles", (float)m_counters.triangles);
+		AddSample("programBinds", (float)m_counters.programBinds);
+		AddSample("textureBinds", (float)m_counters.textureBinds);
+		AddSample("vaoBinds", (float)m_counters.vaoBinds);
+		AddSample("uboBinds", (float)m_counters.uboBinds);
+		AddSample("uploadedBytes", (float)m_counters.uploadedBytes);
+
+		if(!m_frameQueries.empty())
+		{
+			m_pendingFrames.push_back(std::vector<PassQuery>());
+			m_pendingFrames.back().swap(m_frameQueries);
+		}
+		CollectQueries(false);
+
+		m_bInFrame = false;
+	}
+
+	void FrameStats::BeginPass( const std::string &name )
+	{
+		if(!m_bEnabled || !m_bTimerQueries)
+			return;
+
+		if(m_bInPass)
+			throw std::runtime_error("The pass " + name + " was begun inside another pass.");
+
+		PassQuery pass;
+		pass.name = name;
+		if(m_freeQueries.empty())
+			glGenQueries(1, &pass.query);
+		else
+		{
+			pass.query = m_freeQueries.back();
+			m_freeQueries.pop_back();
+		}
+
+		glBeginQuery(GL_TIME_ELAPSED, pass.query);
+		m_frameQueries.push_back(pass);
+		m_bInPass = true;
+	}
+
+	void FrameStats::EndPass()
+	{
+		if(!m_bInPass)
+			return;
+
+		glEndQuery(GL_TIME_ELAPSED);
+		m_bInPass = false;
+	}
+
+	//A frame's results are read once its last query is ready, since queries finish in order.
+	void FrameStats::CollectQueries( bool bWait )
+	{
+		while(!m_pendingFrames.empty())
+		{
+			std::vector<PassQuery> &frame = m_pendingFrames.front();
+			bool bMustWait = bWait || m_pendingFrames.size() > MAX_PENDING_FRAMES;
+			if(!bMustWait)
+			{
+				GLint available = 0;
+				glGetQueryObjectiv(frame.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+				if(!available)
+					return;
+			}
+
+			//Passes with the same name in one frame are added together.
+			std::map<std::string, float> passTimes;
+			for(size_t passIx = 0; passIx < frame.size(); ++passIx)
+			{
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(frame[passIx].query, GL_QUERY_RESULT, &elapsed);
+				passTimes[frame[passIx].name] += elapsed / 1000000.0f;
+				m_freeQueries.push_back(frame[passIx].query);
+			}
+
+			for(std::map<std::string, float>::const_iterator timeIt = passTimes.begin();
+				timeIt != passTimes.end();
+				++timeIt)
+			{
+				AddSample("gpu-ms:" + timeIt->first, timeIt->second);
+			}
+
+			m_pendingFrames.pop_front();
+		}
+	}
+
+	void FrameStats::DeleteQueries()
+	{
+		for(size_t frameIx = 0; frameIx < m_pendingFrames.size(); ++frameIx)
+		{
+			for(size_t passIx = 0; passIx < m_pendingFrames[frameIx].size(); ++passIx)
+				m_freeQueries.push_back(m_pendingFrames[frameIx][passIx].query);
+		}
+		for(size_t passIx = 0; passIx < m_frameQueries.size(); ++passIx)
+			m_freeQueries.push_back(m_frameQueries[passIx].query);
+
+		if(!m_freeQueries.empty())
+			glDeleteQueries((GLsizei)m_freeQueries.size(), &m_freeQueries[0]);
+
+		m_pendingFrames.clear();
+		m_frameQueries.clear();
+		m_freeQueries.clear();
+	}
+
+	void FrameStats::AddSample( const std::string &metric, float value )
+	{
+		std::deque<float> &history = m_history[metric];
+		history.push_back(value);
+		while(history.size() > m_historyFrames)
+			history.pop_front();
+	}
+
+	std::vector<std::string> FrameStats::GetMetricNames() const
+	{
+		std::vector<std::string> names;
+		for(HistoryMap::const_iterator histIt = m_history.begin(); histIt != m_history.end(); ++histIt)
+			names.push_back(histIt->first);
+		return names;
+	}
+
+	StatSummary FrameStats::Summarize( const std::string &metric ) const
+	{
+		StatSummary summary;
+		HistoryMap::const_iterator histIt = m_history.find(metric);
+		if(histIt == m_history.end() || histIt->second.empty())
+			return summary;
+
+		std::vector<float> sorted(histIt->second.begin(), histIt->second.end());
+		std::sort(sorted.begin(), sorted.end());
+
+		double total = 0.0;
+		for(size_t sampleIx = 0; sampleIx < sorted.size(); ++sampleIx)
+			total += sorted[sampleIx];
+
+		summary.samples = sorted.size();
+		summary.mean = (float)(total / sorted.size());
+		summary.p50 = Percentile(sorted, 0.50f);
+		summary.p95 = Percentile(sorted, 0.95f);
+		summary.p99 = Percentile(sorted, 0.99f);
+		summary.max = sorted.back();
+		return summary;
+	}
+
+	void FrameStats::WriteCsv( std::ostream &out ) const
+	{
+		out << "metric,samples,mean,p50,p95,p99,max\n";
+		for(HistoryMap::const_iterator histIt = m_history.begin(); histIt != m_history.end(); ++histIt)
+		{
+			StatSummary summary = Summarize(histIt->first);
+			out << histIt->first << "," << summary.samples << "," << summary.mean << "," <<
+				summary.p50 << "," << summary.p95 << "," << summary.p99 << "," << summary.max << "\n";
+		}
+	}
+
+	void FrameStats::ClearHistory()
+	{
+		m_history.clear();
+		m_bHasFrameStart = false;
+	}
+}
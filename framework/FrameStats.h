@@ -0,0 +1,150 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_FRAME_STATS_H
+#define FRAMEWORK_FRAME_STATS_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <chrono>
+
+namespace Framework
+{
+	//What the GL thread asked OpenGL to do in one frame.
+	struct FrameCounters
+	{
+		FrameCounters() {Reset();}
+
+		void Reset()
+		{
+			draws = 0;
+			triangles = 0;
+			programBinds = 0;
+			textureBinds = 0;
+			vaoBinds = 0;
+			uboBinds = 0;
+			uploadedBytes = 0;
+		}
+
+		size_t draws;
+		size_t triangles;
+		size_t programBinds;
+		size_t textureBinds;
+		size_t vaoBinds;
+		size_t uboBinds;
+		size_t uploadedBytes;	//Buffer and texture data given to OpenGL.
+	};
+
+	//The counters of the enabled FrameStats, or NULL. With statistics off, counting is only
+	//a test of this pointer. Counting happens where the GL calls are made, on the GL thread.
+	extern FrameCounters *g_pFrameCounters;
+
+	inline void CountDraws(size_t draws, size_t triangles)
+	{
+		if(g_pFrameCounters)
+		{
+			g_pFrameCounters->draws += draws;
+			g_pFrameCounters->triangles += triangles;
+		}
+	}
+
+	inline void CountProgramBind() {if(g_pFrameCounters) ++g_pFrameCounters->programBinds;}
+	inline void CountTextureBind() {if(g_pFrameCounters) ++g_pFrameCounters->textureBinds;}
+	inline void CountVaoBind() {if(g_pFrameCounters) ++g_pFrameCounters->vaoBinds;}
+	inline void CountUboBind() {if(g_pFrameCounters) ++g_pFrameCounters->uboBinds;}
+	inline void CountUpload(size_t bytes) {if(g_pFrameCounters) g_pFrameCounters->uploadedBytes += bytes;}
+
+	struct StatSummary
+	{
+		StatSummary() : samples(0), mean(0.0f), p50(0.0f), p95(0.0f), p99(0.0f), max(0.0f) {}
+
+		size_t samples;
+		float mean;
+		float p50;
+		float p95;
+		float p99;
+		float max;
+	};
+
+	/**
+	Collects per-frame counters and timings over a rolling window of frames.
+
+	Between BeginFrame and EndFrame, the framework's GL calls are counted into the current
+	frame. BeginPass and EndPass time the GPU work of a named pass with GL_TIME_ELAPSED
+	queries, where timer queries are available. Results are read a few frames later, once
+	they are ready, so timing never stalls the pipeline. Passes cannot nest.
+
+	Each metric keeps its last historyFrames values. The counters are named after the
+	FrameCounters fields; "cpu-frame-ms" is the time between BeginFrame calls, and each
+	pass's GPU time is "gpu-ms:" followed by its name.
+
+	Only one FrameStats can be enabled at a time. All functions must be called on the GL thread.
+	**/
+	class FrameStats
+	{
+	public:
+		explicit FrameStats(size_t historyFrames = 300);
+		~FrameStats();
+
+		//Disabled, the frame and pass calls return at once and nothing is counted.
+		void SetEnabled(bool enabled);
+		bool IsEnabled() const {return m_bEnabled;}
+
+		void BeginFrame();
+		void EndFrame();
+
+		void BeginPass(const std::string &name);
+		void EndPass();
+
+		const FrameCounters &GetLastFrame() const {return m_lastFrame;}
+
+		std::vector<std::string> GetMetricNames() const;
+		StatSummary Summarize(const std::string &metric) const;
+
+		//One line per metric: metric,samples,mean,p50,p95,p99,max
+		void WriteCsv(std::ostream &out) const;
+
+		void ClearHistory();
+
+	private:
+		struct PassQuery
+		{
+			std::string name;
+			GLuint query;
+		};
+
+		typedef std::chrono::steady_clock Clock;
+		typedef std::map<std::string, std::deque<float> > HistoryMap;
+
+		size_t m_historyFrames;
+		bool m_bEnabled;
+		bool m_bInFrame;
+		bool m_bTimerQueries;
+
+		FrameCounters m_counters;
+		FrameCounters m_lastFrame;
+		HistoryMap m_history;
+
+		Clock::time_point m_frameStart;
+		bool m_bHasFrameStart;
+
+		std::vector<PassQuery> m_frameQueries;
+		std::deque<std::vector<PassQuery> > m_pendingFrames;
+		std::vector<GLuint> m_freeQueries;
+		bool m_bInPass;
+
+		void AddSample(const std::string &metric, float value);
+		void CollectQueries(bool bWait);
+		void DeleteQueries();
+
+		//Prevent copying.
+		FrameStats(const FrameStats &);
+		FrameStats &operator=(const FrameStats &);
+	};
+}
+
+#endif //FRAMEWORK_FRAME_STATS_H
@@ -0,0 +1,383 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+#include <glload/gl_3_3.h>
+#include <glload/gll.hpp>
+#include "Headless.h"
+#include "FrameStats.h"
+#include "InputLog.h"
+
+#ifdef FRAMEWORK_HEADLESS
+//Keeps eglplatform.h from pulling in Xlib, whose macros clash with ordinary names.
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace Framework
+{
+	namespace
+	{
+		bool g_bHeadless = false;
+
+		int ParseCount(const std::string &option, const char *value)
+		{
+			char *end = NULL;
+			long count = strtol(value, &end, 10);
+			if(end == value || *end != '\0' || count < 0)
+				throw std::runtime_error("The option " + option + " needs a count, not " + value + ".");
+			return (int)count;
+		}
+
+		void ReadFramebuffer(int width, int height, std::vector<unsigned char> &pixels)
+		{
+			pixels.resize((size_t)width * height * 3);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+		}
+
+#ifdef FRAMEWORK_HEADLESS
+		//64-bit FNV-1a, so images can be compared without keeping them.
+		unsigned long long Checksum(const std::vector<unsigned char> &data)
+		{
+			unsigned long long hash = 14695981039346656037ULL;
+			for(size_t byteIx = 0; byteIx < data.size(); ++byteIx)
+			{
+				hash ^= data[byteIx];
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+
+		StatSummary Summarize(std::vector<float> times)
+		{
+			StatSummary summary;
+			if(times.empty())
+				return summary;
+
+			std::sort(times.begin(), times.end());
+			double total = 0.0;
+			for(size_t timeIx = 0; timeIx < times.size(); ++timeIx)
+				total += times[timeIx];
+
+			summary.samples = times.size();
+			summary.mean = (float)(total / times.size());
+			summary.p50 = times[(size_t)(0.50f * (times.size() - 1) + 0.5f)];
+			summary.p95 = times[(size_t)(0.95f * (times.size() - 1) + 0.5f)];
+			summary.p99 = times[(size_t)(0.99f * (times.size() - 1) + 0.5f)];
+			summary.max = times.back();
+			return summary;
+		}
+
+		void WriteSummary(FILE *pFile, const char *metric, const StatSummary &summary)
+		{
+			fprintf(pFile, "%s,%u,%.3f,%.3f,%.3f,%.3f,%.3f\n", metric, (unsigned int)summary.samples,
+				summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+		}
+
+		class EglContext
+		{
+		public:
+			EglContext(int width, int height)
+				: m_display(EGL_NO_DISPLAY)
+				, m_surface(EGL_NO_SURFACE)
+				, m_context(EGL_NO_CONTEXT)
+			{
+				try
+				{
+					Create(width, height);
+				}
+				catch(...)
+				{
+					Destroy();
+					throw;
+				}
+			}
+
+			~EglContext()
+			{
+				Destroy();
+			}
+
+		private:
+			EGLDisplay m_display;
+			EGLSurface m_surface;
+			EGLContext m_context;
+
+			void Create(int width, int height)
+			{
+				//Mesa's surfaceless platform needs no display server. Elsewhere, the default
+				//display will do.
+				const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+				PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+					(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+				if(getPlatformDisplay && clientExtensions &&
+					strstr(clientExtensions, "EGL_MESA_platform_surfaceless"))
+				{
+					m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+				}
+
+				if(m_display == EGL_NO_DISPLAY)
+					m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+				if(m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, NULL, NULL))
+					throw std::runtime_error("Could not initialize EGL.");
+
+				if(!eglBindAPI(EGL_OPENGL_API))
+					throw std::runtime_error("This EGL cannot make desktop OpenGL contexts.");
+
+				const EGLint configAttribs[] =
+				{
+					EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+					EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+					EGL_RED_SIZE, 8,
+					EGL_GREEN_SIZE, 8,
+					EGL_BLUE_SIZE, 8,
+					EGL_ALPHA_SIZE, 8,
+					EGL_DEPTH_SIZE, 24,
+					EGL_STENCIL_SIZE, 8,
+					EGL_NONE,
+				};
+
+				EGLConfig config;
+				EGLint configCount = 0;
+				if(!eglChooseConfig(m_display, configAttribs, &config, 1, &configCount) || configCount == 0)
+					throw std::runtime_error("EGL has no RGBA8, depth 24, stencil 8 pbuffer config.");
+
+				const EGLint surfaceAttribs[] =
+				{
+					EGL_WIDTH, width,
+					EGL_HEIGHT, height,
+					EGL_NONE,
+				};
+
+				m_surface = eglCreatePbufferSurface(m_display, config, surfaceAttribs);
+				if(m_surface == EGL_NO_SURFACE)
+					throw std::runtime_error("Could not create the EGL pbuffer.");
+
+				const EGLint contextAttribs[] =
+				{
+					EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+					EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+					EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+					EGL_NONE,
+				};
+
+				m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, contextAttribs);
+				if(m_context == EGL_NO_CONTEXT)
+					throw std::runtime_error("Could not create an OpenGL 3.3 core context with EGL.");
+
+				if(!eglMakeCurrent(m_display, m_surface, m_surface, m_context))
+					throw std::runtime_error("Could not make the EGL context current.");
+			}
+
+			void Destroy()
+			{
+				if(m_display == EGL_NO_DISPLAY)
+					return;
+
+				eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+				if(m_context != EGL_NO_CONTEXT)
+					eglDestroyContext(m_display, m_context);
+				if(m_surface != EGL_NO_SURFACE)
+					eglDestroySurface(m_display, m_surface);
+				eglTerminate(m_display);
+
+				m_display = EGL_NO_DISPLAY;
+				m_surface = EGL_NO_SURFACE;
+				m_context = EGL_NO_CONTEXT;
+			}
+
+			//Prevent copying.
+			EglContext(const EglContext &);
+			EglContext &operator=(const EglContext &);
+		};
+
+		int RunFrames(const HeadlessSettings &settings,
+			void (*init)(), void (*display)(), void (*reshape)(int, int))
+		{
+			typedef std::chrono::steady_clock Clock;
+
+			EglContext context(settings.width, settings.height);
+
+			glload::LoadFunctions();
+			if(!glload::IsVersionGEQ(3, 3))
+			{
+				fprintf(stderr, "The headless context is OpenGL %i.%i, but 3.3 is needed.\n",
+					glload::GetMajorVersion(), glload::GetMinorVersion());
+				return 1;
+			}
+
+			printf("Rendering %d frames at %dx%d with %s.\n", settings.frames,
+				settings.width, settings.height, (const char *)glGetString(GL_RENDERER));
+
+			init();
+			reshape(settings.width, settings.height);
+
+			//The CPU time is spent in display; the total includes waiting for the GPU to finish.
+			//A replayed input log ends the run early if it runs out.
+			std::vector<float> cpuTimes;
+			std::vector<float> totalTimes;
+			for(int frameIx = 0; frameIx < settings.warmupFrames + settings.frames; ++frameIx)
+			{
+				if(GetInputLog().IsReplayFinished())
+					break;
+
+				Clock::time_point start = Clock::now();
+				display();
+				Clock::time_point submitted = Clock::now();
+				glFinish();
+				Clock::time_point finished = Clock::now();
+
+				if(frameIx >= settings.warmupFrames)
+				{
+					cpuTimes.push_back(std::chrono::duration<float, std::milli>(submitted - start).count());
+					totalTimes.push_back(std::chrono::duration<float, std::milli>(finished - start).count());
+				}
+			}
+
+			std::vector<unsigned char> pixels;
+			ReadFramebuffer(settings.width, settings.height, pixels);
+
+			StatSummary cpuSummary = Summarize(cpuTimes);
+			StatSummary totalSummary = Summarize(totalTimes);
+			unsigned long long checksum = Checksum(pixels);
+
+			printf("metric,samples,mean,p50,p95,p99,max\n");
+			WriteSummary(stdout, "cpu-frame-ms", cpuSummary);
+			WriteSummary(stdout, "total-frame-ms", totalSummary);
+			printf("image-checksum,%016llx\n", checksum);
+
+			if(!settings.statsFilename.empty())
+			{
+				FILE *pFile = fopen(settings.statsFilename.c_str(), "w");
+				if(!pFile)
+					throw std::runtime_error("Could not write the statistics to " + settings.statsFilename);
+
+				fprintf(pFile, "metric,samples,mean,p50,p95,p99,max\n");
+				WriteSummary(pFile, "cpu-frame-ms", cpuSummary);
+				WriteSummary(pFile, "total-frame-ms", totalSummary);
+				fprintf(pFile, "image-checksum,%016llx\n", checksum);
+
+				fprintf(pFile, "\nframe,cpu-ms,total-ms\n");
+				for(size_t frameIx = 0; frameIx < cpuTimes.size(); ++frameIx)
+					fprintf(pFile, "%u,%.3f,%.3f\n", (unsigned int)frameIx, cpuTimes[frameIx], totalTimes[frameIx]);
+
+				fclose(pFile);
+			}
+
+			if(!settings.imageFilename.empty() &&
+				!WriteFramebufferPpm(settings.imageFilename, settings.width, settings.height))
+			{
+				throw std::runtime_error("Could not write the image to " + settings.imageFilename);
+			}
+
+			return 0;
+		}
+#endif //FRAMEWORK_HEADLESS
+	}
+
+	bool ParseHeadlessArgs( int argc, char **argv, HeadlessSettings &settings )
+	{
+		bool bHeadless = false;
+		for(int argIx = 1; argIx < argc; ++argIx)
+		{
+			std::string option = argv[argIx];
+			if(option == "--headless")
+			{
+				bHeadless = true;
+				continue;
+			}
+
+			if(option != "--frames" && option != "--warmup" && option != "--size" &&
+				option != "--image" && option != "--stats")
+			{
+				continue;
+			}
+
+			if(argIx + 1 >= argc)
+				throw std::runtime_error("The option " + option + " needs a value.");
+			const char *value = argv[++argIx];
+
+			if(option == "--frames")
+				settings.frames = ParseCount(option, value);
+			else if(option == "--warmup")
+				settings.warmupFrames = ParseCount(option, value);
+			else if(option == "--image")
+				settings.imageFilename = value;
+			else if(option == "--stats")
+				settings.statsFilename = value;
+			else
+			{
+				if(sscanf(value, "%dx%d", &settings.width, &settings.height) != 2 ||
+					settings.width <= 0 || settings.height <= 0)
+				{
+					throw std::runtime_error("The option --size needs WIDTHxHEIGHT, not " + std::string(value) + ".");
+				}
+			}
+		}
+
+		return bHeadless;
+	}
+
+	bool IsHeadless()
+	{
+		return g_bHeadless;
+	}
+
+#ifdef FRAMEWORK_HEADLESS
+	int RunHeadless( const HeadlessSettings &settings,
+		void (*init)(), void (*display)(), void (*reshape)(int, int) )
+	{
+		g_bHeadless = true;
+		int exitCode = 1;
+		try
+		{
+			exitCode = RunFrames(settings, init, display, reshape);
+		}
+		catch(std::exception &e)
+		{
+			fprintf(stderr, "%s\n", e.what());
+		}
+		g_bHeadless = false;
+		return exitCode;
+	}
+#else //FRAMEWORK_HEADLESS
+	int RunHeadless( const HeadlessSettings &,
+		void (*)(), void (*)(), void (*)(int, int) )
+	{
+		fprintf(stderr, "Headless rendering was not compiled in. Run premake with --headless.\n");
+		return 1;
+	}
+#endif //FRAMEWORK_HEADLESS
+
+	bool WriteFramebufferPpm( const std::string &filename, int width, int height )
+	{
+		std::vector<unsigned char> pixels;
+		ReadFramebuffer(width, height, pixels);
+
+		std::ofstream outFile(filename.c_str(), std::ios::binary);
+		if(!outFile.is_open())
+			return false;
+
+		outFile << "P6\n" << width << " " << height << "\n255\n";
+		const size_t rowBytes = (size_t)width * 3;
+		for(int row = height - 1; row >= 0; --row)
+			outFile.write((const char *)&pixels[row * rowBytes], rowBytes);
+
+		return (bool)outFile;
+	}
+}
@@ -0,0 +1,54 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_HEADLESS_H
+#define FRAMEWORK_HEADLESS_H
+
+/**
+Renders without a window, for benchmarks and image tests on machines without a GPU or display.
+
+The context is OpenGL 3.3 core, made with EGL on Mesa's surfaceless platform where it is
+available, and drawn into a pbuffer, so the default framebuffer works as usual. Without a GPU,
+Mesa renders with llvmpipe; setting LIBGL_ALWAYS_SOFTWARE=1 forces it on machines that have one.
+
+Headless support is only compiled in when FRAMEWORK_HEADLESS is defined, by premake's
+--headless option, as it needs EGL to link.
+**/
+
+#include <string>
+
+namespace Framework
+{
+	struct HeadlessSettings
+	{
+		HeadlessSettings() : width(500), height(500), frames(300), warmupFrames(10) {}
+
+		int width;
+		int height;
+		int frames;						//Timed frames, after the warmup frames.
+		int warmupFrames;
+		std::string imageFilename;		//Where to save the last frame, as a binary PPM.
+		std::string statsFilename;		//Where to save the statistics and every frame's times.
+	};
+
+	//Reads the options after --headless: --frames N, --warmup N, --size WxH, --image FILE and
+	//--stats FILE. Returns false if there is no --headless. Throws on an option it cannot read.
+	bool ParseHeadlessArgs(int argc, char **argv, HeadlessSettings &settings);
+
+	//True while RunHeadless runs. freeglut is not initialized then, so code that calls it must
+	//check this first.
+	bool IsHeadless();
+
+	//Makes the context, calls init and reshape, then calls display for every frame. Each frame
+	//is timed up to a glFinish after display. The statistics, and a checksum of the last frame,
+	//are printed. Returns the exit code for main.
+	int RunHeadless(const HeadlessSettings &settings,
+		void (*init)(), void (*display)(), void (*reshape)(int, int));
+
+	//Saves the color buffer of the read framebuffer, bottom row last. Returns false if the file
+	//could not be written.
+	bool WriteFramebufferPpm(const std::string &filename, int width, int height);
+}
+
+#endif //FRAMEWORK_HEADLESS_H
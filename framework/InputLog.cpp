@@ -0,0 +1,493 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <exception>
+#include <stdexcept>
+
+#include "InputLog.h"
+
+namespace Framework
+{
+	namespace
+	{
+		const char LOG_MAGIC[8] = {'F', 'W', 'I', 'N', 'P', 'U', 'T', 1};
+
+		//Records past the input events.
+		enum RecordType
+		{
+			RECORD_CLOCK = InputEvent::NUM_EVENT_TYPES,
+			RECORD_CHECK,
+			RECORD_END,
+
+			NUM_RECORD_TYPES,
+		};
+
+		//The write buffer is written out when it gets this big.
+		const size_t FLUSH_BYTES = 64 * 1024;
+
+		void WriteVarint(std::vector<unsigned char> &out, unsigned long long value)
+		{
+			while(value >= 0x80)
+			{
+				out.push_back((unsigned char)(value | 0x80));
+				value >>= 7;
+			}
+			out.push_back((unsigned char)value);
+		}
+
+		//Zigzag encoded, so small negative numbers stay small.
+		void WriteSigned(std::vector<unsigned char> &out, int value)
+		{
+			WriteVarint(out, ((unsigned int)value << 1) ^ (unsigned int)(value >> 31));
+		}
+
+		void WriteBits(std::vector<unsigned char> &out, unsigned long long bits)
+		{
+			for(int byteIx = 0; byteIx < 8; ++byteIx)
+				out.push_back((unsigned char)(bits >> (byteIx * 8)));
+		}
+
+		class Reader
+		{
+		public:
+			Reader(const std::vector<unsigned char> &data, size_t pos, const std::string &filename)
+				: m_data(data), m_pos(pos), m_filename(filename) {}
+
+			bool AtEnd() const {return m_pos == m_data.size();}
+
+			unsigned char ReadByte()
+			{
+				if(AtEnd())
+					throw std::runtime_error("The input log " + m_filename + " is cut short.");
+				return m_data[m_pos++];
+			}
+
+			unsigned long long ReadVarint()
+			{
+				unsigned long long value = 0;
+				for(int shift = 0; shift < 64; shift += 7)
+				{
+					unsigned char byte = ReadByte();
+					value |= (unsigned long long)(byte & 0x7F) << shift;
+					if(!(byte & 0x80))
+						return value;
+				}
+				throw std::runtime_error("The input log " + m_filename + " is corrupt.");
+			}
+
+			int ReadSigned()
+			{
+				unsigned int value = (unsigned int)ReadVarint();
+				return (int)(value >> 1) ^ -(int)(value & 1);
+			}
+
+			unsigned long long ReadBits()
+			{
+				unsigned long long bits = 0;
+				for(int byteIx = 0; byteIx < 8; ++byteIx)
+					bits |= (unsigned long long)ReadByte() << (byteIx * 8);
+				return bits;
+			}
+
+		private:
+			const std::vector<unsigned char> &m_data;
+			size_t m_pos;
+			const std::string &m_filename;
+		};
+
+		//64-bit FNV-1a.
+		unsigned long long HashBytes(const void *data, size_t bytes)
+		{
+			const unsigned char *pBytes = (const unsigned char *)data;
+			unsigned long long hash = 14695981039346656037ULL;
+			for(size_t byteIx = 0; byteIx < bytes; ++byteIx)
+			{
+				hash ^= pBytes[byteIx];
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+	}
+
+	InputEvent InputEvent::KeyDown( unsigned char key, int x, int y )
+	{
+		InputEvent event;
+		event.type = KEY_DOWN;
+		event.key = key;
+		event.x = x;
+		event.y = y;
+		return event;
+	}
+
+	InputEvent InputEvent::KeyUp( unsigned char key, int x, int y )
+	{
+		InputEvent event = KeyDown(key, x, y);
+		event.type = KEY_UP;
+		return event;
+	}
+
+	InputEvent InputEvent::MouseButton( int button, int state, int x, int y )
+	{
+		InputEvent event;
+		event.type = MOUSE_BUTTON;
+		event.button = button;
+		event.state = state;
+		event.x = x;
+		event.y = y;
+		return event;
+	}
+
+	InputEvent InputEvent::MouseMotion( int x, int y )
+	{
+		InputEvent event;
+		event.type = MOUSE_MOTION;
+		event.x = x;
+		event.y = y;
+		return event;
+	}
+
+	InputEvent InputEvent::MouseWheel( int wheel, int direction, int x, int y )
+	{
+		InputEvent event = MouseButton(wheel, direction, x, y);
+		event.type = MOUSE_WHEEL;
+		return event;
+	}
+
+	InputLog::InputLog()
+		: m_start(Clock::now())
+		, m_frame(0)
+		, m_bRecording(false)
+		, m_lastWrittenFrame(0)
+		, m_bReplaying(false)
+		, m_nextRecord(0)
+		, m_endFrame(0)
+		, m_lastReplayedTime(0.0)
+	{}
+
+	InputLog::~InputLog()
+	{
+		try
+		{
+			Stop();
+		}
+		catch(...)
+		{
+		}
+	}
+
+	void InputLog::StartRecording( const std::string &filename )
+	{
+		Stop();
+
+		m_file.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!m_file)
+			throw std::runtime_error("Could not open the input log " + filename + " for writing.");
+
+		m_writeBuffer.assign(LOG_MAGIC, LOG_MAGIC + sizeof(LOG_MAGIC));
+		m_start = Clock::now();
+		m_frame = 0;
+		m_lastWrittenFrame = 0;
+		m_bRecording = true;
+	}
+
+	void InputLog::StartReplay( const std::string &filename )
+	{
+		Stop();
+
+		std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+		if(!file)
+			throw std::runtime_error("Could not open the input log " + filename + ".");
+
+		std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)),
+			std::istreambuf_iterator<char>());
+		if(data.size() < sizeof(LOG_MAGIC) || memcmp(&data[0], LOG_MAGIC, sizeof(LOG_MAGIC)) != 0)
+			throw std::runtime_error("The file " + filename + " is not an input log.");
+
+		ReadRecords(data, filename);
+
+		m_start = Clock::now();
+		m_frame = 0;
+		m_nextRecord = 0;
+		m_frameClock.clear();
+		m_frameChecks.clear();
+		m_pendingEvents.clear();
+		m_lastReplayedTime = 0.0;
+		m_bReplaying = true;
+		LoadFrame();
+	}
+
+	void InputLog::Stop()
+	{
+		if(m_bRecording)
+		{
+			m_bRecording = false;
+			Record end;
+			end.frame = m_frame;
+			end.type = RECORD_END;
+			Write(end);
+			Flush();
+			m_file.close();
+		}
+
+		if(m_bReplaying)
+		{
+			m_bReplaying = false;
+			m_records.clear();
+			m_frameClock.clear();
+			m_frameChecks.clear();
+			m_pendingEvents.clear();
+			m_start = Clock::now() - std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<double>(m_lastReplayedTime));
+		}
+	}
+
+	bool InputLog::IsReplayFinished() const
+	{
+		return m_bReplaying && m_frame >= m_endFrame;
+	}
+
+	unsigned int InputLog::BeginFrame( const EventFunc &handler )
+	{
+		if(!m_bReplaying)
+			return ++m_frame;
+
+		//Samples the last frame did not ask for belong to it, not to this one.
+		m_frameClock.clear();
+		m_frameChecks.clear();
+
+		std::vector<InputEvent> events;
+		events.swap(m_pendingEvents);
+		++m_frame;
+		LoadFrame();
+
+		for(size_t eventIx = 0; eventIx < events.size(); ++eventIx)
+			handler(events[eventIx]);
+
+		return m_frame;
+	}
+
+	bool InputLog::Capture( const InputEvent &event )
+	{
+		if(m_bReplaying)
+			return false;
+
+		if(m_bRecording)
+		{
+			Record record;
+			record.frame = m_frame;
+			record.type = event.type;
+			record.event = event;
+			Write(record);
+		}
+
+		return true;
+	}
+
+	double InputLog::GetElapsedSeconds()
+	{
+		if(m_bReplaying)
+		{
+			if(!m_frameClock.empty())
+			{
+				unsigned long long bits = m_frameClock.front();
+				m_frameClock.pop_front();
+				memcpy(&m_lastReplayedTime, &bits, sizeof(double));
+			}
+			return m_lastReplayedTime;
+		}
+
+		double seconds = std::chrono::duration<double>(Clock::now() - m_start).count();
+		if(m_bRecording)
+		{
+			Record record;
+			record.frame = m_frame;
+			record.type = RECORD_CLOCK;
+			memcpy(&record.bits, &seconds, sizeof(double));
+			Write(record);
+		}
+
+		return seconds;
+	}
+
+	bool InputLog::CheckState( const void *data, size_t bytes )
+	{
+		unsigned long long hash = HashBytes(data, bytes);
+		if(m_bRecording)
+		{
+			Record record;
+			record.frame = m_frame;
+			record.type = RECORD_CHECK;
+			record.bits = hash;
+			Write(record);
+		}
+
+		if(!m_bReplaying || m_frameChecks.empty())
+			return true;
+
+		unsigned long long recorded = m_frameChecks.front();
+		m_frameChecks.pop_front();
+		return hash == recorded;
+	}
+
+	void InputLog::Write( const Record &record )
+	{
+		WriteVarint(m_writeBuffer, record.frame - m_lastWrittenFrame);
+		m_writeBuffer.push_back((unsigned char)record.type);
+		m_lastWrittenFrame = record.frame;
+
+		const InputEvent &event = record.event;
+		switch(record.type)
+		{
+		case InputEvent::KEY_DOWN:
+		case InputEvent::KEY_UP:
+			m_writeBuffer.push_back(event.key);
+			WriteSigned(m_writeBuffer, event.x);
+			WriteSigned(m_writeBuffer, event.y);
+			break;
+		case InputEvent::MOUSE_BUTTON:
+		case InputEvent::MOUSE_WHEEL:
+			WriteSigned(m_writeBuffer, event.button);
+			WriteSigned(m_writeBuffer, event.state);
+			WriteSigned(m_writeBuffer, event.x);
+			WriteSigned(m_writeBuffer, event.y);
+			break;
+		case InputEvent::MOUSE_MOTION:
+			WriteSigned(m_writeBuffer, event.x);
+			WriteSigned(m_writeBuffer, event.y);
+			break;
+		case RECORD_CLOCK:
+		case RECORD_CHECK:
+			WriteBits(m_writeBuffer, record.bits);
+			break;
+		}
+
+		if(m_writeBuffer.size() >= FLUSH_BYTES)
+			Flush();
+	}
+
+	void InputLog::Flush()
+	{
+		if(!m_writeBuffer.empty())
+			m_file.write((const char *)&m_writeBuffer[0], m_writeBuffer.size());
+		m_file.flush();
+		m_writeBuffer.clear();
+	}
+
+	void InputLog::ReadRecords( const std::vector<unsigned char> &data, const std::string &filename )
+	{
+		m_records.clear();
+		m_endFrame = 0;
+
+		Reader reader(data, sizeof(LOG_MAGIC), filename);
+		unsigned int frame = 0;
+		while(!reader.AtEnd())
+		{
+			Record record;
+			frame += (unsigned int)reader.ReadVarint();
+			record.frame = frame;
+			record.type = reader.ReadByte();
+			record.bits = 0;
+
+			InputEvent &event = record.event;
+			switch(record.type)
+			{
+			case InputEvent::KEY_DOWN:
+			case InputEvent::KEY_UP:
+				event.type = (InputEvent::Type)record.type;
+				event.key = reader.ReadByte();
+				event.x = reader.ReadSigned();
+				event.y = reader.ReadSigned();
+				break;
+			case InputEvent::MOUSE_BUTTON:
+			case InputEvent::MOUSE_WHEEL:
+				event.type = (InputEvent::Type)record.type;
+				event.button = reader.ReadSigned();
+				event.state = reader.ReadSigned();
+				event.x = reader.ReadSigned();
+				event.y = reader.ReadSigned();
+				break;
+			case InputEvent::MOUSE_MOTION:
+				event.type = InputEvent::MOUSE_MOTION;
+				event.x = reader.ReadSigned();
+				event.y = reader.ReadSigned();
+				break;
+			case RECORD_CLOCK:
+			case RECORD_CHECK:
+				record.bits = reader.ReadBits();
+				break;
+			case RECORD_END:
+				break;
+			default:
+				throw std::runtime_error("The input log " + filename + " is corrupt.");
+			}
+
+			m_endFrame = frame;
+			if(record.type == RECORD_END)
+				break;
+			m_records.push_back(record);
+		}
+	}
+
+	void InputLog::LoadFrame()
+	{
+		for(; m_nextRecord < m_records.size(); ++m_nextRecord)
+		{
+			const Record &record = m_records[m_nextRecord];
+			if(record.frame != m_frame)
+				break;
+
+			switch(record.type)
+			{
+			case RECORD_CLOCK:
+				m_frameClock.push_back(record.bits);
+				break;
+			case RECORD_CHECK:
+				m_frameChecks.push_back(record.bits);
+				break;
+			default:
+				m_pendingEvents.push_back(record.event);
+				break;
+			}
+		}
+	}
+
+	InputLog &GetInputLog()
+	{
+		static InputLog log;
+		return log;
+	}
+
+	void ParseInputLogArgs( int argc, char **argv )
+	{
+		std::string recordFilename;
+		std::string replayFilename;
+		for(int argIx = 1; argIx < argc; ++argIx)
+		{
+			std::string option = argv[argIx];
+			if(option != "--record" && option != "--replay")
+				continue;
+
+			if(argIx + 1 >= argc)
+				throw std::runtime_error("The option " + option + " needs a value.");
+
+			if(option == "--record")
+				recordFilename = argv[++argIx];
+			else
+				replayFilename = argv[++argIx];
+		}
+
+		if(!recordFilename.empty() && !replayFilename.empty())
+			throw std::runtime_error("An input log cannot be recorded while another is replayed.");
+
+		if(!recordFilename.empty())
+			GetInputLog().StartRecording(recordFilename);
+		else if(!replayFilename.empty())
+			GetInputLog().StartReplay(replayFilename);
+	}
+}
@@ -0,0 +1,153 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_INPUT_LOG_H
+#define FRAMEWORK_INPUT_LOG_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <chrono>
+#include <atomic>
+#include <functional>
+
+namespace Framework
+{
+	//What one GLUT input callback was called with. Unused values are zero.
+	struct InputEvent
+	{
+		enum Type
+		{
+			KEY_DOWN,
+			KEY_UP,
+			MOUSE_BUTTON,
+			MOUSE_MOTION,
+			MOUSE_WHEEL,
+
+			NUM_EVENT_TYPES,
+		};
+
+		InputEvent() : type(KEY_DOWN), key(0), button(0), state(0), x(0), y(0) {}
+
+		static InputEvent KeyDown(unsigned char key, int x, int y);
+		static InputEvent KeyUp(unsigned char key, int x, int y);
+		static InputEvent MouseButton(int button, int state, int x, int y);
+		static InputEvent MouseMotion(int x, int y);
+		static InputEvent MouseWheel(int wheel, int direction, int x, int y);
+
+		Type type;
+		unsigned char key;
+		int button;			//The wheel, for MOUSE_WHEEL.
+		int state;			//The direction, for MOUSE_WHEEL.
+		int x;
+		int y;
+	};
+
+	/**
+	Records input and the clock into a file, and plays them back, so that a run can be repeated
+	exactly.
+
+	Everything is tagged with the frame it happened in. Clock samples are taken in a frame, and
+	are handed back in the same order in the same frame. Input arrives from GLUT between frames;
+	when replaying, it is given to the handler at the start of the next frame, before anything
+	reads the clock. Code that takes its time only from GetElapsedSeconds, and its input only
+	from the handler, then computes the same thing on replay, to the bit.
+
+	While replaying, live input should be ignored: Capture returns false for it.
+
+	The file is a small header, then one record per event or sample. A record is the change in
+	frame number and the record's type, then its values as variable-length integers. Clock
+	samples are stored as the exact bits of the double.
+	**/
+	class InputLog
+	{
+	public:
+		typedef std::function<void(const InputEvent &)> EventFunc;
+
+		InputLog();
+		~InputLog();
+
+		//Throws if the file cannot be opened. Anything recorded or replayed before is stopped.
+		void StartRecording(const std::string &filename);
+
+		//Reads the whole file. Throws if it cannot be read, or is not an input log.
+		void StartReplay(const std::string &filename);
+
+		//Finishes the recording's file, or ends the replay. Live input and the real clock are
+		//used from then on.
+		void Stop();
+
+		bool IsRecording() const {return m_bRecording;}
+		bool IsReplaying() const {return m_bReplaying;}
+
+		//True once a replay has handed out the last frame it recorded. Unlike the rest, it may be
+		//called from a thread other than the one using the log.
+		bool IsReplayFinished() const;
+
+		//Starts the next frame. While replaying, the input recorded since the last frame is
+		//given to the handler first. Returns the new frame's number.
+		unsigned int BeginFrame(const EventFunc &handler);
+
+		unsigned int GetFrame() const {return m_frame;}
+
+		//Call from every GLUT input callback. Records the event if recording. Returns false if
+		//the event is live input that should be ignored, because a replay is running.
+		bool Capture(const InputEvent &event);
+
+		//Seconds since the log was made, or since recording or replay started. What a replay
+		//returns is what the recording did, at the same point in the same frame.
+		double GetElapsedSeconds();
+
+		//Records a hash of the data when recording. When replaying, compares it with the
+		//recording's and returns false if they differ, as the replay has stopped matching.
+		bool CheckState(const void *data, size_t bytes);
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		struct Record
+		{
+			unsigned int frame;
+			int type;
+			unsigned long long bits;	//Clock samples and state hashes.
+			InputEvent event;
+		};
+
+		Clock::time_point m_start;
+		std::atomic<unsigned int> m_frame;
+
+		bool m_bRecording;
+		std::ofstream m_file;
+		std::vector<unsigned char> m_writeBuffer;
+		unsigned int m_lastWrittenFrame;
+
+		std::atomic<bool> m_bReplaying;
+		std::vector<Record> m_records;
+		size_t m_nextRecord;
+		unsigned int m_endFrame;
+		std::deque<unsigned long long> m_frameClock;
+		std::deque<unsigned long long> m_frameChecks;
+		std::vector<InputEvent> m_pendingEvents;
+		double m_lastReplayedTime;
+
+		void Write(const Record &record);
+		void Flush();
+		void ReadRecords(const std::vector<unsigned char> &data, const std::string &filename);
+		void LoadFrame();
+
+		//Prevent copying.
+		InputLog(const InputLog &);
+		InputLog &operator=(const InputLog &);
+	};
+
+	//The log shared by the framework, created on first use.
+	InputLog &GetInputLog();
+
+	//Starts recording for --record FILE, or replaying for --replay FILE. Throws if the file
+	//cannot be used, or both are given.
+	void ParseInputLogArgs(int argc, char **argv);
+}
+
+#endif //FRAMEWORK_INPUT_LOG_H
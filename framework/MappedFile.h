@@ -0,0 +1,39 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_MAPPED_FILE_H
+#define FRAMEWORK_MAPPED_FILE_H
+
+#include <string>
+
+namespace Framework
+{
+	//A read-only view of an entire file, mapped into the address space.
+	//The data stays valid for as long as the object lives.
+	class MappedFile
+	{
+	public:
+		//Throws a std::runtime_error if the file cannot be opened or mapped.
+		explicit MappedFile(const std::string &filename);
+		~MappedFile();
+
+		const unsigned char *GetData() const {return m_pData;}
+		size_t GetSize() const {return m_size;}
+
+	private:
+		const unsigned char *m_pData;
+		size_t m_size;
+
+#ifdef WIN32
+		void *m_hFile;
+		void *m_hMapping;
+#endif //WIN32
+
+		//Prevent copying.
+		MappedFile(const MappedFile &);
+		MappedFile &operator=(const MappedFile &);
+	};
+}
+
+#endif //FRAMEWORK_MAPPED_FILE_H
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <utility>
 #include <fstream>
 #include <sstream>
@@ -13,11 +14,13 @@
 #include <functional>
 #include <algorithm>
 #include <iostream>
-#include <glload/gl_3_2_comp.h>
+#include <glload/gl_3_3_comp.h>
 #include <glload/gll.h>
 #include <GL/freeglut.h>
 #include "framework.h"
 #include "Mesh.h"
+#include "FrameStats.h"
+#include "Profiler.h"
 #include "directories.h"
 #include "rapidxml.hpp"
 #include "rapidxml_helpers.h"
@@ -60,6 +63,14 @@ namespace Framework
 			else
 				glDrawArrays(ePrimType, start, elemCount);
 		}
+
+		void RenderInstanced(GLsizei instanceCount) const
+		{
+			if(bIsIndexedCmd)
+				glDrawElementsInstanced(ePrimType, elemCount, eIndexDataType, (void*)start, instanceCount);
+			else
+				glDrawArraysInstanced(ePrimType, start, elemCount, instanceCount);
+		}
 	};
 
 	union AttribData
@@ -461,21 +472,187 @@ namespace Framework
 		VAOMap namedVAOs;
 
 		std::vector<RenderCmd> primatives;
+
+		MeshGeometry geometry;
 	};
 
-	Mesh::Mesh( const std::string &strFilename )
-		: m_pData(new MeshData)
+	namespace
+	{
+		float AttribToFloat(const Attribute &attrib, size_t valueIx)
+		{
+			const AttribData &value = attrib.dataArray[valueIx];
+			const bool bNorm = attrib.pAttribType->bNormalized;
+			switch(attrib.pAttribType->eGLType)
+			{
+			case GL_FLOAT:
+			case GL_HALF_FLOAT:
+				return value.fValue;
+			case GL_INT:
+				return bNorm ? std::max(value.iValue / 2147483647.0f, -1.0f) : (float)value.iValue;
+			case GL_UNSIGNED_INT:
+				return bNorm ? value.uiValue / 4294967295.0f : (float)value.uiValue;
+			case GL_SHORT:
+				return bNorm ? std::max(value.sValue / 32767.0f, -1.0f) : (float)value.sValue;
+			case GL_UNSIGNED_SHORT:
+				return bNorm ? value.usValue / 65535.0f : (float)value.usValue;
+			case GL_BYTE:
+				return bNorm ? std::max(value.bValue / 127.0f, -1.0f) : (float)value.bValue;
+			case GL_UNSIGNED_BYTE:
+				return bNorm ? value.ubValue / 255.0f : (float)value.ubValue;
+			}
+
+			return 0.0f;
+		}
+
+		GLuint IndexToUInt(const IndexData &indices, size_t indexIx)
+		{
+			const AttribData &value = indices.dataArray[indexIx];
+			switch(indices.pAttribType->eGLType)
+			{
+			case GL_UNSIGNED_SHORT: return value.usValue;
+			case GL_UNSIGNED_BYTE: return value.ubValue;
+			default: return value.uiValue;
+			}
+		}
+
+		//Turns one primitive's vertex list into triangles. Restart indices split strips and fans.
+		void AddTriangles(GLenum ePrimType, const std::vector<GLuint> &vertices, int primRestart,
+			std::vector<unsigned int> &triangles)
+		{
+			size_t firstIx = 0;
+			while(firstIx < vertices.size())
+			{
+				size_t endIx = firstIx;
+				while(endIx < vertices.size() && (primRestart < 0 || vertices[endIx] != (GLuint)primRestart))
+					++endIx;
+
+				for(size_t vertIx = firstIx + 2; vertIx < endIx; ++vertIx)
+				{
+					const size_t offset = vertIx - firstIx;
+					switch(ePrimType)
+					{
+					case GL_TRIANGLES:
+						if(offset % 3 != 2)
+							continue;
+						triangles.push_back(vertices[vertIx - 2]);
+						triangles.push_back(vertices[vertIx - 1]);
+						triangles.push_back(vertices[vertIx]);
+						break;
+					case GL_TRIANGLE_STRIP:
+						//Every other triangle is wound backwards.
+						triangles.push_back(vertices[vertIx - ((offset % 2) ? 1 : 2)]);
+						triangles.push_back(vertices[vertIx - ((offset % 2) ? 2 : 1)]);
+						triangles.push_back(vertices[vertIx]);
+						break;
+					case GL_TRIANGLE_FAN:
+						triangles.push_back(vertices[firstIx]);
+						triangles.push_back(vertices[vertIx - 1]);
+						triangles.push_back(vertices[vertIx]);
+						break;
+					}
+				}
+
+				firstIx = endIx + 1;
+			}
+		}
+
+		void BuildGeometry(const std::vector<Attribute> &attribs, const std::map<GLuint, int> &attribIndexMap,
+			const std::vector<RenderCmd> &primatives, const std::vector<IndexData> &indexData,
+			MeshGeometry &geometry)
+		{
+			std::map<GLuint, int>::const_iterator posIt = attribIndexMap.find(0);
+			if(posIt == attribIndexMap.end())
+				return;
+
+			const Attribute &posAttrib = attribs[posIt->second];
+			const size_t numVertices = posAttrib.NumElements();
+			geometry.positions.reserve(numVertices);
+			for(size_t vertIx = 0; vertIx < numVertices; ++vertIx)
+			{
+				glm::vec3 position(0.0f);
+				for(int comp = 0; comp < std::min(posAttrib.iSize, 3); ++comp)
+					position[comp] = AttribToFloat(posAttrib, vertIx * posAttrib.iSize + comp);
+
+				geometry.positions.push_back(position);
+				geometry.boundsMin = vertIx ? glm::min(geometry.boundsMin, position) : position;
+				geometry.boundsMax = vertIx ? glm::max(geometry.boundsMax, position) : position;
+			}
+
+			size_t iCurrIndexed = 0;
+			std::vector<GLuint> vertices;
+			for(size_t primIx = 0; primIx < primatives.size(); ++primIx)
+			{
+				const RenderCmd &prim = primatives[primIx];
+				vertices.clear();
+				if(prim.bIsIndexedCmd)
+				{
+					const IndexData &indices = indexData[iCurrIndexed++];
+					for(size_t indexIx = 0; indexIx < indices.dataArray.size(); ++indexIx)
+						vertices.push_back(IndexToUInt(indices, indexIx));
+				}
+				else
+				{
+					for(GLuint vertIx = prim.start; vertIx < prim.start + prim.elemCount; ++vertIx)
+						vertices.push_back(vertIx);
+				}
+
+				AddTriangles(prim.ePrimType, vertices, prim.bIsIndexedCmd ? prim.primRestart : -1,
+					geometry.triangles);
+			}
+
+			//Drop anything that refers past the end of the position array.
+			std::vector<unsigned int> &tris = geometry.triangles;
+			size_t outIx = 0;
+			for(size_t triIx = 0; triIx + 2 < tris.size(); triIx += 3)
+			{
+				if(tris[triIx] >= numVertices || tris[triIx + 1] >= numVertices || tris[triIx + 2] >= numVertices)
+					continue;
+
+				tris[outIx++] = tris[triIx];
+				tris[outIx++] = tris[triIx + 1];
+				tris[outIx++] = tris[triIx + 2];
+			}
+			tris.resize(outIx);
+		}
+	}
+
+	struct ParsedMeshData
 	{
+		std::string filename;
+		std::string pathname;
+
 		std::vector<Attribute> attribs;
-		attribs.reserve(16);
 		std::map<GLuint, int> attribIndexMap;	//Maps from attribute indices to 'attribs' indices.
 
 		std::vector<IndexData> indexData;
 
 		std::vector<std::pair<std::string, std::vector<GLuint> > > namedVaoList;
 
+		std::vector<RenderCmd> primatives;
+
+		MeshGeometry geometry;
+	};
+
+	ParsedMesh::ParsedMesh( const std::string &strFilename )
+		: ParsedMesh(strFilename, FindFileOrThrow(strFilename))
+	{}
+
+	ParsedMesh::ParsedMesh( const std::string &strFilename, const std::string &strPathname )
+		: m_pData(new ParsedMeshData)
+	{
+		PROFILE_SCOPE("ParsedMesh");
+		std::auto_ptr<ParsedMeshData> pData(m_pData);
+		pData->filename = strFilename;
+		pData->pathname = strPathname;
+
+		std::vector<Attribute> &attribs = pData->attribs;
+		attribs.reserve(16);
+		std::map<GLuint, int> &attribIndexMap = pData->attribIndexMap;
+		std::vector<IndexData> &indexData = pData->indexData;
+		std::vector<std::pair<std::string, std::vector<GLuint> > > &namedVaoList = pData->namedVaoList;
+
 		{
-			std::string strDataFilename = FindFileOrThrow(strFilename);
+			const std::string &strDataFilename = strPathname;
 			std::ifstream fileStream(strDataFilename.c_str());
 			if(!fileStream.is_open())
 				throw std::runtime_error("Could not find the mesh file: " + strDataFilename);
@@ -526,12 +703,51 @@ namespace Framework
 				pNode;
 				pNode = rapidxml::next_element(pNode))
 			{
-				m_pData->primatives.push_back(ProcessRenderCmd(*pNode));
+				pData->primatives.push_back(ProcessRenderCmd(*pNode));
 				if(make_string_name(*pNode) == "indices")
 					indexData.push_back(IndexData(*pNode));
 			}
 		}
 
+		BuildGeometry(attribs, attribIndexMap, pData->primatives, indexData, pData->geometry);
+		pData.release();
+	}
+
+	ParsedMesh::~ParsedMesh()
+	{
+		delete m_pData;
+	}
+
+	Mesh::Mesh( const std::string &strFilename )
+		: m_pData(new MeshData)
+		, m_filename(strFilename)
+	{
+		std::auto_ptr<MeshData> pData(m_pData);
+		ParsedMesh parsed(strFilename);
+		m_pathname = parsed.m_pData->pathname;
+		Upload(*parsed.m_pData);
+		pData.release();
+	}
+
+	Mesh::Mesh( ParsedMesh &parsed )
+		: m_pData(new MeshData)
+		, m_filename(parsed.m_pData->filename)
+		, m_pathname(parsed.m_pData->pathname)
+	{
+		std::auto_ptr<MeshData> pData(m_pData);
+		Upload(*parsed.m_pData);
+		pData.release();
+	}
+
+	void Mesh::Upload( ParsedMeshData &parsed )
+	{
+		PROFILE_SCOPE("Mesh::Upload");
+		const std::vector<Attribute> &attribs = parsed.attribs;
+		const std::vector<IndexData> &indexData = parsed.indexData;
+		std::vector<std::pair<std::string, std::vector<GLuint> > > &namedVaoList = parsed.namedVaoList;
+		m_pData->primatives.swap(parsed.primatives);
+		std::swap(m_pData->geometry, parsed.geometry);
+
 		//Figure out how big of a buffer object for the attribute data we need.
 		size_t iAttrbBufferSize = 0;
 		std::vector<size_t> attribStartLocs;
@@ -564,6 +780,7 @@ namespace Framework
 		glGenBuffers(1, &m_pData->oAttribArraysBuffer);
 		glBindBuffer(GL_ARRAY_BUFFER, m_pData->oAttribArraysBuffer);
 		glBufferData(GL_ARRAY_BUFFER, iAttrbBufferSize, NULL, GL_STATIC_DRAW);
+		CountUpload(iAttrbBufferSize);
 
 		//Fill in our data and set up the attribute arrays.
 		for(size_t iLoop = 0; iLoop < attribs.size(); iLoop++)
@@ -626,6 +843,7 @@ namespace Framework
 			glGenBuffers(1, &m_pData->oIndexBuffer);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_pData->oIndexBuffer);
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, iIndexBufferSize, NULL, GL_STATIC_DRAW);
+			CountUpload(iIndexBufferSize);
 
 			//Fill with data.
 			for(size_t iLoop = 0; iLoop < indexData.size(); iLoop++)
@@ -669,6 +887,7 @@ namespace Framework
 
 	void Mesh::Render() const
 	{
+		PROFILE_SCOPE("Mesh::Render");
 		if(!m_pData->oVAO)
 			return;
 
@@ -676,6 +895,9 @@ namespace Framework
 		std::for_each(m_pData->primatives.begin(), m_pData->primatives.end(),
 			std::mem_fun_ref(&RenderCmd::Render));
 		glBindVertexArray(0);
+
+		CountVaoBind();
+		CountDraws(m_pData->primatives.size(), m_pData->geometry.triangles.size() / 3);
 	}
 
 	void Mesh::Render( const std::string &strMeshName ) const
@@ -688,6 +910,60 @@ namespace Framework
 		std::for_each(m_pData->primatives.begin(), m_pData->primatives.end(),
 			std::mem_fun_ref(&RenderCmd::Render));
 		glBindVertexArray(0);
+
+		CountVaoBind();
+		CountDraws(m_pData->primatives.size(), m_pData->geometry.triangles.size() / 3);
+	}
+
+	void Mesh::SetInstanceAttribute( unsigned int attribIndex, unsigned int buffer, int components,
+		int stride, size_t offset )
+	{
+		if(!m_pData->oVAO)
+			return;
+
+		glBindVertexArray(m_pData->oVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glEnableVertexAttribArray(attribIndex);
+		glVertexAttribPointer(attribIndex, components, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+		//glload only loads the 3.2 core functions, so 3.3's divisor may only be there as the
+		//ARB_instanced_arrays one.
+		if(glVertexAttribDivisor)
+			glVertexAttribDivisor(attribIndex, 1);
+		else if(glext_ARB_instanced_arrays)
+			glVertexAttribDivisorARB(attribIndex, 1);
+		else
+			throw std::runtime_error("Instanced attributes need OpenGL 3.3 or ARB_instanced_arrays.");
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void Mesh::RenderInstanced( int instanceCount ) const
+	{
+		PROFILE_SCOPE("Mesh::RenderInstanced");
+		if(!m_pData->oVAO || instanceCount <= 0)
+			return;
+
+		glBindVertexArray(m_pData->oVAO);
+		for(size_t primIx = 0; primIx < m_pData->primatives.size(); ++primIx)
+			m_pData->primatives[primIx].RenderInstanced(instanceCount);
+		glBindVertexArray(0);
+
+		CountVaoBind();
+		CountDraws(m_pData->primatives.size(),
+			(m_pData->geometry.triangles.size() / 3) * instanceCount);
+	}
+
+	const MeshGeometry &Mesh::GetGeometry() const
+	{
+		return m_pData->geometry;
+	}
+
+	void Mesh::Reload()
+	{
+		ParsedMesh parsed(m_filename, m_pathname);
+		Mesh newMesh(parsed);
+		std::swap(m_pData, newMesh.m_pData);
+		newMesh.DeleteObjects();
 	}
 
 	void Mesh::DeleteObjects()
@@ -5,23 +5,89 @@
 #ifndef FRAMEWORK_MESH_H
 #define FRAMEWORK_MESH_H
 
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
 
 namespace Framework
 {
 	struct MeshData;
+	struct ParsedMeshData;
+
+	//A CPU-side copy of a mesh's triangles, for culling and picking. Positions come from
+	//attribute 0. Lines and points are left out.
+	struct MeshGeometry
+	{
+		MeshGeometry() : boundsMin(0.0f), boundsMax(0.0f) {}
+
+		std::vector<glm::vec3> positions;
+		std::vector<unsigned int> triangles;	//Three indices into positions per triangle.
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	//A mesh file that has been read and parsed, but not given to OpenGL. Parsing makes no
+	//GL calls, so it can happen on any thread.
+	class ParsedMesh
+	{
+	public:
+		ParsedMesh(const std::string &strFilename);
+
+		//For a file that has already been found, as by FindFileOrThrow.
+		ParsedMesh(const std::string &strFilename, const std::string &strPathname);
+		~ParsedMesh();
+
+	private:
+		ParsedMeshData *m_pData;
+
+		friend class Mesh;
+
+		//Prevent copying.
+		ParsedMesh(const ParsedMesh &);
+		ParsedMesh &operator=(const ParsedMesh &);
+	};
 
 	class Mesh
 	{
 	public:
 		Mesh(const std::string &strFilename);
+
+		//Only creates the OpenGL objects. Takes the parsed data, leaving the ParsedMesh empty.
+		explicit Mesh(ParsedMesh &parsed);
+
 		~Mesh();
 
 		void Render() const;
 		void Render(const std::string &strMeshName) const;
 		void DeleteObjects();
 
+		//Feeds a float attribute from the buffer once per instance rather than per vertex. The
+		//attribute must not be one the mesh file uses. Reload replaces the vertex array, so set
+		//it again after that.
+		void SetInstanceAttribute(unsigned int attribIndex, unsigned int buffer, int components,
+			int stride, size_t offset);
+
+		//Draws the whole mesh instanceCount times, in one call per render command.
+		void RenderInstanced(int instanceCount) const;
+
+		//Loads the mesh file again, and replaces the current data with it only if that succeeds.
+		//On failure, the exception propagates and the current data remains in use.
+		void Reload();
+
+		const std::string &GetFilename() const {return m_filename;}
+
+		const MeshGeometry &GetGeometry() const;
+
 	private:
 		MeshData *m_pData;
+		std::string m_filename;
+		std::string m_pathname;		//As found when the mesh was first loaded.
+
+		void Upload(ParsedMeshData &parsed);
+
+		//Prevent copying.
+		Mesh(const Mesh &);
+		Mesh &operator=(const Mesh &);
 	};
 }
 
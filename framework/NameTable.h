@@ -0,0 +1,193 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+
+#ifndef FRAMEWORK_NAME_TABLE_H
+#define FRAMEWORK_NAME_TABLE_H
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace Framework
+{
+	//FNV-1a. Cooked scene snapshots store these hashes, so it must not change.
+	inline unsigned int HashName(const char *name, size_t nameLength)
+	{
+		unsigned int hash = 2166136261u;
+		for(size_t charIx = 0; charIx < nameLength; ++charIx)
+		{
+			hash ^= (unsigned char)name[charIx];
+			hash *= 16777619u;
+		}
+
+		return hash;
+	}
+
+	/**
+	Maps names to values with an open-addressed hash table.
+
+	Entries live in a single array with linear probing, so a lookup is usually one hash and
+	one or two string compares within the same cache lines. Each entry caches the full hash,
+	so most mismatches never touch the string. The table is kept at most half full,
+	counting removed entries.
+	**/
+	template<typename ValueType>
+	class NameTable
+	{
+	public:
+		NameTable() : m_count(0), m_used(0) {}
+
+		//Returns false, and changes nothing, if the name is already in the table.
+		bool Insert(const std::string &name, const ValueType &value)
+		{
+			if(Find(name))
+				return false;
+
+			//If it is mostly removed entries, rehashing at the same size is enough.
+			if((m_used + 1) * 2 > m_entries.size())
+			{
+				if(m_entries.empty())
+					Rehash(MIN_CAPACITY);
+				else
+					Rehash((m_count + 1) * 4 > m_entries.size() ? m_entries.size() * 2 : m_entries.size());
+			}
+
+			const unsigned int hash = HashName(name.c_str(), name.size());
+			size_t entryIx = FindInsertSlot(hash);
+
+			Entry &entry = m_entries[entryIx];
+			if(entry.state == ENTRY_EMPTY)
+				++m_used;
+			entry.state = ENTRY_FULL;
+			entry.hash = hash;
+			entry.name = name;
+			entry.value = value;
+			++m_count;
+			return true;
+		}
+
+		//Returns false if the name was not in the table.
+		bool Remove(const std::string &name)
+		{
+			size_t entryIx = FindEntry(name.c_str(), name.size());
+			if(entryIx == NOT_FOUND)
+				return false;
+
+			Entry &entry = m_entries[entryIx];
+			entry.state = ENTRY_REMOVED;
+			entry.name.clear();
+			entry.value = ValueType();
+			--m_count;
+			return true;
+		}
+
+		//Returns NULL if the name is not in the table.
+		const ValueType *Find(const char *name, size_t nameLength) const
+		{
+			size_t entryIx = FindEntry(name, nameLength);
+			return entryIx == NOT_FOUND ? NULL : &m_entries[entryIx].value;
+		}
+
+		const ValueType *Find(const std::string &name) const
+		{
+			return Find(name.c_str(), name.size());
+		}
+
+		void Clear()
+		{
+			m_entries.clear();
+			m_count = 0;
+			m_used = 0;
+		}
+
+		size_t size() const {return m_count;}
+
+	private:
+		enum
+		{
+			MIN_CAPACITY = 16,
+		};
+
+		enum EntryState
+		{
+			ENTRY_EMPTY,
+			ENTRY_FULL,
+			ENTRY_REMOVED,
+		};
+
+		struct Entry
+		{
+			Entry() : hash(0), state(ENTRY_EMPTY), value() {}
+
+			unsigned int hash;
+			EntryState state;
+			ValueType value;
+			std::string name;
+		};
+
+		static const size_t NOT_FOUND = ~size_t(0);
+
+		std::vector<Entry> m_entries;	//Size is always zero or a power of two.
+		size_t m_count;
+		size_t m_used;					//Full and removed entries.
+
+		size_t FindEntry(const char *name, size_t nameLength) const
+		{
+			if(m_entries.empty())
+				return NOT_FOUND;
+
+			const unsigned int hash = HashName(name, nameLength);
+			const size_t mask = m_entries.size() - 1;
+			for(size_t entryIx = hash & mask; ; entryIx = (entryIx + 1) & mask)
+			{
+				const Entry &entry = m_entries[entryIx];
+				if(entry.state == ENTRY_EMPTY)
+					return NOT_FOUND;
+
+				if(entry.state == ENTRY_FULL && entry.hash == hash &&
+					entry.name.size() == nameLength &&
+					memcmp(entry.name.data(), name, nameLength) == 0)
+				{
+					return entryIx;
+				}
+			}
+		}
+
+		size_t FindInsertSlot(unsigned int hash) const
+		{
+			const size_t mask = m_entries.size() - 1;
+			size_t entryIx = hash & mask;
+			while(m_entries[entryIx].state == ENTRY_FULL)
+				entryIx = (entryIx + 1) & mask;
+
+			return entryIx;
+		}
+
+		void Rehash(size_t newCapacity)
+		{
+			while(newCapacity < m_count * 2 + 2)
+				newCapacity *= 2;
+
+			std::vector<Entry> oldEntries(newCapacity);
+			oldEntries.swap(m_entries);
+			m_used = m_count;
+
+			for(size_t oldIx = 0; oldIx < oldEntries.size(); ++oldIx)
+			{
+				Entry &oldEntry = oldEntries[oldIx];
+				if(oldEntry.state != ENTRY_FULL)
+					continue;
+
+				Entry &newEntry = m_entries[FindInsertSlot(oldEntry.hash)];
+				newEntry.state = ENTRY_FULL;
+				newEntry.hash = oldEntry.hash;
+				newEntry.value = oldEntry.value;
+				newEntry.name.swap(oldEntry.name);
+			}
+		}
+	};
+}
+
+#endif //FRAMEWORK_NAME_TABLE_H
@@ -0,0 +1,371 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+#include "OcclusionCuller.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRAMEWORK_OCCLUSION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Framework
+{
+	namespace
+	{
+		//Clip-space w below this is treated as crossing the near plane.
+		const float MIN_CLIP_W = 1.0e-5f;
+
+		void TransformPositions(const glm::mat4 &matrix, const std::vector<glm::vec3> &positions,
+			std::vector<glm::vec4> &clipPositions)
+		{
+			clipPositions.resize(positions.size());
+#ifdef FRAMEWORK_OCCLUSION_SSE2
+			const __m128 col0 = _mm_loadu_ps(&matrix[0][0]);
+			const __m128 col1 = _mm_loadu_ps(&matrix[1][0]);
+			const __m128 col2 = _mm_loadu_ps(&matrix[2][0]);
+			const __m128 col3 = _mm_loadu_ps(&matrix[3][0]);
+			for(size_t posIx = 0; posIx < positions.size(); ++posIx)
+			{
+				const glm::vec3 &pos = positions[posIx];
+				__m128 result = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(col0, _mm_set1_ps(pos.x)), _mm_mul_ps(col1, _mm_set1_ps(pos.y))),
+					_mm_add_ps(_mm_mul_ps(col2, _mm_set1_ps(pos.z)), col3));
+				_mm_storeu_ps(&clipPositions[posIx][0], result);
+			}
+#else
+			for(size_t posIx = 0; posIx < positions.size(); ++posIx)
+				clipPositions[posIx] = matrix * glm::vec4(positions[posIx], 1.0f);
+#endif
+		}
+
+		//True if all three points are outside the same side of the view volume.
+		bool IsTriviallyOutside(const glm::vec4 &clip0, const glm::vec4 &clip1, const glm::vec4 &clip2)
+		{
+			for(int axis = 0; axis < 3; ++axis)
+			{
+				if(clip0[axis] > clip0.w && clip1[axis] > clip1.w && clip2[axis] > clip2.w)
+					return true;
+				if(clip0[axis] < -clip0.w && clip1[axis] < -clip1.w && clip2[axis] < -clip2.w)
+					return true;
+			}
+
+			return false;
+		}
+	}
+
+	OcclusionCuller::OcclusionCuller( int width, int height )
+		: m_width(0)
+		, m_height(0)
+		, m_tilesX(0)
+		, m_tilesY(0)
+	{
+		if(width <= 0 || height <= 0)
+			throw std::runtime_error("The occlusion culler's depth buffer must not be empty.");
+
+		m_tilesX = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+		m_tilesY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+		m_width = m_tilesX * TILE_WIDTH;
+		m_height = m_tilesY * TILE_HEIGHT;
+		m_bins.resize(m_tilesX * m_tilesY);
+
+		int levelWidth = m_width;
+		int levelHeight = m_height;
+		for(;;)
+		{
+			DepthLevel level;
+			level.width = levelWidth;
+			level.height = levelHeight;
+			level.depths.resize(levelWidth * levelHeight, 1.0f);
+			m_levels.push_back(level);
+
+			if(levelWidth == 1 && levelHeight == 1)
+				break;
+
+			levelWidth = std::max((levelWidth + 1) / 2, 1);
+			levelHeight = std::max((levelHeight + 1) / 2, 1);
+		}
+	}
+
+	void OcclusionCuller::BeginFrame( const glm::mat4 &worldToClip )
+	{
+		m_worldToClip = worldToClip;
+		m_triangles.clear();
+		for(size_t binIx = 0; binIx < m_bins.size(); ++binIx)
+			m_bins[binIx].clear();
+
+		for(size_t levelIx = 0; levelIx < m_levels.size(); ++levelIx)
+			std::fill(m_levels[levelIx].depths.begin(), m_levels[levelIx].depths.end(), 1.0f);
+	}
+
+	void OcclusionCuller::AddOccluder( const MeshGeometry &geometry, const glm::mat4 &modelToWorld )
+	{
+		PROFILE_SCOPE("OcclusionCuller::AddOccluder");
+		TransformPositions(m_worldToClip * modelToWorld, geometry.positions, m_clipPositions);
+
+		const std::vector<unsigned int> &tris = geometry.triangles;
+		for(size_t triIx = 0; triIx + 2 < tris.size(); triIx += 3)
+		{
+			SetupTriangle(m_clipPositions[tris[triIx]], m_clipPositions[tris[triIx + 1]],
+				m_clipPositions[tris[triIx + 2]]);
+		}
+	}
+
+	void OcclusionCuller::SetupTriangle( const glm::vec4 &clip0, const glm::vec4 &clip1,
+		const glm::vec4 &clip2 )
+	{
+		if(clip0.w < MIN_CLIP_W || clip1.w < MIN_CLIP_W || clip2.w < MIN_CLIP_W)
+			return;
+		if(IsTriviallyOutside(clip0, clip1, clip2))
+			return;
+		if(clip0.z < -clip0.w || clip1.z < -clip1.w || clip2.z < -clip2.w)
+			return;
+
+		const glm::vec4 *clips[3] = {&clip0, &clip1, &clip2};
+		glm::vec3 win[3];
+		for(int vertIx = 0; vertIx < 3; ++vertIx)
+		{
+			const glm::vec4 &clip = *clips[vertIx];
+			win[vertIx] = glm::vec3(
+				(clip.x / clip.w * 0.5f + 0.5f) * m_width,
+				(clip.y / clip.w * 0.5f + 0.5f) * m_height,
+				std::min(clip.z / clip.w * 0.5f + 0.5f, 1.0f));
+		}
+
+		//Occluders are drawn from both sides, so make the winding counter-clockwise.
+		float area = (win[1].x - win[0].x) * (win[2].y - win[0].y) -
+			(win[1].y - win[0].y) * (win[2].x - win[0].x);
+		if(area < 0.0f)
+		{
+			std::swap(win[1], win[2]);
+			area = -area;
+		}
+		if(area < 1.0e-6f)
+			return;
+
+		TriangleSetup setup;
+		setup.minX = std::max((int)ceilf(std::min(win[0].x, std::min(win[1].x, win[2].x)) - 0.5f), 0);
+		setup.maxX = std::min((int)floorf(std::max(win[0].x, std::max(win[1].x, win[2].x)) - 0.5f), m_width - 1);
+		setup.minY = std::max((int)ceilf(std::min(win[0].y, std::min(win[1].y, win[2].y)) - 0.5f), 0);
+		setup.maxY = std::min((int)floorf(std::max(win[0].y, std::max(win[1].y, win[2].y)) - 0.5f), m_height - 1);
+		if(setup.minX > setup.maxX || setup.minY > setup.maxY)
+			return;
+
+		//Edge i runs from vertex i to vertex i + 1, and is positive on the inside.
+		for(int edgeIx = 0; edgeIx < 3; ++edgeIx)
+		{
+			const glm::vec3 &from = win[edgeIx];
+			const glm::vec3 &to = win[(edgeIx + 1) % 3];
+			setup.edgeA[edgeIx] = from.y - to.y;
+			setup.edgeB[edgeIx] = to.x - from.x;
+			setup.edgeC[edgeIx] = -(setup.edgeA[edgeIx] * from.x + setup.edgeB[edgeIx] * from.y);
+		}
+
+		//Edge 1 is opposite vertex 0, so it is vertex 0's barycentric weight times the area.
+		const float invArea = 1.0f / area;
+		setup.depthA = (setup.edgeA[1] * win[0].z + setup.edgeA[2] * win[1].z + setup.edgeA[0] * win[2].z) * invArea;
+		setup.depthB = (setup.edgeB[1] * win[0].z + setup.edgeB[2] * win[1].z + setup.edgeB[0] * win[2].z) * invArea;
+		setup.depthC = (setup.edgeC[1] * win[0].z + setup.edgeC[2] * win[1].z + setup.edgeC[0] * win[2].z) * invArea;
+
+		const unsigned int setupIx = (unsigned int)m_triangles.size();
+		m_triangles.push_back(setup);
+
+		for(int tileY = setup.minY / TILE_HEIGHT; tileY <= setup.maxY / TILE_HEIGHT; ++tileY)
+		{
+			for(int tileX = setup.minX / TILE_WIDTH; tileX <= setup.maxX / TILE_WIDTH; ++tileX)
+				m_bins[tileY * m_tilesX + tileX].push_back(setupIx);
+		}
+	}
+
+	void OcclusionCuller::FinishOccluders()
+	{
+		PROFILE_SCOPE("OcclusionCuller::FinishOccluders");
+		ParallelFor(GetWorkerPool(), m_bins.size(), 1, [this](size_t begin, size_t end)
+		{
+			for(size_t tileIx = begin; tileIx < end; ++tileIx)
+				RasterizeTile((int)tileIx);
+		});
+
+		BuildPyramid();
+	}
+
+	void OcclusionCuller::RasterizeTile( int tileIx )
+	{
+		PROFILE_SCOPE("OcclusionCuller::RasterizeTile");
+		const std::vector<unsigned int> &bin = m_bins[tileIx];
+		if(bin.empty())
+			return;
+
+		const int tileMinX = (tileIx % m_tilesX) * TILE_WIDTH;
+		const int tileMinY = (tileIx / m_tilesX) * TILE_HEIGHT;
+		float *pDepths = &m_levels[0].depths[0];
+
+		for(size_t binIx = 0; binIx < bin.size(); ++binIx)
+		{
+			const TriangleSetup &tri = m_triangles[bin[binIx]];
+
+			//Tiles are a multiple of four wide, so aligning down keeps each group in the tile.
+			const int minX = std::max(tri.minX, tileMinX) & ~3;
+			const int maxX = std::min(tri.maxX, tileMinX + TILE_WIDTH - 1);
+			const int minY = std::max(tri.minY, tileMinY);
+			const int maxY = std::min(tri.maxY, tileMinY + TILE_HEIGHT - 1);
+
+#ifdef FRAMEWORK_OCCLUSION_SSE2
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+			const __m128 edgeA0 = _mm_set1_ps(tri.edgeA[0]);
+			const __m128 edgeA1 = _mm_set1_ps(tri.edgeA[1]);
+			const __m128 edgeA2 = _mm_set1_ps(tri.edgeA[2]);
+			const __m128 depthA = _mm_set1_ps(tri.depthA);
+
+			for(int y = minY; y <= maxY; ++y)
+			{
+				const float centerY = y + 0.5f;
+				const __m128 row0 = _mm_set1_ps(tri.edgeB[0] * centerY + tri.edgeC[0]);
+				const __m128 row1 = _mm_set1_ps(tri.edgeB[1] * centerY + tri.edgeC[1]);
+				const __m128 row2 = _mm_set1_ps(tri.edgeB[2] * centerY + tri.edgeC[2]);
+				const __m128 rowDepth = _mm_set1_ps(tri.depthB * centerY + tri.depthC);
+				float *pRow = pDepths + y * m_width;
+
+				for(int x = minX; x <= maxX; x += 4)
+				{
+					const __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+					__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, centerX), row0), zero);
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, centerX), row1), zero));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, centerX), row2), zero));
+					if(_mm_movemask_ps(inside) == 0)
+						continue;
+
+					const __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, centerX), rowDepth);
+					const __m128 oldDepth = _mm_loadu_ps(pRow + x);
+					const __m128 newDepth = _mm_min_ps(oldDepth, depth);
+					_mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(inside, newDepth),
+						_mm_andnot_ps(inside, oldDepth)));
+				}
+			}
+#else
+			for(int y = minY; y <= maxY; ++y)
+			{
+				const float centerY = y + 0.5f;
+				float *pRow = pDepths + y * m_width;
+				for(int x = minX; x <= maxX; ++x)
+				{
+					const float centerX = x + 0.5f;
+					if(tri.edgeA[0] * centerX + tri.edgeB[0] * centerY + tri.edgeC[0] < 0.0f ||
+						tri.edgeA[1] * centerX + tri.edgeB[1] * centerY + tri.edgeC[1] < 0.0f ||
+						tri.edgeA[2] * centerX + tri.edgeB[2] * centerY + tri.edgeC[2] < 0.0f)
+					{
+						continue;
+					}
+
+					const float depth = tri.depthA * centerX + tri.depthB * centerY + tri.depthC;
+					pRow[x] = std::min(pRow[x], depth);
+				}
+			}
+#endif
+		}
+	}
+
+	void OcclusionCuller::BuildPyramid()
+	{
+		PROFILE_SCOPE("OcclusionCuller::BuildPyramid");
+		for(size_t levelIx = 1; levelIx < m_levels.size(); ++levelIx)
+		{
+			const DepthLevel &src = m_levels[levelIx - 1];
+			DepthLevel &dst = m_levels[levelIx];
+			for(int y = 0; y < dst.height; ++y)
+			{
+				const int srcY0 = y * 2;
+				const int srcY1 = std::min(srcY0 + 1, src.height - 1);
+				for(int x = 0; x < dst.width; ++x)
+				{
+					const int srcX0 = x * 2;
+					const int srcX1 = std::min(srcX0 + 1, src.width - 1);
+					dst.depths[y * dst.width + x] = std::max(
+						std::max(src.depths[srcY0 * src.width + srcX0], src.depths[srcY0 * src.width + srcX1]),
+						std::max(src.depths[srcY1 * src.width + srcX0], src.depths[srcY1 * src.width + srcX1]));
+				}
+			}
+		}
+	}
+
+	bool OcclusionCuller::IsVisible( const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+		const glm::mat4 &modelToWorld ) const
+	{
+		const glm::mat4 modelToClip = m_worldToClip * modelToWorld;
+
+		glm::vec3 ndcMin(0.0f);
+		glm::vec3 ndcMax(0.0f);
+		int numBehind = 0;
+		for(int cornerIx = 0; cornerIx < 8; ++cornerIx)
+		{
+			glm::vec4 corner(
+				(cornerIx & 1) ? boundsMax.x : boundsMin.x,
+				(cornerIx & 2) ? boundsMax.y : boundsMin.y,
+				(cornerIx & 4) ? boundsMax.z : boundsMin.z,
+				1.0f);
+			glm::vec4 clip = modelToClip * corner;
+			if(clip.w < MIN_CLIP_W)
+			{
+				++numBehind;
+				continue;
+			}
+
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			ndcMin = (cornerIx != numBehind) ? glm::min(ndcMin, ndc) : ndc;
+			ndcMax = (cornerIx != numBehind) ? glm::max(ndcMax, ndc) : ndc;
+		}
+
+		if(numBehind == 8)
+			return false;
+		if(numBehind != 0)
+			return true;
+
+		if(ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f || ndcMin.z > 1.0f)
+			return false;
+		if(ndcMin.z < -1.0f)
+			return true;
+
+		const float nearestDepth = ndcMin.z * 0.5f + 0.5f;
+		int minX = glm::clamp((int)floorf((ndcMin.x * 0.5f + 0.5f) * m_width), 0, m_width - 1);
+		int maxX = glm::clamp((int)floorf((ndcMax.x * 0.5f + 0.5f) * m_width), 0, m_width - 1);
+		int minY = glm::clamp((int)floorf((ndcMin.y * 0.5f + 0.5f) * m_height), 0, m_height - 1);
+		int maxY = glm::clamp((int)floorf((ndcMax.y * 0.5f + 0.5f) * m_height), 0, m_height - 1);
+
+		//Go up until the rectangle covers at most 4x4 texels.
+		int levelIx = 0;
+		while(levelIx + 1 < (int)m_levels.size() && (maxX - minX > 3 || maxY - minY > 3))
+		{
+			minX /= 2; maxX /= 2;
+			minY /= 2; maxY /= 2;
+			++levelIx;
+		}
+
+		const DepthLevel &level = m_levels[levelIx];
+		for(int y = minY; y <= maxY; ++y)
+		{
+			for(int x = minX; x <= maxX; ++x)
+			{
+				if(nearestDepth <= level.depths[y * level.width + x])
+					return true;
+			}
+		}
+
+		return false;
+	}
+
+	const float *OcclusionCuller::GetDepthLevel( int level, int &width, int &height ) const
+	{
+		if(level < 0 || level >= (int)m_levels.size())
+			throw std::runtime_error("There is no occlusion depth level with that index.");
+
+		width = m_levels[level].width;
+		height = m_levels[level].height;
+		return &m_levels[level].depths[0];
+	}
+}
@@ -0,0 +1,105 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_OCCLUSION_CULLER_H
+#define FRAMEWORK_OCCLUSION_CULLER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+
+namespace Framework
+{
+	/**
+	Culls objects hidden behind a few large occluders, entirely on the CPU.
+
+	Each frame, the occluders are rasterized into a small depth buffer. Triangles are binned
+	into screen tiles, and the tiles are rasterized in parallel on the worker pool, four pixels
+	at a time with SSE2 where it is available. A hierarchical-Z pyramid is then built from it,
+	where each texel holds the farthest depth of the texels below it. An object's bounding box
+	is tested against the pyramid level where its screen rectangle covers only a few texels.
+
+	Depths are window-space, 0 at the near plane and 1 at the far plane. Occluder triangles that
+	cross the near plane are skipped rather than clipped, and boxes that cross it are always
+	visible, so errors only ever make things visible.
+
+	No OpenGL is used, so this works without a context.
+	**/
+	class OcclusionCuller
+	{
+	public:
+		enum
+		{
+			TILE_WIDTH = 32,
+			TILE_HEIGHT = 16,
+		};
+
+		//The size is rounded up to a whole number of tiles.
+		OcclusionCuller(int width = 256, int height = 128);
+
+		//Clears the depth buffer. The matrix goes from world space to clip space.
+		void BeginFrame(const glm::mat4 &worldToClip);
+
+		//Transforms and bins the occluder's triangles. Nothing is rasterized until FinishOccluders.
+		void AddOccluder(const MeshGeometry &geometry, const glm::mat4 &modelToWorld);
+
+		//Rasterizes the binned triangles and builds the depth pyramid.
+		void FinishOccluders();
+
+		//Returns false if the box is entirely hidden by the occluders or entirely off-screen.
+		//The box is in model space.
+		bool IsVisible(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+			const glm::mat4 &modelToWorld) const;
+
+		int GetWidth() const {return m_width;}
+		int GetHeight() const {return m_height;}
+
+		//Level 0 is the depth buffer itself. Each level is stored bottom row first.
+		int GetNumLevels() const {return (int)m_levels.size();}
+		const float *GetDepthLevel(int level, int &width, int &height) const;
+
+		//The number of occluder triangles rasterized this frame.
+		size_t GetOccluderTriangleCount() const {return m_triangles.size();}
+
+	private:
+		//Edge functions and the depth plane, as A * x + B * y + C at pixel centers.
+		struct TriangleSetup
+		{
+			float edgeA[3];
+			float edgeB[3];
+			float edgeC[3];
+			float depthA;
+			float depthB;
+			float depthC;
+			int minX;
+			int maxX;
+			int minY;
+			int maxY;
+		};
+
+		struct DepthLevel
+		{
+			int width;
+			int height;
+			std::vector<float> depths;
+		};
+
+		int m_width;
+		int m_height;
+		int m_tilesX;
+		int m_tilesY;
+		glm::mat4 m_worldToClip;
+
+		std::vector<DepthLevel> m_levels;
+		std::vector<TriangleSetup> m_triangles;
+		std::vector<std::vector<unsigned int> > m_bins;	//Triangle indices per tile.
+		std::vector<glm::vec4> m_clipPositions;
+
+		void SetupTriangle(const glm::vec4 &clip0, const glm::vec4 &clip1, const glm::vec4 &clip2);
+		void RasterizeTile(int tileIx);
+		void BuildPyramid();
+	};
+}
+
+#endif //FRAMEWORK_OCCLUSION_CULLER_H
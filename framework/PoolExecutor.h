@@ -0,0 +1,28 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_POOL_EXECUTOR_H
+#define FRAMEWORK_POOL_EXECUTOR_H
+
+#include <glimg/Executor.h>
+#include "WorkerPool.h"
+
+namespace Framework
+{
+	//Lets glimg run its tasks on a WorkerPool, rather than on threads of its own. The
+	//framework's main gives glimg one over the shared pool.
+	class PoolExecutor : public glimg::Executor
+	{
+	public:
+		explicit PoolExecutor(WorkerPool &pool) : m_pool(pool) {}
+
+		virtual void Submit(const std::function<void()> &task) {m_pool.Submit(task);}
+		virtual unsigned int GetThreadCount() const {return m_pool.GetThreadCount();}
+
+	private:
+		WorkerPool &m_pool;
+	};
+}
+
+#endif //FRAMEWORK_POOL_EXECUTOR_H
@@ -0,0 +1,108 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <string>
+#include <fstream>
+#include "Profiler.h"
+
+namespace Framework
+{
+	namespace profile
+	{
+#ifdef FRAMEWORK_PROFILE
+		namespace
+		{
+			void WriteJsonString(std::ostream &out, const char *str)
+			{
+				out << '"';
+				for(; *str; ++str)
+				{
+					if(*str == '"' || *str == '\\')
+						out << '\\' << *str;
+					else if((unsigned char)*str < 0x20)
+						out << ' ';
+					else
+						out << *str;
+				}
+				out << '"';
+			}
+		}
+
+		void WriteChromeTrace( std::ostream &out )
+		{
+			TraceRegistry &registry = TraceRegistry::Get();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+
+			//Ticks are converted using the rate since the registry was made.
+			unsigned long long nowTicks = ReadTicks();
+			double elapsedUs = std::chrono::duration<double, std::micro>(
+				std::chrono::steady_clock::now() - registry.startTime).count();
+			double usPerTick = 0.0;
+			if(nowTicks > registry.startTicks)
+				usPerTick = elapsedUs / (double)(nowTicks - registry.startTicks);
+
+			out << "{\"traceEvents\":[\n";
+			bool bFirst = true;
+			for(size_t traceIx = 0; traceIx < registry.traces.size(); ++traceIx)
+			{
+				const ThreadTrace &trace = *registry.traces[traceIx];
+				if(!trace.name.empty())
+				{
+					out << (bFirst ? "" : ",\n") << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << trace.GetThreadId() <<
+						",\"name\":\"thread_name\",\"args\":{\"name\":";
+					WriteJsonString(out, trace.name.c_str());
+					out << "}}";
+					bFirst = false;
+				}
+
+				size_t count = trace.GetCount();
+				size_t first = count > ThreadTrace::CAPACITY ? count - ThreadTrace::CAPACITY : 0;
+				for(size_t eventIx = first; eventIx < count; ++eventIx)
+				{
+					const TraceEvent &event = trace.GetEvent(eventIx);
+					double startUs = (double)(long long)(event.start - registry.startTicks) * usPerTick;
+					double durationUs = (double)(event.end - event.start) * usPerTick;
+
+					out << (bFirst ? "" : ",\n") << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << trace.GetThreadId() <<
+						",\"ts\":" << startUs << ",\"dur\":" << durationUs << ",\"name\":";
+					WriteJsonString(out, event.name);
+					out << "}";
+					bFirst = false;
+				}
+			}
+			out << "\n]}\n";
+		}
+
+		void SetThreadName( const std::string &name )
+		{
+			ThreadTrace &trace = GetThreadTrace();
+			std::lock_guard<std::mutex> lock(TraceRegistry::Get().mutex);
+			trace.name = name;
+		}
+
+		bool WriteChromeTrace( const std::string &filename )
+		{
+			std::ofstream outFile(filename.c_str());
+			if(!outFile.is_open())
+				return false;
+
+			WriteChromeTrace(outFile);
+			return (bool)outFile;
+		}
+#else
+		void WriteChromeTrace( std::ostream &out )
+		{
+			out << "{\"traceEvents\":[]}\n";
+		}
+
+		void SetThreadName( const std::string & )
+		{}
+
+		bool WriteChromeTrace( const std::string & )
+		{
+			return false;
+		}
+#endif
+	}
+}
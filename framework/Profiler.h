@@ -0,0 +1,188 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_PROFILER_H
+#define FRAMEWORK_PROFILER_H
+
+/**
+A scoped CPU profiler.
+
+PROFILE_SCOPE("name") records when the enclosing scope starts and ends. Each thread writes
+its events into a ring buffer of its own, without locking, so the oldest events are lost
+once it wraps. WriteChromeTrace saves whatever the rings hold in Chrome's trace_event JSON
+format, which chrome://tracing and Perfetto can open.
+
+Names must be string literals, or otherwise outlive the trace; only the pointer is kept.
+
+Profiling is compiled in only when FRAMEWORK_PROFILE is defined. Otherwise PROFILE_SCOPE
+expands to nothing and WriteChromeTrace writes no file. The recording side is in this header
+alone. The glsdk libraries build without the framework's include path, so calls into them
+are timed where the framework or the application makes them.
+**/
+
+#include <string>
+#include <ostream>
+
+#ifdef FRAMEWORK_PROFILE
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define FRAMEWORK_PROFILE_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define FRAMEWORK_PROFILE_RDTSC
+#elif defined(__linux__)
+#include <time.h>
+#endif
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) \
+	::Framework::profile::ScopedMarker PROFILE_CONCAT(profileMarker_, __LINE__)(name)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+
+#endif //FRAMEWORK_PROFILE
+
+namespace Framework
+{
+	namespace profile
+	{
+		//Writes every recorded event. Returns false if the file could not be written, or
+		//profiling is compiled out.
+		bool WriteChromeTrace(const std::string &filename);
+		void WriteChromeTrace(std::ostream &out);
+
+		//Names the calling thread in the trace. The name is copied.
+		void SetThreadName(const std::string &name);
+
+#ifdef FRAMEWORK_PROFILE
+		struct TraceEvent
+		{
+			const char *name;
+			unsigned long long start;
+			unsigned long long end;
+		};
+
+		//rdtsc where there is one, since it costs a few nanoseconds. Its rate is measured
+		//against the steady clock when the trace is written.
+		inline unsigned long long ReadTicks()
+		{
+#if defined(FRAMEWORK_PROFILE_RDTSC)
+			return __rdtsc();
+#elif defined(__linux__)
+			timespec now;
+			clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+			return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+#else
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+
+		//Written only by its thread. A reader takes the count first, then the events before it.
+		class ThreadTrace
+		{
+		public:
+			enum {CAPACITY = 1 << 16};
+
+			ThreadTrace(unsigned int threadId)
+				: m_count(0)
+				, m_threadId(threadId)
+				, m_events(CAPACITY)
+			{}
+
+			void Add(const char *name, unsigned long long start, unsigned long long end)
+			{
+				size_t count = m_count.load(std::memory_order_relaxed);
+				TraceEvent &event = m_events[count & (CAPACITY - 1)];
+				event.name = name;
+				event.start = start;
+				event.end = end;
+				m_count.store(count + 1, std::memory_order_release);
+			}
+
+			size_t GetCount() const {return m_count.load(std::memory_order_acquire);}
+			const TraceEvent &GetEvent(size_t index) const {return m_events[index & (CAPACITY - 1)];}
+
+			unsigned int GetThreadId() const {return m_threadId;}
+
+			std::string name;	//Guarded by the registry's mutex.
+
+		private:
+			std::atomic<size_t> m_count;
+			unsigned int m_threadId;
+			std::vector<TraceEvent> m_events;
+		};
+
+		//Every thread's trace, kept until exit so events outlive the threads that made them.
+		class TraceRegistry
+		{
+		public:
+			static TraceRegistry &Get()
+			{
+				static TraceRegistry registry;
+				return registry;
+			}
+
+			ThreadTrace *Register()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				traces.push_back(new ThreadTrace((unsigned int)traces.size()));
+				return traces.back();
+			}
+
+			std::mutex mutex;
+			std::vector<ThreadTrace *> traces;
+			unsigned long long startTicks;
+			std::chrono::steady_clock::time_point startTime;
+
+		private:
+			TraceRegistry()
+				: startTicks(ReadTicks())
+				, startTime(std::chrono::steady_clock::now())
+			{}
+		};
+
+		inline ThreadTrace &GetThreadTrace()
+		{
+			static thread_local ThreadTrace *pTrace = NULL;
+			if(!pTrace)
+				pTrace = TraceRegistry::Get().Register();
+			return *pTrace;
+		}
+
+		class ScopedMarker
+		{
+		public:
+			explicit ScopedMarker(const char *name)
+				: m_name(name)
+				, m_start(ReadTicks())
+			{}
+
+			~ScopedMarker()
+			{
+				GetThreadTrace().Add(m_name, m_start, ReadTicks());
+			}
+
+		private:
+			const char *m_name;
+			unsigned long long m_start;
+
+			//Prevent copying.
+			ScopedMarker(const ScopedMarker &);
+			ScopedMarker &operator=(const ScopedMarker &);
+		};
+#endif //FRAMEWORK_PROFILE
+	}
+}
+
+#endif //FRAMEWORK_PROFILER_H
@@ -0,0 +1,533 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include <glload/gl_all.h>
+#include "RenderGraph.h"
+#include "Profiler.h"
+
+namespace Framework
+{
+	namespace
+	{
+		bool IsDepthFormat(GLenum format)
+		{
+			switch(format)
+			{
+			case GL_DEPTH_COMPONENT16:
+			case GL_DEPTH_COMPONENT24:
+			case GL_DEPTH_COMPONENT32:
+			case GL_DEPTH_COMPONENT32F:
+			case GL_DEPTH24_STENCIL8:
+			case GL_DEPTH32F_STENCIL8:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool IsDepthStencilFormat(GLenum format)
+		{
+			return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+		}
+
+		struct Lifetime
+		{
+			RenderGraph::ResourceId resource;
+			size_t first;
+			size_t last;
+
+			bool operator<(const Lifetime &other) const {return first < other.first;}
+		};
+	}
+
+	RenderGraph::RenderGraph()
+		: m_bCompiled(false)
+		, m_fbo(0)
+	{}
+
+	RenderGraph::~RenderGraph()
+	{
+		if(!m_textures.empty())
+			glDeleteTextures((GLsizei)m_textures.size(), &m_textures[0]);
+		if(m_fbo)
+			glDeleteFramebuffers(1, &m_fbo);
+	}
+
+	void RenderGraph::Clear()
+	{
+		m_resources.clear();
+		m_passes.clear();
+		m_order.clear();
+		m_physicalDescs.clear();
+		m_bCompiled = false;
+	}
+
+	RenderGraph::ResourceId RenderGraph::AddTarget( const std::string &name, const RenderTargetDesc &desc )
+	{
+		GetBytesPerPixel(desc.format);
+
+		Resource resource;
+		resource.name = name;
+		resource.desc = desc;
+		resource.bImported = false;
+		resource.bOutput = false;
+		resource.importedTexture = 0;
+		resource.physical = -1;
+		m_resources.push_back(resource);
+		m_bCompiled = false;
+		return (ResourceId)(m_resources.size() - 1);
+	}
+
+	RenderGraph::ResourceId RenderGraph::ImportTarget( const std::string &name, const RenderTargetDesc &desc,
+		GLuint texture )
+	{
+		ResourceId id = AddTarget(name, desc);
+		m_resources[id].bImported = true;
+		m_resources[id].bOutput = true;
+		m_resources[id].importedTexture = texture;
+		return id;
+	}
+
+	void RenderGraph::MarkOutput( ResourceId resource )
+	{
+		m_resources.at(resource).bOutput = true;
+		m_bCompiled = false;
+	}
+
+	RenderGraph::PassId RenderGraph::AddPass( const std::string &name, const PassFunc &execute )
+	{
+		Pass pass;
+		pass.name = name;
+		pass.execute = execute;
+		pass.bLive = false;
+		m_passes.push_back(pass);
+		m_bCompiled = false;
+		return (PassId)(m_passes.size() - 1);
+	}
+
+	void RenderGraph::Read( PassId pass, ResourceId resource )
+	{
+		m_resources.at(resource);
+		m_passes.at(pass).reads.push_back(resource);
+		m_bCompiled = false;
+	}
+
+	void RenderGraph::Write( PassId pass, ResourceId resource )
+	{
+		m_resources.at(resource);
+		m_passes.at(pass).writes.push_back(resource);
+		m_bCompiled = false;
+	}
+
+	bool RenderGraph::PassReads( PassId pass, ResourceId resource ) const
+	{
+		const std::vector<ResourceId> &reads = m_passes[pass].reads;
+		return std::find(reads.begin(), reads.end(), resource) != reads.end();
+	}
+
+	bool RenderGraph::PassWrites( PassId pass, ResourceId resource ) const
+	{
+		const std::vector<ResourceId> &writes = m_passes[pass].writes;
+		return std::find(writes.begin(), writes.end(), resource) != writes.end();
+	}
+
+	//dependencies[pass] lists the passes that must run before it.
+	void RenderGraph::BuildDependencies( std::vector<std::vector<PassId> > &dependencies ) const
+	{
+		dependencies.assign(m_passes.size(), std::vector<PassId>());
+		for(ResourceId resIx = 0; resIx < m_resources.size(); ++resIx)
+		{
+			//Writers first, then passes that read and write, then readers.
+			std::vector<PassId> writers;
+			std::vector<PassId> modifiers;
+			std::vector<PassId> readers;
+			for(PassId passIx = 0; passIx < m_passes.size(); ++passIx)
+			{
+				bool reads = PassReads(passIx, resIx);
+				bool writes = PassWrites(passIx, resIx);
+				if(reads && writes)
+					modifiers.push_back(passIx);
+				else if(writes)
+					writers.push_back(passIx);
+				else if(reads)
+					readers.push_back(passIx);
+			}
+
+			std::vector<PassId> chain(writers);
+			chain.insert(chain.end(), modifiers.begin(), modifiers.end());
+			for(size_t chainIx = 1; chainIx < chain.size(); ++chainIx)
+				dependencies[chain[chainIx]].push_back(chain[chainIx - 1]);
+
+			if(!chain.empty())
+			{
+				for(size_t readerIx = 0; readerIx < readers.size(); ++readerIx)
+					dependencies[readers[readerIx]].push_back(chain.back());
+			}
+		}
+	}
+
+	void RenderGraph::Compile()
+	{
+		PROFILE_SCOPE("RenderGraph::Compile");
+		std::vector<std::vector<PassId> > dependencies;
+		BuildDependencies(dependencies);
+
+		//Passes writing outputs are needed, as is everything they depend on.
+		std::vector<PassId> stack;
+		for(PassId passIx = 0; passIx < m_passes.size(); ++passIx)
+		{
+			Pass &pass = m_passes[passIx];
+			pass.bLive = false;
+			for(size_t writeIx = 0; writeIx < pass.writes.size(); ++writeIx)
+			{
+				if(m_resources[pass.writes[writeIx]].bOutput)
+					pass.bLive = true;
+			}
+
+			if(pass.bLive)
+				stack.push_back(passIx);
+		}
+
+		while(!stack.empty())
+		{
+			PassId passIx = stack.back();
+			stack.pop_back();
+			for(size_t depIx = 0; depIx < dependencies[passIx].size(); ++depIx)
+			{
+				Pass &dependency = m_passes[dependencies[passIx][depIx]];
+				if(!dependency.bLive)
+				{
+					dependency.bLive = true;
+					stack.push_back(dependencies[passIx][depIx]);
+				}
+			}
+		}
+
+		for(PassId passIx = 0; passIx < m_passes.size(); ++passIx)
+		{
+			const Pass &pass = m_passes[passIx];
+			if(!pass.bLive)
+				continue;
+
+			for(size_t readIx = 0; readIx < pass.reads.size(); ++readIx)
+			{
+				const Resource &resource = m_resources[pass.reads[readIx]];
+				bool written = false;
+				for(PassId writerIx = 0; writerIx < m_passes.size() && !written; ++writerIx)
+					written = writerIx != passIx && PassWrites(writerIx, pass.reads[readIx]);
+
+				if(!written && !resource.bImported)
+				{
+					throw std::runtime_error("The pass \"" + pass.name + "\" reads the target \"" +
+						resource.name + "\", but no pass writes it.");
+				}
+			}
+		}
+
+		//Topological order. Among the passes that are ready, the first added runs first.
+		std::vector<size_t> waitingOn(m_passes.size(), 0);
+		std::vector<std::vector<PassId> > dependents(m_passes.size());
+		for(PassId passIx = 0; passIx < m_passes.size(); ++passIx)
+		{
+			if(!m_passes[passIx].bLive)
+				continue;
+
+			waitingOn[passIx] = dependencies[passIx].size();
+			for(size_t depIx = 0; depIx < dependencies[passIx].size(); ++depIx)
+				dependents[dependencies[passIx][depIx]].push_back(passIx);
+		}
+
+		m_order.clear();
+		std::vector<bool> scheduled(m_passes.size(), false);
+		for(;;)
+		{
+			PassId next = (PassId)m_passes.size();
+			for(PassId passIx = 0; passIx < m_passes.size(); ++passIx)
+			{
+				if(m_passes[passIx].bLive && !scheduled[passIx] && waitingOn[passIx] == 0)
+				{
+					next = passIx;
+					break;
+				}
+			}
+
+			if(next == m_passes.size())
+				break;
+
+			scheduled[next] = true;
+			m_order.push_back(next);
+			for(size_t depIx = 0; depIx < dependents[next].size(); ++depIx)
+				--waitingOn[dependents[next][depIx]];
+		}
+
+		for(PassId passIx = 0; passIx < m_passes.size(); ++passIx)
+		{
+			if(m_passes[passIx].bLive && !scheduled[passIx])
+				throw std::runtime_error("The pass \"" + m_passes[passIx].name + "\" is part of a cycle.");
+		}
+
+		AssignPhysicalTargets();
+		m_bCompiled = true;
+	}
+
+	//Greedy interval allocation: each target, in order of first use, takes the first texture
+	//of its description that is free by then.
+	void RenderGraph::AssignPhysicalTargets()
+	{
+		std::vector<Lifetime> lifetimes;
+		for(ResourceId resIx = 0; resIx < m_resources.size(); ++resIx)
+		{
+			m_resources[resIx].physical = -1;
+			if(m_resources[resIx].bImported)
+				continue;
+
+			Lifetime lifetime;
+			lifetime.resource = resIx;
+			lifetime.first = m_order.size();
+			lifetime.last = 0;
+			for(size_t orderIx = 0; orderIx < m_order.size(); ++orderIx)
+			{
+				if(PassReads(m_order[orderIx], resIx) || PassWrites(m_order[orderIx], resIx))
+				{
+					lifetime.first = std::min(lifetime.first, orderIx);
+					lifetime.last = orderIx;
+				}
+			}
+
+			//Outputs must survive the whole frame.
+			if(m_resources[resIx].bOutput)
+				lifetime.last = m_order.size();
+
+			if(lifetime.first < m_order.size())
+				lifetimes.push_back(lifetime);
+		}
+
+		std::stable_sort(lifetimes.begin(), lifetimes.end());
+
+		m_physicalDescs.clear();
+		std::vector<size_t> freeAfter;
+		for(size_t lifeIx = 0; lifeIx < lifetimes.size(); ++lifeIx)
+		{
+			const Lifetime &lifetime = lifetimes[lifeIx];
+			Resource &resource = m_resources[lifetime.resource];
+
+			for(size_t physIx = 0; physIx < m_physicalDescs.size(); ++physIx)
+			{
+				if(freeAfter[physIx] < lifetime.first && m_physicalDescs[physIx] == resource.desc)
+				{
+					resource.physical = (int)physIx;
+					break;
+				}
+			}
+
+			if(resource.physical == -1)
+			{
+				resource.physical = (int)m_physicalDescs.size();
+				m_physicalDescs.push_back(resource.desc);
+				freeAfter.push_back(0);
+			}
+
+			freeAfter[resource.physical] = lifetime.last;
+		}
+	}
+
+	bool RenderGraph::IsPassCulled( PassId pass ) const
+	{
+		return !m_passes.at(pass).bLive;
+	}
+
+	int RenderGraph::GetPhysicalTarget( ResourceId resource ) const
+	{
+		return m_resources.at(resource).physical;
+	}
+
+	size_t RenderGraph::GetTransientBytes() const
+	{
+		size_t bytes = 0;
+		for(size_t physIx = 0; physIx < m_physicalDescs.size(); ++physIx)
+		{
+			const RenderTargetDesc &desc = m_physicalDescs[physIx];
+			bytes += (size_t)desc.width * desc.height * GetBytesPerPixel(desc.format);
+		}
+
+		return bytes;
+	}
+
+	size_t RenderGraph::GetUnaliasedBytes() const
+	{
+		size_t bytes = 0;
+		for(size_t resIx = 0; resIx < m_resources.size(); ++resIx)
+		{
+			const Resource &resource = m_resources[resIx];
+			if(resource.physical != -1)
+				bytes += (size_t)resource.desc.width * resource.desc.height * GetBytesPerPixel(resource.desc.format);
+		}
+
+		return bytes;
+	}
+
+	size_t RenderGraph::GetBytesPerPixel( GLenum format )
+	{
+		switch(format)
+		{
+		case GL_R8:
+			return 1;
+		case GL_RG8:
+		case GL_R16F:
+		case GL_DEPTH_COMPONENT16:
+			return 2;
+		case GL_RGBA8:
+		case GL_SRGB8_ALPHA8:
+		case GL_RGB10_A2:
+		case GL_R11F_G11F_B10F:
+		case GL_RG16F:
+		case GL_R32F:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32:
+		case GL_DEPTH_COMPONENT32F:
+		case GL_DEPTH24_STENCIL8:
+			return 4;
+		case GL_RGBA16F:
+		case GL_RG32F:
+		case GL_DEPTH32F_STENCIL8:
+			return 8;
+		case GL_RGBA32F:
+			return 16;
+		default:
+			throw std::runtime_error("Unsupported render target format.");
+		}
+	}
+
+	//Textures are matched to physical targets by description, so a recompile that keeps the
+	//same targets makes nothing new.
+	void RenderGraph::CreateTextures()
+	{
+		std::vector<GLuint> textures(m_physicalDescs.size(), 0);
+		std::vector<bool> used(m_textures.size(), false);
+		for(size_t physIx = 0; physIx < m_physicalDescs.size(); ++physIx)
+		{
+			for(size_t texIx = 0; texIx < m_textures.size(); ++texIx)
+			{
+				if(!used[texIx] && m_textureDescs[texIx] == m_physicalDescs[physIx])
+				{
+					used[texIx] = true;
+					textures[physIx] = m_textures[texIx];
+					break;
+				}
+			}
+		}
+
+		for(size_t texIx = 0; texIx < m_textures.size(); ++texIx)
+		{
+			if(!used[texIx])
+				glDeleteTextures(1, &m_textures[texIx]);
+		}
+
+		for(size_t physIx = 0; physIx < m_physicalDescs.size(); ++physIx)
+		{
+			if(textures[physIx])
+				continue;
+
+			const RenderTargetDesc &desc = m_physicalDescs[physIx];
+			GLenum format = GL_RGBA;
+			GLenum type = GL_UNSIGNED_BYTE;
+			if(IsDepthStencilFormat(desc.format))
+			{
+				format = GL_DEPTH_STENCIL;
+				type = GL_UNSIGNED_INT_24_8;
+			}
+			else if(IsDepthFormat(desc.format))
+			{
+				format = GL_DEPTH_COMPONENT;
+				type = GL_FLOAT;
+			}
+
+			glGenTextures(1, &textures[physIx]);
+			glBindTexture(GL_TEXTURE_2D, textures[physIx]);
+			glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0, format, type, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		m_textures.swap(textures);
+		m_textureDescs = m_physicalDescs;
+	}
+
+	void RenderGraph::Execute()
+	{
+		PROFILE_SCOPE("RenderGraph::Execute");
+		if(!m_bCompiled)
+			Compile();
+
+		CreateTextures();
+		if(!m_fbo)
+			glGenFramebuffers(1, &m_fbo);
+
+		for(size_t orderIx = 0; orderIx < m_order.size(); ++orderIx)
+		{
+			const Pass &pass = m_passes[m_order[orderIx]];
+
+			bool bDefaultFramebuffer = false;
+			std::vector<GLenum> drawBuffers;
+			glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+			for(GLenum attachIx = 0; attachIx < 8; ++attachIx)
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + attachIx, GL_TEXTURE_2D, 0, 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+
+			RenderTargetDesc viewport;
+			for(size_t writeIx = 0; writeIx < pass.writes.size(); ++writeIx)
+			{
+				const Resource &resource = m_resources[pass.writes[writeIx]];
+				viewport = resource.desc;
+				if(resource.bImported && resource.importedTexture == 0)
+				{
+					bDefaultFramebuffer = true;
+					continue;
+				}
+
+				GLuint texture = GetTexture(pass.writes[writeIx]);
+				if(IsDepthStencilFormat(resource.desc.format))
+					glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+				else if(IsDepthFormat(resource.desc.format))
+					glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+				else
+				{
+					GLenum attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+					glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+					drawBuffers.push_back(attachment);
+				}
+			}
+
+			if(bDefaultFramebuffer)
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			else if(drawBuffers.empty())
+				glDrawBuffer(GL_NONE);
+			else
+				glDrawBuffers((GLsizei)drawBuffers.size(), &drawBuffers[0]);
+
+			glViewport(0, 0, viewport.width, viewport.height);
+			if(pass.execute)
+				pass.execute(*this);
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	GLuint RenderGraph::GetTexture( ResourceId resource ) const
+	{
+		const Resource &res = m_resources.at(resource);
+		if(res.bImported)
+			return res.importedTexture;
+		if(res.physical == -1 || (size_t)res.physical >= m_textures.size())
+			return 0;
+		return m_textures[res.physical];
+	}
+}
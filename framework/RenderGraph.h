@@ -0,0 +1,142 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_RENDER_GRAPH_H
+#define FRAMEWORK_RENDER_GRAPH_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace Framework
+{
+	struct RenderTargetDesc
+	{
+		RenderTargetDesc() : width(0), height(0), format(0) {}
+		RenderTargetDesc(int _width, int _height, GLenum _format)
+			: width(_width), height(_height), format(_format) {}
+
+		bool operator==(const RenderTargetDesc &other) const
+		{
+			return width == other.width && height == other.height && format == other.format;
+		}
+
+		int width;
+		int height;
+		GLenum format;		//A sized internal format, such as GL_RGBA16F or GL_DEPTH_COMPONENT24.
+	};
+
+	/**
+	A frame's passes, described by the render targets they read and write.
+
+	Each frame, passes and targets are added, then Compile works out the rest:
+	- The order passes run in. A pass that reads a target runs after every pass that writes it.
+	A pass that both reads and writes a target, such as one that blends into it, runs after the
+	passes that only write it. Passes that write the same target otherwise keep the order they
+	were added in.
+	- Which passes are needed. Only passes that write an output, directly or through the
+	targets other needed passes read, are kept. Imported targets are always outputs.
+	- Where each transient target lives. Targets with the same description whose lifetimes do
+	not overlap share one texture.
+
+	Compile makes no OpenGL calls, so it can be checked without a context. Execute makes the
+	textures, which are kept between frames, and runs the passes with each one's written
+	targets attached to a framebuffer.
+	**/
+	class RenderGraph
+	{
+	public:
+		typedef unsigned int ResourceId;
+		typedef unsigned int PassId;
+
+		//Called during Execute, with the pass's framebuffer bound and the viewport set.
+		typedef std::function<void(const RenderGraph &)> PassFunc;
+
+		RenderGraph();
+		~RenderGraph();
+
+		//Removes every pass and target. The textures are kept for the next Compile to reuse.
+		void Clear();
+
+		ResourceId AddTarget(const std::string &name, const RenderTargetDesc &desc);
+
+		//A texture of 0 means the default framebuffer. Imported targets are never aliased.
+		ResourceId ImportTarget(const std::string &name, const RenderTargetDesc &desc, GLuint texture);
+
+		//Keeps the passes that write this target, even though no pass reads it.
+		void MarkOutput(ResourceId resource);
+
+		PassId AddPass(const std::string &name, const PassFunc &execute);
+		void Read(PassId pass, ResourceId resource);
+		void Write(PassId pass, ResourceId resource);
+
+		//Throws if the passes form a cycle, or a needed pass reads a target nothing writes.
+		void Compile();
+
+		//Only the needed passes, in the order they run.
+		const std::vector<PassId> &GetPassOrder() const {return m_order;}
+		bool IsPassCulled(PassId pass) const;
+
+		//The texture a transient target was given, shared with other targets. -1 for an
+		//imported target, or one no needed pass uses.
+		int GetPhysicalTarget(ResourceId resource) const;
+		size_t GetPhysicalTargetCount() const {return m_physicalDescs.size();}
+
+		//Memory for the transient targets, with and without aliasing.
+		size_t GetTransientBytes() const;
+		size_t GetUnaliasedBytes() const;
+
+		//Runs the compiled passes. Must be called on the GL thread.
+		void Execute();
+
+		//A target's texture. Valid during Execute, and afterwards until the next Execute.
+		GLuint GetTexture(ResourceId resource) const;
+
+		static size_t GetBytesPerPixel(GLenum format);
+
+	private:
+		struct Resource
+		{
+			std::string name;
+			RenderTargetDesc desc;
+			bool bImported;
+			bool bOutput;
+			GLuint importedTexture;
+			int physical;			//Set by Compile.
+		};
+
+		struct Pass
+		{
+			std::string name;
+			PassFunc execute;
+			std::vector<ResourceId> reads;
+			std::vector<ResourceId> writes;
+			bool bLive;				//Set by Compile.
+		};
+
+		std::vector<Resource> m_resources;
+		std::vector<Pass> m_passes;
+
+		std::vector<PassId> m_order;
+		std::vector<RenderTargetDesc> m_physicalDescs;
+		bool m_bCompiled;
+
+		//GL objects, owned across frames. Parallel to m_textureDescs.
+		std::vector<GLuint> m_textures;
+		std::vector<RenderTargetDesc> m_textureDescs;
+		GLuint m_fbo;
+
+		bool PassReads(PassId pass, ResourceId resource) const;
+		bool PassWrites(PassId pass, ResourceId resource) const;
+		void BuildDependencies(std::vector<std::vector<PassId> > &dependencies) const;
+		void AssignPhysicalTargets();
+		void CreateTextures();
+
+		//Prevent copying.
+		RenderGraph(const RenderGraph &);
+		RenderGraph &operator=(const RenderGraph &);
+	};
+}
+
+#endif //FRAMEWORK_RENDER_GRAPH_H
@@ -12,6 +12,7 @@
 #include <algorithm>
 #include <memory>
 #include <ctype.h>
+#include <string.h>
 
 #include <istream>
 #include <fstream>
@@ -22,10 +23,18 @@
 #include "Scene.h"
 #include "SceneBinders.h"
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "SlotMap.h"
+#include "SceneSnapshot.h"
+#include "FileWatcher.h"
+#include "WorkerPool.h"
+#include "OcclusionCuller.h"
+#include "CommandList.h"
+#include "Bvh.h"
+#include "FrameStats.h"
+#include "Profiler.h"
 #include <glutil/Shader.h>
 
-#include "rapidxml.hpp"
-#include "rapidxml_helpers.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -33,48 +42,26 @@
 #include <glimg/glimg.h>
 
 
-#define PARSE_THROW(cond, message)\
-	if(!(cond))\
-		throw std::runtime_error(message);
-
-
 namespace Framework
 {
-	using rapidxml::xml_document;
-	using rapidxml::xml_node;
-	using rapidxml::xml_attribute;
-	using rapidxml::make_string;
-
-
 	namespace
 	{
-		void ThrowAttrib(const xml_attribute<> &attrib, const std::string &msg)
-		{
-			std::string name = make_string(attrib);
-			throw std::runtime_error("Attribute " + name + " " + msg);
-		}
-
-		template<typename PairType>
-		void DeleteSecond(PairType &value)
-		{
-			delete value.second;
-			value.second = NULL;
-		}
-
 		template<typename DeleteType>
 		void DeleteThis(DeleteType &value) { delete value; }
 
 		struct BindBinder
 		{
-			BindBinder(GLuint prog) : m_prog(prog){}
-			void operator()(const StateBinder *pState) const {pState->BindState(m_prog);}
+			BindBinder(CommandList &cmds, GLuint prog) : m_cmds(cmds), m_prog(prog){}
+			void operator()(const StateBinder *pState) const {m_cmds.BindState(pState, m_prog);}
+			CommandList &m_cmds;
 			GLuint m_prog;
 		};
 
 		struct UnbindBinder
 		{
-			UnbindBinder(GLuint prog) : m_prog(prog){}
-			void operator()(const StateBinder *pState) const {pState->UnbindState(m_prog);}
+			UnbindBinder(CommandList &cmds, GLuint prog) : m_cmds(cmds), m_prog(prog){}
+			void operator()(const StateBinder *pState) const {m_cmds.UnbindState(pState, m_prog);}
+			CommandList &m_cmds;
 			GLuint m_prog;
 		};
 
@@ -91,13 +78,156 @@ namespace Framework
 
 			return ext;
 		}
+
+		//True if the two strings, each from its own snapshot, are the same.
+		bool SameString(const snapshot::SnapshotView &lhsView, const snapshot::StringRef &lhs,
+			const snapshot::SnapshotView &rhsView, const snapshot::StringRef &rhs)
+		{
+			return lhs.length == rhs.length &&
+				memcmp(lhsView.String(lhs), rhsView.String(rhs), lhs.length) == 0;
+		}
+	}
+
+	//Reads and decodes an image file. This touches no GL state, so it may run on any thread.
+	glimg::ImageSet *DecodeTextureFile(const std::string &pathname)
+	{
+		PROFILE_SCOPE("DecodeTextureFile");
+		std::string ext = GetExtension(pathname);
+		if(ext == "dds")
+			return glimg::loaders::dds::LoadFromFile(pathname.c_str());
+		else
+			return glimg::loaders::stb::LoadFromFile(pathname.c_str());
+	}
+
+	//Reads a scene file of either kind as a snapshot, cooking XML in memory. The scene keeps its
+	//own copy rather than the mapping, since the file may be rewritten while it is watched.
+	void ReadSceneFile(const std::string &pathname, const std::string &filename,
+		std::vector<unsigned char> &snapshotData)
+	{
+		MappedFile sceneFile(pathname);
+		if(snapshot::IsSnapshot(sceneFile.GetData(), sceneFile.GetSize()))
+			snapshotData.assign(sceneFile.GetData(), sceneFile.GetData() + sceneFile.GetSize());
+		else
+		{
+			snapshot::CookFromXml(reinterpret_cast<const char *>(sceneFile.GetData()),
+				sceneFile.GetSize(), filename, snapshotData);
+		}
 	}
 
+	//Decodes image files on the worker pool and hands them back to the GL thread in the order
+	//they finish, so each upload overlaps the decodes still running.
+	class TextureDecodeQueue
+	{
+	public:
+		TextureDecodeQueue()
+			: m_outstanding(0)
+			, m_group(GetWorkerPool())
+		{}
+
+		~TextureDecodeQueue()
+		{
+			m_group.Wait();
+			for(size_t resultIx = 0; resultIx < m_results.size(); ++resultIx)
+				delete m_results[resultIx].pImageSet;
+		}
+
+		//The pathname must outlive the queue.
+		void Add(size_t index, const char *pathname)
+		{
+			++m_outstanding;
+			m_group.Run([this, index, pathname]()
+			{
+				DecodedTexture result;
+				result.index = index;
+				result.pImageSet = NULL;
+				try
+				{
+					result.pImageSet = DecodeTextureFile(pathname);
+				}
+				catch(...)
+				{
+					result.error = std::current_exception();
+				}
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_results.push_back(result);
+				m_resultReady.notify_one();
+			});
+		}
+
+		//Blocks until another image is decoded, helping with the decoding meanwhile.
+		//Returns false once every image has been returned. Rethrows any decoding error.
+		bool WaitNext(size_t &index, std::auto_ptr<glimg::ImageSet> &pImageSet)
+		{
+			if(m_outstanding == 0)
+				return false;
+
+			DecodedTexture result;
+			for(;;)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if(!m_results.empty())
+					{
+						result = m_results.front();
+						m_results.pop_front();
+						break;
+					}
+				}
+
+				if(!m_group.RunPendingTask())
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					while(m_results.empty())
+						m_resultReady.wait(lock);
+				}
+			}
+
+			--m_outstanding;
+			if(result.error)
+				std::rethrow_exception(result.error);
+
+			index = result.index;
+			pImageSet.reset(result.pImageSet);
+			return true;
+		}
+
+	private:
+		struct DecodedTexture
+		{
+			size_t index;
+			glimg::ImageSet *pImageSet;
+			std::exception_ptr error;
+		};
+
+		size_t m_outstanding;
+		std::mutex m_mutex;
+		std::condition_variable m_resultReady;
+		std::deque<DecodedTexture> m_results;
+
+		TaskGroup m_group;	//Last, so that its tasks finish before anything else goes away.
+	};
+
+	//Scene resources get their names and files from their records in the scene's snapshot.
+	//A resource that a reload keeps is rebound to its record in the new snapshot.
 	class SceneMesh
 	{
 	public:
-		SceneMesh(const std::string &filename)
-			: m_pMesh(new Framework::Mesh(filename))
+		SceneMesh(const snapshot::SnapshotView &view, const snapshot::MeshRecord &meshRec)
+			: m_view(view)
+			, m_pRecord(&meshRec)
+			, m_pMesh(NULL)
+		{
+			ParsedMesh parsed(GetFilename(), GetPathname());
+			m_pMesh = new Framework::Mesh(parsed);
+		}
+
+		//Only creates the GL objects, for a mesh that was parsed elsewhere.
+		SceneMesh(const snapshot::SnapshotView &view, const snapshot::MeshRecord &meshRec,
+			ParsedMesh &parsed)
+			: m_view(view)
+			, m_pRecord(&meshRec)
+			, m_pMesh(new Framework::Mesh(parsed))
 		{}
 
 		~SceneMesh()
@@ -111,31 +241,59 @@ namespace Framework
 		}
 
 		Mesh *GetMesh() {return m_pMesh;}
+		const Mesh *GetMesh() const {return m_pMesh;}
+
+		const MeshBvh &GetBvh() const
+		{
+			if(!m_pBvh.get())
+				m_pBvh.reset(new MeshBvh(m_pMesh->GetGeometry()));
+			return *m_pBvh;
+		}
+
+		const char *GetName() const {return m_view.String(m_pRecord->name);}
+		const char *GetFilename() const {return m_view.String(m_pRecord->file);}
+		const char *GetPathname() const {return m_view.String(m_pRecord->path);}
+
+		//True if the record would load the same mesh.
+		bool Matches(const snapshot::SnapshotView &view, const snapshot::MeshRecord &meshRec) const
+		{
+			return SameString(m_view, m_pRecord->path, view, meshRec.path) &&
+				SameString(m_view, m_pRecord->file, view, meshRec.file);
+		}
+
+		void Rebind(const snapshot::SnapshotView &view, const snapshot::MeshRecord &meshRec)
+		{
+			m_view = view;
+			m_pRecord = &meshRec;
+		}
+
+		bool UsesFile(const std::string &pathname) const {return pathname == GetPathname();}
+		void GetWatchedFiles(std::set<std::string> &pathnames) const {pathnames.insert(GetPathname());}
+
+		//The Mesh object stays the same, so pointers from FindMesh remain valid.
+		void Reload()
+		{
+			m_pMesh->Reload();
+			m_pBvh.reset();
+		}
 
 	private:
+		snapshot::SnapshotView m_view;
+		const snapshot::MeshRecord *m_pRecord;
 		Mesh *m_pMesh;
+		mutable std::auto_ptr<MeshBvh> m_pBvh;	//Built on first pick.
 	};
 
 	class SceneTexture
 	{
 	public:
-		SceneTexture(const std::string &filename, unsigned int creationFlags)
+		//Uploads an image that was already decoded from the file.
+		SceneTexture(const snapshot::SnapshotView &view, const snapshot::TextureRecord &texRec,
+			const glimg::ImageSet *pImageSet)
+			: m_view(view)
+			, m_pRecord(&texRec)
 		{
-			std::string pathname(Framework::FindFileOrThrow(filename));
-
-			std::auto_ptr<glimg::ImageSet> pImageSet;
-			std::string ext = GetExtension(pathname);
-			if(ext == "dds")
-			{
-				pImageSet.reset(glimg::loaders::dds::LoadFromFile(pathname.c_str()));
-			}
-			else
-			{
-				pImageSet.reset(glimg::loaders::stb::LoadFromFile(pathname.c_str()));
-			}
-
-			m_texObj = glimg::CreateTexture(pImageSet.get(), creationFlags);
-			m_texType = glimg::GetTextureType(pImageSet.get(), creationFlags);
+			UploadTexture(pImageSet, m_texObj, m_texType);
 		}
 
 		~SceneTexture()
@@ -146,19 +304,82 @@ namespace Framework
 		GLuint GetTexture() const {return m_texObj;}
 		GLenum GetType() const {return m_texType;}
 
+		const char *GetName() const {return m_view.String(m_pRecord->name);}
+		const char *GetPathname() const {return m_view.String(m_pRecord->path);}
+
+		//True if the record would load the same texture.
+		bool Matches(const snapshot::SnapshotView &view, const snapshot::TextureRecord &texRec) const
+		{
+			return SameString(m_view, m_pRecord->path, view, texRec.path) && m_pRecord->flags == texRec.flags;
+		}
+
+		void Rebind(const snapshot::SnapshotView &view, const snapshot::TextureRecord &texRec)
+		{
+			m_view = view;
+			m_pRecord = &texRec;
+		}
+
+		bool UsesFile(const std::string &pathname) const {return pathname == GetPathname();}
+		void GetWatchedFiles(std::set<std::string> &pathnames) const {pathnames.insert(GetPathname());}
+
+		//The current texture is kept if the new one fails to load.
+		void Reload()
+		{
+			std::auto_ptr<glimg::ImageSet> pImageSet(DecodeTextureFile(GetPathname()));
+
+			GLuint texObj = 0;
+			GLenum texType = 0;
+			UploadTexture(pImageSet.get(), texObj, texType);
+
+			glDeleteTextures(1, &m_texObj);
+			m_texObj = texObj;
+			m_texType = texType;
+		}
+
 	private:
+		snapshot::SnapshotView m_view;
+		const snapshot::TextureRecord *m_pRecord;
+
 		GLuint m_texObj;
 		GLenum m_texType;
+
+		void UploadTexture(const glimg::ImageSet *pImageSet, GLuint &texObj, GLenum &texType) const
+		{
+			PROFILE_SCOPE("SceneTexture::UploadTexture");
+			unsigned int creationFlags = 0;
+			if(m_pRecord->flags & snapshot::TEX_SRGB)
+				creationFlags |= glimg::FORCE_SRGB_COLORSPACE_FMT;
+
+			texObj = glimg::CreateTexture(pImageSet, creationFlags);
+			texType = glimg::GetTextureType(pImageSet, creationFlags);
+
+			if(!g_pFrameCounters)
+				return;
+
+			for(int mipmapIx = 0; mipmapIx < pImageSet->GetMipmapCount(); ++mipmapIx)
+			{
+				for(int arrayIx = 0; arrayIx < pImageSet->GetArrayCount(); ++arrayIx)
+				{
+					for(int faceIx = 0; faceIx < pImageSet->GetFaceCount(); ++faceIx)
+						CountUpload(pImageSet->GetImage(mipmapIx, arrayIx, faceIx).GetImageByteSize());
+				}
+			}
+		}
 	};
 
 	class SceneProgram
 	{
 	public:
-		SceneProgram(GLuint programObj, GLint matrixLoc, GLint normalMatLoc)
-			: m_programObj(programObj)
-			, m_matrixLoc(matrixLoc)
-			, m_normalMatLoc(normalMatLoc)
-		{}
+		SceneProgram(const snapshot::SnapshotView &view, const snapshot::ProgramRecord &progRec)
+			: m_view(view)
+			, m_pRecord(&progRec)
+			, m_programObj(0)
+			, m_matrixLoc(-1)
+			, m_normalMatLoc(-1)
+			, m_lodFadeLoc(-1)
+		{
+			m_programObj = BuildProgram(m_matrixLoc, m_normalMatLoc, m_lodFadeLoc);
+		}
 
 		~SceneProgram()
 		{
@@ -167,15 +388,190 @@ namespace Framework
 
 		GLint GetMatrixLoc() const {return m_matrixLoc;}
 		GLint GetNormalMatLoc() const {return m_normalMatLoc;}
+		GLint GetLodFadeLoc() const {return m_lodFadeLoc;}
 
 		void UseProgram() const {glUseProgram(m_programObj);}
 
 		GLuint GetProgram() const {return m_programObj;}
 
+		const char *GetName() const {return m_view.String(m_pRecord->name);}
+
+		//True if the record would build the same program.
+		bool Matches(const snapshot::SnapshotView &view, const snapshot::ProgramRecord &progRec) const
+		{
+			const snapshot::ProgramRecord &currRec = *m_pRecord;
+			if(!SameString(m_view, currRec.vertPath, view, progRec.vertPath) ||
+				!SameString(m_view, currRec.fragPath, view, progRec.fragPath) ||
+				!SameString(m_view, currRec.geomPath, view, progRec.geomPath) ||
+				!SameString(m_view, currRec.matrixUnif, view, progRec.matrixUnif) ||
+				!SameString(m_view, currRec.normalMatrixUnif, view, progRec.normalMatrixUnif) ||
+				!SameString(m_view, currRec.lodFadeUnif, view, progRec.lodFadeUnif) ||
+				currRec.blocks.count != progRec.blocks.count ||
+				currRec.samplers.count != progRec.samplers.count)
+			{
+				return false;
+			}
+
+			const snapshot::BlockBindingRecord *pCurrBlocks = m_view.Blocks(currRec);
+			const snapshot::BlockBindingRecord *pBlocks = view.Blocks(progRec);
+			for(unsigned int blockIx = 0; blockIx < progRec.blocks.count; ++blockIx)
+			{
+				if(pCurrBlocks[blockIx].bindPoint != pBlocks[blockIx].bindPoint ||
+					!SameString(m_view, pCurrBlocks[blockIx].blockName, view, pBlocks[blockIx].blockName))
+				{
+					return false;
+				}
+			}
+
+			const snapshot::SamplerBindingRecord *pCurrSamplers = m_view.Samplers(currRec);
+			const snapshot::SamplerBindingRecord *pSamplers = view.Samplers(progRec);
+			for(unsigned int splIx = 0; splIx < progRec.samplers.count; ++splIx)
+			{
+				if(pCurrSamplers[splIx].texUnit != pSamplers[splIx].texUnit ||
+					!SameString(m_view, pCurrSamplers[splIx].samplerName, view, pSamplers[splIx].samplerName))
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		void Rebind(const snapshot::SnapshotView &view, const snapshot::ProgramRecord &progRec)
+		{
+			m_view = view;
+			m_pRecord = &progRec;
+		}
+
+		bool UsesFile(const std::string &pathname) const
+		{
+			const snapshot::ProgramRecord &progRec = *m_pRecord;
+			return pathname == m_view.String(progRec.vertPath) || pathname == m_view.String(progRec.fragPath) ||
+				(progRec.geomPath.length != 0 && pathname == m_view.String(progRec.geomPath));
+		}
+
+		void GetWatchedFiles(std::set<std::string> &pathnames) const
+		{
+			const snapshot::ProgramRecord &progRec = *m_pRecord;
+			pathnames.insert(m_view.String(progRec.vertPath));
+			pathnames.insert(m_view.String(progRec.fragPath));
+			if(progRec.geomPath.length != 0)
+				pathnames.insert(m_view.String(progRec.geomPath));
+		}
+
+		//If the shaders no longer compile or link, the last good program stays in use.
+		void Reload()
+		{
+			GLint matrixLoc = -1;
+			GLint normalMatLoc = -1;
+			GLint lodFadeLoc = -1;
+			GLuint programObj = BuildProgram(matrixLoc, normalMatLoc, lodFadeLoc);
+
+			glDeleteProgram(m_programObj);
+			m_programObj = programObj;
+			m_matrixLoc = matrixLoc;
+			m_normalMatLoc = normalMatLoc;
+			m_lodFadeLoc = lodFadeLoc;
+		}
+
 	private:
+		snapshot::SnapshotView m_view;
+		const snapshot::ProgramRecord *m_pRecord;
+
 		GLuint m_programObj;
 		GLint m_matrixLoc;
 		GLint m_normalMatLoc;
+		GLint m_lodFadeLoc;
+
+		GLuint BuildProgram(GLint &matrixLoc, GLint &normalMatLoc, GLint &lodFadeLoc) const
+		{
+			const snapshot::ProgramRecord &progRec = *m_pRecord;
+			std::vector<GLuint> shaders;
+			GLuint program = 0;
+
+			try
+			{
+				shaders.push_back(LoadShaderFile(GL_VERTEX_SHADER, m_view.String(progRec.vertPath)));
+				shaders.push_back(LoadShaderFile(GL_FRAGMENT_SHADER, m_view.String(progRec.fragPath)));
+				if(progRec.geomPath.length != 0)
+					shaders.push_back(LoadShaderFile(GL_GEOMETRY_SHADER, m_view.String(progRec.geomPath)));
+				program = glutil::LinkProgram(shaders);
+			}
+			catch(std::exception &)
+			{
+				std::for_each(shaders.begin(), shaders.end(), glDeleteShader);
+				throw;
+			}
+
+			std::for_each(shaders.begin(), shaders.end(), glDeleteShader);
+
+			const char *matrixUnif = m_view.String(progRec.matrixUnif);
+			matrixLoc = glGetUniformLocation(program, matrixUnif);
+			if(matrixLoc == -1)
+			{
+				glDeleteProgram(program);
+				throw std::runtime_error(std::string("Could not find the matrix uniform ") + matrixUnif +
+					" in program " + GetName());
+			}
+
+			normalMatLoc = -1;
+			if(progRec.normalMatrixUnif.length != 0)
+			{
+				const char *normalMatrixUnif = m_view.String(progRec.normalMatrixUnif);
+				normalMatLoc = glGetUniformLocation(program, normalMatrixUnif);
+				if(normalMatLoc == -1)
+				{
+					glDeleteProgram(program);
+					throw std::runtime_error(std::string("Could not find the normal matrix uniform ") +
+						normalMatrixUnif + " in program " + GetName());
+				}
+			}
+
+			lodFadeLoc = -1;
+			if(progRec.lodFadeUnif.length != 0)
+			{
+				const char *lodFadeUnif = m_view.String(progRec.lodFadeUnif);
+				lodFadeLoc = glGetUniformLocation(program, lodFadeUnif);
+				if(lodFadeLoc == -1)
+				{
+					glDeleteProgram(program);
+					throw std::runtime_error(std::string("Could not find the level of detail fade uniform ") +
+						lodFadeUnif + " in program " + GetName());
+				}
+			}
+
+			const snapshot::BlockBindingRecord *pBlocks = m_view.Blocks(progRec);
+			for(unsigned int blockIx = 0; blockIx < progRec.blocks.count; ++blockIx)
+			{
+				const char *name = m_view.String(pBlocks[blockIx].blockName);
+				GLuint blockIndex = glGetUniformBlockIndex(program, name);
+				if(blockIndex == GL_INVALID_INDEX)
+				{
+					std::cout << "Warning: the uniform block " << name << " could not be found." << std::endl;
+					continue;
+				}
+
+				glUniformBlockBinding(program, blockIndex, pBlocks[blockIx].bindPoint);
+			}
+
+			const snapshot::SamplerBindingRecord *pSamplers = m_view.Samplers(progRec);
+			for(unsigned int splIx = 0; splIx < progRec.samplers.count; ++splIx)
+			{
+				const char *name = m_view.String(pSamplers[splIx].samplerName);
+				GLint samplerLoc = glGetUniformLocation(program, name);
+				if(samplerLoc == -1)
+				{
+					std::cout << "Warning: the sampler " << name << " could not be found." << std::endl;
+					continue;
+				}
+
+				glUseProgram(program);
+				glUniform1i(samplerLoc, pSamplers[splIx].texUnit);
+				glUseProgram(0);
+			}
+
+			return program;
+		}
 	};
 
 	struct Transform
@@ -195,46 +591,16 @@ namespace Framework
 			return ret;
 		}
 
+		bool operator==(const Transform &other) const
+		{
+			return m_orient == other.m_orient && m_scale == other.m_scale && m_trans == other.m_trans;
+		}
+
 		glm::fquat m_orient;
 		glm::vec3 m_scale;
 		glm::vec3 m_trans;
 	};
 
-	enum SamplerTypes
-	{
-		SPL_NEAREST,
-		SPL_LINEAR,
-		SPL_MIPMAP_NEAREST,
-		SPL_MIPMAP_LINEAR,
-		SPL_ANISOTROPIC,
-		SPL_HALF_ANISOTROPIC,
-
-		MAX_SAMPLERS,
-	};
-
-	SamplerTypes GetTypeFromName(const std::string &name)
-	{
-		const char *samplerNames[MAX_SAMPLERS] =
-		{
-			"nearest",
-			"linear",
-			"mipmap nearest",
-			"mipmap linear",
-			"anisotropic",
-			"half anisotropic",
-		};
-
-		const char **theName = std::find(samplerNames, samplerNames + MAX_SAMPLERS, name);
-
-		for(int spl = 0; spl < MAX_SAMPLERS; ++spl)
-		{
-			if(name == samplerNames[spl])
-				return SamplerTypes(spl);
-		}
-
-		throw std::runtime_error("Unknown sampler name: " + name);
-	}
-
 	void MakeSamplerObjects(std::vector<GLuint> &samplers)
 	{
 		samplers.resize(MAX_SAMPLERS);
@@ -279,16 +645,73 @@ namespace Framework
 		SamplerTypes sampler;
 	};
 
+	struct LodLevel
+	{
+		SceneMesh *pMesh;
+		float geometricError;
+	};
+
+	namespace
+	{
+		size_t CountTriangles(const SceneMesh *pMesh)
+		{
+			return pMesh->GetMesh()->GetGeometry().triangles.size() / 3;
+		}
+	}
+
 	class SceneNode
 	{
 	public:
-		SceneNode(SceneMesh *pMesh, SceneProgram *pProg, const glm::vec3 &nodePos,
-			const std::vector<TextureBinding> &texBindings)
-			: m_pMesh(pMesh)
-			, m_pProg(pProg)
-			, m_texBindings(texBindings)
+		SceneNode(const char *name, const Transform &fileTm)
+			: m_name(name)
+			, m_pMesh(NULL)
+			, m_pProg(NULL)
+			, m_bOccluder(false)
+			, m_currLod(0)
+			, m_prevLod(0)
+			, m_fadeFramesLeft(0)
+			, m_nodeTm(fileTm)
+			, m_fileTm(fileTm)
+		{}
+
+		//The first level is the node's own mesh.
+		void SetResources(const std::vector<LodLevel> &lods, SceneProgram *pProg,
+			const std::vector<TextureBinding> &texBindings, bool bOccluder)
 		{
-			m_nodeTm.m_trans = nodePos;
+			m_lods = lods;
+			m_pMesh = lods[0].pMesh;
+			m_pProg = pProg;
+			m_texBindings = texBindings;
+			m_bOccluder = bOccluder;
+
+			if(m_currLod >= m_lods.size())
+				m_currLod = m_lods.size() - 1;
+			m_fadeFramesLeft = 0;
+		}
+
+		//Only resets the transform if the scene file moved the node. That way, a reload
+		//for some other reason keeps whatever the program has done to the node.
+		void SetFileTransform(const Transform &fileTm)
+		{
+			if(m_fileTm == fileTm)
+				return;
+
+			m_fileTm = fileTm;
+			m_nodeTm = fileTm;
+		}
+
+		const char *GetName() const {return m_name;}
+
+		//The name lives in the scene's snapshot, so it moves when a reload replaces that.
+		void SetName(const char *name) {m_name = name;}
+
+		bool IsOccluder() const {return m_bOccluder;}
+		const MeshGeometry &GetGeometry() const {return m_pMesh->GetMesh()->GetGeometry();}
+		const MeshBvh &GetBvh() const {return m_pMesh->GetBvh();}
+
+		glm::mat4 GetModelMatrix() const
+		{
+			return m_nodeTm.GetMatrix() * m_objTm.GetMatrix();
 		}
 
 		void NodeSetScale( const glm::vec3 &scale )
@@ -308,612 +731,1105 @@ namespace Framework
 
 		glm::fquat NodeGetOrient() const {return m_nodeTm.m_orient;}
 
-		void SetNodeOrient(const glm::fquat &nodeOrient)
-		{
-			m_nodeTm.m_orient = glm::normalize(nodeOrient);
-		}
-
-		void SetNodeScale(const glm::vec3 &nodeScale)
-		{
-			m_nodeTm.m_scale = nodeScale;
-		}
-
-		void Render(const std::vector<GLuint> &samplers, glm::mat4 baseMat) const
+		//Makes no GL calls, so nodes can be recorded on any thread. Also picks this frame's
+		//level of detail, so each node must only be recorded by one thread at a time.
+		void Record(CommandList &cmds, const std::vector<GLuint> &samplers, glm::mat4 baseMat,
+			const LodSettings &lodSettings, SceneRenderStats &stats) const
 		{
 			baseMat *= m_nodeTm.GetMatrix();
 			glm::mat4 objMat = baseMat * m_objTm.GetMatrix();
+			const GLuint program = m_pProg->GetProgram();
+
+			UpdateLod(objMat, lodSettings);
+			const GLint fadeLoc = m_pProg->GetLodFadeLoc();
+			const bool bFading = m_fadeFramesLeft > 0;
 
-			m_pProg->UseProgram();
-			glUniformMatrix4fv(m_pProg->GetMatrixLoc(), 1, GL_FALSE, glm::value_ptr(objMat));
+			cmds.UseProgram(program);
+			cmds.SetMatrix4(m_pProg->GetMatrixLoc(), objMat);
 
 			if(m_pProg->GetNormalMatLoc() != -1)
 			{
 				glm::mat3 normMat = glm::mat3(glm::transpose(glm::inverse(objMat)));
-				glUniformMatrix3fv(m_pProg->GetNormalMatLoc(), 1, GL_FALSE,
-					glm::value_ptr(normMat));
+				cmds.SetMatrix3(m_pProg->GetNormalMatLoc(), normMat);
 			}
 
-			std::for_each(m_binders.begin(), m_binders.end(), BindBinder(m_pProg->GetProgram()));
+			std::for_each(m_binders.begin(), m_binders.end(), BindBinder(cmds, program));
 			for(size_t texIx = 0; texIx < m_texBindings.size(); ++texIx)
 			{
 				const TextureBinding &binding = m_texBindings[texIx];
-				glActiveTexture(GL_TEXTURE0 + binding.texUnit);
-				glBindTexture(binding.pTex->GetType(), binding.pTex->GetTexture());
-				glBindSampler(binding.texUnit, samplers[binding.sampler]);
+				cmds.BindTexture(binding.texUnit, binding.pTex->GetType(), binding.pTex->GetTexture(),
+					samplers[binding.sampler]);
 			}
 
-			m_pMesh->Render();
+			if(bFading)
+			{
+				float fade = m_fadeFramesLeft / float(lodSettings.fadeFrames + 1);
+				cmds.SetFloat(fadeLoc, fade);
+				cmds.DrawMesh(m_lods[m_prevLod].pMesh->GetMesh());
+				cmds.SetFloat(fadeLoc, -fade);
+				stats.triangles += CountTriangles(m_lods[m_prevLod].pMesh);
+				--m_fadeFramesLeft;
+			}
+			else if(fadeLoc != -1)
+				cmds.SetFloat(fadeLoc, 0.0f);
+
+			cmds.DrawMesh(m_lods[m_currLod].pMesh->GetMesh());
+			stats.triangles += CountTriangles(m_lods[m_currLod].pMesh);
+			stats.fullDetailTriangles += CountTriangles(m_pMesh);
+			++stats.nodesDrawn;
+
+			for(size_t texIx = 0; texIx < m_texBindings.size(); ++texIx)
+			{
+				const TextureBinding &binding = m_texBindings[texIx];
+				cmds.BindTexture(binding.texUnit, binding.pTex->GetType(), 0, 0);
+			}
+			std::for_each(m_binders.rbegin(), m_binders.rend(), UnbindBinder(cmds, program));
+			cmds.UseProgram(0);
+		}
+
+		void NodeOffset(const glm::vec3 &offset)
+		{
+			m_nodeTm.m_trans += offset;
+		}
+
+		void NodeSetTrans(const glm::vec3 &offset)
+		{
+			m_nodeTm.m_trans = offset;
+		}
+
+		void SetStateBinder(StateBinder *pBinder)
+		{
+			m_binders.push_back(pBinder);
+		}
+
+		GLuint GetProgram() const
+		{
+			return m_pProg->GetProgram();
+		}
+
+		void UpdateLod(const glm::mat4 &modelToCamera, const LodSettings &lodSettings) const
+		{
+			if(m_lods.size() < 2 || lodSettings.projectionScale <= 0.0f)
+			{
+				m_currLod = 0;
+				m_fadeFramesLeft = 0;
+				return;
+			}
+
+			//The finest level's bounding sphere stands in for all of them.
+			const MeshGeometry &geometry = GetGeometry();
+			glm::vec3 center = (geometry.boundsMin + geometry.boundsMax) * 0.5f;
+			float radius = glm::length(geometry.boundsMax - geometry.boundsMin) * 0.5f;
+			float scale = std::max(glm::length(glm::vec3(modelToCamera[0])),
+				std::max(glm::length(glm::vec3(modelToCamera[1])), glm::length(glm::vec3(modelToCamera[2]))));
+
+			float distance = glm::length(glm::vec3(modelToCamera * glm::vec4(center, 1.0f))) - radius * scale;
+			size_t lod = m_currLod;
+			if(distance <= 0.0f)
+				lod = 0;
+			else
+			{
+				//Pixels of error per unit of model-space error.
+				const float pixelsPerError = scale * lodSettings.projectionScale / distance;
+				const float refineAbove = lodSettings.maxPixelError * (1.0f + lodSettings.hysteresis);
+				const float coarsenBelow = lodSettings.maxPixelError * (1.0f - lodSettings.hysteresis);
+
+				while(lod > 0 && m_lods[lod].geometricError * pixelsPerError > refineAbove)
+					--lod;
+				while(lod + 1 < m_lods.size() && m_lods[lod + 1].geometricError * pixelsPerError <= coarsenBelow)
+					++lod;
+			}
+
+			if(lod == m_currLod)
+				return;
+
+			if(lodSettings.fadeFrames > 0 && m_pProg->GetLodFadeLoc() != -1)
+			{
+				m_prevLod = m_currLod;
+				m_fadeFramesLeft = lodSettings.fadeFrames;
+			}
+			m_currLod = lod;
+		}
+
+
+	private:
+		const char *m_name;
+
+		SceneMesh *m_pMesh;		//Unmanaged. We are deleted first, so these should always be real values.
+		SceneProgram *m_pProg;	//Unmanaged. We are deleted first, so these should always be real values.
+		bool m_bOccluder;
+
+		//Level 0 is m_pMesh, with no error. The level state changes while recording.
+		std::vector<LodLevel> m_lods;
+		mutable size_t m_currLod;
+		mutable size_t m_prevLod;
+		mutable int m_fadeFramesLeft;
+
+		std::vector<StateBinder*> m_binders;	//Unmanaged. These live beyond us.
+		std::vector<TextureBinding> m_texBindings;
+
+		Transform m_nodeTm;
+		Transform m_objTm;
+		Transform m_fileTm;		//As the scene file last placed it.
+	};
+
+	//Resources are owned through pointers, since nodes point to them directly.
+	//Nodes are stored by value, so rendering walks them contiguously.
+	typedef SlotMap<SceneMesh*> MeshTable;
+	typedef SlotMap<SceneTexture*> TextureTable;
+	typedef SlotMap<SceneProgram*> ProgramTable;
+	typedef SlotMap<SceneNode> NodeTable;
+
+	//A scene file's contents, loaded as far as they can be without OpenGL, and then the
+	//GL objects made from them so far. Whatever the scene does not take is deleted with this.
+	class ScenePreloadImpl
+	{
+	public:
+		ScenePreloadImpl(const std::string &filename, WorkerPool &pool)
+			: m_filename(filename)
+			, m_pathname(FindFileOrThrow(filename))
+			, m_nextUpload(0)
+		{
+			PROFILE_SCOPE("ScenePreload");
+			ReadSceneFile(m_pathname, filename, m_data);
+			m_view = snapshot::SnapshotView(&m_data[0], m_data.size());
+
+			const snapshot::Header &hdr = m_view.GetHeader();
+			m_parsedMeshes.resize(hdr.meshes.count, NULL);
+			m_meshes.resize(hdr.meshes.count, NULL);
+			m_images.resize(hdr.textures.count, NULL);
+			m_textures.resize(hdr.textures.count, NULL);
+
+			try
+			{
+				//Each task fills in its own element, so they need no locking. The strings
+				//point into m_data, which does not change.
+				TaskGroup group(pool);
+				for(unsigned int meshIx = 0; meshIx < hdr.meshes.count; ++meshIx)
+				{
+					const snapshot::MeshRecord &meshRec = m_view.Meshes()[meshIx];
+					const char *file = m_view.String(meshRec.file);
+					const char *path = m_view.String(meshRec.path);
+					group.Run([this, meshIx, file, path]()
+					{
+						m_parsedMeshes[meshIx] = new ParsedMesh(file, path);
+					});
+				}
+
+				for(unsigned int texIx = 0; texIx < hdr.textures.count; ++texIx)
+				{
+					const char *path = m_view.String(m_view.Textures()[texIx].path);
+					group.Run([this, texIx, path]()
+					{
+						m_images[texIx] = DecodeTextureFile(path);
+					});
+				}
+
+				group.Wait();
+			}
+			catch(...)
+			{
+				DeleteAll();
+				throw;
+			}
+		}
+
+		~ScenePreloadImpl()
+		{
+			DeleteAll();
+		}
+
+		//Makes the GL objects for the next mesh, or failing that the next texture.
+		//Returns false once everything has been made.
+		bool UploadNext()
+		{
+			PROFILE_SCOPE("ScenePreload::UploadNext");
+			if(m_nextUpload < m_meshes.size())
+			{
+				size_t meshIx = m_nextUpload;
+				m_meshes[meshIx] = new SceneMesh(m_view, m_view.Meshes()[meshIx], *m_parsedMeshes[meshIx]);
+				delete m_parsedMeshes[meshIx];
+				m_parsedMeshes[meshIx] = NULL;
+				++m_nextUpload;
+				return true;
+			}
 
-			for(size_t texIx = 0; texIx < m_texBindings.size(); ++texIx)
+			size_t texIx = m_nextUpload - m_meshes.size();
+			if(texIx < m_textures.size())
 			{
-				const TextureBinding &binding = m_texBindings[texIx];
-				glActiveTexture(GL_TEXTURE0 + binding.texUnit);
-				glBindTexture(binding.pTex->GetType(), 0);
-				glBindSampler(binding.texUnit, 0);
+				m_textures[texIx] = new SceneTexture(m_view, m_view.Textures()[texIx], m_images[texIx]);
+				delete m_images[texIx];
+				m_images[texIx] = NULL;
+				++m_nextUpload;
+				return true;
 			}
-			std::for_each(m_binders.rbegin(), m_binders.rend(), UnbindBinder(m_pProg->GetProgram()));
-			glUseProgram(0);
-		}
 
-		void NodeOffset(const glm::vec3 &offset)
-		{
-			m_nodeTm.m_trans += offset;
+			return false;
 		}
 
-		void NodeSetTrans(const glm::vec3 &offset)
-		{
-			m_nodeTm.m_trans = offset;
-		}
+		size_t GetUploadsLeft() const {return m_meshes.size() + m_textures.size() - m_nextUpload;}
 
-		void SetStateBinder(StateBinder *pBinder)
+		const std::string &GetFilename() const {return m_filename;}
+		const std::string &GetPathname() const {return m_pathname;}
+		const snapshot::SnapshotView &GetView() const {return m_view;}
+
+		//The scene takes the snapshot along with the resources, since they point into it.
+		std::vector<unsigned char> &GetData() {return m_data;}
+
+		//The caller owns these afterwards. Everything must have been uploaded.
+		SceneMesh *TakeMesh(size_t meshIx)
 		{
-			m_binders.push_back(pBinder);
+			SceneMesh *pMesh = m_meshes[meshIx];
+			m_meshes[meshIx] = NULL;
+			return pMesh;
 		}
 
-		GLuint GetProgram() const
+		SceneTexture *TakeTexture(size_t texIx)
 		{
-			return m_pProg->GetProgram();
+			SceneTexture *pTexture = m_textures[texIx];
+			m_textures[texIx] = NULL;
+			return pTexture;
 		}
 
-
 	private:
-		SceneMesh *m_pMesh;		//Unmanaged. We are deleted first, so these should always be real values.
-		SceneProgram *m_pProg;	//Unmanaged. We are deleted first, so these should always be real values.
+		std::string m_filename;
+		std::string m_pathname;
+		std::vector<unsigned char> m_data;		//Always a snapshot.
+		snapshot::SnapshotView m_view;
 
-		std::vector<StateBinder*> m_binders;	//Unmanaged. These live beyond us.
-		std::vector<TextureBinding> m_texBindings;
+		//Indexed like the snapshot's records.
+		std::vector<ParsedMesh *> m_parsedMeshes;
+		std::vector<SceneMesh *> m_meshes;
+		std::vector<glimg::ImageSet *> m_images;
+		std::vector<SceneTexture *> m_textures;
 
-		Transform m_nodeTm;
-		Transform m_objTm;
-	};
+		size_t m_nextUpload;	//Meshes first, then textures.
 
-	typedef std::map<std::string, SceneMesh*> MeshMap;
-	typedef std::map<std::string, SceneTexture*> TextureMap;
-	typedef std::map<std::string, SceneProgram*> ProgramMap;
-	typedef std::map<std::string, SceneNode*> NodeMap;
+		void DeleteAll()
+		{
+			std::for_each(m_parsedMeshes.begin(), m_parsedMeshes.end(), DeleteThis<ParsedMesh *>);
+			std::for_each(m_meshes.begin(), m_meshes.end(), DeleteThis<SceneMesh *>);
+			std::for_each(m_images.begin(), m_images.end(), DeleteThis<glimg::ImageSet *>);
+			std::for_each(m_textures.begin(), m_textures.end(), DeleteThis<SceneTexture *>);
+			m_parsedMeshes.clear();
+			m_meshes.clear();
+			m_images.clear();
+			m_textures.clear();
+		}
+
+		//Prevent copying.
+		ScenePreloadImpl(const ScenePreloadImpl &);
+		ScenePreloadImpl &operator=(const ScenePreloadImpl &);
+	};
 
 	class SceneImpl
 	{
 	private:
-		MeshMap m_meshes;
-		TextureMap m_textures;
-		ProgramMap m_progs;
-		NodeMap m_nodes;
+		std::string m_filename;
+		std::string m_pathname;
 
-		std::vector<SceneNode *> m_rootNodes;
+		MeshTable m_meshes;
+		TextureTable m_textures;
+		ProgramTable m_progs;
+		NodeTable m_nodes;
+
+		//The scene file, as a snapshot. Resources and nodes point into it, and Find* uses its
+		//name tables. Empty until the first commit.
+		std::vector<unsigned char> m_snapshot;
+		snapshot::SnapshotView m_view;
+
+		//The handles of the snapshot's records, indexed like them.
+		std::vector<Handle> m_meshHandles;
+		std::vector<Handle> m_textureHandles;
+		std::vector<Handle> m_progHandles;
+		std::vector<Handle> m_nodeHandles;
+
+		std::vector<Handle> m_rootNodes;
 
 		std::vector<GLuint> m_samplers;
 
+		//Only while hot reload is on, so that scenes which never reload hold no watches.
+		std::auto_ptr<FileWatcher> m_pWatcher;
+		std::set<std::string> m_watchedFiles;
+
+		//One per chunk of nodes, kept between frames so recording rarely allocates.
+		mutable std::vector<CommandList> m_commandLists;
+
+		LodSettings m_lodSettings;
+		mutable SceneRenderStats m_stats;
+
+		//Rebuilt by Pick after nodes move or the scene reloads.
+		mutable InstanceBvh m_pickBvh;
+		mutable std::vector<Handle> m_pickNodes;	//Indexed like the BVH's instances.
+		mutable bool m_bPickDirty;
+
 	public:
 		SceneImpl(const std::string &filename)
+			: m_filename(filename)
+			, m_pathname(FindFileOrThrow(filename))
+			, m_bPickDirty(true)
 		{
-			std::string pathname = FindFileOrThrow(filename);
+			PROFILE_SCOPE("Scene::Scene");
+			std::vector<unsigned char> snapshotData;
+			ReadSceneFile(m_pathname, m_filename, snapshotData);
+			CreateScene(snapshot::SnapshotView(&snapshotData[0], snapshotData.size()), snapshotData, NULL);
+		}
 
-			std::ifstream fileStream(pathname.c_str());
-			if(!fileStream.is_open())
-				throw std::runtime_error("Could not open the scene file.");
+		SceneImpl(ScenePreloadImpl &preload)
+			: m_filename(preload.GetFilename())
+			, m_pathname(preload.GetPathname())
+			, m_bPickDirty(true)
+		{
+			PROFILE_SCOPE("Scene::Scene(preload)");
+			while(preload.UploadNext())
+			{}
 
-			std::vector<char> fileData;
-			fileData.reserve(2000);
-			fileData.insert(fileData.end(), std::istreambuf_iterator<char>(fileStream),
-				std::istreambuf_iterator<char>());
-			fileData.push_back('\0');
+			CreateScene(preload.GetView(), preload.GetData(), &preload);
+		}
 
-			xml_document<> doc;
+		~SceneImpl()
+		{
+			glDeleteSamplers(m_samplers.size(), &m_samplers[0]);
+			m_samplers.clear();
 
-			try
-			{
-				doc.parse<0>(&fileData[0]);
-			}
-			catch(rapidxml::parse_error &e)
-			{
-				std::cout << filename << ": Parse error in scene file." << std::endl;
-				std::cout << e.what() << std::endl << e.where<char>() << std::endl;
-				throw;
-			}
+			DeleteResources();
+		}
 
-			xml_node<> *pSceneNode = doc.first_node("scene");
-			PARSE_THROW(pSceneNode, "Scene node not found in scene file.");
+		void Render(const glm::mat4 &cameraMatrix, CommandBackend &backend) const
+		{
+			m_stats = RecordNodes(cameraMatrix, NULL);
+			ExecuteCommands(backend);
+		}
 
-			try
-			{
-				ReadMeshes(*pSceneNode);
-				ReadTextures(*pSceneNode);
-				ReadPrograms(*pSceneNode);
-				ReadNodes(NULL, *pSceneNode);
-			}
-			catch(...)
+		size_t Render(const glm::mat4 &cameraMatrix, const glm::mat4 &cameraToClipMatrix,
+			OcclusionCuller &culler) const
+		{
+			culler.BeginFrame(cameraToClipMatrix * cameraMatrix);
+			for(NodeTable::const_iterator theIt = m_nodes.begin(); theIt != m_nodes.end(); ++theIt)
 			{
-				std::for_each(m_nodes.begin(), m_nodes.end(), DeleteSecond<typename NodeMap::value_type>);
-				std::for_each(m_progs.begin(), m_progs.end(), DeleteSecond<typename ProgramMap::value_type>);
-				std::for_each(m_textures.begin(), m_textures.end(), DeleteSecond<typename TextureMap::value_type>);
-				std::for_each(m_meshes.begin(), m_meshes.end(), DeleteSecond<typename MeshMap::value_type>);
-				throw;
+				if(theIt->IsOccluder())
+					culler.AddOccluder(theIt->GetGeometry(), theIt->GetModelMatrix());
 			}
+			culler.FinishOccluders();
 
-			MakeSamplerObjects(m_samplers);
+			m_stats = RecordNodes(cameraMatrix, &culler);
+			GLCommandBackend backend;
+			ExecuteCommands(backend);
+			return m_stats.nodesCulled;
 		}
 
-		~SceneImpl()
-		{
-			glDeleteSamplers(m_samplers.size(), &m_samplers[0]);
-			m_samplers.clear();
+		void SetLodSettings(const LodSettings &settings) {m_lodSettings = settings;}
+		const LodSettings &GetLodSettings() const {return m_lodSettings;}
 
-			std::for_each(m_nodes.begin(), m_nodes.end(), DeleteSecond<typename NodeMap::value_type>);
-			std::for_each(m_progs.begin(), m_progs.end(), DeleteSecond<typename ProgramMap::value_type>);
-			std::for_each(m_textures.begin(), m_textures.end(), DeleteSecond<typename TextureMap::value_type>);
-			std::for_each(m_meshes.begin(), m_meshes.end(), DeleteSecond<typename MeshMap::value_type>);
-		}
+		const SceneRenderStats &GetRenderStats() const {return m_stats;}
 
-		void Render(const glm::mat4 &cameraMatrix) const
+		bool Pick(const glm::vec3 &rayOrigin, const glm::vec3 &rayDirection, ScenePick &pick) const
 		{
-			for(NodeMap::const_iterator theIt = m_nodes.begin();
-				theIt != m_nodes.end();
-				++theIt)
+			PROFILE_SCOPE("Scene::Pick");
+			if(m_bPickDirty)
 			{
-				theIt->second->Render(m_samplers, cameraMatrix);
+				std::vector<InstanceBvh::Instance> instances(m_nodes.size());
+				m_pickNodes.resize(m_nodes.size());
+				for(size_t nodeIx = 0; nodeIx < m_nodes.size(); ++nodeIx)
+				{
+					instances[nodeIx].pMesh = &m_nodes[nodeIx].GetBvh();
+					instances[nodeIx].modelToWorld = m_nodes[nodeIx].GetModelMatrix();
+					m_pickNodes[nodeIx] = m_nodes.GetHandle(nodeIx);
+				}
+
+				m_pickBvh.Build(instances);
+				m_bPickDirty = false;
 			}
+
+			RayHit hit;
+			if(!m_pickBvh.Intersect(Ray(rayOrigin, rayDirection), hit))
+				return false;
+
+			pick.nodeName = m_nodes.Get(m_pickNodes[hit.instance])->GetName();
+			pick.triangle = hit.triangle;
+			pick.barycentrics = glm::vec3(1.0f - hit.u - hit.v, hit.u, hit.v);
+			pick.distance = hit.t;
+			pick.position = rayOrigin + rayDirection * hit.t;
+			return true;
 		}
 
 		NodeRef FindNode(const std::string &nodeName)
 		{
-			NodeMap::iterator theIt = m_nodes.find(nodeName);
-			if(theIt == m_nodes.end())
+			unsigned int nodeIx = m_view.FindNode(nodeName.c_str(), nodeName.size());
+			if(nodeIx == snapshot::NO_RECORD)
 				throw std::runtime_error("Could not find the node named: " + nodeName);
 
-			return NodeRef(theIt->second);
+			return NodeRef(this, m_nodeHandles[nodeIx]);
 		}
 
 		GLuint FindProgram(const std::string &progName)
 		{
-			ProgramMap::iterator theIt = m_progs.find(progName);
-			if(theIt == m_progs.end())
+			unsigned int progIx = m_view.FindProgram(progName.c_str(), progName.size());
+			if(progIx == snapshot::NO_RECORD)
 				throw std::runtime_error("Could not find the program named: " + progName);
 
-			return theIt->second->GetProgram();
+			return (*m_progs.Get(m_progHandles[progIx]))->GetProgram();
 		}
 
 		Mesh *FindMesh(const std::string &meshName)
 		{
-			MeshMap::iterator theIt = m_meshes.find(meshName);
-			if(theIt == m_meshes.end())
+			unsigned int meshIx = m_view.FindMesh(meshName.c_str(), meshName.size());
+			if(meshIx == snapshot::NO_RECORD)
 				throw std::runtime_error("Could not find the mesh named: " + meshName);
 
-			return theIt->second->GetMesh();
+			return (*m_meshes.Get(m_meshHandles[meshIx]))->GetMesh();
 		}
 
 		std::pair<GLuint, GLenum> FindTexture(const std::string &textureName)
 		{
-			TextureMap::iterator theIt = m_textures.find(textureName);
-			if(theIt == m_textures.end())
+			unsigned int texIx = m_view.FindTexture(textureName.c_str(), textureName.size());
+			if(texIx == snapshot::NO_RECORD)
 				throw std::runtime_error("Could not find the texture named: " + textureName);
 
-			return std::make_pair(theIt->second->GetTexture(), theIt->second->GetType());
+			const SceneTexture *pTexture = *m_textures.Get(m_textureHandles[texIx]);
+			return std::make_pair(pTexture->GetTexture(), pTexture->GetType());
 		}
 
-	private:
-
-		void ReadMeshes(const xml_node<> &scene)
+		SceneNode &GetNode(const Handle &node)
 		{
-			for(const xml_node<> *pMeshNode = scene.first_node("mesh");
-				pMeshNode;
-				pMeshNode = pMeshNode->next_sibling("mesh"))
-			{
-				ReadMesh(*pMeshNode);
-			}
+			SceneNode *pNode = m_nodes.Get(node);
+			if(!pNode)
+				throw std::runtime_error("The node reference is no longer valid.");
+
+			return *pNode;
 		}
 
-		void ReadMesh(const xml_node<> &meshNode)
+		//For changes that move the node.
+		SceneNode &GetNodeForMove(const Handle &node)
 		{
-			const xml_attribute<> *pNameNode = meshNode.first_attribute("xml:id");
-			const xml_attribute<> *pFilenameNode = meshNode.first_attribute("file");
-
-			PARSE_THROW(pNameNode, "Mesh found with no `xml:id` name specified.");
-			PARSE_THROW(pFilenameNode, "Mesh found with no `file` filename specified.");
-
-			std::string name = make_string(*pNameNode);
-			if(m_meshes.find(name) != m_meshes.end())
-				throw std::runtime_error("The mesh named \"" + name + "\" already exists.");
-
-			m_meshes[name] = NULL;
-
-			SceneMesh *pMesh = new SceneMesh(make_string(*pFilenameNode));
-
-			m_meshes[name] = pMesh;
+			m_bPickDirty = true;
+			return GetNode(node);
 		}
 
-		void ReadTextures(const xml_node<> &scene)
+		void SetHotReload(bool bEnable)
 		{
-			for(const xml_node<> *pTexNode = scene.first_node("texture");
-				pTexNode;
-				pTexNode = pTexNode->next_sibling("texture"))
+			if(!bEnable)
 			{
-				ReadTexture(*pTexNode);
+				m_pWatcher.reset();
+				m_watchedFiles.clear();
+				return;
 			}
-		}
 
-		void ReadTexture(const xml_node<> &TexNode)
-		{
-			const xml_attribute<> *pNameNode = TexNode.first_attribute("xml:id");
-			const xml_attribute<> *pFilenameNode = TexNode.first_attribute("file");
+			if(m_pWatcher.get())
+				return;
 
-			PARSE_THROW(pNameNode, "Texture found with no `xml:id` name specified.");
-			PARSE_THROW(pFilenameNode, "Texture found with no `file` filename specified.");
+			try
+			{
+				m_pWatcher.reset(new FileWatcher);
+			}
+			catch(std::exception &e)
+			{
+				std::cout << "Could not watch the files of the scene " << m_filename <<
+					"; hot reload is off." << std::endl << e.what() << std::endl;
+				return;
+			}
 
-			const xml_attribute<> *pSrgbNode = TexNode.first_attribute("srgb");
+			WatchFiles();
+		}
 
-			std::string name = make_string(*pNameNode);
-			if(m_textures.find(name) != m_textures.end())
-				throw std::runtime_error("The texture named \"" + name + "\" already exists.");
+		bool IsHotReloadEnabled() const {return m_pWatcher.get() != NULL;}
 
-			m_textures[name] = NULL;
+		bool ReloadChangedFiles()
+		{
+			PROFILE_SCOPE("Scene::ReloadChangedFiles");
+			if(!m_pWatcher.get())
+				return false;
+
+			std::vector<std::string> changedFiles;
+			m_pWatcher->GetChangedFiles(changedFiles);
+			if(changedFiles.empty())
+				return false;
+
+			bool reloaded = false;
+			if(std::find(changedFiles.begin(), changedFiles.end(), m_pathname) != changedFiles.end())
+				reloaded |= ReloadScene();
+
+			reloaded |= ReloadResources(m_meshes, changedFiles, "mesh");
+			reloaded |= ReloadResources(m_textures, changedFiles, "texture");
+			reloaded |= ReloadResources(m_progs, changedFiles, "program");
+
+			WatchFiles();
+			m_bPickDirty |= reloaded;
+			return reloaded;
+		}
 
-			unsigned int creationFlags = 0;
-			if(get_attrib_bool(TexNode, "srgb"))
-				creationFlags |= glimg::FORCE_SRGB_COLORSPACE_FMT;
+	private:
+		enum {NODES_PER_COMMAND_LIST = 64};
 
-			SceneTexture *pTexture = new SceneTexture(make_string(*pFilenameNode), creationFlags);
+		//Records every node into m_commandLists, chunks in parallel. With a culler, nodes it
+		//finds hidden are left out.
+		SceneRenderStats RecordNodes(const glm::mat4 &cameraMatrix, const OcclusionCuller *pCuller) const
+		{
+			PROFILE_SCOPE("Scene::RecordNodes");
+			const size_t numLists = (m_nodes.size() + NODES_PER_COMMAND_LIST - 1) / NODES_PER_COMMAND_LIST;
+			m_commandLists.resize(numLists);
 
-			m_textures[name] = pTexture;
-		}
+			std::vector<SceneRenderStats> listStats(numLists);
+			ParallelFor(GetWorkerPool(), numLists, 1, [&](size_t beginList, size_t endList)
+			{
+				for(size_t listIx = beginList; listIx < endList; ++listIx)
+				{
+					CommandList &cmds = m_commandLists[listIx];
+					cmds.Clear();
 
-		void ReadPrograms(const xml_node<> &scene)
-		{
-			for(const xml_node<> *pProgNode = scene.first_node("prog");
-				pProgNode;
-				pProgNode = pProgNode->next_sibling("prog"))
+					const size_t endNode = std::min((listIx + 1) * NODES_PER_COMMAND_LIST, m_nodes.size());
+					for(size_t nodeIx = listIx * NODES_PER_COMMAND_LIST; nodeIx < endNode; ++nodeIx)
+					{
+						const SceneNode &node = m_nodes[nodeIx];
+
+						//Without positions there are no bounds to test.
+						const MeshGeometry &geometry = node.GetGeometry();
+						if(pCuller && !geometry.positions.empty() &&
+							!pCuller->IsVisible(geometry.boundsMin, geometry.boundsMax, node.GetModelMatrix()))
+						{
+							++listStats[listIx].nodesCulled;
+							continue;
+						}
+
+						node.Record(cmds, m_samplers, cameraMatrix, m_lodSettings, listStats[listIx]);
+					}
+				}
+			});
+
+			SceneRenderStats stats;
+			for(size_t listIx = 0; listIx < numLists; ++listIx)
 			{
-				ReadProgram(*pProgNode);
+				stats.nodesDrawn += listStats[listIx].nodesDrawn;
+				stats.nodesCulled += listStats[listIx].nodesCulled;
+				stats.triangles += listStats[listIx].triangles;
+				stats.fullDetailTriangles += listStats[listIx].fullDetailTriangles;
 			}
+			return stats;
 		}
 
-		void ReadProgram(const xml_node<> &progNode)
+		void ExecuteCommands(CommandBackend &backend) const
 		{
-			const xml_attribute<> *pNameNode = progNode.first_attribute("xml:id");
-			const xml_attribute<> *pVertexShaderNode = progNode.first_attribute("vert");
-			const xml_attribute<> *pFragmentShaderNode = progNode.first_attribute("frag");
-			const xml_attribute<> *pModelMatrixNode = progNode.first_attribute("model-to-camera");
-
-			PARSE_THROW(pNameNode, "Program found with no `xml:id` name specified.");
-			PARSE_THROW(pVertexShaderNode, "Program found with no `vert` vertex shader specified.");
-			PARSE_THROW(pFragmentShaderNode, "Program found with no `frag` fragment shader specified.");
-			PARSE_THROW(pModelMatrixNode, "Program found with no model-to-camera matrix uniform name specified.");
+			PROFILE_SCOPE("Scene::ExecuteCommands");
+			for(size_t listIx = 0; listIx < m_commandLists.size(); ++listIx)
+				m_commandLists[listIx].Execute(backend);
+		}
 
-			//Optional.
-			const xml_attribute<> *pNormalMatrixNode = progNode.first_attribute("normal-model-to-camera");
-			const xml_attribute<> *pGeometryShaderNode = progNode.first_attribute("geom");
+		//Resources for the scene file being applied, indexed like its records. Entries are either
+		//existing resources that did not change or new ones in the 'created' lists.
+		struct SceneUpdate
+		{
+			std::vector<SceneMesh *> meshes;
+			std::vector<SceneTexture *> textures;
+			std::vector<SceneProgram *> progs;
 
-			std::string name = make_string(*pNameNode);
-			if(m_progs.find(name) != m_progs.end())
-				throw std::runtime_error("The program named \"" + name + "\" already exists.");
+			//The current scene's record whose resource each entry keeps, or NO_RECORD.
+			std::vector<unsigned int> prevMeshes;
+			std::vector<unsigned int> prevTextures;
+			std::vector<unsigned int> prevProgs;
 
-			m_progs[name] = NULL;
+			std::set<SceneMesh *> createdMeshes;
+			std::set<SceneTexture *> createdTextures;
+			std::set<SceneProgram *> createdProgs;
 
-			std::vector<GLuint> shaders;
-			GLuint program = 0;
+			void DeleteCreated()
+			{
+				std::for_each(createdProgs.begin(), createdProgs.end(), DeleteThis<SceneProgram *const>);
+				std::for_each(createdTextures.begin(), createdTextures.end(), DeleteThis<SceneTexture *const>);
+				std::for_each(createdMeshes.begin(), createdMeshes.end(), DeleteThis<SceneMesh *const>);
+				createdProgs.clear();
+				createdTextures.clear();
+				createdMeshes.clear();
+			}
+		};
 
+		void CreateScene(const snapshot::SnapshotView &view, std::vector<unsigned char> &snapshotData,
+			ScenePreloadImpl *pPreload)
+		{
+			SceneUpdate update;
 			try
 			{
-				shaders.push_back(LoadShader(GL_VERTEX_SHADER, make_string(*pVertexShaderNode)));
-				shaders.push_back(LoadShader(GL_FRAGMENT_SHADER, make_string(*pFragmentShaderNode)));
-				if(pGeometryShaderNode)
-					shaders.push_back(LoadShader(GL_GEOMETRY_SHADER, make_string(*pGeometryShaderNode)));
-				program = glutil::LinkProgram(shaders);
+				StageScene(view, update, pPreload);
+				CommitScene(view, update, snapshotData);
 			}
-			catch(std::exception &)
+			catch(...)
 			{
-				std::for_each(shaders.begin(), shaders.end(), glDeleteShader);
+				update.DeleteCreated();
+				DeleteResources();
 				throw;
 			}
 
-			std::for_each(shaders.begin(), shaders.end(), glDeleteShader);
+			MakeSamplerObjects(m_samplers);
+			WatchFiles();
+		}
 
-			std::string matrixName = make_string(*pModelMatrixNode);
-			GLint matrixLoc = glGetUniformLocation(program, matrixName.c_str());
-			if(matrixLoc == -1)
-			{
-				glDeleteProgram(program);
-				throw std::runtime_error("Could not find the matrix uniform " + matrixName +
-					" in program " + name);
-			}
+		void DeleteResources()
+		{
+			std::for_each(m_progs.begin(), m_progs.end(), DeleteThis<SceneProgram *>);
+			std::for_each(m_textures.begin(), m_textures.end(), DeleteThis<SceneTexture *>);
+			std::for_each(m_meshes.begin(), m_meshes.end(), DeleteThis<SceneMesh *>);
+			m_nodes.Clear();
+			m_progs.Clear();
+			m_textures.Clear();
+			m_meshes.Clear();
+		}
 
-			GLint normalMatLoc = -1;
-			if(pNormalMatrixNode)
+		//Brings the watches in line with the files the scene now uses. Files still in use keep
+		//their watches, so changes made during a reload are reported by the next call.
+		//If a file cannot be watched, hot reload is turned off; the scene itself is fine.
+		void WatchFiles()
+		{
+			if(!m_pWatcher.get())
+				return;
+
+			std::set<std::string> pathnames;
+			pathnames.insert(m_pathname);
+			for(MeshTable::const_iterator theIt = m_meshes.begin(); theIt != m_meshes.end(); ++theIt)
+				(*theIt)->GetWatchedFiles(pathnames);
+			for(TextureTable::const_iterator theIt = m_textures.begin(); theIt != m_textures.end(); ++theIt)
+				(*theIt)->GetWatchedFiles(pathnames);
+			for(ProgramTable::const_iterator theIt = m_progs.begin(); theIt != m_progs.end(); ++theIt)
+				(*theIt)->GetWatchedFiles(pathnames);
+
+			try
 			{
-				matrixName = make_string(*pNormalMatrixNode);
-				normalMatLoc = glGetUniformLocation(program, matrixName.c_str());
-				if(normalMatLoc == -1)
+				for(std::set<std::string>::const_iterator theIt = m_watchedFiles.begin();
+					theIt != m_watchedFiles.end(); ++theIt)
 				{
-					glDeleteProgram(program);
-					throw std::runtime_error("Could not find the normal matrix uniform " + matrixName +
-						" in program " + name);
+					if(pathnames.find(*theIt) == pathnames.end())
+						m_pWatcher->RemoveFile(*theIt);
 				}
-			}
 
-			m_progs[name] = new SceneProgram(program, matrixLoc, normalMatLoc);
+				for(std::set<std::string>::const_iterator theIt = pathnames.begin();
+					theIt != pathnames.end(); ++theIt)
+				{
+					if(m_watchedFiles.find(*theIt) == m_watchedFiles.end())
+						m_pWatcher->AddFile(*theIt);
+				}
+			}
+			catch(std::exception &e)
+			{
+				std::cout << "Could not watch the files of the scene " << m_filename <<
+					"; hot reload is off." << std::endl << e.what() << std::endl;
+				m_pWatcher.reset();
+				m_watchedFiles.clear();
+				return;
+			}
 
-			ReadProgramContents(program, progNode);
+			m_watchedFiles.swap(pathnames);
 		}
 
-		void ReadProgramContents(GLuint program, const xml_node<> &progNode)
+		template<typename ResourceTable>
+		bool ReloadResources(ResourceTable &resources, const std::vector<std::string> &changedFiles,
+			const char *what)
 		{
-			std::set<std::string> blockBindings;
-			std::set<std::string> samplerBindings;
-
-			for(const xml_node<> *pChildNode = progNode.first_node();
-				pChildNode;
-				pChildNode = pChildNode->next_sibling())
+			bool reloaded = false;
+			for(typename ResourceTable::iterator theIt = resources.begin(); theIt != resources.end(); ++theIt)
 			{
-				if(pChildNode->type() != rapidxml::node_element)
+				bool changed = false;
+				for(size_t fileIx = 0; fileIx < changedFiles.size(); ++fileIx)
+					changed = changed || (*theIt)->UsesFile(changedFiles[fileIx]);
+
+				if(!changed)
 					continue;
 
-				const std::string childName = std::string(pChildNode->name(), pChildNode->name_size());
-				if(childName == "block")
+				try
 				{
-					const xml_attribute<> *pNameNode = pChildNode->first_attribute("name");
-					const xml_attribute<> *pBindingNode = pChildNode->first_attribute("binding");
-
-					PARSE_THROW(pNameNode, "Program `block` element with no `name`.");
-					PARSE_THROW(pBindingNode, "Program `block` element with no `binding`.");
+					(*theIt)->Reload();
+					reloaded = true;
+				}
+				catch(std::exception &e)
+				{
+					std::cout << "Could not reload the " << what << " " << (*theIt)->GetName() <<
+						"; keeping the current one." << std::endl << e.what() << std::endl;
+				}
+			}
 
-					std::string name = make_string(*pNameNode);
-					if(blockBindings.find(name) != blockBindings.end())
-						throw std::runtime_error("The uniform block " + name + " is used twice in the same program.");
+			return reloaded;
+		}
 
-					blockBindings.insert(name);
+		bool ReloadScene()
+		{
+			SceneUpdate update;
+			try
+			{
+				std::vector<unsigned char> snapshotData;
+				ReadSceneFile(m_pathname, m_filename, snapshotData);
+				snapshot::SnapshotView view(&snapshotData[0], snapshotData.size());
 
-					GLuint blockIx = glGetUniformBlockIndex(program, name.c_str());
-					if(blockIx == GL_INVALID_INDEX)
-					{
-						std::cout << "Warning: the uniform block " << name << " could not be found." << std::endl;
-						continue;
-					}
+				StageScene(view, update);
+				CommitScene(view, update, snapshotData);
+				return true;
+			}
+			catch(std::exception &e)
+			{
+				update.DeleteCreated();
+				std::cout << "Could not reload the scene " << m_filename <<
+					"; keeping the current one." << std::endl << e.what() << std::endl;
+				return false;
+			}
+		}
 
-					int bindPoint = rapidxml::attrib_to_int(*pBindingNode, ThrowAttrib);
-					glUniformBlockBinding(program, blockIx, bindPoint);
-				}
-				else if(childName == "sampler")
+		//Loads everything that is new or different in the scene file, without touching the
+		//current scene. If anything fails, the scene stays exactly as it was.
+		//With a preload, the meshes and textures come from it instead of from their files.
+		void StageScene(const snapshot::SnapshotView &view, SceneUpdate &update,
+			ScenePreloadImpl *pPreload = NULL)
+		{
+			PROFILE_SCOPE("Scene::StageScene");
+			const snapshot::Header &hdr = view.GetHeader();
+
+			//A new scene has no current records, so everything in it is created by index.
+			const bool bReload = !m_snapshot.empty();
+
+			//Start decoding every new texture first. Meshes and programs load on this thread
+			//meanwhile, and then the textures are uploaded as their decodes finish.
+			TextureDecodeQueue decodeQueue;
+			std::vector<bool> keptTextures(m_textureHandles.size(), false);
+			update.textures.resize(hdr.textures.count, NULL);
+			update.prevTextures.resize(hdr.textures.count, snapshot::NO_RECORD);
+			for(unsigned int texIx = 0; texIx < hdr.textures.count; ++texIx)
+			{
+				const snapshot::TextureRecord &texRec = view.Textures()[texIx];
+				if(pPreload)
 				{
-					const xml_attribute<> *pNameNode = pChildNode->first_attribute("name");
-					const xml_attribute<> *pTexunitNode = pChildNode->first_attribute("unit");
-
-					PARSE_THROW(pNameNode, "Program `sampler` element with no `name`.");
-					PARSE_THROW(pTexunitNode, "Program `sampler` element with no `unit`.");
+					update.textures[texIx] = pPreload->TakeTexture(texIx);
+					update.createdTextures.insert(update.textures[texIx]);
+					continue;
+				}
 
-					std::string name = make_string(*pNameNode);
-					if(samplerBindings.find(name) != samplerBindings.end())
-						throw std::runtime_error("A sampler " + name + " is used twice within the same program.");
+				unsigned int prevIx = bReload ?
+					m_view.FindTexture(view.String(texRec.name), texRec.name.length) : snapshot::NO_RECORD;
+				prevIx = KeepPrevious(m_textures, m_textureHandles, prevIx, view, texRec, keptTextures);
+				if(prevIx == snapshot::NO_RECORD)
+					decodeQueue.Add(texIx, view.String(texRec.path));
+				else
+				{
+					update.textures[texIx] = *m_textures.Get(m_textureHandles[prevIx]);
+					update.prevTextures[texIx] = prevIx;
+				}
+			}
 
-					samplerBindings.insert(name);
+			std::vector<bool> keptMeshes(m_meshHandles.size(), false);
+			update.meshes.resize(hdr.meshes.count, NULL);
+			update.prevMeshes.resize(hdr.meshes.count, snapshot::NO_RECORD);
+			for(unsigned int meshIx = 0; meshIx < hdr.meshes.count; ++meshIx)
+			{
+				const snapshot::MeshRecord &meshRec = view.Meshes()[meshIx];
+				if(pPreload)
+				{
+					update.meshes[meshIx] = pPreload->TakeMesh(meshIx);
+					update.createdMeshes.insert(update.meshes[meshIx]);
+					continue;
+				}
 
-					GLint samplerLoc = glGetUniformLocation(program, name.c_str());
-					if(samplerLoc == -1)
-					{
-						std::cout << "Warning: the sampler " << name << " could not be found." << std::endl;
-						continue;
-					}
+				unsigned int prevIx = bReload ?
+					m_view.FindMesh(view.String(meshRec.name), meshRec.name.length) : snapshot::NO_RECORD;
+				prevIx = KeepPrevious(m_meshes, m_meshHandles, prevIx, view, meshRec, keptMeshes);
+				if(prevIx == snapshot::NO_RECORD)
+				{
+					update.meshes[meshIx] = new SceneMesh(view, meshRec);
+					update.createdMeshes.insert(update.meshes[meshIx]);
+				}
+				else
+				{
+					update.meshes[meshIx] = *m_meshes.Get(m_meshHandles[prevIx]);
+					update.prevMeshes[meshIx] = prevIx;
+				}
+			}
 
-					GLint textureUnit = rapidxml::attrib_to_int(*pTexunitNode, ThrowAttrib);
-					glUseProgram(program);
-					glUniform1i(samplerLoc, textureUnit);
-					glUseProgram(0);
+			std::vector<bool> keptProgs(m_progHandles.size(), false);
+			update.progs.resize(hdr.programs.count, NULL);
+			update.prevProgs.resize(hdr.programs.count, snapshot::NO_RECORD);
+			for(unsigned int progIx = 0; progIx < hdr.programs.count; ++progIx)
+			{
+				const snapshot::ProgramRecord &progRec = view.Programs()[progIx];
+				unsigned int prevIx = bReload ?
+					m_view.FindProgram(view.String(progRec.name), progRec.name.length) : snapshot::NO_RECORD;
+				prevIx = KeepPrevious(m_progs, m_progHandles, prevIx, view, progRec, keptProgs);
+				if(prevIx == snapshot::NO_RECORD)
+				{
+					update.progs[progIx] = new SceneProgram(view, progRec);
+					update.createdProgs.insert(update.progs[progIx]);
 				}
 				else
 				{
-					//Bad node. Die.
-					throw std::runtime_error("Unknown element found in program.");
+					update.progs[progIx] = *m_progs.Get(m_progHandles[prevIx]);
+					update.prevProgs[progIx] = prevIx;
 				}
 			}
-		}
 
-		void ReadNodes(SceneNode *pParent, const xml_node<> &scene)
-		{
-			for(const xml_node<> *pNodeNode = scene.first_node("node");
-				pNodeNode;
-				pNodeNode = pNodeNode->next_sibling("node"))
+			size_t texIx = 0;
+			std::auto_ptr<glimg::ImageSet> pImageSet;
+			while(decodeQueue.WaitNext(texIx, pImageSet))
 			{
-				ReadNode(pParent, *pNodeNode);
+				SceneTexture *pTexture = new SceneTexture(view, view.Textures()[texIx], pImageSet.get());
+				update.createdTextures.insert(pTexture);
+				update.textures[texIx] = pTexture;
 			}
 		}
 
-		void ReadNode(SceneNode *pParent, const xml_node<> &nodeNode)
+		//Returns prevIx if the current resource at that record matches the new record and no
+		//earlier new record kept it, and otherwise NO_RECORD. Keeping each current record at
+		//most once leaves every handle with one record, even if a snapshot repeats a name.
+		template<typename ResourceType, typename RecordType>
+		static unsigned int KeepPrevious(const SlotMap<ResourceType *> &resources, const std::vector<Handle> &handles,
+			unsigned int prevIx, const snapshot::SnapshotView &view, const RecordType &record, std::vector<bool> &kept)
 		{
-			const xml_attribute<> *pNameNode = nodeNode.first_attribute("name");
-			const xml_attribute<> *pMeshNode = nodeNode.first_attribute("mesh");
-			const xml_attribute<> *pProgNode = nodeNode.first_attribute("prog");
+			if(prevIx == snapshot::NO_RECORD || kept[prevIx] || !(*resources.Get(handles[prevIx]))->Matches(view, record))
+				return snapshot::NO_RECORD;
 
-			PARSE_THROW(pNameNode, "Node found with no `name` name specified.");
-			PARSE_THROW(pMeshNode, "Node found with no `mesh` name specified.");
-			PARSE_THROW(pProgNode, "Node found with no `prog` name specified.");
+			kept[prevIx] = true;
+			return prevIx;
+		}
 
-			const xml_attribute<> *pPositionNode = nodeNode.first_attribute("pos");
-			const xml_attribute<> *pOrientNode = nodeNode.first_attribute("orient");
-			const xml_attribute<> *pScaleNode = nodeNode.first_attribute("scale");
+		//Swaps in a staged scene, and takes its snapshot. Nothing here can fail, other than by
+		//running out of memory.
+		void CommitScene(const snapshot::SnapshotView &view, SceneUpdate &update,
+			std::vector<unsigned char> &snapshotData)
+		{
+			CommitResources(m_meshes, m_meshHandles, view, view.Meshes(), update.meshes, update.prevMeshes,
+				update.createdMeshes);
+			CommitResources(m_textures, m_textureHandles, view, view.Textures(), update.textures,
+				update.prevTextures, update.createdTextures);
+			CommitResources(m_progs, m_progHandles, view, view.Programs(), update.progs, update.prevProgs,
+				update.createdProgs);
+
+			const snapshot::Header &hdr = view.GetHeader();
+			const bool bReload = !m_snapshot.empty();
+			std::vector<Handle> nodeHandles(hdr.nodes.count);
+			std::vector<bool> keptNodes(m_nodeHandles.size(), false);
+			for(unsigned int nodeIx = 0; nodeIx < hdr.nodes.count; ++nodeIx)
+			{
+				const snapshot::NodeRecord &nodeRec = view.Nodes()[nodeIx];
+				const char *name = view.String(nodeRec.name);
+
+				Transform fileTm;
+				fileTm.m_trans = glm::vec3(nodeRec.trans[0], nodeRec.trans[1], nodeRec.trans[2]);
+				fileTm.m_orient = glm::normalize(glm::fquat(nodeRec.orient[3], nodeRec.orient[0],
+					nodeRec.orient[1], nodeRec.orient[2]));
+				fileTm.m_scale = glm::vec3(nodeRec.scale[0], nodeRec.scale[1], nodeRec.scale[2]);
+
+				std::vector<TextureBinding> texBindings;
+				texBindings.reserve(nodeRec.textures.count);
+				const snapshot::TextureBindingRecord *pBindings = view.TextureBindings(nodeRec);
+				for(unsigned int bindIx = 0; bindIx < nodeRec.textures.count; ++bindIx)
+				{
+					TextureBinding binding;
+					binding.pTex = update.textures[pBindings[bindIx].textureIx];
+					binding.texUnit = pBindings[bindIx].texUnit;
+					binding.sampler = SamplerTypes(pBindings[bindIx].sampler);
+					texBindings.push_back(binding);
+				}
 
-			PARSE_THROW(pPositionNode, "Node found with no `pos` specified.");
+				//Existing nodes are updated in place, so NodeRefs and state binders survive.
+				//As with resources, each current node is kept by at most one new one.
+				unsigned int prevIx = bReload ? m_view.FindNode(name, nodeRec.name.length) : snapshot::NO_RECORD;
+				SceneNode *pNode = NULL;
+				if(prevIx != snapshot::NO_RECORD && !keptNodes[prevIx])
+				{
+					keptNodes[prevIx] = true;
+					nodeHandles[nodeIx] = m_nodeHandles[prevIx];
+					pNode = m_nodes.Get(nodeHandles[nodeIx]);
+					pNode->SetName(name);
+					pNode->SetFileTransform(fileTm);
+				}
+				else
+				{
+					nodeHandles[nodeIx] = m_nodes.Insert(SceneNode(name, fileTm));
 
-			std::string name = make_string(*pNameNode);
-			if(m_nodes.find(name) != m_nodes.end())
-				throw std::runtime_error("The node named \"" + name + "\" already exists.");
+					//TODO: parent/child nodes.
+					m_rootNodes.push_back(nodeHandles[nodeIx]);
+					pNode = m_nodes.Get(nodeHandles[nodeIx]);
+				}
 
-			m_nodes[name] = NULL;
+				std::vector<LodLevel> lods(1 + nodeRec.lods.count);
+				lods[0].pMesh = update.meshes[nodeRec.meshIx];
+				lods[0].geometricError = 0.0f;
+				const snapshot::LodRecord *pLods = view.Lods(nodeRec);
+				for(unsigned int lodIx = 0; lodIx < nodeRec.lods.count; ++lodIx)
+				{
+					lods[lodIx + 1].pMesh = update.meshes[pLods[lodIx].meshIx];
+					lods[lodIx + 1].geometricError = pLods[lodIx].geometricError;
+				}
 
-			std::string meshName = make_string(*pMeshNode);
-			MeshMap::iterator meshIt = m_meshes.find(meshName);
-			if(meshIt == m_meshes.end())
-			{
-				throw std::runtime_error("The node named \"" + name + 
-					"\" references the mesh \"" + meshName + "\" which does not exist.");
+				pNode->SetResources(lods, update.progs[nodeRec.progIx], texBindings,
+					(nodeRec.flags & snapshot::NODE_OCCLUDER) != 0);
 			}
 
-			std::string progName = make_string(*pProgNode);
-			ProgramMap::iterator progIt = m_progs.find(progName);
-			if(progIt == m_progs.end())
+			for(size_t prevIx = 0; prevIx < m_nodeHandles.size(); ++prevIx)
 			{
-				throw std::runtime_error("The node named \"" + name + 
-					"\" references the program \"" + progName + "\" which does not exist.");
-			}
-
-			glm::vec3 nodePos = rapidxml::attrib_to_vec3(*pPositionNode, ThrowAttrib);
-
-			SceneNode *pNode = new SceneNode(meshIt->second, progIt->second, nodePos,
-				ReadNodeTextures(nodeNode));
-			m_nodes[name] = pNode;
-
-			//TODO: parent/child nodes.
-			if(!pParent)
-				m_rootNodes.push_back(pNode);
-
-			if(pOrientNode)
-				pNode->SetNodeOrient(rapidxml::attrib_to_quat(*pOrientNode, ThrowAttrib));
+				if(keptNodes[prevIx])
+					continue;
 
-			if(pScaleNode)
-			{
-				if(rapidxml::attrib_is_vec3(*pScaleNode))
-					pNode->SetNodeScale(rapidxml::attrib_to_vec3(*pScaleNode, ThrowAttrib));
-				else
-				{
-					float unifScale = rapidxml::attrib_to_float(*pScaleNode, ThrowAttrib);
-					pNode->SetNodeScale(glm::vec3(unifScale));
-				}
+				const Handle &nodeHandle = m_nodeHandles[prevIx];
+				m_rootNodes.erase(std::remove(m_rootNodes.begin(), m_rootNodes.end(), nodeHandle),
+					m_rootNodes.end());
+				m_nodes.Remove(nodeHandle);
 			}
 
-			ReadNodeNotes(nodeNode);
+			m_nodeHandles.swap(nodeHandles);
+			m_snapshot.swap(snapshotData);
+			m_view = view;
 		}
 
-		void ReadNodeNotes(const xml_node<> &nodeNode)
+		//Deletes the current resources that the new scene does not keep, adds the new ones,
+		//and rebinds the kept ones to their new records. Nodes are repointed afterwards, so
+		//nothing refers to a deleted resource.
+		template<typename ResourceType, typename RecordType>
+		static void CommitResources(SlotMap<ResourceType *> &resources, std::vector<Handle> &handles,
+			const snapshot::SnapshotView &view, const RecordType *pRecords,
+			const std::vector<ResourceType *> &staged, const std::vector<unsigned int> &prevIxs,
+			std::set<ResourceType *> &created)
 		{
-			for(const xml_node<> *pNoteNode = nodeNode.first_node("note");
-				pNoteNode;
-				pNoteNode = pNoteNode->next_sibling("note"))
+			std::vector<bool> kept(handles.size(), false);
+			for(size_t resIx = 0; resIx < prevIxs.size(); ++resIx)
 			{
-				const xml_node<> &noteNode = *pNoteNode;
-				const xml_attribute<> *pNameNode = noteNode.first_attribute("name");
-				PARSE_THROW(pNameNode, "Notations on nodes must have a `name` attribute.");
+				if(prevIxs[resIx] != snapshot::NO_RECORD)
+					kept[prevIxs[resIx]] = true;
 			}
-		}
-
-		std::vector<TextureBinding> ReadNodeTextures(const xml_node<> &nodeNode)
-		{
-			std::vector<TextureBinding> texBindings;
-			std::set<GLuint> texUnits;
 
-			for(const xml_node<> *pTexNode = nodeNode.first_node("texture");
-				pTexNode;
-				pTexNode = pTexNode->next_sibling("texture"))
+			for(size_t prevIx = 0; prevIx < handles.size(); ++prevIx)
 			{
-				const xml_node<> &texNode = *pTexNode;
-				const xml_attribute<> *pNameNode = texNode.first_attribute("name");
-				const xml_attribute<> *pUnitName = texNode.first_attribute("unit");
-				const xml_attribute<> *pSamplerName = texNode.first_attribute("sampler");
+				if(kept[prevIx])
+					continue;
 
-				PARSE_THROW(pNameNode, "Textures on nodes must have a `name` attribute.");
-				PARSE_THROW(pUnitName, "Textures on nodes must have a `unit` attribute.");
-				PARSE_THROW(pSamplerName, "Textures on nodes must have a `sampler` attribute.");
+				delete *resources.Get(handles[prevIx]);
+				resources.Remove(handles[prevIx]);
+			}
 
-				std::string textureName = make_string(*pNameNode);
-				TextureMap::iterator texIt = m_textures.find(textureName);
-				if(texIt == m_textures.end())
+			std::vector<Handle> stagedHandles(staged.size());
+			for(size_t resIx = 0; resIx < staged.size(); ++resIx)
+			{
+				if(prevIxs[resIx] == snapshot::NO_RECORD)
+					stagedHandles[resIx] = resources.Insert(staged[resIx]);
+				else
 				{
-					throw std::runtime_error("The node texture named \"" + textureName + 
-						"\" is a texture which does not exist.");
+					stagedHandles[resIx] = handles[prevIxs[resIx]];
+					staged[resIx]->Rebind(view, pRecords[resIx]);
 				}
-
-				TextureBinding binding;
-
-				binding.pTex = texIt->second;
-				binding.texUnit = rapidxml::attrib_to_int(*pUnitName, ThrowAttrib);
-				binding.sampler = GetTypeFromName(make_string(*pSamplerName));
-
-				if(texUnits.find(binding.texUnit) != texUnits.end())
-					throw std::runtime_error("Multiply bound texture unit in node texture " + textureName);
-
-				texBindings.push_back(binding);
-
-				texUnits.insert(binding.texUnit);
 			}
 
-			return texBindings;
+			handles.swap(stagedHandles);
+			created.clear();
 		}
 	};
 
 	void NodeRef::NodeSetScale( const glm::vec3 &scale )
 	{
-		m_pNode->NodeSetScale(scale);
+		m_pImpl->GetNodeForMove(m_node).NodeSetScale(scale);
 	}
 
 	void NodeRef::NodeSetScale( float scale )
 	{
-		m_pNode->NodeSetScale(glm::vec3(scale));
+		m_pImpl->GetNodeForMove(m_node).NodeSetScale(glm::vec3(scale));
 	}
 
 	void NodeRef::NodeRotate( const glm::fquat &orient )
 	{
-		m_pNode->NodeRotate(orient);
+		m_pImpl->GetNodeForMove(m_node).NodeRotate(orient);
 	}
 
 	void NodeRef::NodeSetOrient( const glm::fquat &orient )
 	{
-		m_pNode->NodeSetOrient(orient);
+		m_pImpl->GetNodeForMove(m_node).NodeSetOrient(orient);
 	}
 
 	glm::fquat NodeRef::NodeGetOrient() const
 	{
-		return m_pNode->NodeGetOrient();
+		return m_pImpl->GetNode(m_node).NodeGetOrient();
 	}
 
 	void NodeRef::NodeOffset( const glm::vec3 &offset )
 	{
-		m_pNode->NodeOffset(offset);
+		m_pImpl->GetNodeForMove(m_node).NodeOffset(offset);
 	}
 
 	void NodeRef::NodeSetTrans( const glm::vec3 &offset )
 	{
-		m_pNode->NodeSetTrans(offset);
+		m_pImpl->GetNodeForMove(m_node).NodeSetTrans(offset);
 	}
 
 	void NodeRef::SetStateBinder( StateBinder *pBinder )
 	{
-		m_pNode->SetStateBinder(pBinder);
+		m_pImpl->GetNode(m_node).SetStateBinder(pBinder);
 	}
 
 	GLuint NodeRef::GetProgram() const
 	{
-		return m_pNode->GetProgram();
+		return m_pImpl->GetNode(m_node).GetProgram();
 	}
 
 	Scene::Scene( const std::string &filename )
 		: m_pImpl(new SceneImpl(filename))
 	{}
 
+	Scene::Scene( ScenePreload &preload )
+		: m_pImpl(new SceneImpl(*preload.m_pImpl))
+	{}
+
 	Scene::~Scene()
 	{
 		delete m_pImpl;
 	}
 
+	ScenePreload::ScenePreload( const std::string &filename )
+		: m_pImpl(new ScenePreloadImpl(filename, GetWorkerPool()))
+	{}
+
+	ScenePreload::ScenePreload( const std::string &filename, WorkerPool &pool )
+		: m_pImpl(new ScenePreloadImpl(filename, pool))
+	{}
+
+	ScenePreload::~ScenePreload()
+	{
+		delete m_pImpl;
+	}
+
+	bool ScenePreload::UploadNext()
+	{
+		return m_pImpl->UploadNext();
+	}
+
+	size_t ScenePreload::GetUploadsLeft() const
+	{
+		return m_pImpl->GetUploadsLeft();
+	}
+
 	void Scene::Render( const glm::mat4 &cameraMatrix ) const
 	{
-		m_pImpl->Render(cameraMatrix);
+		GLCommandBackend backend;
+		m_pImpl->Render(cameraMatrix, backend);
+	}
+
+	void Scene::Render( const glm::mat4 &cameraMatrix, CommandBackend &backend ) const
+	{
+		m_pImpl->Render(cameraMatrix, backend);
+	}
+
+	size_t Scene::Render( const glm::mat4 &cameraMatrix, const glm::mat4 &cameraToClipMatrix,
+		OcclusionCuller &culler ) const
+	{
+		return m_pImpl->Render(cameraMatrix, cameraToClipMatrix, culler);
+	}
+
+	void Scene::SetLodSettings( const LodSettings &settings )
+	{
+		m_pImpl->SetLodSettings(settings);
+	}
+
+	const LodSettings &Scene::GetLodSettings() const
+	{
+		return m_pImpl->GetLodSettings();
+	}
+
+	const SceneRenderStats &Scene::GetRenderStats() const
+	{
+		return m_pImpl->GetRenderStats();
+	}
+
+	bool Scene::Pick( const glm::vec3 &rayOrigin, const glm::vec3 &rayDirection, ScenePick &pick ) const
+	{
+		return m_pImpl->Pick(rayOrigin, rayDirection, pick);
 	}
 
 	Framework::NodeRef Scene::FindNode( const std::string &nodeName )
@@ -930,4 +1846,19 @@ namespace Framework
 	{
 		return m_pImpl->FindMesh(meshName);
 	}
+
+	void Scene::SetHotReload( bool bEnable )
+	{
+		m_pImpl->SetHotReload(bEnable);
+	}
+
+	bool Scene::IsHotReloadEnabled() const
+	{
+		return m_pImpl->IsHotReloadEnabled();
+	}
+
+	bool Scene::ReloadChangedFiles()
+	{
+		return m_pImpl->ReloadChangedFiles();
+	}
 }
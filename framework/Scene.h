@@ -9,16 +9,72 @@
 #include <string>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include "SlotMap.h"
 
 namespace Framework
 {
 	class SceneImpl;
 	class SceneNode;
+	class ScenePreloadImpl;
 
 	class Mesh;
+	class OcclusionCuller;
+	class CommandBackend;
+	class WorkerPool;
 
 	class StateBinder;
 
+	/**
+	Controls how nodes pick among their levels of detail.
+
+	A node's mesh is its finest level. Its <lod> elements name coarser meshes, each with the
+	geometric error of using it, in model space. Each frame, a node uses the coarsest level
+	whose error, projected to the screen, is within maxPixelError. A level must be better than
+	that by the hysteresis fraction before a node coarsens to it, and worse by the same
+	fraction before the node refines past it.
+
+	With fadeFrames set, a node that changes level draws both levels for that many frames.
+	Programs with a lod-fade uniform get a value in (0, 1) for the outgoing level and its
+	negation for the incoming one, and 0 otherwise. Discarding fragments whose dither value is
+	at least a positive fade, or below a negative fade's magnitude, cross-fades the two.
+	**/
+	struct LodSettings
+	{
+		LodSettings() : projectionScale(0.0f), maxPixelError(1.0f), hysteresis(0.1f), fadeFrames(0) {}
+
+		//Sets the projection scale for the given camera-to-clip matrix and viewport height.
+		void SetProjection(const glm::mat4 &cameraToClipMatrix, int viewportHeight)
+		{
+			projectionScale = cameraToClipMatrix[1][1] * viewportHeight * 0.5f;
+		}
+
+		float projectionScale;	//Pixels covered by one unit at a distance of one. Zero means always finest.
+		float maxPixelError;
+		float hysteresis;
+		int fadeFrames;
+	};
+
+	//The nearest triangle found by Scene::Pick.
+	struct ScenePick
+	{
+		std::string nodeName;
+		unsigned int triangle;		//Into the MeshGeometry of the node's finest mesh.
+		glm::vec3 barycentrics;		//Weights of the triangle's three vertices.
+		float distance;				//In units of the ray direction's length.
+		glm::vec3 position;			//World space.
+	};
+
+	//What the last Render call did.
+	struct SceneRenderStats
+	{
+		SceneRenderStats() : nodesDrawn(0), nodesCulled(0), triangles(0), fullDetailTriangles(0) {}
+
+		size_t nodesDrawn;
+		size_t nodesCulled;
+		size_t triangles;			//Both levels count for nodes that are cross-fading.
+		size_t fullDetailTriangles;	//What the drawn nodes would cost at their finest levels.
+	};
+
 	class NodeRef
 	{
 	public:
@@ -45,26 +101,101 @@ namespace Framework
 
 	private:
 		NodeRef();	//No default-construction.
-		explicit NodeRef(SceneNode *pNode) : m_pNode(pNode) {}
-		SceneNode *m_pNode;
+		NodeRef(SceneImpl *pImpl, const Handle &node) : m_pImpl(pImpl), m_node(node) {}
+		SceneImpl *m_pImpl;
+		Handle m_node;
 
 		friend class SceneImpl;
 	};
 
+	/**
+	Loads a scene's files without making any OpenGL objects, so that the slow part of loading
+	can happen on another thread.
+
+	The constructor reads the scene file, parses its meshes and decodes its textures. It can
+	run on any thread, and spreads the parsing and decoding across a worker pool: the shared
+	one, unless another is given. UploadNext then makes the GL objects one
+	mesh or texture at a time, so a caller can spread them over several frames. Scene's
+	constructor makes any that are left.
+
+	Once UploadNext has been called, the preload must be destroyed on the GL thread.
+	**/
+	class ScenePreload
+	{
+	public:
+		explicit ScenePreload(const std::string &filename);
+		ScenePreload(const std::string &filename, WorkerPool &pool);
+		~ScenePreload();
+
+		//Makes the GL objects for one mesh or texture. Returns false if none were left.
+		bool UploadNext();
+
+		size_t GetUploadsLeft() const;
+
+	private:
+		ScenePreloadImpl *m_pImpl;
+
+		friend class Scene;
+
+		//Prevent copying.
+		ScenePreload(const ScenePreload &);
+		ScenePreload &operator=(const ScenePreload &);
+	};
+
 	class Scene
 	{
 	public:
 		Scene(const std::string &filename);
+
+		//Finishes the preload's uploads, then compiles the programs. The preload is left empty.
+		explicit Scene(ScenePreload &preload);
+
 		~Scene();
 
+		//Nodes are recorded into command lists on the worker pool, then the lists are
+		//executed in order on the calling thread.
 		void Render(const glm::mat4 &cameraMatrix) const;
 
+		//Executes the recorded commands through the given backend instead of through GL.
+		void Render(const glm::mat4 &cameraMatrix, CommandBackend &backend) const;
+
+		//Skips nodes hidden behind the scene's occluders, the nodes marked occluder="true".
+		//The occluders are rasterized into the culler first, then every node's mesh bounds are
+		//tested against it. Returns the number of nodes skipped.
+		size_t Render(const glm::mat4 &cameraMatrix, const glm::mat4 &cameraToClipMatrix,
+			OcclusionCuller &culler) const;
+
 		NodeRef FindNode(const std::string &nodeName);
 
 		GLuint FindProgram(const std::string &progName);
 
 		Mesh *FindMesh(const std::string &meshName);
 
+		//Hot reload is off until this turns it on, since each scene that has it on holds a
+		//file watcher of its own. If the scene's files cannot be watched, it stays off and a
+		//message is printed; the scene works as before.
+		void SetHotReload(bool bEnable);
+		bool IsHotReloadEnabled() const;
+
+		//With hot reload on, reloads whatever the scene uses that has changed on disk since the
+		//last call. Does nothing and returns false when it is off.
+		//If the scene file itself changed, only the resources it now describes differently
+		//are reloaded. Nothing changes if any of them fail to load. A resource that fails
+		//to reload, such as a shader that no longer compiles, keeps its last good version.
+		//Call this between frames. Program objects from FindProgram may be replaced by it.
+		//Returns true if anything was reloaded.
+		bool ReloadChangedFiles();
+
+		void SetLodSettings(const LodSettings &settings);
+		const LodSettings &GetLodSettings() const;
+
+		const SceneRenderStats &GetRenderStats() const;
+
+		//Finds the nearest node triangle along a world-space ray, using each node's finest mesh.
+		//Bounding volume hierarchies are built for meshes on first use, and for the node
+		//placements whenever nodes have moved since the last pick. Returns false on a miss.
+		bool Pick(const glm::vec3 &rayOrigin, const glm::vec3 &rayDirection, ScenePick &pick) const;
+
 	private:
 		SceneImpl *m_pImpl;
 	};
@@ -11,6 +11,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "Scene.h"
+#include "FrameStats.h"
 
 namespace Framework
 {
@@ -187,6 +188,7 @@ namespace Framework
 			glActiveTexture(GL_TEXTURE0 + m_texUnit);
 			glBindTexture(m_texType, m_texObj);
 			glBindSampler(m_texUnit, m_samplerObj);
+			CountTextureBind();
 		}
 
 		virtual void UnbindState(GLuint prog) const
@@ -221,6 +223,7 @@ namespace Framework
 		{
 			glBindBufferRange(GL_UNIFORM_BUFFER, m_blockIndex, m_unifBuffer,
 				m_buffOffset, m_buffSize);
+			CountUboBind();
 		}
 
 		virtual void UnbindState(GLuint prog) const
@@ -0,0 +1,888 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <string>
+#include <vector>
+#include <set>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <string.h>
+
+#include <glload/gl_all.h>
+#include "framework.h"
+#include "SceneSnapshot.h"
+#include "MappedFile.h"
+#include "NameTable.h"
+
+#include "rapidxml.hpp"
+#include "rapidxml_helpers.h"
+#include "Profiler.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+
+#define PARSE_THROW(cond, message)\
+	if(!(cond))\
+		throw std::runtime_error(message);
+
+
+namespace Framework
+{
+	using rapidxml::xml_document;
+	using rapidxml::xml_node;
+	using rapidxml::xml_attribute;
+	using rapidxml::make_string;
+
+	namespace
+	{
+		void ThrowAttrib(const xml_attribute<> &attrib, const std::string &msg)
+		{
+			std::string name = make_string(attrib);
+			throw std::runtime_error("Attribute " + name + " " + msg);
+		}
+
+		SamplerTypes GetTypeFromName(const std::string &name)
+		{
+			const char *samplerNames[MAX_SAMPLERS] =
+			{
+				"nearest",
+				"linear",
+				"mipmap nearest",
+				"mipmap linear",
+				"anisotropic",
+				"half anisotropic",
+			};
+
+			for(int spl = 0; spl < MAX_SAMPLERS; ++spl)
+			{
+				if(name == samplerNames[spl])
+					return SamplerTypes(spl);
+			}
+
+			throw std::runtime_error("Unknown sampler name: " + name);
+		}
+
+		void ThrowMalformed(const std::string &msg)
+		{
+			throw std::runtime_error("Malformed scene snapshot: " + msg);
+		}
+	}
+
+	namespace snapshot
+	{
+		bool IsSnapshot( const unsigned char *pData, size_t dataSize )
+		{
+			if(dataSize < sizeof(Header))
+				return false;
+
+			unsigned int magic = 0;
+			memcpy(&magic, pData, sizeof(magic));
+			return magic == SNAPSHOT_MAGIC;
+		}
+
+		namespace
+		{
+			void CheckArray(const ArrayRef &arr, size_t recordSize, size_t dataSize, const char *what)
+			{
+				if(arr.offset % 4 != 0)
+					ThrowMalformed(std::string("misaligned ") + what + " array.");
+				if(arr.offset > dataSize || arr.count > (dataSize - arr.offset) / recordSize)
+					ThrowMalformed(std::string(what) + " array is outside of the file.");
+			}
+
+			void CheckSubArray(const ArrayRef &sub, const ArrayRef &parent, size_t recordSize,
+				const char *what)
+			{
+				size_t parentEnd = parent.offset + parent.count * recordSize;
+				if(sub.count == 0)
+					return;
+				if(sub.offset < parent.offset || sub.offset >= parentEnd ||
+					(sub.offset - parent.offset) % recordSize != 0 ||
+					sub.count > (parentEnd - sub.offset) / recordSize)
+					ThrowMalformed(std::string(what) + " range is outside of its table.");
+			}
+
+			void CheckString(const StringRef &str, const unsigned char *pData, size_t dataSize)
+			{
+				if(str.offset >= dataSize || str.length >= dataSize - str.offset)
+					ThrowMalformed("string is outside of the file.");
+				if(pData[str.offset + str.length] != '\0')
+					ThrowMalformed("string is not terminated.");
+			}
+
+			void CheckIndex(unsigned int index, unsigned int count, const char *what)
+			{
+				if(index >= count)
+					ThrowMalformed(std::string(what) + " index out of range.");
+			}
+
+			//Having no more full slots than records leaves an empty slot to end every probe.
+			void CheckNameTable(const ArrayRef &names, const NameSlotRecord *pSlots,
+				unsigned int recordCount, const char *what)
+			{
+				if(names.count <= recordCount || (names.count & (names.count - 1)) != 0)
+					ThrowMalformed(std::string(what) + " name table has the wrong size.");
+
+				unsigned int fullSlots = 0;
+				for(unsigned int slotIx = 0; slotIx < names.count; ++slotIx)
+				{
+					if(pSlots[slotIx].recordIx == NO_RECORD)
+						continue;
+
+					CheckIndex(pSlots[slotIx].recordIx, recordCount, what);
+					++fullSlots;
+				}
+
+				if(fullSlots > recordCount)
+					ThrowMalformed(std::string(what) + " name table has too many entries.");
+			}
+		}
+
+		SnapshotView::SnapshotView( const unsigned char *pData, size_t dataSize )
+			: m_pData(pData)
+			, m_pHeader(reinterpret_cast<const Header *>(pData))
+		{
+			if(!IsSnapshot(pData, dataSize))
+				ThrowMalformed("missing the magic number.");
+			if(m_pHeader->version != SNAPSHOT_VERSION)
+				ThrowMalformed("unknown version.");
+			if(m_pHeader->fileSize != dataSize)
+				ThrowMalformed("the file size does not match the header.");
+
+			const Header &hdr = *m_pHeader;
+			CheckArray(hdr.meshes, sizeof(MeshRecord), dataSize, "mesh");
+			CheckArray(hdr.textures, sizeof(TextureRecord), dataSize, "texture");
+			CheckArray(hdr.programs, sizeof(ProgramRecord), dataSize, "program");
+			CheckArray(hdr.blockBindings, sizeof(BlockBindingRecord), dataSize, "block binding");
+			CheckArray(hdr.samplerBindings, sizeof(SamplerBindingRecord), dataSize, "sampler binding");
+			CheckArray(hdr.nodes, sizeof(NodeRecord), dataSize, "node");
+			CheckArray(hdr.textureBindings, sizeof(TextureBindingRecord), dataSize, "texture binding");
+			CheckArray(hdr.lods, sizeof(LodRecord), dataSize, "level of detail");
+			CheckArray(hdr.meshNames, sizeof(NameSlotRecord), dataSize, "mesh name");
+			CheckArray(hdr.textureNames, sizeof(NameSlotRecord), dataSize, "texture name");
+			CheckArray(hdr.programNames, sizeof(NameSlotRecord), dataSize, "program name");
+			CheckArray(hdr.nodeNames, sizeof(NameSlotRecord), dataSize, "node name");
+
+			CheckNameTable(hdr.meshNames, Array<NameSlotRecord>(hdr.meshNames), hdr.meshes.count, "mesh");
+			CheckNameTable(hdr.textureNames, Array<NameSlotRecord>(hdr.textureNames), hdr.textures.count, "texture");
+			CheckNameTable(hdr.programNames, Array<NameSlotRecord>(hdr.programNames), hdr.programs.count, "program");
+			CheckNameTable(hdr.nodeNames, Array<NameSlotRecord>(hdr.nodeNames), hdr.nodes.count, "node");
+
+			for(unsigned int meshIx = 0; meshIx < hdr.meshes.count; ++meshIx)
+			{
+				const MeshRecord &mesh = Meshes()[meshIx];
+				CheckString(mesh.name, pData, dataSize);
+				CheckString(mesh.file, pData, dataSize);
+				CheckString(mesh.path, pData, dataSize);
+			}
+
+			for(unsigned int texIx = 0; texIx < hdr.textures.count; ++texIx)
+			{
+				const TextureRecord &tex = Textures()[texIx];
+				CheckString(tex.name, pData, dataSize);
+				CheckString(tex.path, pData, dataSize);
+			}
+
+			for(unsigned int progIx = 0; progIx < hdr.programs.count; ++progIx)
+			{
+				const ProgramRecord &prog = Programs()[progIx];
+				CheckString(prog.name, pData, dataSize);
+				CheckString(prog.vertPath, pData, dataSize);
+				CheckString(prog.fragPath, pData, dataSize);
+				CheckString(prog.geomPath, pData, dataSize);
+				CheckString(prog.matrixUnif, pData, dataSize);
+				CheckString(prog.normalMatrixUnif, pData, dataSize);
+				CheckString(prog.lodFadeUnif, pData, dataSize);
+				CheckSubArray(prog.blocks, hdr.blockBindings, sizeof(BlockBindingRecord), "block binding");
+				CheckSubArray(prog.samplers, hdr.samplerBindings, sizeof(SamplerBindingRecord), "sampler binding");
+
+				for(unsigned int blockIx = 0; blockIx < prog.blocks.count; ++blockIx)
+					CheckString(Blocks(prog)[blockIx].blockName, pData, dataSize);
+				for(unsigned int splIx = 0; splIx < prog.samplers.count; ++splIx)
+					CheckString(Samplers(prog)[splIx].samplerName, pData, dataSize);
+			}
+
+			for(unsigned int nodeIx = 0; nodeIx < hdr.nodes.count; ++nodeIx)
+			{
+				const NodeRecord &node = Nodes()[nodeIx];
+				CheckString(node.name, pData, dataSize);
+				CheckIndex(node.meshIx, hdr.meshes.count, "mesh");
+				CheckIndex(node.progIx, hdr.programs.count, "program");
+				CheckSubArray(node.textures, hdr.textureBindings, sizeof(TextureBindingRecord), "texture binding");
+				CheckSubArray(node.lods, hdr.lods, sizeof(LodRecord), "level of detail");
+
+				for(unsigned int bindIx = 0; bindIx < node.textures.count; ++bindIx)
+				{
+					const TextureBindingRecord &binding = TextureBindings(node)[bindIx];
+					CheckIndex(binding.textureIx, hdr.textures.count, "texture");
+					CheckIndex(binding.sampler, MAX_SAMPLERS, "sampler");
+				}
+
+				for(unsigned int lodIx = 0; lodIx < node.lods.count; ++lodIx)
+					CheckIndex(Lods(node)[lodIx].meshIx, hdr.meshes.count, "mesh");
+			}
+		}
+
+		template<typename RecordType>
+		unsigned int SnapshotView::FindRecord( const ArrayRef &names, const ArrayRef &records,
+			const char *name, size_t nameLength ) const
+		{
+			const NameSlotRecord *pSlots = Array<NameSlotRecord>(names);
+			const RecordType *pRecords = Array<RecordType>(records);
+			const unsigned int hash = HashName(name, nameLength);
+			const unsigned int mask = names.count - 1;
+			for(unsigned int slotIx = hash & mask; ; slotIx = (slotIx + 1) & mask)
+			{
+				const NameSlotRecord &slot = pSlots[slotIx];
+				if(slot.recordIx == NO_RECORD)
+					return NO_RECORD;
+
+				const StringRef &recordName = pRecords[slot.recordIx].name;
+				if(slot.hash == hash && recordName.length == nameLength &&
+					memcmp(String(recordName), name, nameLength) == 0)
+				{
+					return slot.recordIx;
+				}
+			}
+		}
+
+		unsigned int SnapshotView::FindMesh( const char *name, size_t nameLength ) const
+		{
+			return FindRecord<MeshRecord>(m_pHeader->meshNames, m_pHeader->meshes, name, nameLength);
+		}
+
+		unsigned int SnapshotView::FindTexture( const char *name, size_t nameLength ) const
+		{
+			return FindRecord<TextureRecord>(m_pHeader->textureNames, m_pHeader->textures, name, nameLength);
+		}
+
+		unsigned int SnapshotView::FindProgram( const char *name, size_t nameLength ) const
+		{
+			return FindRecord<ProgramRecord>(m_pHeader->programNames, m_pHeader->programs, name, nameLength);
+		}
+
+		unsigned int SnapshotView::FindNode( const char *name, size_t nameLength ) const
+		{
+			return FindRecord<NodeRecord>(m_pHeader->nodeNames, m_pHeader->nodes, name, nameLength);
+		}
+
+		namespace
+		{
+			//Builds the snapshot's record tables. All string offsets are relative to the string
+			//blob until Finish is called, which lays out the file and rebases them.
+			class SnapshotBuilder
+			{
+			public:
+				SnapshotBuilder()
+				{
+					//Offset zero is always the empty string.
+					m_strings.push_back('\0');
+				}
+
+				StringRef AddString(const std::string &str)
+				{
+					StringRef ret;
+					ret.offset = (unsigned int)m_strings.size();
+					ret.length = (unsigned int)str.size();
+					m_strings.insert(m_strings.end(), str.begin(), str.end());
+					m_strings.push_back('\0');
+					return ret;
+				}
+
+				StringRef EmptyString() const
+				{
+					StringRef ret = {0, 0};
+					return ret;
+				}
+
+				void Finish(std::vector<unsigned char> &snapshotData)
+				{
+					Header hdr;
+					memset(&hdr, 0, sizeof(Header));
+					hdr.magic = SNAPSHOT_MAGIC;
+					hdr.version = SNAPSHOT_VERSION;
+
+					size_t currOffset = sizeof(Header);
+					hdr.meshes = Place(m_meshes, currOffset);
+					hdr.textures = Place(m_textures, currOffset);
+					hdr.programs = Place(m_programs, currOffset);
+					hdr.blockBindings = Place(m_blocks, currOffset);
+					hdr.samplerBindings = Place(m_samplers, currOffset);
+					hdr.nodes = Place(m_nodes, currOffset);
+					hdr.textureBindings = Place(m_texBindings, currOffset);
+					hdr.lods = Place(m_lods, currOffset);
+
+					std::vector<NameSlotRecord> meshNames, textureNames, programNames, nodeNames;
+					BuildNameTable(m_meshes, meshNames);
+					BuildNameTable(m_textures, textureNames);
+					BuildNameTable(m_programs, programNames);
+					BuildNameTable(m_nodes, nodeNames);
+					hdr.meshNames = Place(meshNames, currOffset);
+					hdr.textureNames = Place(textureNames, currOffset);
+					hdr.programNames = Place(programNames, currOffset);
+					hdr.nodeNames = Place(nodeNames, currOffset);
+
+					const unsigned int stringBase = (unsigned int)currOffset;
+					hdr.fileSize = (unsigned int)(currOffset + m_strings.size());
+
+					for(size_t ix = 0; ix < m_meshes.size(); ++ix)
+					{
+						Rebase(m_meshes[ix].name, stringBase);
+						Rebase(m_meshes[ix].file, stringBase);
+						Rebase(m_meshes[ix].path, stringBase);
+					}
+
+					for(size_t ix = 0; ix < m_textures.size(); ++ix)
+					{
+						Rebase(m_textures[ix].name, stringBase);
+						Rebase(m_textures[ix].path, stringBase);
+					}
+
+					for(size_t ix = 0; ix < m_programs.size(); ++ix)
+					{
+						ProgramRecord &prog = m_programs[ix];
+						Rebase(prog.name, stringBase);
+						Rebase(prog.vertPath, stringBase);
+						Rebase(prog.fragPath, stringBase);
+						Rebase(prog.geomPath, stringBase);
+						Rebase(prog.matrixUnif, stringBase);
+						Rebase(prog.normalMatrixUnif, stringBase);
+						Rebase(prog.lodFadeUnif, stringBase);
+						prog.blocks.offset = hdr.blockBindings.offset +
+							prog.blocks.offset * sizeof(BlockBindingRecord);
+						prog.samplers.offset = hdr.samplerBindings.offset +
+							prog.samplers.offset * sizeof(SamplerBindingRecord);
+					}
+
+					for(size_t ix = 0; ix < m_blocks.size(); ++ix)
+						Rebase(m_blocks[ix].blockName, stringBase);
+
+					for(size_t ix = 0; ix < m_samplers.size(); ++ix)
+						Rebase(m_samplers[ix].samplerName, stringBase);
+
+					for(size_t ix = 0; ix < m_nodes.size(); ++ix)
+					{
+						Rebase(m_nodes[ix].name, stringBase);
+						m_nodes[ix].textures.offset = hdr.textureBindings.offset +
+							m_nodes[ix].textures.offset * sizeof(TextureBindingRecord);
+						m_nodes[ix].lods.offset = hdr.lods.offset +
+							m_nodes[ix].lods.offset * sizeof(LodRecord);
+					}
+
+					snapshotData.clear();
+					snapshotData.resize(hdr.fileSize, 0);
+					memcpy(&snapshotData[0], &hdr, sizeof(Header));
+					Copy(m_meshes, hdr.meshes, snapshotData);
+					Copy(m_textures, hdr.textures, snapshotData);
+					Copy(m_programs, hdr.programs, snapshotData);
+					Copy(m_blocks, hdr.blockBindings, snapshotData);
+					Copy(m_samplers, hdr.samplerBindings, snapshotData);
+					Copy(m_nodes, hdr.nodes, snapshotData);
+					Copy(m_texBindings, hdr.textureBindings, snapshotData);
+					Copy(m_lods, hdr.lods, snapshotData);
+					Copy(meshNames, hdr.meshNames, snapshotData);
+					Copy(textureNames, hdr.textureNames, snapshotData);
+					Copy(programNames, hdr.programNames, snapshotData);
+					Copy(nodeNames, hdr.nodeNames, snapshotData);
+					memcpy(&snapshotData[stringBase], &m_strings[0], m_strings.size());
+				}
+
+				std::vector<MeshRecord> m_meshes;
+				std::vector<TextureRecord> m_textures;
+				std::vector<ProgramRecord> m_programs;
+				std::vector<BlockBindingRecord> m_blocks;
+				std::vector<SamplerBindingRecord> m_samplers;
+				std::vector<NodeRecord> m_nodes;
+				std::vector<TextureBindingRecord> m_texBindings;
+				std::vector<LodRecord> m_lods;
+
+			private:
+				std::vector<char> m_strings;
+
+				template<typename RecordType>
+				static ArrayRef Place(const std::vector<RecordType> &records, size_t &currOffset)
+				{
+					ArrayRef ret;
+					ret.offset = (unsigned int)currOffset;
+					ret.count = (unsigned int)records.size();
+					currOffset += records.size() * sizeof(RecordType);
+					return ret;
+				}
+
+				template<typename RecordType>
+				static void Copy(const std::vector<RecordType> &records, const ArrayRef &arr,
+					std::vector<unsigned char> &snapshotData)
+				{
+					if(!records.empty())
+						memcpy(&snapshotData[arr.offset], &records[0], records.size() * sizeof(RecordType));
+				}
+
+				static void Rebase(StringRef &str, unsigned int stringBase)
+				{
+					str.offset += stringBase;
+				}
+
+				//Must run before the names are rebased. The table is at least twice the record count.
+				template<typename RecordType>
+				void BuildNameTable(const std::vector<RecordType> &records, std::vector<NameSlotRecord> &slots) const
+				{
+					size_t tableSize = 1;
+					while(tableSize < records.size() * 2 + 1)
+						tableSize *= 2;
+
+					NameSlotRecord emptySlot = {0, NO_RECORD};
+					slots.assign(tableSize, emptySlot);
+
+					const unsigned int mask = (unsigned int)tableSize - 1;
+					for(size_t recordIx = 0; recordIx < records.size(); ++recordIx)
+					{
+						const StringRef &name = records[recordIx].name;
+						const unsigned int hash = HashName(&m_strings[name.offset], name.length);
+
+						unsigned int slotIx = hash & mask;
+						while(slots[slotIx].recordIx != NO_RECORD)
+							slotIx = (slotIx + 1) & mask;
+
+						slots[slotIx].hash = hash;
+						slots[slotIx].recordIx = (unsigned int)recordIx;
+					}
+				}
+			};
+
+			class XmlSceneCooker
+			{
+			public:
+				XmlSceneCooker(const xml_node<> &scene)
+				{
+					ReadMeshes(scene);
+					ReadTextures(scene);
+					ReadPrograms(scene);
+					ReadNodes(scene);
+				}
+
+				void Finish(std::vector<unsigned char> &snapshotData)
+				{
+					m_builder.Finish(snapshotData);
+				}
+
+			private:
+				SnapshotBuilder m_builder;
+
+				//Each maps a name to its record's index.
+				NameTable<unsigned int> m_meshes;
+				NameTable<unsigned int> m_textures;
+				NameTable<unsigned int> m_progs;
+				NameTable<unsigned int> m_nodes;
+
+				void ReadMeshes(const xml_node<> &scene)
+				{
+					for(const xml_node<> *pMeshNode = scene.first_node("mesh");
+						pMeshNode;
+						pMeshNode = pMeshNode->next_sibling("mesh"))
+					{
+						ReadMesh(*pMeshNode);
+					}
+				}
+
+				void ReadMesh(const xml_node<> &meshNode)
+				{
+					const xml_attribute<> *pNameNode = meshNode.first_attribute("xml:id");
+					const xml_attribute<> *pFilenameNode = meshNode.first_attribute("file");
+
+					PARSE_THROW(pNameNode, "Mesh found with no `xml:id` name specified.");
+					PARSE_THROW(pFilenameNode, "Mesh found with no `file` filename specified.");
+
+					std::string name = make_string(*pNameNode);
+					if(!m_meshes.Insert(name, (unsigned int)m_builder.m_meshes.size()))
+						throw std::runtime_error("The mesh named \"" + name + "\" already exists.");
+
+					std::string filename = make_string(*pFilenameNode);
+
+					MeshRecord mesh;
+					mesh.name = m_builder.AddString(name);
+					mesh.file = m_builder.AddString(filename);
+					mesh.path = m_builder.AddString(FindFileOrThrow(filename));
+					m_builder.m_meshes.push_back(mesh);
+				}
+
+				void ReadTextures(const xml_node<> &scene)
+				{
+					for(const xml_node<> *pTexNode = scene.first_node("texture");
+						pTexNode;
+						pTexNode = pTexNode->next_sibling("texture"))
+					{
+						ReadTexture(*pTexNode);
+					}
+				}
+
+				void ReadTexture(const xml_node<> &texNode)
+				{
+					const xml_attribute<> *pNameNode = texNode.first_attribute("xml:id");
+					const xml_attribute<> *pFilenameNode = texNode.first_attribute("file");
+
+					PARSE_THROW(pNameNode, "Texture found with no `xml:id` name specified.");
+					PARSE_THROW(pFilenameNode, "Texture found with no `file` filename specified.");
+
+					std::string name = make_string(*pNameNode);
+					if(!m_textures.Insert(name, (unsigned int)m_builder.m_textures.size()))
+						throw std::runtime_error("The texture named \"" + name + "\" already exists.");
+
+					TextureRecord texture;
+					texture.name = m_builder.AddString(name);
+					texture.path = m_builder.AddString(FindFileOrThrow(make_string(*pFilenameNode)));
+					texture.flags = 0;
+					if(rapidxml::get_attrib_bool(texNode, "srgb"))
+						texture.flags |= TEX_SRGB;
+					m_builder.m_textures.push_back(texture);
+				}
+
+				void ReadPrograms(const xml_node<> &scene)
+				{
+					for(const xml_node<> *pProgNode = scene.first_node("prog");
+						pProgNode;
+						pProgNode = pProgNode->next_sibling("prog"))
+					{
+						ReadProgram(*pProgNode);
+					}
+				}
+
+				void ReadProgram(const xml_node<> &progNode)
+				{
+					const xml_attribute<> *pNameNode = progNode.first_attribute("xml:id");
+					const xml_attribute<> *pVertexShaderNode = progNode.first_attribute("vert");
+					const xml_attribute<> *pFragmentShaderNode = progNode.first_attribute("frag");
+					const xml_attribute<> *pModelMatrixNode = progNode.first_attribute("model-to-camera");
+
+					PARSE_THROW(pNameNode, "Program found with no `xml:id` name specified.");
+					PARSE_THROW(pVertexShaderNode, "Program found with no `vert` vertex shader specified.");
+					PARSE_THROW(pFragmentShaderNode, "Program found with no `frag` fragment shader specified.");
+					PARSE_THROW(pModelMatrixNode, "Program found with no model-to-camera matrix uniform name specified.");
+
+					//Optional.
+					const xml_attribute<> *pNormalMatrixNode = progNode.first_attribute("normal-model-to-camera");
+					const xml_attribute<> *pGeometryShaderNode = progNode.first_attribute("geom");
+					const xml_attribute<> *pLodFadeNode = progNode.first_attribute("lod-fade");
+
+					std::string name = make_string(*pNameNode);
+					if(!m_progs.Insert(name, (unsigned int)m_builder.m_programs.size()))
+						throw std::runtime_error("The program named \"" + name + "\" already exists.");
+
+					ProgramRecord prog;
+					prog.name = m_builder.AddString(name);
+					prog.vertPath = m_builder.AddString(FindFileOrThrow(make_string(*pVertexShaderNode)));
+					prog.fragPath = m_builder.AddString(FindFileOrThrow(make_string(*pFragmentShaderNode)));
+					prog.geomPath = pGeometryShaderNode ?
+						m_builder.AddString(FindFileOrThrow(make_string(*pGeometryShaderNode))) :
+						m_builder.EmptyString();
+					prog.matrixUnif = m_builder.AddString(make_string(*pModelMatrixNode));
+					prog.normalMatrixUnif = pNormalMatrixNode ?
+						m_builder.AddString(make_string(*pNormalMatrixNode)) : m_builder.EmptyString();
+					prog.lodFadeUnif = pLodFadeNode ?
+						m_builder.AddString(make_string(*pLodFadeNode)) : m_builder.EmptyString();
+
+					//Table-relative for now; the builder turns these into file offsets.
+					prog.blocks.offset = (unsigned int)m_builder.m_blocks.size();
+					prog.samplers.offset = (unsigned int)m_builder.m_samplers.size();
+
+					ReadProgramContents(progNode);
+
+					prog.blocks.count = (unsigned int)m_builder.m_blocks.size() - prog.blocks.offset;
+					prog.samplers.count = (unsigned int)m_builder.m_samplers.size() - prog.samplers.offset;
+
+					m_builder.m_programs.push_back(prog);
+				}
+
+				void ReadProgramContents(const xml_node<> &progNode)
+				{
+					std::set<std::string> blockBindings;
+					std::set<std::string> samplerBindings;
+
+					for(const xml_node<> *pChildNode = progNode.first_node();
+						pChildNode;
+						pChildNode = pChildNode->next_sibling())
+					{
+						if(pChildNode->type() != rapidxml::node_element)
+							continue;
+
+						const std::string childName = std::string(pChildNode->name(), pChildNode->name_size());
+						if(childName == "block")
+						{
+							const xml_attribute<> *pNameNode = pChildNode->first_attribute("name");
+							const xml_attribute<> *pBindingNode = pChildNode->first_attribute("binding");
+
+							PARSE_THROW(pNameNode, "Program `block` element with no `name`.");
+							PARSE_THROW(pBindingNode, "Program `block` element with no `binding`.");
+
+							std::string name = make_string(*pNameNode);
+							if(blockBindings.find(name) != blockBindings.end())
+								throw std::runtime_error("The uniform block " + name + " is used twice in the same program.");
+
+							blockBindings.insert(name);
+
+							BlockBindingRecord block;
+							block.blockName = m_builder.AddString(name);
+							block.bindPoint = rapidxml::attrib_to_int(*pBindingNode, ThrowAttrib);
+							m_builder.m_blocks.push_back(block);
+						}
+						else if(childName == "sampler")
+						{
+							const xml_attribute<> *pNameNode = pChildNode->first_attribute("name");
+							const xml_attribute<> *pTexunitNode = pChildNode->first_attribute("unit");
+
+							PARSE_THROW(pNameNode, "Program `sampler` element with no `name`.");
+							PARSE_THROW(pTexunitNode, "Program `sampler` element with no `unit`.");
+
+							std::string name = make_string(*pNameNode);
+							if(samplerBindings.find(name) != samplerBindings.end())
+								throw std::runtime_error("A sampler " + name + " is used twice within the same program.");
+
+							samplerBindings.insert(name);
+
+							SamplerBindingRecord sampler;
+							sampler.samplerName = m_builder.AddString(name);
+							sampler.texUnit = rapidxml::attrib_to_int(*pTexunitNode, ThrowAttrib);
+							m_builder.m_samplers.push_back(sampler);
+						}
+						else
+						{
+							//Bad node. Die.
+							throw std::runtime_error("Unknown element found in program.");
+						}
+					}
+				}
+
+				void ReadNodes(const xml_node<> &scene)
+				{
+					for(const xml_node<> *pNodeNode = scene.first_node("node");
+						pNodeNode;
+						pNodeNode = pNodeNode->next_sibling("node"))
+					{
+						ReadNode(*pNodeNode);
+					}
+				}
+
+				void ReadNode(const xml_node<> &nodeNode)
+				{
+					const xml_attribute<> *pNameNode = nodeNode.first_attribute("name");
+					const xml_attribute<> *pMeshNode = nodeNode.first_attribute("mesh");
+					const xml_attribute<> *pProgNode = nodeNode.first_attribute("prog");
+
+					PARSE_THROW(pNameNode, "Node found with no `name` name specified.");
+					PARSE_THROW(pMeshNode, "Node found with no `mesh` name specified.");
+					PARSE_THROW(pProgNode, "Node found with no `prog` name specified.");
+
+					const xml_attribute<> *pPositionNode = nodeNode.first_attribute("pos");
+					const xml_attribute<> *pOrientNode = nodeNode.first_attribute("orient");
+					const xml_attribute<> *pScaleNode = nodeNode.first_attribute("scale");
+
+					PARSE_THROW(pPositionNode, "Node found with no `pos` specified.");
+
+					std::string name = make_string(*pNameNode);
+					if(!m_nodes.Insert(name, (unsigned int)m_builder.m_nodes.size()))
+						throw std::runtime_error("The node named \"" + name + "\" already exists.");
+
+					std::string meshName = make_string(*pMeshNode);
+					const unsigned int *pMeshIx = m_meshes.Find(meshName);
+					if(!pMeshIx)
+					{
+						throw std::runtime_error("The node named \"" + name +
+							"\" references the mesh \"" + meshName + "\" which does not exist.");
+					}
+
+					std::string progName = make_string(*pProgNode);
+					const unsigned int *pProgIx = m_progs.Find(progName);
+					if(!pProgIx)
+					{
+						throw std::runtime_error("The node named \"" + name +
+							"\" references the program \"" + progName + "\" which does not exist.");
+					}
+
+					NodeRecord node;
+					node.name = m_builder.AddString(name);
+					node.meshIx = *pMeshIx;
+					node.progIx = *pProgIx;
+
+					glm::vec3 nodePos = rapidxml::attrib_to_vec3(*pPositionNode, ThrowAttrib);
+					node.trans[0] = nodePos.x;
+					node.trans[1] = nodePos.y;
+					node.trans[2] = nodePos.z;
+
+					glm::fquat orient(1.0f, 0.0f, 0.0f, 0.0f);
+					if(pOrientNode)
+						orient = rapidxml::attrib_to_quat(*pOrientNode, ThrowAttrib);
+					node.orient[0] = orient.x;
+					node.orient[1] = orient.y;
+					node.orient[2] = orient.z;
+					node.orient[3] = orient.w;
+
+					glm::vec3 scale(1.0f);
+					if(pScaleNode)
+					{
+						if(rapidxml::attrib_is_vec3(*pScaleNode))
+							scale = rapidxml::attrib_to_vec3(*pScaleNode, ThrowAttrib);
+						else
+							scale = glm::vec3(rapidxml::attrib_to_float(*pScaleNode, ThrowAttrib));
+					}
+					node.scale[0] = scale.x;
+					node.scale[1] = scale.y;
+					node.scale[2] = scale.z;
+
+					node.flags = 0;
+					if(rapidxml::get_attrib_bool(nodeNode, "occluder"))
+						node.flags |= NODE_OCCLUDER;
+
+					node.textures.offset = (unsigned int)m_builder.m_texBindings.size();
+					ReadNodeTextures(nodeNode);
+					node.textures.count = (unsigned int)m_builder.m_texBindings.size() - node.textures.offset;
+
+					node.lods.offset = (unsigned int)m_builder.m_lods.size();
+					ReadNodeLods(nodeNode, name);
+					node.lods.count = (unsigned int)m_builder.m_lods.size() - node.lods.offset;
+
+					ReadNodeNotes(nodeNode);
+
+					m_builder.m_nodes.push_back(node);
+				}
+
+				void ReadNodeNotes(const xml_node<> &nodeNode)
+				{
+					for(const xml_node<> *pNoteNode = nodeNode.first_node("note");
+						pNoteNode;
+						pNoteNode = pNoteNode->next_sibling("note"))
+					{
+						const xml_node<> &noteNode = *pNoteNode;
+						const xml_attribute<> *pNameNode = noteNode.first_attribute("name");
+						PARSE_THROW(pNameNode, "Notations on nodes must have a `name` attribute.");
+					}
+				}
+
+				void ReadNodeLods(const xml_node<> &nodeNode, const std::string &nodeName)
+				{
+					float prevError = 0.0f;
+					for(const xml_node<> *pLodNode = nodeNode.first_node("lod");
+						pLodNode;
+						pLodNode = pLodNode->next_sibling("lod"))
+					{
+						const xml_node<> &lodNode = *pLodNode;
+						const xml_attribute<> *pMeshNode = lodNode.first_attribute("mesh");
+						const xml_attribute<> *pErrorNode = lodNode.first_attribute("error");
+
+						PARSE_THROW(pMeshNode, "Levels of detail on nodes must have a `mesh` attribute.");
+						PARSE_THROW(pErrorNode, "Levels of detail on nodes must have an `error` attribute.");
+
+						std::string meshName = make_string(*pMeshNode);
+						const unsigned int *pMeshIx = m_meshes.Find(meshName);
+						if(!pMeshIx)
+						{
+							throw std::runtime_error("The node named \"" + nodeName +
+								"\" has a level of detail using the mesh \"" + meshName + "\" which does not exist.");
+						}
+
+						LodRecord lod;
+						lod.meshIx = *pMeshIx;
+						lod.geometricError = rapidxml::attrib_to_float(*pErrorNode, ThrowAttrib);
+						if(lod.geometricError <= prevError)
+						{
+							throw std::runtime_error("The levels of detail of the node named \"" + nodeName +
+								"\" must have increasing, positive errors.");
+						}
+
+						prevError = lod.geometricError;
+						m_builder.m_lods.push_back(lod);
+					}
+				}
+
+				void ReadNodeTextures(const xml_node<> &nodeNode)
+				{
+					std::set<unsigned int> texUnits;
+
+					for(const xml_node<> *pTexNode = nodeNode.first_node("texture");
+						pTexNode;
+						pTexNode = pTexNode->next_sibling("texture"))
+					{
+						const xml_node<> &texNode = *pTexNode;
+						const xml_attribute<> *pNameNode = texNode.first_attribute("name");
+						const xml_attribute<> *pUnitName = texNode.first_attribute("unit");
+						const xml_attribute<> *pSamplerName = texNode.first_attribute("sampler");
+
+						PARSE_THROW(pNameNode, "Textures on nodes must have a `name` attribute.");
+						PARSE_THROW(pUnitName, "Textures on nodes must have a `unit` attribute.");
+						PARSE_THROW(pSamplerName, "Textures on nodes must have a `sampler` attribute.");
+
+						std::string textureName = make_string(*pNameNode);
+						const unsigned int *pTexIx = m_textures.Find(textureName);
+						if(!pTexIx)
+						{
+							throw std::runtime_error("The node texture named \"" + textureName +
+								"\" is a texture which does not exist.");
+						}
+
+						TextureBindingRecord binding;
+						binding.textureIx = *pTexIx;
+						binding.texUnit = rapidxml::attrib_to_int(*pUnitName, ThrowAttrib);
+						binding.sampler = GetTypeFromName(make_string(*pSamplerName));
+
+						if(texUnits.find(binding.texUnit) != texUnits.end())
+							throw std::runtime_error("Multiply bound texture unit in node texture " + textureName);
+
+						m_builder.m_texBindings.push_back(binding);
+
+						texUnits.insert(binding.texUnit);
+					}
+				}
+			};
+		}
+
+		void CookFromXml( const char *pXmlData, size_t dataSize, const std::string &filename,
+			std::vector<unsigned char> &snapshotData )
+		{
+			PROFILE_SCOPE("CookFromXml");
+			//rapidxml parses in place, so it needs its own terminated copy.
+			std::vector<char> fileData;
+			fileData.reserve(dataSize + 1);
+			fileData.insert(fileData.end(), pXmlData, pXmlData + dataSize);
+			fileData.push_back('\0');
+
+			xml_document<> doc;
+
+			try
+			{
+				doc.parse<0>(&fileData[0]);
+			}
+			catch(rapidxml::parse_error &e)
+			{
+				std::cout << filename << ": Parse error in scene file." << std::endl;
+				std::cout << e.what() << std::endl << e.where<char>() << std::endl;
+				throw;
+			}
+
+			xml_node<> *pSceneNode = doc.first_node("scene");
+			PARSE_THROW(pSceneNode, "Scene node not found in scene file.");
+
+			XmlSceneCooker cooker(*pSceneNode);
+			cooker.Finish(snapshotData);
+		}
+	}
+
+	void CookScene( const std::string &xmlFilename, const std::string &snapshotFilename )
+	{
+		std::string pathname = FindFileOrThrow(xmlFilename);
+		MappedFile sceneFile(pathname);
+
+		std::vector<unsigned char> snapshotData;
+		snapshot::CookFromXml(reinterpret_cast<const char *>(sceneFile.GetData()),
+			sceneFile.GetSize(), xmlFilename, snapshotData);
+
+		std::ofstream outFile(snapshotFilename.c_str(), std::ios::binary);
+		if(!outFile.is_open())
+			throw std::runtime_error("Could not create the scene snapshot " + snapshotFilename);
+
+		outFile.write(reinterpret_cast<const char *>(&snapshotData[0]), snapshotData.size());
+		if(!outFile)
+			throw std::runtime_error("Could not write the scene snapshot " + snapshotFilename);
+	}
+}
@@ -0,0 +1,235 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+
+#ifndef FRAMEWORK_SCENE_SNAPSHOT_H
+#define FRAMEWORK_SCENE_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+
+namespace Framework
+{
+	enum SamplerTypes
+	{
+		SPL_NEAREST,
+		SPL_LINEAR,
+		SPL_MIPMAP_NEAREST,
+		SPL_MIPMAP_LINEAR,
+		SPL_ANISOTROPIC,
+		SPL_HALF_ANISOTROPIC,
+
+		MAX_SAMPLERS,
+	};
+
+	/**
+	A cooked scene is the XML scene file with every name reference already resolved
+	to an index. The file is a single flat block: a Header, followed by the record
+	arrays, followed by a blob of NUL-terminated strings. Every reference inside the
+	file is a byte offset from the start of the file, so the whole thing can be mapped
+	into memory at any address and used in place.
+
+	The strings that remain are only the ones that must be handed to the file system
+	or to OpenGL: resource pathnames, uniform names, and the names used by Scene::Find*.
+	Cooking does everything else that needs strings. It finds each resource file with
+	FindFileOrThrow and stores the pathname found, so a snapshot must be loaded from the
+	directory it was cooked in. It rejects duplicate names, and it stores a hash table of
+	each kind of record by name. Loading therefore compares no strings.
+	**/
+	namespace snapshot
+	{
+		enum
+		{
+			SNAPSHOT_MAGIC		= 0x424E4353,	//"SCNB"
+			SNAPSHOT_VERSION	= 4,
+		};
+
+		//An index that refers to no record.
+		static const unsigned int NO_RECORD = 0xFFFFFFFF;
+
+		enum TextureFlags
+		{
+			TEX_SRGB			= 0x0001,
+		};
+
+		enum NodeFlags
+		{
+			NODE_OCCLUDER		= 0x0001,
+		};
+
+		struct StringRef
+		{
+			unsigned int offset;	//From the start of the file.
+			unsigned int length;	//Not counting the terminating NUL.
+		};
+
+		struct ArrayRef
+		{
+			unsigned int offset;	//From the start of the file.
+			unsigned int count;
+		};
+
+		struct Header
+		{
+			unsigned int magic;
+			unsigned int version;
+			unsigned int fileSize;
+
+			ArrayRef meshes;			//MeshRecord
+			ArrayRef textures;			//TextureRecord
+			ArrayRef programs;			//ProgramRecord
+			ArrayRef blockBindings;		//BlockBindingRecord
+			ArrayRef samplerBindings;	//SamplerBindingRecord
+			ArrayRef nodes;				//NodeRecord
+			ArrayRef textureBindings;	//TextureBindingRecord
+			ArrayRef lods;				//LodRecord
+
+			//NameSlotRecord. Each is a hash table of the records above by name.
+			ArrayRef meshNames;
+			ArrayRef textureNames;
+			ArrayRef programNames;
+			ArrayRef nodeNames;
+		};
+
+		//Every record type starts with its name.
+		struct MeshRecord
+		{
+			StringRef name;
+			StringRef file;				//As the scene names it.
+			StringRef path;				//As FindFileOrThrow found it.
+		};
+
+		struct TextureRecord
+		{
+			StringRef name;
+			StringRef path;
+			unsigned int flags;			//TextureFlags
+		};
+
+		struct ProgramRecord
+		{
+			StringRef name;
+			StringRef vertPath;
+			StringRef fragPath;
+			StringRef geomPath;			//Empty if there is no geometry shader.
+			StringRef matrixUnif;
+			StringRef normalMatrixUnif;	//Empty if there is no normal matrix.
+			StringRef lodFadeUnif;		//Empty if the program cannot cross-fade levels of detail.
+			ArrayRef blocks;			//Into Header::blockBindings.
+			ArrayRef samplers;			//Into Header::samplerBindings.
+		};
+
+		struct BlockBindingRecord
+		{
+			StringRef blockName;
+			int bindPoint;
+		};
+
+		struct SamplerBindingRecord
+		{
+			StringRef samplerName;
+			int texUnit;
+		};
+
+		struct NodeRecord
+		{
+			StringRef name;
+			unsigned int meshIx;
+			unsigned int progIx;
+			float trans[3];
+			float orient[4];			//x, y, z, w
+			float scale[3];
+			unsigned int flags;			//NodeFlags
+			ArrayRef textures;			//Into Header::textureBindings.
+			ArrayRef lods;				//Into Header::lods. The levels after meshIx, coarsest last.
+		};
+
+		struct TextureBindingRecord
+		{
+			unsigned int textureIx;
+			unsigned int texUnit;
+			unsigned int sampler;		//SamplerTypes
+		};
+
+		struct LodRecord
+		{
+			unsigned int meshIx;
+			float geometricError;		//In the node's model space. Increases along a node's levels.
+		};
+
+		//A slot of an open-addressed hash table with linear probing. The table's size is a
+		//power of two, larger than its record count. The hash is HashName of the record's name.
+		struct NameSlotRecord
+		{
+			unsigned int hash;
+			unsigned int recordIx;		//NO_RECORD if the slot is empty.
+		};
+
+		//True if the memory starts with a snapshot header.
+		bool IsSnapshot(const unsigned char *pData, size_t dataSize);
+
+		//Checks every offset, count, and index of the snapshot against its size once,
+		//so that the accessors can be used without further checking.
+		//Throws a std::runtime_error if the data is not a valid snapshot.
+		class SnapshotView
+		{
+		public:
+			//Views nothing, until a real view is assigned to it.
+			SnapshotView() : m_pData(NULL), m_pHeader(NULL) {}
+			SnapshotView(const unsigned char *pData, size_t dataSize);
+
+			const Header &GetHeader() const {return *m_pHeader;}
+
+			const MeshRecord *Meshes() const {return Array<MeshRecord>(m_pHeader->meshes);}
+			const TextureRecord *Textures() const {return Array<TextureRecord>(m_pHeader->textures);}
+			const ProgramRecord *Programs() const {return Array<ProgramRecord>(m_pHeader->programs);}
+			const NodeRecord *Nodes() const {return Array<NodeRecord>(m_pHeader->nodes);}
+
+			const BlockBindingRecord *Blocks(const ProgramRecord &prog) const
+			{return Array<BlockBindingRecord>(prog.blocks);}
+			const SamplerBindingRecord *Samplers(const ProgramRecord &prog) const
+			{return Array<SamplerBindingRecord>(prog.samplers);}
+			const TextureBindingRecord *TextureBindings(const NodeRecord &node) const
+			{return Array<TextureBindingRecord>(node.textures);}
+			const LodRecord *Lods(const NodeRecord &node) const
+			{return Array<LodRecord>(node.lods);}
+
+			const char *String(const StringRef &str) const
+			{return reinterpret_cast<const char *>(m_pData + str.offset);}
+
+			//Each returns the index of the record with the name, or NO_RECORD.
+			unsigned int FindMesh(const char *name, size_t nameLength) const;
+			unsigned int FindTexture(const char *name, size_t nameLength) const;
+			unsigned int FindProgram(const char *name, size_t nameLength) const;
+			unsigned int FindNode(const char *name, size_t nameLength) const;
+
+		private:
+			const unsigned char *m_pData;
+			const Header *m_pHeader;
+
+			template<typename RecordType>
+			const RecordType *Array(const ArrayRef &arr) const
+			{
+				return reinterpret_cast<const RecordType *>(m_pData + arr.offset);
+			}
+
+			template<typename RecordType>
+			unsigned int FindRecord(const ArrayRef &names, const ArrayRef &records,
+				const char *name, size_t nameLength) const;
+		};
+
+		//Parses an XML scene in memory and returns the equivalent snapshot. The filename
+		//is only used for error messages. Every file the scene uses must be found.
+		//Throws a std::runtime_error on any error in the scene.
+		void CookFromXml(const char *pXmlData, size_t dataSize, const std::string &filename,
+			std::vector<unsigned char> &snapshotData);
+	}
+
+	//Reads the XML scene file and writes the cooked snapshot of it to snapshotFilename.
+	//Scene will load either kind of file. The snapshot holds the pathnames of the files
+	//the scene uses, as found from the current directory.
+	void CookScene(const std::string &xmlFilename, const std::string &snapshotFilename);
+}
+
+#endif //FRAMEWORK_SCENE_SNAPSHOT_H
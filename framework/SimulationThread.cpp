@@ -0,0 +1,143 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+#include "SimulationThread.h"
+#include "Profiler.h"
+
+namespace Framework
+{
+	namespace
+	{
+		bool g_bSimulationThreadRequested = false;
+	}
+
+	SimulationThread::SimulationThread( double ticksPerSecond )
+		: m_loop(ticksPerSecond, ticksPerSecond)
+		, m_bStopping(false)
+		, m_stepNanoseconds(0)
+		, m_countedNanoseconds(0)
+	{}
+
+	SimulationThread::~SimulationThread()
+	{
+		try
+		{
+			Stop();
+		}
+		catch(...)
+		{
+		}
+	}
+
+	void SimulationThread::Start( const StepFunc &step )
+	{
+		if(IsRunning())
+			throw std::runtime_error("The simulation thread is already running.");
+
+		m_step = step;
+		m_bStopping = false;
+		m_error = std::exception_ptr();
+		m_thread = std::thread(&SimulationThread::ThreadLoop, this);
+	}
+
+	void SimulationThread::Stop()
+	{
+		if(!IsRunning())
+			return;
+
+		m_bStopping = true;
+		m_thread.join();
+
+		if(m_error)
+		{
+			std::exception_ptr error = m_error;
+			m_error = std::exception_ptr();
+			std::rethrow_exception(error);
+		}
+	}
+
+	void SimulationThread::ThreadLoop()
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		profile::SetThreadName("Simulation");
+		try
+		{
+			while(!m_bStopping)
+			{
+				m_loop.WaitForNextFrame();
+
+				Clock::time_point start = Clock::now();
+				m_step(m_loop);
+				m_stepNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+					Clock::now() - start).count();
+			}
+		}
+		catch(...)
+		{
+			m_error = std::current_exception();
+		}
+	}
+
+	void SimulationThread::PostInput( const InputEvent &event )
+	{
+		std::lock_guard<std::mutex> lock(m_inputMutex);
+		m_postedInput.push_back(event);
+	}
+
+	void SimulationThread::TakeInput( std::vector<InputEvent> &events )
+	{
+		events.clear();
+		std::lock_guard<std::mutex> lock(m_inputMutex);
+		events.swap(m_postedInput);
+	}
+
+	void SimulationThread::CountHiddenTime()
+	{
+		unsigned long long total = m_stepNanoseconds;
+		m_hiddenTimes.Add((total - m_countedNanoseconds) / 1.0e6f);
+		m_countedNanoseconds = total;
+	}
+
+	void SimulationThread::WriteHistograms( std::ostream &out,
+		const FrameTimeHistogram &renderWorkTimes ) const
+	{
+		float hidden = m_hiddenTimes.GetMean();
+		float render = renderWorkTimes.GetMean();
+		float hiddenShare = (hidden + render) > 0.0f ? hidden / (hidden + render) : 0.0f;
+
+		out << "histogram,samples,mean,p50,p95,p99,max\n";
+		out << "hidden-ms," << m_hiddenTimes.GetSampleCount() << "," << hidden << "," <<
+			m_hiddenTimes.GetPercentile(0.50f) << "," << m_hiddenTimes.GetPercentile(0.95f) << "," <<
+			m_hiddenTimes.GetPercentile(0.99f) << "," << m_hiddenTimes.GetMax() << "\n";
+		out << "render-work-ms," << renderWorkTimes.GetSampleCount() << "," << render << "," <<
+			renderWorkTimes.GetPercentile(0.50f) << "," << renderWorkTimes.GetPercentile(0.95f) << "," <<
+			renderWorkTimes.GetPercentile(0.99f) << "," << renderWorkTimes.GetMax() << "\n";
+		out << "hidden-share," << hiddenShare << "\n";
+
+		out << "\nhidden-ms,count\n";
+		m_hiddenTimes.WriteCsv(out);
+	}
+
+	bool ParseSimulationThreadArgs( int argc, char **argv )
+	{
+		for(int argIx = 1; argIx < argc; ++argIx)
+		{
+			if(std::string(argv[argIx]) == "--sim-thread")
+				g_bSimulationThreadRequested = true;
+		}
+		return g_bSimulationThreadRequested;
+	}
+
+	bool IsSimulationThreadRequested()
+	{
+		return g_bSimulationThreadRequested;
+	}
+}
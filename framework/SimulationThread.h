@@ -0,0 +1,103 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_SIMULATION_THREAD_H
+#define FRAMEWORK_SIMULATION_THREAD_H
+
+#include <vector>
+#include <ostream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <functional>
+#include "FrameLoop.h"
+#include "InputLog.h"
+
+namespace Framework
+{
+	/**
+	Runs the simulation on a thread of its own, so the GL thread only draws.
+
+	The thread calls the step function over and over, paced by its own FrameLoop. A step
+	takes the input the GL thread has posted since the last one, runs the loop's ticks, and
+	publishes what is to be drawn, usually into a TripleBuffer the GL thread reads from. The
+	step must not touch OpenGL, nor anything the GL thread touches other than through the
+	buffer.
+
+	Input is posted under a mutex that is only held to add or take events, so neither side
+	waits on the other's work.
+
+	The time the thread spends in its steps is time the GL thread no longer spends each frame.
+	CountHiddenTime, called once a frame on the GL thread, adds what the steps took since the
+	last frame to a histogram; WriteHistograms compares it with the GL thread's own work.
+	**/
+	class SimulationThread
+	{
+	public:
+		//Called on the simulation thread. Should call BeginFrame and EndFrame on the loop.
+		typedef std::function<void(FrameLoop &)> StepFunc;
+
+		explicit SimulationThread(double ticksPerSecond = 60.0);
+
+		//Stops the thread, discarding any exception from the steps.
+		~SimulationThread();
+
+		//Only use the loop to set it up, before Start.
+		FrameLoop &GetFrameLoop() {return m_loop;}
+
+		void Start(const StepFunc &step);
+
+		//Waits for the current step to finish and the thread to end. Rethrows the exception a
+		//step threw, if one did; the thread stops at the first.
+		void Stop();
+
+		bool IsRunning() const {return m_thread.joinable();}
+
+		//Called on the GL thread.
+		void PostInput(const InputEvent &event);
+
+		//Called in the step. Replaces the events with the ones posted since the last call, in
+		//the order they were posted.
+		void TakeInput(std::vector<InputEvent> &events);
+
+		//Called on the GL thread, once a frame.
+		void CountHiddenTime();
+
+		//Milliseconds of simulation per drawn frame.
+		const FrameTimeHistogram &GetHiddenTimes() const {return m_hiddenTimes;}
+
+		//The hidden time per frame, the GL thread's work per frame, and the share of their sum
+		//that is hidden; then the hidden time's buckets.
+		void WriteHistograms(std::ostream &out, const FrameTimeHistogram &renderWorkTimes) const;
+
+	private:
+		FrameLoop m_loop;
+		StepFunc m_step;
+		std::thread m_thread;
+		std::atomic<bool> m_bStopping;
+		std::exception_ptr m_error;
+
+		std::mutex m_inputMutex;
+		std::vector<InputEvent> m_postedInput;
+
+		std::atomic<unsigned long long> m_stepNanoseconds;	//Added to by the thread.
+		unsigned long long m_countedNanoseconds;			//How much of that has been counted.
+		FrameTimeHistogram m_hiddenTimes;
+
+		void ThreadLoop();
+
+		//Prevent copying.
+		SimulationThread(const SimulationThread &);
+		SimulationThread &operator=(const SimulationThread &);
+	};
+
+	//Reads --sim-thread. Returns true if it is there.
+	bool ParseSimulationThreadArgs(int argc, char **argv);
+
+	//True if --sim-thread was given.
+	bool IsSimulationThreadRequested();
+}
+
+#endif //FRAMEWORK_SIMULATION_THREAD_H
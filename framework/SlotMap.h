@@ -0,0 +1,167 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+
+#ifndef FRAMEWORK_SLOT_MAP_H
+#define FRAMEWORK_SLOT_MAP_H
+
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+
+namespace Framework
+{
+	//Refers to an object in a SlotMap. A handle whose object has been removed is stale,
+	//even if its slot has since been reused. The default-constructed handle is never valid.
+	struct Handle
+	{
+		Handle() : index(0), generation(0) {}
+		Handle(unsigned int _index, unsigned int _generation)
+			: index(_index), generation(_generation) {}
+
+		bool IsNull() const {return generation == 0;}
+
+		bool operator==(const Handle &other) const
+		{return index == other.index && generation == other.generation;}
+		bool operator!=(const Handle &other) const {return !(*this == other);}
+
+		unsigned int index;
+		unsigned int generation;
+	};
+
+	/**
+	Stores objects contiguously, with stable Handles to them.
+
+	The values live in one dense array, so iterating over them is a linear walk. Each handle
+	goes through an indirection slot that records where its value currently lives and which
+	generation of the slot it belongs to. Removing a value moves the last value into its place,
+	so the dense order is insertion order until something is removed.
+	**/
+	template<typename ValueType>
+	class SlotMap
+	{
+	public:
+		typedef typename std::vector<ValueType>::iterator iterator;
+		typedef typename std::vector<ValueType>::const_iterator const_iterator;
+
+		SlotMap() : m_freeHead(INVALID_SLOT) {}
+
+		Handle Insert(const ValueType &value)
+		{
+			unsigned int slotIx = m_freeHead;
+			if(slotIx == INVALID_SLOT)
+			{
+				slotIx = (unsigned int)m_slots.size();
+				m_slots.push_back(Slot());
+			}
+			else
+				m_freeHead = m_slots[slotIx].denseIx;
+
+			Slot &slot = m_slots[slotIx];
+			slot.denseIx = (unsigned int)m_values.size();
+
+			m_values.push_back(value);
+			m_denseToSlot.push_back(slotIx);
+
+			return Handle(slotIx, slot.generation);
+		}
+
+		//Returns false if the handle is stale.
+		bool Remove(const Handle &handle)
+		{
+			if(!IsValid(handle))
+				return false;
+
+			Slot &slot = m_slots[handle.index];
+			const unsigned int denseIx = slot.denseIx;
+			const unsigned int lastIx = (unsigned int)m_values.size() - 1;
+			if(denseIx != lastIx)
+			{
+				std::swap(m_values[denseIx], m_values[lastIx]);
+				m_denseToSlot[denseIx] = m_denseToSlot[lastIx];
+				m_slots[m_denseToSlot[denseIx]].denseIx = denseIx;
+			}
+
+			m_values.pop_back();
+			m_denseToSlot.pop_back();
+
+			//Generation 0 is reserved for the null handle.
+			++slot.generation;
+			if(slot.generation == 0)
+				slot.generation = 1;
+			slot.denseIx = m_freeHead;
+			m_freeHead = handle.index;
+			return true;
+		}
+
+		bool IsValid(const Handle &handle) const
+		{
+			return handle.index < m_slots.size() &&
+				m_slots[handle.index].generation == handle.generation &&
+				!handle.IsNull();
+		}
+
+		//Returns NULL if the handle is stale.
+		ValueType *Get(const Handle &handle)
+		{
+			return IsValid(handle) ? &m_values[m_slots[handle.index].denseIx] : NULL;
+		}
+
+		const ValueType *Get(const Handle &handle) const
+		{
+			return IsValid(handle) ? &m_values[m_slots[handle.index].denseIx] : NULL;
+		}
+
+		//The handle of the value at the given position in the dense array.
+		Handle GetHandle(size_t denseIx) const
+		{
+			assert(denseIx < m_values.size());
+			unsigned int slotIx = m_denseToSlot[denseIx];
+			return Handle(slotIx, m_slots[slotIx].generation);
+		}
+
+		void Clear()
+		{
+			//Removing from the back never moves anything, and it stales every handle.
+			while(!m_values.empty())
+				Remove(GetHandle(m_values.size() - 1));
+		}
+
+		void Reserve(size_t count)
+		{
+			m_values.reserve(count);
+			m_denseToSlot.reserve(count);
+			m_slots.reserve(count);
+		}
+
+		size_t size() const {return m_values.size();}
+		bool empty() const {return m_values.empty();}
+
+		ValueType &operator[](size_t denseIx) {return m_values[denseIx];}
+		const ValueType &operator[](size_t denseIx) const {return m_values[denseIx];}
+
+		iterator begin() {return m_values.begin();}
+		iterator end() {return m_values.end();}
+		const_iterator begin() const {return m_values.begin();}
+		const_iterator end() const {return m_values.end();}
+
+	private:
+		enum {INVALID_SLOT = 0xFFFFFFFF};
+
+		struct Slot
+		{
+			Slot() : denseIx(0), generation(1) {}
+
+			unsigned int denseIx;		//The next free slot, if this one is free.
+			unsigned int generation;
+		};
+
+		std::vector<ValueType> m_values;
+		std::vector<unsigned int> m_denseToSlot;
+		std::vector<Slot> m_slots;
+		unsigned int m_freeHead;
+	};
+}
+
+#endif //FRAMEWORK_SLOT_MAP_H
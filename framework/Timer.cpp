@@ -6,9 +6,10 @@
 
 #include <math.h>
 #include <glm/glm.hpp>
-#include <GL/freeglut.h>
+#include <glload/gl_3_3.h>
 #include "framework.h"
 #include "Timer.h"
+#include "InputLog.h"
 
 
 
@@ -50,7 +51,8 @@ namespace Framework
 
 	bool Timer::Update()
 	{
-		float absCurrTime = glutGet(GLUT_ELAPSED_TIME) / 1000.0f;
+		//The input log's clock, so that replays see the recorded times.
+		float absCurrTime = (float)GetInputLog().GetElapsedSeconds();
 		if(!m_hasUpdated)
 		{
 			m_absPrevTime = absCurrTime;
@@ -0,0 +1,78 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_TRIPLE_BUFFER_H
+#define FRAMEWORK_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+namespace Framework
+{
+	/**
+	Hands the latest value from one thread to another without locks or waiting.
+
+	There are three values. The writer fills its own, then Publish swaps it with the one in
+	the middle. The reader's Acquire swaps its own with the middle one if something has been
+	published since, so it always gets the latest. Each swap is one atomic exchange, so
+	neither side ever waits for the other, however slow it is. Values published faster than
+	they are read are overwritten; nothing queues up.
+
+	The values are reused rather than rebuilt, so containers in them keep their memory. The
+	writer should overwrite every field, as its value holds whatever was published two swaps
+	ago.
+
+	Exactly one thread may write, and one other thread read.
+	**/
+	template<typename ValueType>
+	class TripleBuffer
+	{
+	public:
+		TripleBuffer()
+			: m_middle(1)
+			, m_writeIx(0)
+			, m_readIx(2)
+		{}
+
+		//The writer's value, to fill before publishing it.
+		ValueType &GetWriteBuffer() {return m_values[m_writeIx];}
+
+		//Makes the written value the latest. The writer gets a different one to fill next.
+		void Publish()
+		{
+			m_writeIx = m_middle.exchange(m_writeIx | NEW_VALUE) & INDEX_MASK;
+		}
+
+		//Takes the latest published value, if there is one the reader does not have yet.
+		//Returns false if not; the reader's value is then the same as before.
+		bool Acquire()
+		{
+			if(!(m_middle.load() & NEW_VALUE))
+				return false;
+
+			m_readIx = m_middle.exchange(m_readIx) & INDEX_MASK;
+			return true;
+		}
+
+		//The reader's value. Until the first Acquire, it is default constructed.
+		const ValueType &GetReadBuffer() const {return m_values[m_readIx];}
+
+	private:
+		enum
+		{
+			INDEX_MASK = 0x3,
+			NEW_VALUE = 0x4,	//Set in the middle index when it was published after the last Acquire.
+		};
+
+		ValueType m_values[3];
+		std::atomic<unsigned int> m_middle;
+		unsigned int m_writeIx;		//Only touched by the writer.
+		unsigned int m_readIx;		//Only touched by the reader.
+
+		//Prevent copying.
+		TripleBuffer(const TripleBuffer &);
+		TripleBuffer &operator=(const TripleBuffer &);
+	};
+}
+
+#endif //FRAMEWORK_TRIPLE_BUFFER_H
@@ -10,6 +10,7 @@
 
 #include <string.h>
 #include <vector>
+#include "FrameStats.h"
 
 namespace Framework
 {
@@ -90,6 +91,7 @@ namespace Framework
 			glGenBuffers(1, &bufferObject);
 			glBindBuffer(GL_UNIFORM_BUFFER, bufferObject);
 			glBufferData(GL_UNIFORM_BUFFER, m_storage.size(), &m_storage[0], GL_STATIC_DRAW);
+			CountUpload(m_storage.size());
 			glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
 			return bufferObject;
@@ -0,0 +1,220 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <algorithm>
+#include "WorkerPool.h"
+#include "Profiler.h"
+
+namespace Framework
+{
+	WorkerPool::WorkerPool( unsigned int numThreads )
+		: m_stopping(false)
+	{
+		if(numThreads == 0)
+			numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+		m_threads.reserve(numThreads);
+		for(unsigned int threadIx = 0; threadIx < numThreads; ++threadIx)
+			m_threads.push_back(std::thread(&WorkerPool::WorkerLoop, this));
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_taskReady.notify_all();
+
+		for(size_t threadIx = 0; threadIx < m_threads.size(); ++threadIx)
+			m_threads[threadIx].join();
+	}
+
+	void WorkerPool::Submit( const std::function<void()> &task, const void *pOwner )
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.push_back(QueuedTask());
+			m_tasks.back().func = task;
+			m_tasks.back().pOwner = pOwner;
+		}
+		m_taskReady.notify_one();
+	}
+
+	bool WorkerPool::RunPendingTask( const void *pOwner )
+	{
+		std::function<void()> task;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			std::deque<QueuedTask>::iterator theIt = m_tasks.begin();
+			while(theIt != m_tasks.end() && theIt->pOwner != pOwner)
+				++theIt;
+
+			if(theIt == m_tasks.end())
+				return false;
+
+			task.swap(theIt->func);
+			m_tasks.erase(theIt);
+		}
+
+		task();
+		return true;
+	}
+
+	void WorkerPool::WorkerLoop()
+	{
+		profile::SetThreadName("Worker");
+		for(;;)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while(m_tasks.empty() && !m_stopping)
+					m_taskReady.wait(lock);
+
+				//Drain the queue before stopping.
+				if(m_tasks.empty())
+					return;
+
+				task.swap(m_tasks.front().func);
+				m_tasks.pop_front();
+			}
+
+			task();
+		}
+	}
+
+	WorkerPool &GetWorkerPool()
+	{
+		static WorkerPool pool;
+		return pool;
+	}
+
+	TaskGroup::TaskGroup( WorkerPool &pool )
+		: m_pool(pool)
+		, m_pending(0)
+	{}
+
+	TaskGroup::~TaskGroup()
+	{
+		try
+		{
+			Wait();
+		}
+		catch(...)
+		{
+		}
+	}
+
+	void TaskGroup::Run( const std::function<void()> &task )
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			++m_pending;
+		}
+
+		m_pool.Submit([this, task]()
+		{
+			std::exception_ptr error;
+			try
+			{
+				task();
+			}
+			catch(...)
+			{
+				error = std::current_exception();
+			}
+
+			TaskFinished(error);
+		}, this);
+	}
+
+	void TaskGroup::TaskFinished( std::exception_ptr error )
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(error && !m_error)
+			m_error = error;
+
+		--m_pending;
+		if(m_pending == 0)
+			m_done.notify_all();
+	}
+
+	void TaskGroup::Wait()
+	{
+		for(;;)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if(m_pending == 0)
+					break;
+			}
+
+			//Help out rather than sleep. Once none of ours are queued, the rest are already
+			//running somewhere.
+			if(!RunPendingTask())
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while(m_pending != 0)
+					m_done.wait(lock);
+				break;
+			}
+		}
+
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			error = m_error;
+			m_error = std::exception_ptr();
+		}
+
+		if(error)
+			std::rethrow_exception(error);
+	}
+
+	bool TaskGroup::RunPendingTask()
+	{
+		return m_pool.RunPendingTask(this);
+	}
+
+	void ParallelFor( WorkerPool &pool, size_t count, size_t minRangeSize,
+		const std::function<void(size_t, size_t)> &func )
+	{
+		if(count == 0)
+			return;
+
+		//A few ranges per thread evens out uneven work.
+		const size_t numThreads = pool.GetThreadCount() + 1;
+		size_t rangeSize = std::max((count + numThreads * 4 - 1) / (numThreads * 4),
+			std::max(minRangeSize, size_t(1)));
+
+		if(rangeSize >= count)
+		{
+			func(0, count);
+			return;
+		}
+
+		TaskGroup group(pool);
+		for(size_t begin = rangeSize; begin < count; begin += rangeSize)
+		{
+			size_t end = std::min(begin + rangeSize, count);
+			group.Run([&func, begin, end]() {func(begin, end);});
+		}
+
+		//The caller does the first range itself.
+		std::exception_ptr error;
+		try
+		{
+			func(0, rangeSize);
+		}
+		catch(...)
+		{
+			error = std::current_exception();
+		}
+
+		group.Wait();
+		if(error)
+			std::rethrow_exception(error);
+	}
+}
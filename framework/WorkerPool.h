@@ -0,0 +1,111 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_WORKER_POOL_H
+#define FRAMEWORK_WORKER_POOL_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace Framework
+{
+	/**
+	A fixed set of threads that run queued tasks in FIFO order.
+
+	Tasks must not touch OpenGL; only the thread that owns the context may do that. Use a
+	TaskGroup to wait for a particular set of tasks, since other code may share the pool.
+	**/
+	class WorkerPool
+	{
+	public:
+		//A thread count of zero means one thread per hardware thread.
+		explicit WorkerPool(unsigned int numThreads = 0);
+
+		//Finishes every queued task before returning.
+		~WorkerPool();
+
+		//The owner only tags the task, so that RunPendingTask can find it. The pool's own
+		//threads run every task in FIFO order, whatever its owner.
+		void Submit(const std::function<void()> &task, const void *pOwner = NULL);
+
+		//Runs the oldest queued task submitted with this owner on the calling thread, if there
+		//is one. Returns false if there was not. Tasks of other owners are never taken, so
+		//a thread waiting on its own work cannot get stuck in someone else's long task.
+		bool RunPendingTask(const void *pOwner);
+
+		unsigned int GetThreadCount() const {return (unsigned int)m_threads.size();}
+
+	private:
+		std::vector<std::thread> m_threads;
+		struct QueuedTask
+		{
+			std::function<void()> func;
+			const void *pOwner;
+		};
+
+		std::deque<QueuedTask> m_tasks;
+		std::mutex m_mutex;
+		std::condition_variable m_taskReady;
+		bool m_stopping;
+
+		void WorkerLoop();
+
+		//Prevent copying.
+		WorkerPool(const WorkerPool &);
+		WorkerPool &operator=(const WorkerPool &);
+	};
+
+	//The pool shared by the framework, created on first use.
+	WorkerPool &GetWorkerPool();
+
+	/**
+	Tracks a set of tasks submitted to a pool.
+
+	Wait() runs the group's own queued tasks on the calling thread while it waits, so waiting
+	from inside a task cannot deadlock the pool. It never runs tasks from other groups, so
+	waiting costs no more than the group's own work. The first exception thrown by any task is rethrown from
+	Wait(); the others are discarded.
+	**/
+	class TaskGroup
+	{
+	public:
+		explicit TaskGroup(WorkerPool &pool);
+
+		//Waits for the tasks, but swallows their exceptions.
+		~TaskGroup();
+
+		void Run(const std::function<void()> &task);
+
+		void Wait();
+
+		//Runs one of the group's queued tasks on the calling thread. Returns false if none
+		//were queued; any that are left are already running.
+		bool RunPendingTask();
+
+	private:
+		WorkerPool &m_pool;
+		std::mutex m_mutex;
+		std::condition_variable m_done;
+		size_t m_pending;
+		std::exception_ptr m_error;
+
+		void TaskFinished(std::exception_ptr error);
+
+		//Prevent copying.
+		TaskGroup(const TaskGroup &);
+		TaskGroup &operator=(const TaskGroup &);
+	};
+
+	//Calls func(begin, end) over contiguous ranges covering [0, count), spread across the pool
+	//and the calling thread. Ranges are at least minRangeSize long, except for the last.
+	void ParallelFor(WorkerPool &pool, size_t count, size_t minRangeSize,
+		const std::function<void(size_t, size_t)> &func);
+}
+
+#endif //FRAMEWORK_WORKER_POOL_H
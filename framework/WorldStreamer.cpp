@@ -0,0 +1,408 @@
+//Copyright (C) 2010-2012 by Jason L. McKesson
+//This file is licensed under the MIT License.
+
+
+#include <string>
+#include <vector>
+#include <set>
+#include <utility>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+
+#include <glload/gl_all.h>
+#include "framework.h"
+#include "WorldStreamer.h"
+#include "Scene.h"
+#include "Profiler.h"
+#include "rapidxml.hpp"
+#include "rapidxml_helpers.h"
+
+namespace Framework
+{
+	using rapidxml::xml_document;
+	using rapidxml::xml_node;
+	using rapidxml::xml_attribute;
+
+	namespace
+	{
+		void ThrowAttrib(const xml_attribute<> &attrib, const std::string &msg)
+		{
+			std::string name = rapidxml::make_string(attrib);
+			throw std::runtime_error("Attribute " + name + " " + msg);
+		}
+
+		float SecondsBetween(const std::chrono::steady_clock::time_point &start,
+			const std::chrono::steady_clock::time_point &end)
+		{
+			return std::chrono::duration<float>(end - start).count();
+		}
+
+		//Tiles read at once. Each read also spreads its meshes and textures across the pool.
+		const unsigned int STREAMING_THREADS = 2;
+
+		struct TileDistanceLess
+		{
+			TileDistanceLess(const std::vector<float> &distances) : m_distances(distances) {}
+			bool operator()(size_t lhs, size_t rhs) const {return m_distances[lhs] < m_distances[rhs];}
+			const std::vector<float> &m_distances;
+		};
+	}
+
+	WorldStreamer::WorldStreamer( const std::string &worldFilename, const WorldStreamSettings &settings )
+		: m_tileSize(0.0f)
+		, m_settings(settings)
+		, m_bHasUpdated(false)
+		, m_bWasStreaming(false)
+		, m_streamingPool(STREAMING_THREADS)
+		, m_reads(m_streamingPool)
+	{
+		ReadWorldFile(worldFilename);
+	}
+
+	WorldStreamer::~WorldStreamer()
+	{
+		//Reads catch their own errors, so this cannot throw.
+		m_reads.Wait();
+		CollectFinishedReads();
+
+		for(size_t tileIx = 0; tileIx < m_tiles.size(); ++tileIx)
+			UnloadTile(m_tiles[tileIx]);
+	}
+
+	void WorldStreamer::ReadWorldFile( const std::string &worldFilename )
+	{
+		std::string pathname = FindFileOrThrow(worldFilename);
+		std::ifstream fileStream(pathname.c_str());
+		if(!fileStream.is_open())
+			throw std::runtime_error("Could not open the world file: " + pathname);
+
+		std::vector<char> fileData;
+		fileData.insert(fileData.end(), std::istreambuf_iterator<char>(fileStream),
+			std::istreambuf_iterator<char>());
+		fileData.push_back('\0');
+
+		xml_document<> doc;
+
+		try
+		{
+			doc.parse<0>(&fileData[0]);
+		}
+		catch(rapidxml::parse_error &e)
+		{
+			std::cout << pathname << ": Parse error in the world file." << std::endl;
+			std::cout << e.what() << std::endl << e.where<char>() << std::endl;
+			throw;
+		}
+
+		const xml_node<> *pWorldNode = doc.first_node("world");
+		if(!pWorldNode)
+			throw std::runtime_error("`world` node not found in world file: " + pathname);
+
+		const xml_attribute<> *pSizeAttrib = pWorldNode->first_attribute("tile-size");
+		if(!pSizeAttrib)
+			throw std::runtime_error("The world must have a `tile-size`.");
+		m_tileSize = rapidxml::attrib_to_float(*pSizeAttrib, ThrowAttrib);
+		if(!(m_tileSize > 0.0f))
+			throw std::runtime_error("The world's `tile-size` must be positive.");
+
+		std::set<std::pair<int, int> > coords;
+		for(const xml_node<> *pTileNode = pWorldNode->first_node("tile");
+			pTileNode;
+			pTileNode = pTileNode->next_sibling("tile"))
+		{
+			const xml_attribute<> *pXAttrib = pTileNode->first_attribute("x");
+			const xml_attribute<> *pZAttrib = pTileNode->first_attribute("z");
+			const xml_attribute<> *pFileAttrib = pTileNode->first_attribute("file");
+			if(!pXAttrib || !pZAttrib || !pFileAttrib)
+				throw std::runtime_error("Every tile needs an `x`, a `z` and a `file`.");
+
+			Tile tile;
+			tile.x = rapidxml::attrib_to_int(*pXAttrib, ThrowAttrib);
+			tile.z = rapidxml::attrib_to_int(*pZAttrib, ThrowAttrib);
+			tile.filename = rapidxml::make_string(*pFileAttrib);
+			tile.state = TILE_UNLOADED;
+			tile.distance = 0.0f;
+			tile.bCancelled = false;
+			tile.pPreload = NULL;
+			tile.pScene = NULL;
+
+			if(!coords.insert(std::make_pair(tile.x, tile.z)).second)
+				throw std::runtime_error("The world file has two tiles at " + rapidxml::make_string(*pXAttrib) +
+					", " + rapidxml::make_string(*pZAttrib) + ".");
+
+			m_tiles.push_back(tile);
+		}
+	}
+
+	void WorldStreamer::CollectFinishedReads()
+	{
+		std::vector<FinishedRead> finished;
+		{
+			std::lock_guard<std::mutex> lock(m_finishedMutex);
+			finished.swap(m_finished);
+		}
+
+		for(size_t readIx = 0; readIx < finished.size(); ++readIx)
+		{
+			const FinishedRead &read = finished[readIx];
+			Tile &tile = m_tiles[read.tileIx];
+			if(tile.bCancelled)
+			{
+				delete read.pPreload;
+				tile.bCancelled = false;
+				tile.state = TILE_UNLOADED;
+			}
+			else if(!read.pPreload)
+			{
+				std::cout << "Could not load the world tile " << tile.filename << "." << std::endl <<
+					read.error << std::endl;
+				tile.state = TILE_FAILED;
+			}
+			else
+			{
+				tile.pPreload = read.pPreload;
+				tile.state = TILE_UPLOADING;
+			}
+		}
+	}
+
+	void WorldStreamer::StartRead( size_t tileIx )
+	{
+		Tile &tile = m_tiles[tileIx];
+		tile.state = TILE_READING;
+		tile.bCancelled = false;
+
+		std::string filename = tile.filename;
+		m_reads.Run([this, tileIx, filename]()
+		{
+			FinishedRead read;
+			read.tileIx = tileIx;
+			read.pPreload = NULL;
+			try
+			{
+				read.pPreload = new ScenePreload(filename, m_streamingPool);
+			}
+			catch(std::exception &e)
+			{
+				read.error = e.what();
+			}
+
+			std::lock_guard<std::mutex> lock(m_finishedMutex);
+			m_finished.push_back(read);
+		});
+	}
+
+	void WorldStreamer::UnloadTile( Tile &tile )
+	{
+		switch(tile.state)
+		{
+		case TILE_READING:
+			tile.bCancelled = true;
+			return;
+		case TILE_UPLOADING:
+			delete tile.pPreload;
+			tile.pPreload = NULL;
+			break;
+		case TILE_RESIDENT:
+			delete tile.pScene;
+			tile.pScene = NULL;
+			break;
+		default:
+			return;
+		}
+
+		tile.state = TILE_UNLOADED;
+	}
+
+	void WorldStreamer::Update( const glm::vec3 &cameraPos )
+	{
+		PROFILE_SCOPE("WorldStreamer::Update");
+		Clock::time_point updateStart = Clock::now();
+
+		CollectFinishedReads();
+
+		std::vector<float> distances(m_tiles.size());
+		for(size_t tileIx = 0; tileIx < m_tiles.size(); ++tileIx)
+		{
+			Tile &tile = m_tiles[tileIx];
+			glm::vec2 tileMin = glm::vec2(tile.x, tile.z) * m_tileSize;
+			glm::vec2 camera(cameraPos.x, cameraPos.z);
+			glm::vec2 closest = glm::clamp(camera, tileMin, tileMin + glm::vec2(m_tileSize));
+			tile.distance = glm::length(camera - closest);
+			distances[tileIx] = tile.distance;
+		}
+
+		std::vector<size_t> wanted;
+		size_t numActive = 0;
+		for(size_t tileIx = 0; tileIx < m_tiles.size(); ++tileIx)
+		{
+			Tile &tile = m_tiles[tileIx];
+			if(tile.distance > m_settings.unloadRadius)
+				UnloadTile(tile);
+			else if(tile.state == TILE_READING && tile.bCancelled && tile.distance <= m_settings.loadRadius)
+				tile.bCancelled = false;
+
+			if(tile.state == TILE_UNLOADED && tile.distance <= m_settings.loadRadius)
+				wanted.push_back(tileIx);
+			else if(tile.state == TILE_READING || tile.state == TILE_UPLOADING || tile.state == TILE_RESIDENT)
+				++numActive;
+		}
+
+		//Nearest first. When the budget is full, a tile may only replace a farther one.
+		std::sort(wanted.begin(), wanted.end(), TileDistanceLess(distances));
+		for(size_t wantedIx = 0; wantedIx < wanted.size(); ++wantedIx)
+		{
+			size_t tileIx = wanted[wantedIx];
+			if(numActive >= m_settings.maxResidentTiles)
+			{
+				Tile *pFarthest = NULL;
+				for(size_t otherIx = 0; otherIx < m_tiles.size(); ++otherIx)
+				{
+					Tile &other = m_tiles[otherIx];
+					if(other.state != TILE_UPLOADING && other.state != TILE_RESIDENT)
+						continue;
+					if(other.distance > m_tiles[tileIx].distance &&
+						(!pFarthest || other.distance > pFarthest->distance))
+					{
+						pFarthest = &other;
+					}
+				}
+
+				if(!pFarthest)
+					break;
+
+				UnloadTile(*pFarthest);
+				--numActive;
+			}
+
+			StartRead(tileIx);
+			++numActive;
+		}
+
+		UploadTiles(updateStart);
+		UpdateStats(updateStart);
+	}
+
+	void WorldStreamer::UploadTiles( const Clock::time_point &updateStart )
+	{
+		PROFILE_SCOPE("WorldStreamer::UploadTiles");
+		std::vector<size_t> uploading;
+		std::vector<float> distances(m_tiles.size());
+		for(size_t tileIx = 0; tileIx < m_tiles.size(); ++tileIx)
+		{
+			distances[tileIx] = m_tiles[tileIx].distance;
+			if(m_tiles[tileIx].state == TILE_UPLOADING)
+				uploading.push_back(tileIx);
+		}
+		std::sort(uploading.begin(), uploading.end(), TileDistanceLess(distances));
+
+		//Finishing a tile compiles its programs, so it counts as an upload too.
+		int numUploads = 0;
+		for(size_t uploadIx = 0; uploadIx < uploading.size(); ++uploadIx)
+		{
+			Tile &tile = m_tiles[uploading[uploadIx]];
+			try
+			{
+				while(tile.state == TILE_UPLOADING)
+				{
+					if(numUploads >= m_settings.maxUploadsPerFrame ||
+						(numUploads > 0 &&
+						SecondsBetween(updateStart, Clock::now()) >= m_settings.uploadTimeBudget))
+					{
+						m_stats.uploadsThisFrame = numUploads;
+						return;
+					}
+
+					++numUploads;
+					if(!tile.pPreload->UploadNext())
+					{
+						tile.pScene = new Scene(*tile.pPreload);
+						delete tile.pPreload;
+						tile.pPreload = NULL;
+						tile.state = TILE_RESIDENT;
+					}
+				}
+			}
+			catch(std::exception &e)
+			{
+				std::cout << "Could not load the world tile " << tile.filename << "." << std::endl <<
+					e.what() << std::endl;
+				delete tile.pPreload;
+				tile.pPreload = NULL;
+				tile.state = TILE_FAILED;
+			}
+		}
+
+		m_stats.uploadsThisFrame = numUploads;
+	}
+
+	void WorldStreamer::UpdateStats( const Clock::time_point &updateStart )
+	{
+		//The frame before this Update streamed if tiles were loading as it began.
+		if(m_bHasUpdated && m_bWasStreaming)
+		{
+			m_stats.worstStreamingFrameTime = std::max(m_stats.worstStreamingFrameTime,
+				SecondsBetween(m_lastUpdate, updateStart));
+		}
+
+		m_stats.residentTiles = 0;
+		m_stats.loadingTiles = 0;
+		m_stats.failedTiles = 0;
+		for(size_t tileIx = 0; tileIx < m_tiles.size(); ++tileIx)
+		{
+			switch(m_tiles[tileIx].state)
+			{
+			case TILE_READING:
+			case TILE_UPLOADING:
+				++m_stats.loadingTiles;
+				break;
+			case TILE_RESIDENT:
+				++m_stats.residentTiles;
+				break;
+			case TILE_FAILED:
+				++m_stats.failedTiles;
+				break;
+			default:
+				break;
+			}
+		}
+
+		m_stats.lastUpdateTime = SecondsBetween(updateStart, Clock::now());
+		m_stats.worstUpdateTime = std::max(m_stats.worstUpdateTime, m_stats.lastUpdateTime);
+
+		m_lastUpdate = updateStart;
+		m_bHasUpdated = true;
+		m_bWasStreaming = m_stats.loadingTiles > 0 || m_stats.uploadsThisFrame > 0;
+	}
+
+	void WorldStreamer::ResetWorstTimes()
+	{
+		m_stats.worstUpdateTime = 0.0f;
+		m_stats.worstStreamingFrameTime = 0.0f;
+	}
+
+	void WorldStreamer::Render( const glm::mat4 &cameraMatrix ) const
+	{
+		for(size_t tileIx = 0; tileIx < m_tiles.size(); ++tileIx)
+		{
+			if(m_tiles[tileIx].state == TILE_RESIDENT)
+				m_tiles[tileIx].pScene->Render(cameraMatrix);
+		}
+	}
+
+	Scene *WorldStreamer::FindTileScene( int x, int z )
+	{
+		for(size_t tileIx = 0; tileIx < m_tiles.size(); ++tileIx)
+		{
+			const Tile &tile = m_tiles[tileIx];
+			if(tile.x == x && tile.z == z)
+				return tile.pScene;
+		}
+
+		return NULL;
+	}
+}
@@ -0,0 +1,166 @@
+/** Copyright (C) 2010-2012 by Jason L. McKesson **/
+/** This file is licensed under the MIT License. **/
+
+
+#ifndef FRAMEWORK_WORLD_STREAMER_H
+#define FRAMEWORK_WORLD_STREAMER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <glm/glm.hpp>
+#include "WorkerPool.h"
+
+namespace Framework
+{
+	class Scene;
+	class ScenePreload;
+
+	struct WorldStreamSettings
+	{
+		WorldStreamSettings()
+			: loadRadius(100.0f)
+			, unloadRadius(150.0f)
+			, maxResidentTiles(16)
+			, maxUploadsPerFrame(4)
+			, uploadTimeBudget(0.004f)
+		{}
+
+		float loadRadius;			//Tiles closer than this to the camera are loaded.
+		float unloadRadius;			//Tiles farther than this are unloaded. Should exceed loadRadius.
+		size_t maxResidentTiles;	//Counting the ones still loading.
+		int maxUploadsPerFrame;		//Meshes and textures given to OpenGL per Update.
+		float uploadTimeBudget;		//Seconds per Update spent on uploads. At least one is always made.
+	};
+
+	struct WorldStreamStats
+	{
+		WorldStreamStats()
+			: residentTiles(0)
+			, loadingTiles(0)
+			, failedTiles(0)
+			, uploadsThisFrame(0)
+			, lastUpdateTime(0.0f)
+			, worstUpdateTime(0.0f)
+			, worstStreamingFrameTime(0.0f)
+		{}
+
+		size_t residentTiles;
+		size_t loadingTiles;		//Being read on the streaming pool, or waiting for uploads.
+		size_t failedTiles;
+		int uploadsThisFrame;
+		float lastUpdateTime;		//Seconds spent in the last Update.
+		float worstUpdateTime;
+		float worstStreamingFrameTime;	//The longest time between Updates while tiles were loading.
+	};
+
+	/**
+	Streams a large world in and out as a grid of tiles around the camera.
+
+	A world file lists the tiles, each a scene file of its own, with its own meshes, textures
+	and nodes placed in world space:
+
+	<world tile-size="64">
+		<tile x="0" z="0" file="tile_0_0.xml"/>
+		<tile x="1" z="0" file="tile_1_0.xml"/>
+	</world>
+
+	Tile (x, z) covers [x, x+1) * tile-size along the world X and Z axes. Its distance from the
+	camera is the distance to that square in the XZ plane.
+
+	Update loads the nearest tiles within the load radius, up to the tile budget, reading and
+	decoding them with ScenePreload on a small worker pool of the streamer's own. Tile reads
+	are long, so they are kept away from the shared pool that rendering waits on. Their GL objects are then made a few at
+	a time per Update, within the upload budget, so loading never stalls a frame for long.
+	Tiles beyond the unload radius are destroyed, and when the budget is full, the farthest
+	resident tile makes room for a nearer one. A tile that fails to load is reported once and
+	not tried again.
+
+	Update and Render must be called on the GL thread.
+	**/
+	class WorldStreamer
+	{
+	public:
+		explicit WorldStreamer(const std::string &worldFilename,
+			const WorldStreamSettings &settings = WorldStreamSettings());
+
+		//Waits for the tiles being read on the streaming pool.
+		~WorldStreamer();
+
+		//Call once per frame.
+		void Update(const glm::vec3 &cameraPos);
+
+		void Render(const glm::mat4 &cameraMatrix) const;
+
+		void SetSettings(const WorldStreamSettings &settings) {m_settings = settings;}
+		const WorldStreamSettings &GetSettings() const {return m_settings;}
+
+		const WorldStreamStats &GetStats() const {return m_stats;}
+		void ResetWorstTimes();
+
+		float GetTileSize() const {return m_tileSize;}
+		size_t GetTileCount() const {return m_tiles.size();}
+
+		//NULL unless the tile is resident.
+		Scene *FindTileScene(int x, int z);
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		enum TileState
+		{
+			TILE_UNLOADED,
+			TILE_READING,		//ScenePreload running on the streaming pool.
+			TILE_UPLOADING,		//Preloaded; making GL objects.
+			TILE_RESIDENT,
+			TILE_FAILED,
+		};
+
+		struct Tile
+		{
+			int x;
+			int z;
+			std::string filename;
+			TileState state;
+			float distance;			//From the camera, as of the last Update.
+			bool bCancelled;		//Unloaded while reading; dropped once the read finishes.
+			ScenePreload *pPreload;
+			Scene *pScene;
+		};
+
+		struct FinishedRead
+		{
+			size_t tileIx;
+			ScenePreload *pPreload;	//NULL if the read failed.
+			std::string error;
+		};
+
+		float m_tileSize;
+		std::vector<Tile> m_tiles;
+		WorldStreamSettings m_settings;
+		WorldStreamStats m_stats;
+
+		Clock::time_point m_lastUpdate;
+		bool m_bHasUpdated;
+		bool m_bWasStreaming;
+
+		std::mutex m_finishedMutex;
+		std::vector<FinishedRead> m_finished;
+		WorkerPool m_streamingPool;
+		TaskGroup m_reads;		//After the pool, so that it is destroyed first.
+
+		void ReadWorldFile(const std::string &worldFilename);
+		void CollectFinishedReads();
+		void StartRead(size_t tileIx);
+		void UnloadTile(Tile &tile);
+		void UploadTiles(const Clock::time_point &updateStart);
+		void UpdateStats(const Clock::time_point &updateStart);
+
+		//Prevent copying.
+		WorldStreamer(const WorldStreamer &);
+		WorldStreamer &operator=(const WorldStreamer &);
+	};
+}
+
+#endif //FRAMEWORK_WORLD_STREAMER_H
@@ -17,6 +17,11 @@
 #include <GL/freeglut.h>
 #include "framework.h"
 #include "directories.h"
+#include "Profiler.h"
+#include "Headless.h"
+#include "InputLog.h"
+#include "SimulationThread.h"
+#include "PoolExecutor.h"
 
 #ifdef LOAD_X11
 #define APIENTRY
@@ -26,8 +31,16 @@ namespace Framework
 {
 	GLuint LoadShader(GLenum eShaderType, const std::string &strShaderFilename)
 	{
-		std::string strFilename = FindFileOrThrow(strShaderFilename);
-		std::ifstream shaderFile(strFilename.c_str());
+		return LoadShaderFile(eShaderType, FindFileOrThrow(strShaderFilename));
+	}
+
+	GLuint LoadShaderFile(GLenum eShaderType, const std::string &strShaderPathname)
+	{
+		PROFILE_SCOPE("LoadShader");
+		std::ifstream shaderFile(strShaderPathname.c_str());
+		if(!shaderFile.is_open())
+			throw std::runtime_error("Could not open the shader file " + strShaderPathname);
+
 		std::stringstream shaderData;
 		shaderData << shaderFile.rdbuf();
 		shaderFile.close();
@@ -45,6 +58,7 @@ namespace Framework
 
 	GLuint CreateProgram(const std::vector<GLuint> &shaderList)
 	{
+		PROFILE_SCOPE("CreateProgram");
 		try
 		{
 			GLuint prog = glutil::LinkProgram(shaderList);
@@ -129,6 +143,27 @@ void APIENTRY DebugFunc(GLenum source, GLenum type, GLuint id, GLenum severity,
 
 int main(int argc, char** argv)
 {
+	Framework::profile::SetThreadName("Main");
+
+	//glimg shares the framework's pool rather than starting one of its own.
+	static Framework::PoolExecutor glimgExecutor(Framework::GetWorkerPool());
+	glimg::SetExecutor(&glimgExecutor);
+
+	try
+	{
+		Framework::ParseInputLogArgs(argc, argv);
+		Framework::ParseSimulationThreadArgs(argc, argv);
+
+		Framework::HeadlessSettings headless;
+		if(Framework::ParseHeadlessArgs(argc, argv, headless))
+			return Framework::RunHeadless(headless, init, display, reshape);
+	}
+	catch(std::exception &e)
+	{
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
 	glutInit(&argc, argv);
 
 	int width = 500;
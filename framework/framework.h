@@ -18,6 +18,9 @@ namespace Framework
 		const std::string &strShaderFile, const std::string &strShaderName);
 	GLuint LoadShader(GLenum eShaderType, const std::string &strShaderFilename);
 
+	//Like LoadShader, for a file that has already been found, as by FindFileOrThrow.
+	GLuint LoadShaderFile(GLenum eShaderType, const std::string &strShaderPathname);
+
 	//Will *delete* the shaders given.
 	GLuint CreateProgram(const std::vector<GLuint> &shaderList);
 
@@ -2,6 +2,24 @@
 dofile("../glsdk/links.lua")
 
 local myPath = os.getcwd();
+
+newoption
+{
+	trigger = "profile",
+	description = "Compile in the scoped CPU profiler (PROFILE_SCOPE); see Profiler.h.",
+}
+
+newoption
+{
+	trigger = "headless",
+	description = "Compile in the windowless --headless run mode, which links EGL; see Headless.h.",
+}
+
+newoption
+{
+	trigger = "avx",
+	description = "Compile for CPUs with AVX, which Fleet steps eight craft at a time with; see Fleet.h.",
+}
 local usedLibs = {"glload", "glimage", "glm", "glutil", "glmesh", "freeglut"}
 
 function SetupSolution(slnName)
@@ -15,6 +33,20 @@ function SetupSolution(slnName)
         	
        	configuration "linux"
     	    defines {"LOAD_X11"}
+    	    buildoptions {"-std=c++11", "-pthread"}
+    	    linkoptions {"-pthread"}
+
+		configuration "profile"
+			defines {"FRAMEWORK_PROFILE"}
+
+		configuration "headless"
+			defines {"FRAMEWORK_HEADLESS"}
+
+		configuration {"avx", "windows"}
+			buildoptions {"/arch:AVX"}
+
+		configuration {"avx", "linux"}
+			buildoptions {"-mavx"}
 		
 	local currPath = os.getcwd();
 	os.chdir(myPath);
@@ -79,5 +111,8 @@ function SetupProject(projName, ...)
 	    configuration "linux"
 	        links {"GL", "GLU", "X11"}
 
+	    configuration {"linux", "headless"}
+	        links {"EGL"}
+
 end
 
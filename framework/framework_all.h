@@ -10,7 +10,28 @@
 #include "Mesh.h"
 #include "MousePole.h"
 #include "Scene.h"
+#include "SlotMap.h"
+#include "NameTable.h"
 #include "SceneBinders.h"
+#include "SceneSnapshot.h"
+#include "FileWatcher.h"
+#include "WorkerPool.h"
+#include "PoolExecutor.h"
+#include "OcclusionCuller.h"
+#include "CommandList.h"
+#include "Bvh.h"
+#include "Collision.h"
+#include "ClusteredLights.h"
+#include "Fleet.h"
+#include "WorldStreamer.h"
+#include "RenderGraph.h"
+#include "FrameStats.h"
+#include "Profiler.h"
+#include "FrameLoop.h"
+#include "TripleBuffer.h"
+#include "SimulationThread.h"
+#include "Headless.h"
+#include "InputLog.h"
 #include "Timer.h"
 #include "UniformBlockArray.h"
 #include "Interpolators.h"
@@ -18,6 +18,13 @@ project("glimg")
 	
 	configuration "linux"
 	    defines {"LOAD_X11"}
+	    buildoptions {"-std=c++11", "-pthread"}
+
+	configuration {"avx", "windows"}
+		buildoptions {"/arch:AVX"}
+
+	configuration {"avx", "linux"}
+		buildoptions {"-mavx"}
 
 	configuration "Debug"
 		flags "Unicode";
@@ -32,3 +39,39 @@ project("glimg")
 		flags {"OptimizeSpeed", "NoFramePointer", "ExtraWarnings", "NoEditAndContinue"};
 		objdir "Release";
 		targetname "glimg"
+
+--Checks the DDS loader against the files in test/dds, which test/MakeDdsCorpus.py writes.
+--Run it from the test directory.
+project("glimgDdsTest")
+	kind "ConsoleApp"
+	language "c++"
+	includedirs {"include"}
+	targetdir "test"
+	debugdir "test"
+
+	files {
+		"test/*.cpp",
+		"test/*.py",
+	};
+
+	links {"glimg"}
+
+	configuration "windows"
+		defines {"WIN32"}
+	
+	configuration "linux"
+	    defines {"LOAD_X11"}
+	    buildoptions {"-std=c++11", "-pthread"}
+	    linkoptions {"-pthread"}
+
+	configuration "Debug"
+		defines {"DEBUG", "_DEBUG"};
+		objdir "test/Debug";
+		flags "Symbols";
+		targetname "glimgDdsTestD";
+
+	configuration "Release"
+		defines {"NDEBUG", "RELEASE"};
+		flags {"OptimizeSpeed", "NoFramePointer", "ExtraWarnings", "NoEditAndContinue"};
+		objdir "test/Release";
+		targetname "glimgDdsTest"
@@ -0,0 +1,113 @@
+/** Copyright (C) 2011 by Jason L. McKesson **/
+/** This file is licensed by the MIT License. **/
+
+
+
+#ifndef GLIMG_BATCH_LOADER_H
+#define GLIMG_BATCH_LOADER_H
+
+#include <string>
+#include <memory>
+#include <future>
+#include <functional>
+#include <exception>
+#include "ImageSet.h"
+#include "Executor.h"
+
+/**
+\file
+\brief Declares the loader that decodes many images at once.
+**/
+
+namespace glimg
+{
+	namespace detail
+	{
+		class BatchLoaderImpl;
+	}
+
+	namespace loaders
+	{
+		/**
+		\brief Decodes many image files or memory buffers at once, on an Executor's threads.
+
+		Each item is decoded by the loader the single-image functions would use: files ending in
+		.dds go to dds::LoadFromFile, and buffers that start with the DDS magic number go to
+		dds::LoadFromMemory. Everything else goes to the stb loader.
+
+		Items can finish in any order. Each one's result is handed back either through a future
+		or through a function called on the worker thread that decoded it. A failed item hands
+		back the exception its loader threw, and the other items are not affected.
+
+		Memory is bounded by estimating what each item needs before starting it. That estimate
+		covers the file data read in and the decoded pixels, taken from the image's header. Items
+		wait in the order they became ready until the estimates of those running leave room for
+		them. An item larger than the whole limit runs alone. Files have their headers read on
+		the executor as well, so adding items never touches the disk on the calling thread.
+
+		\ingroup module_glimg_loaders
+		**/
+		class BatchLoader
+		{
+		public:
+			/**
+			\brief Receives the result of one item.
+
+			Called on a worker thread. \a pImageSet is the decoded image, which the function
+			takes ownership of, or NULL if \a error holds the exception the loader threw.
+			**/
+			typedef std::function<void (ImageSet *pImageSet, std::exception_ptr error)> CompletionFunc;
+
+			/**
+			\brief Creates a loader with no items.
+
+			\param maxBytesInFlight The most memory the items being read and decoded may be estimated to need at once.
+			\param pExecutor The executor to decode on, or NULL for the one GetExecutor returns.
+			**/
+			explicit BatchLoader(size_t maxBytesInFlight = 256 * 1024 * 1024, Executor *pExecutor = NULL);
+
+			///Waits for every item to finish. Exceptions thrown by completion functions are discarded.
+			~BatchLoader();
+
+			///Adds an image file. The future's get() returns the image, or rethrows the loader's exception.
+			std::future<std::unique_ptr<ImageSet> > AddFile(const std::string &filename);
+
+			///Adds an image file, whose result is passed to \a onComplete.
+			void AddFile(const std::string &filename, const CompletionFunc &onComplete);
+
+			/**
+			\brief Adds an image already in memory.
+
+			Unlike the LoadFromMemory functions, the buffer is not copied; it must stay valid until
+			this item's result has been handed back.
+			**/
+			std::future<std::unique_ptr<ImageSet> > AddMemory(const unsigned char *buffer, size_t bufSize);
+
+			///Adds an image already in memory, whose result is passed to \a onComplete.
+			void AddMemory(const unsigned char *buffer, size_t bufSize, const CompletionFunc &onComplete);
+
+			/**
+			\brief Blocks until every item added so far has finished.
+
+			The items run on the executor alone, so do not call this from one of the executor's
+			tasks unless other threads are left to run them.
+
+			\throws ... The first exception thrown by a completion function since the last call.
+			Loader exceptions are not thrown here; they go to the item's future or function.
+			**/
+			void Wait();
+
+			///The highest total of estimates that were in flight at once.
+			size_t GetPeakBytesInFlight() const;
+
+		private:
+			detail::BatchLoaderImpl *m_pImpl;
+
+			//Prevent copying.
+			BatchLoader(const BatchLoader &);
+			BatchLoader &operator=(const BatchLoader &);
+		};
+	}
+}
+
+#endif //GLIMG_BATCH_LOADER_H
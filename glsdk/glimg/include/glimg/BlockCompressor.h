@@ -0,0 +1,114 @@
+/** Copyright (C) 2011 by Jason L. McKesson **/
+/** This file is licensed by the MIT License. **/
+
+
+
+#ifndef GLIMG_BLOCK_COMPRESSOR_H
+#define GLIMG_BLOCK_COMPRESSOR_H
+
+#include <string>
+#include <exception>
+#include "ImageSet.h"
+
+/**
+\file
+\brief Declares the function that compresses ImageSets into BC formats.
+**/
+
+namespace glimg
+{
+	///\addtogroup module_glimg_exceptions
+	///@{
+
+	///Base class for all exceptions thrown by CompressImageSet.
+	class CompressionException : public std::exception
+	{
+	public:
+	    virtual ~CompressionException() throw() {}
+
+		virtual const char *what() const throw() {return message.c_str();}
+
+	protected:
+		std::string message;
+	};
+
+	///Thrown if the source images are not two-dimensional, 8-bit, normalized unsigned integer colors.
+	class CompressionSourceUnsupportedException : public CompressionException
+	{
+	public:
+		CompressionSourceUnsupportedException()
+		{
+			message = "Only two-dimensional, 8-bit per component, normalized unsigned RGBA or BGRA color images can be compressed.";
+		}
+	};
+
+	///Thrown if the target type is not one the compressor can write.
+	class CompressionTargetUnsupportedException : public CompressionException
+	{
+	public:
+		CompressionTargetUnsupportedException()
+		{
+			message = "Images can only be compressed to BC1, BC3, unsigned BC4 or unsigned BC5.";
+		}
+	};
+
+	///@}
+
+	///\addtogroup module_glimg_creation
+	///@{
+
+	///How much time CompressImageSet spends looking for the best endpoints of each block.
+	enum CompressionQuality
+	{
+		COMPRESS_FAST,			///<Endpoints from the corners of the block's bounding box.
+		COMPRESS_NORMAL,		///<Endpoints from the block's principal axis, refined once by least squares.
+		COMPRESS_BEST,			///<Refined until it stops improving, then the neighboring endpoints are tried.
+	};
+
+	///What a call to CompressImageSet did.
+	struct CompressionStats
+	{
+		///Root mean square error over every component the target format stores, on a 0-255 scale.
+		///The colors of texels that BC1 stores as transparent are not counted.
+		double rmse;
+
+		double seconds;				///<Time spent compressing the blocks.
+		double megabytesPerSecond;	///<Uncompressed source bytes compressed per second, in millions.
+	};
+
+	/**
+	\brief Compresses every image of an ImageSet into a block-compressed format.
+
+	The source must be two-dimensional, though it may have array images and cube faces, and
+	hold 8-bit normalized unsigned integer colors, with one to four components in RGBA or
+	BGRA order. The target is one of:
+
+	\li DT_COMPRESSED_BC1: RGB, plus 1-bit alpha if the source has alpha. Blocks with any alpha
+	below one half store those texels as transparent black.
+	\li DT_COMPRESSED_BC3: RGBA.
+	\li DT_COMPRESSED_UNSIGNED_BC4: the red component.
+	\li DT_COMPRESSED_UNSIGNED_BC5: the red and green components.
+
+	sRGB sources give sRGB targets; the colors are compressed as they are stored. The result
+	has the source's dimensions, mipmaps, array images, faces and row order. Blocks that hang
+	over the edge of an image repeat its last row and column.
+
+	Blocks are spread across threads by glimg's Executor. The endpoint search and the
+	matching of texels to palette entries use SSE or AVX when the compiler allows them.
+
+	\param pSource The images to compress. It is not modified.
+	\param eTargetType The compressed type to produce.
+	\param eQuality How hard to look for good endpoints.
+	\param pStats If not NULL, receives the error and speed of the compression.
+	\return A new ImageSet, which the caller owns.
+
+	\throws CompressionSourceUnsupportedException If the source's format is not one listed above.
+	\throws CompressionTargetUnsupportedException If the target type is not one listed above.
+	**/
+	ImageSet *CompressImageSet(const ImageSet *pSource, PixelDataType eTargetType,
+		CompressionQuality eQuality = COMPRESS_NORMAL, CompressionStats *pStats = NULL);
+
+	///@}
+}
+
+#endif //GLIMG_BLOCK_COMPRESSOR_H
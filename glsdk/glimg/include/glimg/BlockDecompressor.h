@@ -0,0 +1,73 @@
+/** Copyright (C) 2011 by Jason L. McKesson **/
+/** This file is licensed by the MIT License. **/
+
+
+
+#ifndef GLIMG_BLOCK_DECOMPRESSOR_H
+#define GLIMG_BLOCK_DECOMPRESSOR_H
+
+#include <string>
+#include <exception>
+#include "ImageSet.h"
+
+/**
+\file
+\brief Declares the function that decodes block-compressed ImageSets on the CPU.
+**/
+
+namespace glimg
+{
+	///\addtogroup module_glimg_exceptions
+	///@{
+
+	///Thrown if DecompressImageSet is given images that are not block compressed.
+	class DecompressionSourceUnsupportedException : public std::exception
+	{
+	public:
+		DecompressionSourceUnsupportedException()
+		{
+			message = "Only two-dimensional BC1 through BC7 images can be decompressed.";
+		}
+
+	    virtual ~DecompressionSourceUnsupportedException() throw() {}
+
+		virtual const char *what() const throw() {return message.c_str();}
+
+	protected:
+		std::string message;
+	};
+
+	///@}
+
+	///\addtogroup module_glimg_creation
+	///@{
+
+	/**
+	\brief Decodes every image of a block-compressed ImageSet.
+
+	Each format decodes to the nearest uncompressed one, with 8-bit normalized components
+	unless noted:
+
+	\li DT_COMPRESSED_BC1: RGBA, or RGBX if the source has no alpha.
+	\li DT_COMPRESSED_BC2, DT_COMPRESSED_BC3, DT_COMPRESSED_BC7: RGBA.
+	\li DT_COMPRESSED_UNSIGNED_BC4, DT_COMPRESSED_SIGNED_BC4: red, unsigned or signed.
+	\li DT_COMPRESSED_UNSIGNED_BC5, DT_COMPRESSED_SIGNED_BC5: red and green, unsigned or signed.
+	\li DT_COMPRESSED_UNSIGNED_BC6H, DT_COMPRESSED_SIGNED_BC6H: RGB half floats.
+
+	sRGB sources give sRGB results. The result has the source's dimensions, mipmaps, array
+	images, faces and row order. BC1 through BC5 use SSE2 to look texels up in their palettes
+	when the compiler allows it. Blocks are spread across threads by glimg's Executor.
+
+	CreateTexture uses this to upload formats the OpenGL implementation cannot take.
+
+	\param pSource The images to decode. It is not modified.
+	\return A new ImageSet, which the caller owns.
+
+	\throws DecompressionSourceUnsupportedException If the source is not block compressed.
+	**/
+	ImageSet *DecompressImageSet(const ImageSet *pSource);
+
+	///@}
+}
+
+#endif //GLIMG_BLOCK_DECOMPRESSOR_H
@@ -92,17 +92,35 @@ namespace glimg
 			\throws DdsLoaderException The image could not be loaded.  There are derived classes from this type that could be thrown.
 			\return An ImageSet that represents the loaded image data.
 
-			\todo Flip the textures, or allow the user to decide not to.
-			\todo Get 3D textures working.
-			\todo Get cubemap textures working. With mipmaps.
-			\todo Implement the D3D10 format.
-			\todo Get array textures working. With mipmaps.
-			\todo Get cubemap array textures working.
+			Files with a DX10 header may be 1D, 2D or 3D, and 1D and 2D ones may be arrays, of
+			cubemaps too. Their DXGI format must have a fixed meaning in OpenGL; TYPELESS formats
+			are not accepted. The BC6H and BC7 block formats and the sRGB variants are.
+
+			Compressed 3D textures are not supported.
+
+			The images are flipped to bottom-left, except for BC6H and BC7 ones, which the loader
+			cannot flip. Those keep the file's top-left order, and ImageSet::IsTopLeft returns true.
 			**/
 			ImageSet *LoadFromFile(const std::string &filename);
 
 			///As LoadFromFile, but from an already loaded buffer. The buffer pointer may be deleted after this call.
 			ImageSet *LoadFromMemory(const unsigned char *buffer, size_t bufSize);
+
+			/**
+			\brief Maps a DDS file into memory, without copying any of its pixel data.
+
+			The images of the returned ImageSet point straight into the mapped file, which stays
+			mapped until the ImageSet is deleted. Uploading them reads the mapped pages directly.
+
+			The rows are left in the file's top-left order rather than flipped, so
+			ImageSet::IsTopLeft returns true. Compressed images are not flipped either.
+
+			ImageSet::GetImageArray has to gather array and cubemap levels into one buffer, since the
+			file stores each image's mipmaps together. The other accessors never copy.
+
+			\throws DdsLoaderException The image could not be loaded.  There are derived classes from this type that could be thrown.
+			**/
+			ImageSet *MapFromFile(const std::string &filename);
 		}
 	}
 }
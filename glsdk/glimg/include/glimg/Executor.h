@@ -0,0 +1,59 @@
+/** Copyright (C) 2011 by Jason L. McKesson **/
+/** This file is licensed by the MIT License. **/
+
+
+
+#ifndef GLIMG_EXECUTOR_H
+#define GLIMG_EXECUTOR_H
+
+#include <functional>
+
+/**
+\file
+\brief Declares the interface glimg spreads its work across threads through.
+**/
+
+namespace glimg
+{
+	/**
+	\brief Runs the tasks that glimg splits its slower work into.
+
+	Block compression and decompression, mipmap generation and the batch loader all hand
+	their tasks to an Executor. Unless SetExecutor is given another, glimg uses a pool of its
+	own, with one thread per hardware thread, made the first time it is needed. An
+	application with a thread pool of its own can implement this interface over that pool, so
+	that glimg shares its threads rather than adding more.
+
+	glimg never waits on a task that no thread has started. A thread that needs some work done
+	runs whatever of it is still unclaimed itself, so an Executor may be slow to start tasks,
+	or share its threads with other work, without deadlocking glimg.
+
+	\ingroup module_glimg
+	**/
+	class Executor
+	{
+	public:
+		virtual ~Executor() {}
+
+		///Runs the task on some thread, at some point. The task never throws.
+		virtual void Submit(const std::function<void()> &task) = 0;
+
+		///Roughly how many threads run submitted tasks. glimg splits its work to suit.
+		virtual unsigned int GetThreadCount() const = 0;
+	};
+
+	/**
+	\brief Sets the executor that glimg uses from now on.
+
+	Call this while no glimg work is running. The executor must outlive every use glimg makes of
+	it, including tasks it has already been given.
+
+	\param pExecutor The executor to use, or NULL to go back to glimg's own pool.
+	**/
+	void SetExecutor(Executor *pExecutor);
+
+	///The executor given to SetExecutor, or glimg's own pool if there is none.
+	Executor &GetExecutor();
+}
+
+#endif //GLIMG_EXECUTOR_H
@@ -12,10 +12,21 @@
 \brief Contains the ImageSet class and associated objects.
 **/
 
+#include <string>
 #include "ImageFormat.h"
 
 namespace glimg
 {
+	class ImageSet;
+
+	namespace loaders
+	{
+		namespace dds
+		{
+			ImageSet *MapFromFile(const std::string &filename);
+		}
+	}
+
 	///\addtogroup module_glimg_imageset
 	///@{
 
@@ -51,9 +62,10 @@ namespace glimg
 	namespace detail
 	{
 		class ImageSetImpl;
-	}
 
-	class ImageSet;
+		//Wraps an implementation built by the library itself, rather than by an ImageCreator.
+		ImageSet *MakeImageSet(ImageSetImpl *pImpl);
+	}
 
 	/**
 	\brief Represents a single image of a certain dimensionality.
@@ -155,6 +167,15 @@ namespace glimg
 		**/
 		ImageFormat GetFormat() const;
 
+		/**
+		\brief Returns true if the first row of each image is the top of the picture.
+
+		ImageSets made by an ImageCreator are always bottom-left, as OpenGL expects. A mapped
+		ImageSet keeps the rows in the file's order instead of flipping them, so a top-left image
+		will be upside down in OpenGL's texture space; flip the texture coordinates to match.
+		**/
+		bool IsTopLeft() const;
+
 		/**
 		\brief Retrieves the image at the given mipmap level, array index, and face index.
 		
@@ -179,6 +200,8 @@ namespace glimg
 
 		friend class ImageCreator;
 		friend void CreateTexture(unsigned int textureName, const ImageSet *pImage, unsigned int forceConvertBits);
+		friend ImageSet *loaders::dds::MapFromFile(const std::string &filename);
+		friend ImageSet *detail::MakeImageSet(detail::ImageSetImpl *pImpl);
 
 		//Prevent copying.
 		ImageSet(const ImageSet &);
@@ -0,0 +1,87 @@
+/** Copyright (C) 2011 by Jason L. McKesson **/
+/** This file is licensed by the MIT License. **/
+
+
+
+#ifndef GLIMG_MIPMAP_GENERATOR_H
+#define GLIMG_MIPMAP_GENERATOR_H
+
+#include <string>
+#include <exception>
+#include "ImageSet.h"
+
+/**
+\file
+\brief Declares the function that builds mipmap chains for ImageSets on the CPU.
+**/
+
+namespace glimg
+{
+	///\addtogroup module_glimg_exceptions
+	///@{
+
+	///Thrown if GenerateMipmaps is given images whose format it cannot filter.
+	class MipmapSourceUnsupportedException : public std::exception
+	{
+	public:
+		MipmapSourceUnsupportedException()
+		{
+			message = "Only one or two-dimensional color images with 8 or 16-bit normalized unsigned, or 32-bit float, components can be mipmapped.";
+		}
+
+	    virtual ~MipmapSourceUnsupportedException() throw() {}
+
+		virtual const char *what() const throw() {return message.c_str();}
+
+	protected:
+		std::string message;
+	};
+
+	///@}
+
+	///\addtogroup module_glimg_creation
+	///@{
+
+	///The filter GenerateMipmaps shrinks each level with.
+	enum MipmapFilter
+	{
+		MIPMAP_FILTER_BOX,			///<Averages the texels each one covers. Fast, but soft and prone to aliasing.
+		MIPMAP_FILTER_KAISER,		///<A sinc windowed by a Kaiser window, 3 texels wide. Sharp with little ringing.
+		MIPMAP_FILTER_LANCZOS,		///<A three-lobed Lanczos filter. Sharpest, with some ringing at hard edges.
+	};
+
+	/**
+	\brief Builds a full mipmap chain from the base level of an ImageSet.
+
+	The source must be one or two-dimensional, though it may have array images and cube faces,
+	and hold color components that are 8 or 16-bit normalized unsigned integers, or 32-bit
+	floats. Any mipmaps the source already has are ignored. The result has the source's format
+	and base level, followed by every smaller level down to 1x1.
+
+	Each level is filtered from the previous one, kept as floats so that rounding does not
+	build up down the chain. The RGB components of sRGB formats are filtered in linear space
+	and converted back when stored. Normalized values the filter overshoots are clamped.
+
+	If \a alphaReference is greater than zero and the format has alpha, each level's alpha is
+	scaled so that the fraction of texels with alpha at or above \a alphaReference is the same
+	as in the base level. Alpha-tested cutouts then keep their coverage in the distance
+	instead of thinning away.
+
+	The levels are built one after another; within a level, the rows of every array image and
+	face are spread across threads by glimg's Executor. The filtering uses SSE or AVX when the
+	compiler allows them.
+
+	\param pSource The images to build mipmaps for. It is not modified.
+	\param eFilter The filter to shrink each level with.
+	\param alphaReference The alpha test reference to preserve coverage for, or 0 to leave alpha as filtered.
+	\return A new ImageSet, which the caller owns.
+
+	\throws MipmapSourceUnsupportedException If the source is not one of the formats listed above.
+	**/
+	ImageSet *GenerateMipmaps(const ImageSet *pSource, MipmapFilter eFilter = MIPMAP_FILTER_KAISER,
+		float alphaReference = 0.0f);
+
+	///@}
+}
+
+#endif //GLIMG_MIPMAP_GENERATOR_H
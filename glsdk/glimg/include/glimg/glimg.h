@@ -12,8 +12,12 @@
 **/
 
 #include "ImageSet.h"
+#include "Executor.h"
 #include "Loaders.h"
 #include "TextureGenerator.h"
+#include "BlockCompressor.h"
+#include "BlockDecompressor.h"
+#include "MipmapGenerator.h"
 
 /**
 \brief The main GL Image library namespace.
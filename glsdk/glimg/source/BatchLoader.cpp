@@ -0,0 +1,353 @@
+//Copyright (C) 2011 by Jason L. McKesson
+//This file is licensed by the MIT License.
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include "stb_image.h"
+#include "glimg/BatchLoader.h"
+#include "glimg/StbLoader.h"
+#include "glimg/DdsLoader.h"
+
+namespace glimg
+{
+	namespace
+	{
+		const char DDS_MAGIC[] = "DDS ";
+
+		bool IsDdsFilename(const std::string &filename)
+		{
+			size_t dotLoc = filename.rfind('.');
+			if(dotLoc == std::string::npos || filename.size() - dotLoc != 4)
+				return false;
+
+			std::string ext = filename.substr(dotLoc + 1);
+			std::transform(ext.begin(), ext.end(), ext.begin(), tolower);
+			return ext == "dds";
+		}
+
+		bool IsDdsBuffer(const unsigned char *buffer, size_t bufSize)
+		{
+			return bufSize >= 4 && memcmp(buffer, DDS_MAGIC, 4) == 0;
+		}
+
+		//What stb_image's decoded pixels take, twice over: its own buffer and the ImageSet's copy.
+		size_t EstimateStbPixelBytes(int width, int height, int numComp)
+		{
+			return 2 * (size_t)width * height * numComp;
+		}
+
+		//Never throws; files that cannot be read cost nothing, and fail when they are decoded.
+		size_t EstimateFileBytes(const std::string &filename)
+		{
+			FILE *pFile = fopen(filename.c_str(), "rb");
+			if(!pFile)
+				return 0;
+
+			fseek(pFile, 0, SEEK_END);
+			long int fileSize = ftell(pFile);
+			fseek(pFile, 0, SEEK_SET);
+
+			//DDS files are read whole, then copied into the ImageSet.
+			size_t estimate = 2 * (size_t)std::max(fileSize, 0L);
+			if(!IsDdsFilename(filename))
+			{
+				int width = 0;
+				int height = 0;
+				int numComp = 0;
+				if(stbi_info_from_file(pFile, &width, &height, &numComp))
+					estimate = EstimateStbPixelBytes(width, height, numComp);
+			}
+
+			fclose(pFile);
+			return estimate;
+		}
+
+		size_t EstimateMemoryBytes(const unsigned char *buffer, size_t bufSize)
+		{
+			//The buffer belongs to the caller; only the ImageSet's copy is new.
+			if(IsDdsBuffer(buffer, bufSize))
+				return bufSize;
+
+			int width = 0;
+			int height = 0;
+			int numComp = 0;
+			if(stbi_info_from_memory(buffer, (int)bufSize, &width, &height, &numComp))
+				return EstimateStbPixelBytes(width, height, numComp);
+
+			return 0;
+		}
+	}
+
+	namespace detail
+	{
+		class BatchLoaderImpl
+		{
+		public:
+			struct Item
+			{
+				bool bIsFile;
+				std::string filename;
+				const unsigned char *buffer;
+				size_t bufSize;
+				size_t estimatedBytes;
+				loaders::BatchLoader::CompletionFunc onComplete;
+			};
+
+			BatchLoaderImpl(size_t maxBytesInFlight, Executor &executor)
+				: m_executor(executor)
+				, m_maxBytesInFlight(maxBytesInFlight)
+				, m_bytesInFlight(0)
+				, m_peakBytesInFlight(0)
+				, m_pendingTasks(0)
+			{}
+
+			void AddFile(const Item &item)
+			{
+				//Reading the header is I/O too, so it happens on the executor.
+				Run([this, item]()
+				{
+					Item estimated = item;
+					estimated.estimatedBytes = EstimateFileBytes(item.filename);
+					MakeReady(estimated);
+				});
+			}
+
+			void AddMemory(const Item &item)
+			{
+				Item estimated = item;
+				estimated.estimatedBytes = EstimateMemoryBytes(item.buffer, item.bufSize);
+				MakeReady(estimated);
+			}
+
+			//Rethrows the first exception a completion function threw since the last call.
+			void Wait()
+			{
+				std::exception_ptr error;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					while(m_pendingTasks != 0)
+						m_idle.wait(lock);
+
+					error = m_error;
+					m_error = std::exception_ptr();
+				}
+
+				if(error)
+					std::rethrow_exception(error);
+			}
+
+			size_t GetPeakBytesInFlight()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				return m_peakBytesInFlight;
+			}
+
+		private:
+			Executor &m_executor;
+			size_t m_maxBytesInFlight;
+			size_t m_bytesInFlight;
+			size_t m_peakBytesInFlight;
+			std::deque<Item> m_ready;		//Estimated, but waiting for room.
+
+			std::mutex m_mutex;
+			std::condition_variable m_idle;
+			size_t m_pendingTasks;			//Submitted, and not yet finished.
+			std::exception_ptr m_error;
+
+			//Tasks that start more tasks count them first, so the count only reaches zero
+			//once every item is done.
+			void Run(const std::function<void()> &task)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					++m_pendingTasks;
+				}
+
+				m_executor.Submit([this, task]()
+				{
+					std::exception_ptr error;
+					try
+					{
+						task();
+					}
+					catch(...)
+					{
+						error = std::current_exception();
+					}
+
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if(error && !m_error)
+						m_error = error;
+
+					--m_pendingTasks;
+					if(m_pendingTasks == 0)
+						m_idle.notify_all();
+				});
+			}
+
+			void MakeReady(const Item &item)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_ready.push_back(item);
+				}
+
+				StartReadyItems();
+			}
+
+			//Starts waiting items, in order, until the next would not fit.
+			void StartReadyItems()
+			{
+				std::vector<Item> startable;
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					while(!m_ready.empty())
+					{
+						const Item &next = m_ready.front();
+						if(m_bytesInFlight != 0 && m_bytesInFlight + next.estimatedBytes > m_maxBytesInFlight)
+							break;
+
+						m_bytesInFlight += next.estimatedBytes;
+						m_peakBytesInFlight = std::max(m_peakBytesInFlight, m_bytesInFlight);
+						startable.push_back(next);
+						m_ready.pop_front();
+					}
+				}
+
+				for(size_t itemIx = 0; itemIx < startable.size(); ++itemIx)
+				{
+					const Item &item = startable[itemIx];
+					Run([this, item]() {Decode(item);});
+				}
+			}
+
+			void Decode(const Item &item)
+			{
+				ImageSet *pImageSet = NULL;
+				std::exception_ptr error;
+				try
+				{
+					if(item.bIsFile)
+					{
+						if(IsDdsFilename(item.filename))
+							pImageSet = loaders::dds::LoadFromFile(item.filename);
+						else
+							pImageSet = loaders::stb::LoadFromFile(item.filename);
+					}
+					else
+					{
+						if(IsDdsBuffer(item.buffer, item.bufSize))
+							pImageSet = loaders::dds::LoadFromMemory(item.buffer, item.bufSize);
+						else
+							pImageSet = loaders::stb::LoadFromMemory(item.buffer, item.bufSize);
+					}
+				}
+				catch(...)
+				{
+					error = std::current_exception();
+				}
+
+				//Once decoded, the image is the caller's; make room for the next before handing it over.
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_bytesInFlight -= item.estimatedBytes;
+				}
+
+				StartReadyItems();
+				item.onComplete(pImageSet, error);
+			}
+		};
+	}
+
+	namespace
+	{
+		typedef std::shared_ptr<std::promise<std::unique_ptr<ImageSet> > > ResultPromise;
+
+		loaders::BatchLoader::CompletionFunc MakePromiseSetter(const ResultPromise &pPromise)
+		{
+			return [pPromise](ImageSet *pImageSet, std::exception_ptr error)
+			{
+				if(error)
+					pPromise->set_exception(error);
+				else
+					pPromise->set_value(std::unique_ptr<ImageSet>(pImageSet));
+			};
+		}
+	}
+
+	namespace loaders
+	{
+		BatchLoader::BatchLoader( size_t maxBytesInFlight, Executor *pExecutor )
+			: m_pImpl(new detail::BatchLoaderImpl(maxBytesInFlight,
+				pExecutor ? *pExecutor : GetExecutor()))
+		{}
+
+		BatchLoader::~BatchLoader()
+		{
+			try
+			{
+				m_pImpl->Wait();
+			}
+			catch(...)
+			{
+			}
+
+			delete m_pImpl;
+		}
+
+		std::future<std::unique_ptr<ImageSet> > BatchLoader::AddFile( const std::string &filename )
+		{
+			ResultPromise pPromise(new std::promise<std::unique_ptr<ImageSet> >());
+			AddFile(filename, MakePromiseSetter(pPromise));
+			return pPromise->get_future();
+		}
+
+		void BatchLoader::AddFile( const std::string &filename, const CompletionFunc &onComplete )
+		{
+			detail::BatchLoaderImpl::Item item;
+			item.bIsFile = true;
+			item.filename = filename;
+			item.buffer = NULL;
+			item.bufSize = 0;
+			item.estimatedBytes = 0;
+			item.onComplete = onComplete;
+			m_pImpl->AddFile(item);
+		}
+
+		std::future<std::unique_ptr<ImageSet> > BatchLoader::AddMemory( const unsigned char *buffer, size_t bufSize )
+		{
+			ResultPromise pPromise(new std::promise<std::unique_ptr<ImageSet> >());
+			AddMemory(buffer, bufSize, MakePromiseSetter(pPromise));
+			return pPromise->get_future();
+		}
+
+		void BatchLoader::AddMemory( const unsigned char *buffer, size_t bufSize, const CompletionFunc &onComplete )
+		{
+			detail::BatchLoaderImpl::Item item;
+			item.bIsFile = false;
+			item.buffer = buffer;
+			item.bufSize = bufSize;
+			item.estimatedBytes = 0;
+			item.onComplete = onComplete;
+			m_pImpl->AddMemory(item);
+		}
+
+		void BatchLoader::Wait()
+		{
+			m_pImpl->Wait();
+		}
+
+		size_t BatchLoader::GetPeakBytesInFlight() const
+		{
+			return m_pImpl->GetPeakBytesInFlight();
+		}
+	}
+}
@@ -0,0 +1,961 @@
+//Copyright (C) 2011 by Jason L. McKesson
+//This file is licensed by the MIT License.
+
+
+
+#include <float.h>
+#include <math.h>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include "glimg/BlockCompressor.h"
+#include "glimg/Executor.h"
+#include "ImageSetImpl.h"
+#include "Util.h"
+#include "SimdOps.h"
+#include "ParallelFor.h"
+
+#define ARRAY_COUNT( array ) (sizeof( array ) / (sizeof( array[0] ) * (sizeof( array ) != sizeof(void*) || sizeof( array[0] ) <= sizeof(void*))))
+
+namespace glimg
+{
+	namespace
+	{
+		template<int arrayCount, typename TestType>
+		bool IsOneOfThese(TestType testValue, TestType *testArray)
+		{
+			for(int loop = 0; loop < arrayCount; loop++)
+			{
+				if(testValue == testArray[loop])
+					return true;
+			}
+
+			return false;
+		}
+
+		const int BLOCK_TEXELS = 16;
+
+		//Fewer blocks per task would spend more time handing out tasks than encoding them.
+		const size_t MIN_BLOCKS_PER_TASK = 64;
+
+		//How many times COMPRESS_BEST refines the endpoints, or walks to better neighbors.
+		const int MAX_REFINEMENTS = 8;
+
+		//BC1 stores texels with less alpha than this as transparent.
+		const float ALPHA_THRESHOLD = 128.0f;
+
+		//A block's texels, one array per component, each on a 0-255 scale.
+		struct TexelBlock
+		{
+			float comps[4][BLOCK_TEXELS];
+			bool inside[BLOCK_TEXELS];		//False for texels repeated past the image's edge.
+		};
+
+		//Where R, G, B and A are in a source texel; -1 for those it does not have.
+		struct SourceLayout
+		{
+			int texelSize;
+			int compOffsets[4];
+		};
+
+		PixelComponents g_sourceFormats[] = {FMT_COLOR_RED, FMT_COLOR_RG, FMT_COLOR_RGB,
+			FMT_COLOR_RGBX, FMT_COLOR_RGBA, FMT_COLOR_RGB_sRGB, FMT_COLOR_RGBX_sRGB, FMT_COLOR_RGBA_sRGB};
+		PixelComponents g_alphaFormats[] = {FMT_COLOR_RGBA, FMT_COLOR_RGBA_sRGB};
+		PixelComponents g_srgbFormats[] = {FMT_COLOR_RGB_sRGB, FMT_COLOR_RGBX_sRGB, FMT_COLOR_RGBA_sRGB};
+
+		SourceLayout GetSourceLayout(const ImageFormat &fmt, const Dimensions &dims)
+		{
+			if(fmt.Type() != DT_NORM_UNSIGNED_INTEGER || fmt.Depth() != BD_PER_COMP_8 ||
+				dims.numDimensions != 2)
+				throw CompressionSourceUnsupportedException();
+
+			if(fmt.Order() != ORDER_RGBA && fmt.Order() != ORDER_BGRA)
+				throw CompressionSourceUnsupportedException();
+
+			if(!IsOneOfThese<ARRAY_COUNT(g_sourceFormats)>(fmt.Components(), g_sourceFormats))
+				throw CompressionSourceUnsupportedException();
+
+			SourceLayout layout;
+			layout.texelSize = ComponentCount(fmt.Components());
+			for(int compIx = 0; compIx < 4; ++compIx)
+				layout.compOffsets[compIx] = compIx < layout.texelSize ? compIx : -1;
+
+			if(!IsOneOfThese<ARRAY_COUNT(g_alphaFormats)>(fmt.Components(), g_alphaFormats))
+				layout.compOffsets[3] = -1;
+
+			if(fmt.Order() == ORDER_BGRA && layout.texelSize >= 3)
+				std::swap(layout.compOffsets[0], layout.compOffsets[2]);
+
+			return layout;
+		}
+
+		ImageFormat GetTargetFormat(const ImageFormat &sourceFmt, PixelDataType eTargetType)
+		{
+			bool bHasAlpha = IsOneOfThese<ARRAY_COUNT(g_alphaFormats)>(sourceFmt.Components(), g_alphaFormats);
+			bool bIsSRGB = IsOneOfThese<ARRAY_COUNT(g_srgbFormats)>(sourceFmt.Components(), g_srgbFormats);
+
+			PixelComponents eFormat;
+			switch(eTargetType)
+			{
+			case DT_COMPRESSED_BC1:
+				if(bHasAlpha)
+					eFormat = bIsSRGB ? FMT_COLOR_RGBA_sRGB : FMT_COLOR_RGBA;
+				else
+					eFormat = bIsSRGB ? FMT_COLOR_RGB_sRGB : FMT_COLOR_RGB;
+				break;
+			case DT_COMPRESSED_BC3:
+				eFormat = bIsSRGB ? FMT_COLOR_RGBA_sRGB : FMT_COLOR_RGBA;
+				break;
+			case DT_COMPRESSED_UNSIGNED_BC4:
+				eFormat = FMT_COLOR_RED;
+				break;
+			case DT_COMPRESSED_UNSIGNED_BC5:
+				eFormat = FMT_COLOR_RG;
+				break;
+			default:
+				throw CompressionTargetUnsupportedException();
+			}
+
+			return ImageFormat(eTargetType, eFormat, ORDER_COMPRESSED, BD_COMPRESSED, 1);
+		}
+
+		void GatherBlock( const unsigned char *pImage, size_t lineSize, const SourceLayout &layout,
+			int width, int height, int blockX, int blockY, TexelBlock &block )
+		{
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+			{
+				int x = blockX * 4 + (texelIx % 4);
+				int y = blockY * 4 + (texelIx / 4);
+				block.inside[texelIx] = x < width && y < height;
+
+				const unsigned char *pTexel = pImage + std::min(y, height - 1) * lineSize +
+					std::min(x, width - 1) * layout.texelSize;
+				for(int compIx = 0; compIx < 4; ++compIx)
+				{
+					int offset = layout.compOffsets[compIx];
+					if(offset >= 0)
+						block.comps[compIx][texelIx] = pTexel[offset];
+					else
+						block.comps[compIx][texelIx] = compIx == 3 ? 255.0f : 0.0f;
+				}
+			}
+		}
+
+		//Matches each texel to its nearest palette entry. Entries hold compCount values each.
+		//If pAlpha is not NULL, texels whose alpha is under the threshold take the entry after
+		//the last without adding error. Returns the summed squared error.
+		template<typename Ops>
+		float FitPalette( const float *const *comps, int compCount, const float *palette,
+			int paletteSize, const float *pAlpha, unsigned char *indices )
+		{
+			typedef typename Ops::Floats Floats;
+			typedef typename Ops::Mask Mask;
+
+			Floats totalError = Ops::Set(0.0f);
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; texelIx += Ops::LANES)
+			{
+				Floats values[4];
+				for(int compIx = 0; compIx < compCount; ++compIx)
+					values[compIx] = Ops::Load(comps[compIx] + texelIx);
+
+				Floats bestError = Ops::Set(FLT_MAX);
+				Floats bestIndex = Ops::Set(0.0f);
+				for(int entryIx = 0; entryIx < paletteSize; ++entryIx)
+				{
+					Floats error = Ops::Set(0.0f);
+					for(int compIx = 0; compIx < compCount; ++compIx)
+					{
+						Floats diff = Ops::Sub(values[compIx], Ops::Set(palette[entryIx * compCount + compIx]));
+						error = Ops::Add(error, Ops::Mul(diff, diff));
+					}
+
+					Mask closer = Ops::Less(error, bestError);
+					bestError = Ops::Select(closer, error, bestError);
+					bestIndex = Ops::Select(closer, Ops::Set((float)entryIx), bestIndex);
+				}
+
+				if(pAlpha)
+				{
+					Mask transparent = Ops::Less(Ops::Load(pAlpha + texelIx), Ops::Set(ALPHA_THRESHOLD));
+					bestError = Ops::Select(transparent, Ops::Set(0.0f), bestError);
+					bestIndex = Ops::Select(transparent, Ops::Set((float)paletteSize), bestIndex);
+				}
+
+				totalError = Ops::Add(totalError, bestError);
+
+				float laneIndices[Ops::LANES];
+				Ops::Store(laneIndices, bestIndex);
+				for(int laneIx = 0; laneIx < Ops::LANES; ++laneIx)
+					indices[texelIx + laneIx] = (unsigned char)laneIndices[laneIx];
+			}
+
+			return Ops::Sum(totalError);
+		}
+
+		//Finds the pair of endpoints that best reproduces the texels, given the palette entries
+		//they were matched to. weights[i] is how much of entry i is endpoint 0; the rest is
+		//endpoint 1. A negative weight marks an entry that does not depend on the endpoints.
+		//Returns false if the matches do not pin down both endpoints.
+		template<typename Ops>
+		bool SolveEndpoints( const float *const *comps, int compCount, const unsigned char *indices,
+			const float *weights, float ends[2][3] )
+		{
+			typedef typename Ops::Floats Floats;
+
+			float weights0[BLOCK_TEXELS];
+			float weights1[BLOCK_TEXELS];
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+			{
+				float weight = weights[indices[texelIx]];
+				weights0[texelIx] = weight < 0.0f ? 0.0f : weight;
+				weights1[texelIx] = weight < 0.0f ? 0.0f : 1.0f - weight;
+			}
+
+			Floats sum00 = Ops::Set(0.0f);
+			Floats sum01 = Ops::Set(0.0f);
+			Floats sum11 = Ops::Set(0.0f);
+			Floats sumValue0[3] = {Ops::Set(0.0f), Ops::Set(0.0f), Ops::Set(0.0f)};
+			Floats sumValue1[3] = {Ops::Set(0.0f), Ops::Set(0.0f), Ops::Set(0.0f)};
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; texelIx += Ops::LANES)
+			{
+				Floats weight0 = Ops::Load(weights0 + texelIx);
+				Floats weight1 = Ops::Load(weights1 + texelIx);
+				sum00 = Ops::Add(sum00, Ops::Mul(weight0, weight0));
+				sum01 = Ops::Add(sum01, Ops::Mul(weight0, weight1));
+				sum11 = Ops::Add(sum11, Ops::Mul(weight1, weight1));
+				for(int compIx = 0; compIx < compCount; ++compIx)
+				{
+					Floats value = Ops::Load(comps[compIx] + texelIx);
+					sumValue0[compIx] = Ops::Add(sumValue0[compIx], Ops::Mul(weight0, value));
+					sumValue1[compIx] = Ops::Add(sumValue1[compIx], Ops::Mul(weight1, value));
+				}
+			}
+
+			float a = Ops::Sum(sum00);
+			float b = Ops::Sum(sum01);
+			float c = Ops::Sum(sum11);
+			float determinant = a * c - b * b;
+			if(fabsf(determinant) < 1.0e-4f)
+				return false;
+
+			for(int compIx = 0; compIx < compCount; ++compIx)
+			{
+				float value0 = Ops::Sum(sumValue0[compIx]);
+				float value1 = Ops::Sum(sumValue1[compIx]);
+				ends[0][compIx] = std::min(std::max((c * value0 - b * value1) / determinant, 0.0f), 255.0f);
+				ends[1][compIx] = std::min(std::max((a * value1 - b * value0) / determinant, 0.0f), 255.0f);
+			}
+
+			return true;
+		}
+
+		//The smallest and largest of each component, over the block's texels.
+		template<typename Ops>
+		void FindBounds( const float *const *comps, int compCount, float *pMins, float *pMaxs )
+		{
+			for(int compIx = 0; compIx < compCount; ++compIx)
+			{
+				typename Ops::Floats mins = Ops::Load(comps[compIx]);
+				typename Ops::Floats maxs = mins;
+				for(int texelIx = Ops::LANES; texelIx < BLOCK_TEXELS; texelIx += Ops::LANES)
+				{
+					typename Ops::Floats values = Ops::Load(comps[compIx] + texelIx);
+					mins = Ops::Min(mins, values);
+					maxs = Ops::Max(maxs, values);
+				}
+
+				pMins[compIx] = Ops::ReduceMin(mins);
+				pMaxs[compIx] = Ops::ReduceMax(maxs);
+			}
+		}
+
+		////////////////////////////////////////////////////////
+		//Color blocks, for BC1 and the color half of BC3.
+
+		struct ColorBlockCode
+		{
+			unsigned short colors[2];
+			unsigned char indices[BLOCK_TEXELS];
+			float palette[4][3];
+			float error;
+		};
+
+		//Weights of endpoint 0 in each palette entry, for SolveEndpoints.
+		const float g_fourColorWeights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+		const float g_threeColorWeights[4] = {1.0f, 0.0f, 0.5f, -1.0f};
+
+		unsigned short PackColor565( const float color[3] )
+		{
+			int red = (int)(color[0] * (31.0f / 255.0f) + 0.5f);
+			int green = (int)(color[1] * (63.0f / 255.0f) + 0.5f);
+			int blue = (int)(color[2] * (31.0f / 255.0f) + 0.5f);
+			return (unsigned short)((red << 11) | (green << 5) | blue);
+		}
+
+		void UnpackColor565( unsigned short packed, float color[3] )
+		{
+			int red = (packed >> 11) & 0x1F;
+			int green = (packed >> 5) & 0x3F;
+			int blue = packed & 0x1F;
+			color[0] = (float)((red << 3) | (red >> 2));
+			color[1] = (float)((green << 2) | (green >> 4));
+			color[2] = (float)((blue << 3) | (blue >> 2));
+		}
+
+		//Puts the packed colors in the order that selects the mode, builds the palette, and
+		//matches the texels to it. With punch-through alpha, the colors are ordered for the
+		//three-color mode, whose fourth entry is transparent black. BC3 always decodes four
+		//colors, but the order is kept the same as BC1's so any decoder agrees.
+		template<typename Ops>
+		void FitColorCode( const TexelBlock &block, bool bPunchThrough, ColorBlockCode &code )
+		{
+			if(bPunchThrough ? code.colors[0] > code.colors[1] : code.colors[0] < code.colors[1])
+				std::swap(code.colors[0], code.colors[1]);
+
+			UnpackColor565(code.colors[0], code.palette[0]);
+			UnpackColor565(code.colors[1], code.palette[1]);
+
+			int paletteSize;
+			if(bPunchThrough)
+			{
+				for(int compIx = 0; compIx < 3; ++compIx)
+				{
+					code.palette[2][compIx] = (code.palette[0][compIx] + code.palette[1][compIx]) * 0.5f;
+					code.palette[3][compIx] = 0.0f;
+				}
+				paletteSize = 3;
+			}
+			else if(code.colors[0] == code.colors[1])
+			{
+				//Which mode this is depends on the decoder, but both have the color at index 0.
+				paletteSize = 1;
+			}
+			else
+			{
+				for(int compIx = 0; compIx < 3; ++compIx)
+				{
+					code.palette[2][compIx] = (2.0f * code.palette[0][compIx] + code.palette[1][compIx]) / 3.0f;
+					code.palette[3][compIx] = (code.palette[0][compIx] + 2.0f * code.palette[1][compIx]) / 3.0f;
+				}
+				paletteSize = 4;
+			}
+
+			const float *comps[3] = {block.comps[0], block.comps[1], block.comps[2]};
+			code.error = FitPalette<Ops>(comps, 3, &code.palette[0][0], paletteSize,
+				bPunchThrough ? block.comps[3] : NULL, code.indices);
+		}
+
+		template<typename Ops>
+		void TryColorEndpoints( const TexelBlock &block, bool bPunchThrough, const float ends[2][3],
+			ColorBlockCode &best )
+		{
+			ColorBlockCode code;
+			code.colors[0] = PackColor565(ends[0]);
+			code.colors[1] = PackColor565(ends[1]);
+			FitColorCode<Ops>(block, bPunchThrough, code);
+			if(code.error < best.error)
+				best = code;
+		}
+
+		//The corners of the bounding box, along the diagonal the texels lean towards, pulled
+		//in a little so the palette covers the middle better.
+		template<typename Ops>
+		void FindBoxColorEndpoints( const TexelBlock &block, float ends[2][3] )
+		{
+			const float *comps[3] = {block.comps[0], block.comps[1], block.comps[2]};
+			float mins[3], maxs[3];
+			FindBounds<Ops>(comps, 3, mins, maxs);
+
+			float center[3];
+			for(int compIx = 0; compIx < 3; ++compIx)
+			{
+				float inset = (maxs[compIx] - mins[compIx]) / 16.0f;
+				center[compIx] = (maxs[compIx] + mins[compIx]) * 0.5f;
+				ends[0][compIx] = maxs[compIx] - inset;
+				ends[1][compIx] = mins[compIx] + inset;
+			}
+
+			typename Ops::Floats redGreen = Ops::Set(0.0f);
+			typename Ops::Floats blueGreen = Ops::Set(0.0f);
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; texelIx += Ops::LANES)
+			{
+				typename Ops::Floats red = Ops::Sub(Ops::Load(comps[0] + texelIx), Ops::Set(center[0]));
+				typename Ops::Floats green = Ops::Sub(Ops::Load(comps[1] + texelIx), Ops::Set(center[1]));
+				typename Ops::Floats blue = Ops::Sub(Ops::Load(comps[2] + texelIx), Ops::Set(center[2]));
+				redGreen = Ops::Add(redGreen, Ops::Mul(red, green));
+				blueGreen = Ops::Add(blueGreen, Ops::Mul(blue, green));
+			}
+
+			if(Ops::Sum(redGreen) < 0.0f)
+				std::swap(ends[0][0], ends[1][0]);
+			if(Ops::Sum(blueGreen) < 0.0f)
+				std::swap(ends[0][2], ends[1][2]);
+		}
+
+		//The extent of the texels along the axis they spread the most on.
+		template<typename Ops>
+		void FindAxisColorEndpoints( const TexelBlock &block, float ends[2][3] )
+		{
+			typedef typename Ops::Floats Floats;
+
+			const float *comps[3] = {block.comps[0], block.comps[1], block.comps[2]};
+
+			float mean[3];
+			for(int compIx = 0; compIx < 3; ++compIx)
+			{
+				Floats sum = Ops::Set(0.0f);
+				for(int texelIx = 0; texelIx < BLOCK_TEXELS; texelIx += Ops::LANES)
+					sum = Ops::Add(sum, Ops::Load(comps[compIx] + texelIx));
+				mean[compIx] = Ops::Sum(sum) / BLOCK_TEXELS;
+			}
+
+			//Covariance: rr, rg, rb, gg, gb, bb.
+			Floats covarianceSums[6];
+			for(int sumIx = 0; sumIx < 6; ++sumIx)
+				covarianceSums[sumIx] = Ops::Set(0.0f);
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; texelIx += Ops::LANES)
+			{
+				Floats red = Ops::Sub(Ops::Load(comps[0] + texelIx), Ops::Set(mean[0]));
+				Floats green = Ops::Sub(Ops::Load(comps[1] + texelIx), Ops::Set(mean[1]));
+				Floats blue = Ops::Sub(Ops::Load(comps[2] + texelIx), Ops::Set(mean[2]));
+				covarianceSums[0] = Ops::Add(covarianceSums[0], Ops::Mul(red, red));
+				covarianceSums[1] = Ops::Add(covarianceSums[1], Ops::Mul(red, green));
+				covarianceSums[2] = Ops::Add(covarianceSums[2], Ops::Mul(red, blue));
+				covarianceSums[3] = Ops::Add(covarianceSums[3], Ops::Mul(green, green));
+				covarianceSums[4] = Ops::Add(covarianceSums[4], Ops::Mul(green, blue));
+				covarianceSums[5] = Ops::Add(covarianceSums[5], Ops::Mul(blue, blue));
+			}
+
+			float covariance[6];
+			for(int sumIx = 0; sumIx < 6; ++sumIx)
+				covariance[sumIx] = Ops::Sum(covarianceSums[sumIx]);
+
+			//Power iteration, starting from the luminance direction.
+			float axis[3] = {1.0f, 1.0f, 1.0f};
+			for(int iteration = 0; iteration < 8; ++iteration)
+			{
+				float next[3];
+				next[0] = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+				next[1] = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+				next[2] = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+
+				float largest = std::max(fabsf(next[0]), std::max(fabsf(next[1]), fabsf(next[2])));
+				if(largest < 1.0e-6f)
+					break;
+
+				for(int compIx = 0; compIx < 3; ++compIx)
+					axis[compIx] = next[compIx] / largest;
+			}
+
+			Floats minProjection = Ops::Set(FLT_MAX);
+			Floats maxProjection = Ops::Set(-FLT_MAX);
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; texelIx += Ops::LANES)
+			{
+				Floats projection = Ops::Set(0.0f);
+				for(int compIx = 0; compIx < 3; ++compIx)
+				{
+					Floats offset = Ops::Sub(Ops::Load(comps[compIx] + texelIx), Ops::Set(mean[compIx]));
+					projection = Ops::Add(projection, Ops::Mul(offset, Ops::Set(axis[compIx])));
+				}
+				minProjection = Ops::Min(minProjection, projection);
+				maxProjection = Ops::Max(maxProjection, projection);
+			}
+
+			float lengthSqr = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+			float lowest = Ops::ReduceMin(minProjection) / lengthSqr;
+			float highest = Ops::ReduceMax(maxProjection) / lengthSqr;
+			for(int compIx = 0; compIx < 3; ++compIx)
+			{
+				ends[0][compIx] = std::min(std::max(mean[compIx] + axis[compIx] * highest, 0.0f), 255.0f);
+				ends[1][compIx] = std::min(std::max(mean[compIx] + axis[compIx] * lowest, 0.0f), 255.0f);
+			}
+		}
+
+		//Tries the endpoints that best fit the texels' current matches, up to maxRefinements
+		//times, stopping once that no longer helps.
+		template<typename Ops>
+		void RefineColorCode( const TexelBlock &block, bool bPunchThrough, int maxRefinements,
+			ColorBlockCode &best )
+		{
+			const float *comps[3] = {block.comps[0], block.comps[1], block.comps[2]};
+			const float *weights = bPunchThrough ? g_threeColorWeights : g_fourColorWeights;
+
+			for(int refinement = 0; refinement < maxRefinements; ++refinement)
+			{
+				float ends[2][3];
+				if(!SolveEndpoints<Ops>(comps, 3, best.indices, weights, ends))
+					return;
+
+				float previousError = best.error;
+				TryColorEndpoints<Ops>(block, bPunchThrough, ends, best);
+				if(!(best.error < previousError))
+					return;
+			}
+		}
+
+		//Walks the packed endpoints one step at a time to whichever neighbor fits better.
+		template<typename Ops>
+		void SearchColorNeighbors( const TexelBlock &block, bool bPunchThrough, ColorBlockCode &best )
+		{
+			const int shifts[3] = {11, 5, 0};
+			const int masks[3] = {0x1F, 0x3F, 0x1F};
+
+			for(int pass = 0; pass < MAX_REFINEMENTS; ++pass)
+			{
+				bool bImproved = false;
+				for(int endIx = 0; endIx < 2; ++endIx)
+				{
+					for(int compIx = 0; compIx < 3; ++compIx)
+					{
+						for(int step = -1; step <= 1; step += 2)
+						{
+							int value = ((best.colors[endIx] >> shifts[compIx]) & masks[compIx]) + step;
+							if(value < 0 || value > masks[compIx])
+								continue;
+
+							ColorBlockCode code = best;
+							code.colors[endIx] = (unsigned short)((best.colors[endIx] &
+								~(masks[compIx] << shifts[compIx])) | (value << shifts[compIx]));
+							FitColorCode<Ops>(block, bPunchThrough, code);
+							if(code.error < best.error)
+							{
+								best = code;
+								bImproved = true;
+							}
+						}
+					}
+				}
+
+				if(!bImproved)
+					return;
+			}
+		}
+
+		template<typename Ops>
+		void EncodeColorBlock( const TexelBlock &block, bool bAllowPunchThrough,
+			CompressionQuality eQuality, ColorBlockCode &best )
+		{
+			bool bPunchThrough = false;
+			int firstOpaque = 0;
+			if(bAllowPunchThrough)
+			{
+				for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+				{
+					if(block.comps[3][texelIx] < ALPHA_THRESHOLD)
+						bPunchThrough = true;
+					else if(block.comps[3][firstOpaque] < ALPHA_THRESHOLD)
+						firstOpaque = texelIx;
+				}
+			}
+
+			//Transparent texels take an opaque one's color, so they do not pull the endpoints.
+			const TexelBlock *pSearchBlock = &block;
+			TexelBlock opaqueBlock;
+			if(bPunchThrough)
+			{
+				opaqueBlock = block;
+				for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+				{
+					if(block.comps[3][texelIx] < ALPHA_THRESHOLD)
+					{
+						for(int compIx = 0; compIx < 3; ++compIx)
+							opaqueBlock.comps[compIx][texelIx] = block.comps[compIx][firstOpaque];
+					}
+				}
+				pSearchBlock = &opaqueBlock;
+			}
+
+			float ends[2][3];
+			if(eQuality == COMPRESS_FAST)
+				FindBoxColorEndpoints<Ops>(*pSearchBlock, ends);
+			else
+				FindAxisColorEndpoints<Ops>(*pSearchBlock, ends);
+
+			best.error = FLT_MAX;
+			TryColorEndpoints<Ops>(block, bPunchThrough, ends, best);
+
+			if(eQuality == COMPRESS_NORMAL)
+				RefineColorCode<Ops>(block, bPunchThrough, 1, best);
+			else if(eQuality == COMPRESS_BEST)
+			{
+				RefineColorCode<Ops>(block, bPunchThrough, MAX_REFINEMENTS, best);
+				SearchColorNeighbors<Ops>(block, bPunchThrough, best);
+			}
+		}
+
+		void WriteColorBlock( const ColorBlockCode &code, unsigned char *pBlock )
+		{
+			unsigned int indexBits = 0;
+			for(int texelIx = BLOCK_TEXELS - 1; texelIx >= 0; --texelIx)
+				indexBits = (indexBits << 2) | code.indices[texelIx];
+
+			pBlock[0] = (unsigned char)(code.colors[0] & 0xFF);
+			pBlock[1] = (unsigned char)(code.colors[0] >> 8);
+			pBlock[2] = (unsigned char)(code.colors[1] & 0xFF);
+			pBlock[3] = (unsigned char)(code.colors[1] >> 8);
+			for(int byteIx = 0; byteIx < 4; ++byteIx)
+				pBlock[4 + byteIx] = (unsigned char)(indexBits >> (byteIx * 8));
+		}
+
+		////////////////////////////////////////////////////////
+		//Single-component blocks, for BC4, BC5 and the alpha half of BC3.
+
+		struct ValueBlockCode
+		{
+			unsigned char ends[2];
+			unsigned char indices[BLOCK_TEXELS];
+			float palette[8];
+			float error;
+		};
+
+		//Weights of endpoint 0 in each palette entry, for SolveEndpoints.
+		const float g_eightValueWeights[8] = {1.0f, 0.0f, 6.0f / 7.0f, 5.0f / 7.0f,
+			4.0f / 7.0f, 3.0f / 7.0f, 2.0f / 7.0f, 1.0f / 7.0f};
+		const float g_sixValueWeights[8] = {1.0f, 0.0f, 4.0f / 5.0f, 3.0f / 5.0f,
+			2.0f / 5.0f, 1.0f / 5.0f, -1.0f, -1.0f};
+
+		//The endpoints' order selects the mode: descending interpolates eight values, otherwise
+		//six, plus 0 and 255.
+		template<typename Ops>
+		void FitValueCode( const float *pValues, ValueBlockCode &code )
+		{
+			float end0 = code.ends[0];
+			float end1 = code.ends[1];
+			code.palette[0] = end0;
+			code.palette[1] = end1;
+			if(code.ends[0] > code.ends[1])
+			{
+				for(int entryIx = 2; entryIx < 8; ++entryIx)
+					code.palette[entryIx] = ((8 - entryIx) * end0 + (entryIx - 1) * end1) / 7.0f;
+			}
+			else
+			{
+				for(int entryIx = 2; entryIx < 6; ++entryIx)
+					code.palette[entryIx] = ((6 - entryIx) * end0 + (entryIx - 1) * end1) / 5.0f;
+				code.palette[6] = 0.0f;
+				code.palette[7] = 255.0f;
+			}
+
+			code.error = FitPalette<Ops>(&pValues, 1, code.palette, 8, NULL, code.indices);
+		}
+
+		template<typename Ops>
+		void TryValueEndpoints( const float *pValues, int end0, int end1, ValueBlockCode &best )
+		{
+			ValueBlockCode code;
+			code.ends[0] = (unsigned char)std::min(std::max(end0, 0), 255);
+			code.ends[1] = (unsigned char)std::min(std::max(end1, 0), 255);
+			FitValueCode<Ops>(pValues, code);
+			if(code.error < best.error)
+				best = code;
+		}
+
+		template<typename Ops>
+		void RefineValueCode( const float *pValues, int maxRefinements, ValueBlockCode &best )
+		{
+			for(int refinement = 0; refinement < maxRefinements; ++refinement)
+			{
+				bool bEightValues = best.ends[0] > best.ends[1];
+				float ends[2][3];
+				if(!SolveEndpoints<Ops>(&pValues, 1, best.indices,
+					bEightValues ? g_eightValueWeights : g_sixValueWeights, ends))
+					return;
+
+				//Keep the mode; the solution may have swapped the endpoints' order.
+				int end0 = (int)(ends[0][0] + 0.5f);
+				int end1 = (int)(ends[1][0] + 0.5f);
+				if(bEightValues ? end0 <= end1 : end0 > end1)
+				{
+					if(end0 == end1)
+						return;
+					std::swap(end0, end1);
+				}
+
+				float previousError = best.error;
+				TryValueEndpoints<Ops>(pValues, end0, end1, best);
+				if(!(best.error < previousError))
+					return;
+			}
+		}
+
+		template<typename Ops>
+		void SearchValueNeighbors( const float *pValues, ValueBlockCode &best )
+		{
+			for(int pass = 0; pass < MAX_REFINEMENTS; ++pass)
+			{
+				ValueBlockCode start = best;
+				for(int endIx = 0; endIx < 2; ++endIx)
+				{
+					for(int step = -1; step <= 1; step += 2)
+					{
+						int ends[2] = {start.ends[0], start.ends[1]};
+						ends[endIx] += step;
+						TryValueEndpoints<Ops>(pValues, ends[0], ends[1], best);
+					}
+				}
+
+				if(!(best.error < start.error))
+					return;
+			}
+		}
+
+		template<typename Ops>
+		void EncodeValueBlock( const float *pValues, CompressionQuality eQuality, ValueBlockCode &best )
+		{
+			float lowest, highest;
+			FindBounds<Ops>(&pValues, 1, &lowest, &highest);
+
+			best.error = FLT_MAX;
+			TryValueEndpoints<Ops>(pValues, (int)highest, (int)lowest, best);
+			if(eQuality == COMPRESS_FAST || best.error == 0.0f)
+				return;
+
+			//The six-value mode spends its range on the values between 0 and 255, which it has
+			//exactly.
+			float innerLowest = 255.0f;
+			float innerHighest = 0.0f;
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+			{
+				if(pValues[texelIx] > 0.0f && pValues[texelIx] < 255.0f)
+				{
+					innerLowest = std::min(innerLowest, pValues[texelIx]);
+					innerHighest = std::max(innerHighest, pValues[texelIx]);
+				}
+			}
+
+			ValueBlockCode sixValues;
+			sixValues.error = FLT_MAX;
+			if(innerLowest <= innerHighest)
+				TryValueEndpoints<Ops>(pValues, (int)innerLowest, (int)innerHighest, sixValues);
+			else
+				TryValueEndpoints<Ops>(pValues, 0, 0, sixValues);
+
+			int maxRefinements = eQuality == COMPRESS_BEST ? MAX_REFINEMENTS : 1;
+			RefineValueCode<Ops>(pValues, maxRefinements, best);
+			RefineValueCode<Ops>(pValues, maxRefinements, sixValues);
+			if(eQuality == COMPRESS_BEST)
+			{
+				SearchValueNeighbors<Ops>(pValues, best);
+				SearchValueNeighbors<Ops>(pValues, sixValues);
+			}
+
+			if(sixValues.error < best.error)
+				best = sixValues;
+		}
+
+		void WriteValueBlock( const ValueBlockCode &code, unsigned char *pBlock )
+		{
+			unsigned long long indexBits = 0;
+			for(int texelIx = BLOCK_TEXELS - 1; texelIx >= 0; --texelIx)
+				indexBits = (indexBits << 3) | code.indices[texelIx];
+
+			pBlock[0] = code.ends[0];
+			pBlock[1] = code.ends[1];
+			for(int byteIx = 0; byteIx < 6; ++byteIx)
+				pBlock[2 + byteIx] = (unsigned char)(indexBits >> (byteIx * 8));
+		}
+
+		////////////////////////////////////////////////////////
+		//Error, measured over the texels inside the image.
+
+		struct ErrorSum
+		{
+			double squaredError;
+			double compCount;
+
+			ErrorSum() : squaredError(0.0), compCount(0.0) {}
+		};
+
+		void MeasureColorBlock( const TexelBlock &block, const ColorBlockCode &code, bool bAlpha,
+			ErrorSum &sum )
+		{
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+			{
+				if(!block.inside[texelIx])
+					continue;
+
+				int index = code.indices[texelIx];
+				bool bTransparent = bAlpha && code.colors[0] <= code.colors[1] && index == 3;
+				if(!bTransparent)
+				{
+					for(int compIx = 0; compIx < 3; ++compIx)
+					{
+						double diff = code.palette[index][compIx] - block.comps[compIx][texelIx];
+						sum.squaredError += diff * diff;
+					}
+					sum.compCount += 3.0;
+				}
+
+				if(bAlpha)
+				{
+					double diff = (bTransparent ? 0.0 : 255.0) - block.comps[3][texelIx];
+					sum.squaredError += diff * diff;
+					sum.compCount += 1.0;
+				}
+			}
+		}
+
+		void MeasureValueBlock( const TexelBlock &block, int compIx, const ValueBlockCode &code,
+			ErrorSum &sum )
+		{
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+			{
+				if(!block.inside[texelIx])
+					continue;
+
+				double diff = code.palette[code.indices[texelIx]] - block.comps[compIx][texelIx];
+				sum.squaredError += diff * diff;
+				sum.compCount += 1.0;
+			}
+		}
+
+		template<typename Ops>
+		void EncodeBlock( const TexelBlock &block, PixelDataType eTargetType, bool bSourceAlpha,
+			CompressionQuality eQuality, unsigned char *pBlock, ErrorSum &sum )
+		{
+			ColorBlockCode color;
+			ValueBlockCode values[2];
+			switch(eTargetType)
+			{
+			case DT_COMPRESSED_BC1:
+				EncodeColorBlock<Ops>(block, bSourceAlpha, eQuality, color);
+				WriteColorBlock(color, pBlock);
+				MeasureColorBlock(block, color, bSourceAlpha, sum);
+				break;
+			case DT_COMPRESSED_BC3:
+				EncodeValueBlock<Ops>(block.comps[3], eQuality, values[0]);
+				EncodeColorBlock<Ops>(block, false, eQuality, color);
+				WriteValueBlock(values[0], pBlock);
+				WriteColorBlock(color, pBlock + 8);
+				MeasureValueBlock(block, 3, values[0], sum);
+				MeasureColorBlock(block, color, false, sum);
+				break;
+			case DT_COMPRESSED_UNSIGNED_BC4:
+				EncodeValueBlock<Ops>(block.comps[0], eQuality, values[0]);
+				WriteValueBlock(values[0], pBlock);
+				MeasureValueBlock(block, 0, values[0], sum);
+				break;
+			case DT_COMPRESSED_UNSIGNED_BC5:
+				EncodeValueBlock<Ops>(block.comps[0], eQuality, values[0]);
+				EncodeValueBlock<Ops>(block.comps[1], eQuality, values[1]);
+				WriteValueBlock(values[0], pBlock);
+				WriteValueBlock(values[1], pBlock + 8);
+				MeasureValueBlock(block, 0, values[0], sum);
+				MeasureValueBlock(block, 1, values[1], sum);
+				break;
+			default:
+				break;
+			}
+		}
+
+		//One source image and where its blocks go.
+		struct ImageJob
+		{
+			const unsigned char *pSource;
+			size_t lineSize;
+			int width;
+			int height;
+			int blocksWide;
+			unsigned char *pDest;
+			size_t firstBlock;		//Of all the images' blocks, the index of this one's first.
+		};
+
+		bool CompareFirstBlock( size_t blockIx, const ImageJob &job )
+		{
+			return blockIx < job.firstBlock;
+		}
+	}
+
+	ImageSet *CompressImageSet( const ImageSet *pSource, PixelDataType eTargetType,
+		CompressionQuality eQuality, CompressionStats *pStats )
+	{
+		ImageFormat sourceFmt = pSource->GetFormat();
+		Dimensions dims = pSource->GetDimensions();
+		SourceLayout layout = GetSourceLayout(sourceFmt, dims);
+		ImageFormat targetFmt = GetTargetFormat(sourceFmt, eTargetType);
+		bool bSourceAlpha = layout.compOffsets[3] >= 0;
+
+		int mipmapCount = pSource->GetMipmapCount();
+		int arrayCount = pSource->GetArrayCount();
+		int faceCount = pSource->GetFaceCount();
+		size_t blockByteCount = GetBlockCompressionData(eTargetType).byteCount;
+
+		std::vector<ImageBuffer> imageData(mipmapCount);
+		std::vector<size_t> imageSizes(mipmapCount);
+		std::vector<ImageJob> jobs;
+		size_t blockCount = 0;
+		size_t sourceByteCount = 0;
+		for(int mipmapLevel = 0; mipmapLevel < mipmapCount; ++mipmapLevel)
+		{
+			Dimensions mipmapDims = ModifySizeForMipmap(dims, mipmapLevel);
+			imageSizes[mipmapLevel] = CalcImageByteSize(targetFmt, mipmapDims);
+			imageData[mipmapLevel].resize(imageSizes[mipmapLevel] * arrayCount * faceCount);
+
+			for(int arrayIx = 0; arrayIx < arrayCount; ++arrayIx)
+			{
+				for(int faceIx = 0; faceIx < faceCount; ++faceIx)
+				{
+					SingleImage image = pSource->GetImage(mipmapLevel, arrayIx, faceIx);
+
+					ImageJob job;
+					job.pSource = (const unsigned char *)image.GetImageData();
+					job.lineSize = sourceFmt.AlignByteCount(CalcBytesPerPixel(sourceFmt) * mipmapDims.width);
+					job.width = mipmapDims.width;
+					job.height = mipmapDims.height;
+					job.blocksWide = (mipmapDims.width + 3) / 4;
+					job.pDest = &imageData[mipmapLevel][0] +
+						((arrayIx * faceCount) + faceIx) * imageSizes[mipmapLevel];
+					job.firstBlock = blockCount;
+					jobs.push_back(job);
+
+					blockCount += job.blocksWide * ((mipmapDims.height + 3) / 4);
+					sourceByteCount += image.GetImageByteSize();
+				}
+			}
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		std::mutex sumMutex;
+		ErrorSum totalSum;
+		detail::ParallelFor(GetExecutor(), blockCount, MIN_BLOCKS_PER_TASK,
+			[&](size_t beginBlock, size_t endBlock)
+		{
+			ErrorSum sum;
+			TexelBlock block;
+			std::vector<ImageJob>::const_iterator jobIt =
+				std::upper_bound(jobs.begin(), jobs.end(), beginBlock, CompareFirstBlock) - 1;
+			for(size_t blockIx = beginBlock; blockIx < endBlock; ++blockIx)
+			{
+				while((jobIt + 1) != jobs.end() && (jobIt + 1)->firstBlock <= blockIx)
+					++jobIt;
+
+				size_t imageBlockIx = blockIx - jobIt->firstBlock;
+				int blockX = (int)(imageBlockIx % jobIt->blocksWide);
+				int blockY = (int)(imageBlockIx / jobIt->blocksWide);
+				GatherBlock(jobIt->pSource, jobIt->lineSize, layout, jobIt->width, jobIt->height,
+					blockX, blockY, block);
+				EncodeBlock<detail::SimdOps>(block, eTargetType, bSourceAlpha, eQuality,
+					jobIt->pDest + imageBlockIx * blockByteCount, sum);
+			}
+
+			std::lock_guard<std::mutex> lock(sumMutex);
+			totalSum.squaredError += sum.squaredError;
+			totalSum.compCount += sum.compCount;
+		});
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if(pStats)
+		{
+			pStats->rmse = totalSum.compCount > 0.0 ?
+				sqrt(totalSum.squaredError / totalSum.compCount) : 0.0;
+			pStats->seconds = seconds;
+			pStats->megabytesPerSecond = seconds > 0.0 ? (sourceByteCount / 1.0e6) / seconds : 0.0;
+		}
+
+		detail::ImageSetImpl *pImageData = new detail::ImageSetImpl(targetFmt, dims,
+			mipmapCount, arrayCount, faceCount, pSource->IsTopLeft(), imageData, imageSizes);
+		return detail::MakeImageSet(pImageData);
+	}
+}
@@ -0,0 +1,913 @@
+//Copyright (C) 2011 by Jason L. McKesson
+//This file is licensed by the MIT License.
+
+
+
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "glimg/BlockDecompressor.h"
+#include "glimg/Executor.h"
+#include "ImageSetImpl.h"
+#include "Util.h"
+#include "SimdOps.h"
+#include "ParallelFor.h"
+
+#define ARRAY_COUNT( array ) (sizeof( array ) / (sizeof( array[0] ) * (sizeof( array ) != sizeof(void*) || sizeof( array[0] ) <= sizeof(void*))))
+
+#if defined(GLIMG_SIMD_AVX) || defined(GLIMG_SIMD_SSE2)
+#define GLIMG_DECODE_SSE2
+#endif
+
+namespace glimg
+{
+	namespace
+	{
+		const int BLOCK_TEXELS = 16;
+
+		//Fewer blocks per task would spend more time handing out tasks than decoding them.
+		const size_t MIN_BLOCKS_PER_TASK = 256;
+
+		//Decoded blocks are at most 16 texels of 8 bytes.
+		const int MAX_DECODED_BLOCK_SIZE = BLOCK_TEXELS * 8;
+
+		////////////////////////////////////////////////////////
+		//BC1 through BC5.
+
+		//An RGBA8 color, red in the lowest byte.
+		unsigned int UnpackColor565( unsigned short packed )
+		{
+			unsigned int red = (packed >> 11) & 0x1F;
+			unsigned int green = (packed >> 5) & 0x3F;
+			unsigned int blue = packed & 0x1F;
+			red = (red << 3) | (red >> 2);
+			green = (green << 2) | (green >> 4);
+			blue = (blue << 3) | (blue >> 2);
+			return red | (green << 8) | (blue << 16) | 0xFF000000;
+		}
+
+		unsigned int MixColors( unsigned int color0, int weight0, unsigned int color1, int weight1 )
+		{
+			int total = weight0 + weight1;
+			unsigned int mixed = 0xFF000000;
+			for(int shift = 0; shift < 24; shift += 8)
+			{
+				unsigned int value = (((color0 >> shift) & 0xFF) * weight0 +
+					((color1 >> shift) & 0xFF) * weight1 + total / 2) / total;
+				mixed |= value << shift;
+			}
+			return mixed;
+		}
+
+		//Decodes the 8 byte color half of a block into 16 RGBA8 texels. BC2 and BC3 always use
+		//four colors; BC1 uses three and transparent black if the first color is not greater.
+		void DecodeColorBlock( const unsigned char *pBlock, bool bFourColors, bool bTransparentBlack,
+			unsigned char *pTexels )
+		{
+			unsigned short packed0 = (unsigned short)(pBlock[0] | (pBlock[1] << 8));
+			unsigned short packed1 = (unsigned short)(pBlock[2] | (pBlock[3] << 8));
+			unsigned int indexBits = pBlock[4] | (pBlock[5] << 8) | (pBlock[6] << 16) |
+				((unsigned int)pBlock[7] << 24);
+
+			unsigned int palette[4];
+			palette[0] = UnpackColor565(packed0);
+			palette[1] = UnpackColor565(packed1);
+			if(bFourColors || packed0 > packed1)
+			{
+				palette[2] = MixColors(palette[0], 2, palette[1], 1);
+				palette[3] = MixColors(palette[0], 1, palette[1], 2);
+			}
+			else
+			{
+				palette[2] = MixColors(palette[0], 1, palette[1], 1);
+				palette[3] = bTransparentBlack ? 0 : 0xFF000000;
+			}
+
+#ifdef GLIMG_DECODE_SSE2
+			//Each lane holds one texel of the row, and picks its two bits with a mask instead of
+			//a shift, since SSE2 has no per-lane shifts.
+			const __m128i laneMasks = _mm_setr_epi32(0x03, 0x0C, 0x30, 0xC0);
+			for(int rowIx = 0; rowIx < 4; ++rowIx)
+			{
+				__m128i indices = _mm_and_si128(_mm_set1_epi32((indexBits >> (rowIx * 8)) & 0xFF), laneMasks);
+				__m128i texels = _mm_setzero_si128();
+				for(int entryIx = 0; entryIx < 4; ++entryIx)
+				{
+					__m128i match = _mm_cmpeq_epi32(indices,
+						_mm_setr_epi32(entryIx, entryIx << 2, entryIx << 4, entryIx << 6));
+					texels = _mm_or_si128(texels, _mm_and_si128(match, _mm_set1_epi32((int)palette[entryIx])));
+				}
+				_mm_storeu_si128((__m128i *)(pTexels + rowIx * 16), texels);
+			}
+#else
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+			{
+				unsigned int color = palette[(indexBits >> (texelIx * 2)) & 0x3];
+				for(int byteIx = 0; byteIx < 4; ++byteIx)
+					pTexels[texelIx * 4 + byteIx] = (unsigned char)(color >> (byteIx * 8));
+			}
+#endif
+		}
+
+		//Decodes a BC4 block, or half of BC3 or BC5, into 16 bytes. Signed blocks give signed bytes.
+		void DecodeValueBlock( const unsigned char *pBlock, bool bSigned, unsigned char *pValues )
+		{
+			int end0 = bSigned ? std::max((int)(signed char)pBlock[0], -127) : pBlock[0];
+			int end1 = bSigned ? std::max((int)(signed char)pBlock[1], -127) : pBlock[1];
+
+			//Rounds half away from zero, for either sign.
+			int palette[8];
+			palette[0] = end0;
+			palette[1] = end1;
+			if(end0 > end1)
+			{
+				for(int entryIx = 2; entryIx < 8; ++entryIx)
+				{
+					int sum = (8 - entryIx) * end0 + (entryIx - 1) * end1;
+					palette[entryIx] = (sum + (sum < 0 ? -3 : 3)) / 7;
+				}
+			}
+			else
+			{
+				for(int entryIx = 2; entryIx < 6; ++entryIx)
+				{
+					int sum = (6 - entryIx) * end0 + (entryIx - 1) * end1;
+					palette[entryIx] = (sum + (sum < 0 ? -2 : 2)) / 5;
+				}
+				palette[6] = bSigned ? -127 : 0;
+				palette[7] = bSigned ? 127 : 255;
+			}
+
+			unsigned long long indexBits = 0;
+			for(int byteIx = 0; byteIx < 6; ++byteIx)
+				indexBits |= (unsigned long long)pBlock[2 + byteIx] << (byteIx * 8);
+
+			unsigned char indices[BLOCK_TEXELS];
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+				indices[texelIx] = (unsigned char)((indexBits >> (texelIx * 3)) & 0x7);
+
+#ifdef GLIMG_DECODE_SSE2
+			__m128i indexBytes = _mm_loadu_si128((const __m128i *)indices);
+			__m128i values = _mm_setzero_si128();
+			for(int entryIx = 0; entryIx < 8; ++entryIx)
+			{
+				__m128i match = _mm_cmpeq_epi8(indexBytes, _mm_set1_epi8((char)entryIx));
+				values = _mm_or_si128(values, _mm_and_si128(match, _mm_set1_epi8((char)palette[entryIx])));
+			}
+			_mm_storeu_si128((__m128i *)pValues, values);
+#else
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+				pValues[texelIx] = (unsigned char)palette[indices[texelIx]];
+#endif
+		}
+
+		void SetAlpha( const unsigned char *pAlphas, unsigned char *pTexels )
+		{
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+				pTexels[texelIx * 4 + 3] = pAlphas[texelIx];
+		}
+
+		void DecodeBlockBC1( const unsigned char *pBlock, bool bAlpha, unsigned char *pTexels )
+		{
+			DecodeColorBlock(pBlock, false, bAlpha, pTexels);
+		}
+
+		void DecodeBlockBC2( const unsigned char *pBlock, unsigned char *pTexels )
+		{
+			unsigned char alphas[BLOCK_TEXELS];
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+				alphas[texelIx] = (unsigned char)(((pBlock[texelIx / 2] >> ((texelIx % 2) * 4)) & 0xF) * 17);
+
+			DecodeColorBlock(pBlock + 8, true, false, pTexels);
+			SetAlpha(alphas, pTexels);
+		}
+
+		void DecodeBlockBC3( const unsigned char *pBlock, unsigned char *pTexels )
+		{
+			unsigned char alphas[BLOCK_TEXELS];
+			DecodeValueBlock(pBlock, false, alphas);
+			DecodeColorBlock(pBlock + 8, true, false, pTexels);
+			SetAlpha(alphas, pTexels);
+		}
+
+		void DecodeBlockBC5( const unsigned char *pBlock, bool bSigned, unsigned char *pTexels )
+		{
+			unsigned char reds[BLOCK_TEXELS];
+			unsigned char greens[BLOCK_TEXELS];
+			DecodeValueBlock(pBlock, bSigned, reds);
+			DecodeValueBlock(pBlock + 8, bSigned, greens);
+
+#ifdef GLIMG_DECODE_SSE2
+			__m128i redBytes = _mm_loadu_si128((const __m128i *)reds);
+			__m128i greenBytes = _mm_loadu_si128((const __m128i *)greens);
+			_mm_storeu_si128((__m128i *)pTexels, _mm_unpacklo_epi8(redBytes, greenBytes));
+			_mm_storeu_si128((__m128i *)(pTexels + 16), _mm_unpackhi_epi8(redBytes, greenBytes));
+#else
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+			{
+				pTexels[texelIx * 2] = reds[texelIx];
+				pTexels[texelIx * 2 + 1] = greens[texelIx];
+			}
+#endif
+		}
+
+		////////////////////////////////////////////////////////
+		//BC6H and BC7. Their time goes into unpacking fields that change size and place with
+		//the mode, so they are decoded one texel at a time.
+
+		//Reads a block's fields from its lowest bit up.
+		class BlockBits
+		{
+		public:
+			explicit BlockBits(const unsigned char *pBlock)
+				: m_low(0)
+				, m_high(0)
+				, m_position(0)
+			{
+				for(int byteIx = 0; byteIx < 8; ++byteIx)
+				{
+					m_low |= (unsigned long long)pBlock[byteIx] << (byteIx * 8);
+					m_high |= (unsigned long long)pBlock[8 + byteIx] << (byteIx * 8);
+				}
+			}
+
+			int Read(int bitCount)
+			{
+				if(bitCount == 0)
+					return 0;
+
+				unsigned long long bits;
+				if(m_position >= 64)
+					bits = m_high >> (m_position - 64);
+				else if(m_position == 0)
+					bits = m_low;
+				else
+					bits = (m_low >> m_position) | (m_high << (64 - m_position));
+
+				m_position += bitCount;
+				return (int)(bits & ((1ULL << bitCount) - 1));
+			}
+
+		private:
+			unsigned long long m_low;
+			unsigned long long m_high;
+			int m_position;
+		};
+
+		//Which subset each texel is in, for two-subset partitions; bit N is texel N.
+		const unsigned short g_partitions2[64] =
+		{
+			0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+			0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+			0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+			0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+			0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+			0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+			0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+			0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+		};
+
+		//Which subset each texel is in, for three-subset partitions.
+		const unsigned char g_partitions3[64][BLOCK_TEXELS] =
+		{
+			{0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2}, {0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1},
+			{0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1}, {0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1},
+			{0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2}, {0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2},
+			{0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1}, {0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1},
+			{0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2}, {0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2},
+			{0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2}, {0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2},
+			{0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2}, {0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2},
+			{0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2}, {0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0},
+			{0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2}, {0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0},
+			{0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2}, {0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1},
+			{0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2}, {0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1},
+			{0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2}, {0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0},
+			{0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0}, {0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2},
+			{0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0}, {0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1},
+			{0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2}, {0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2},
+			{0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1}, {0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1},
+			{0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2}, {0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1},
+			{0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2}, {0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0},
+			{0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0}, {0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0},
+			{0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0}, {0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1},
+			{0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1}, {0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2},
+			{0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1}, {0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2},
+			{0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1}, {0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1},
+			{0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1}, {0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1},
+			{0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2}, {0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1},
+			{0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2}, {0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2},
+			{0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2}, {0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2},
+			{0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2}, {0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2},
+			{0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2}, {0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2},
+			{0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2}, {0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2},
+			{0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1}, {0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2},
+			{0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2}, {0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0},
+		};
+
+		//The texel of each partition's second subset that has one index bit fewer.
+		const unsigned char g_anchors2[64] =
+		{
+			15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15,
+			15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+			15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,
+			 6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+		};
+
+		//The same for the second and third subsets of three-subset partitions.
+		const unsigned char g_anchors3Second[64] =
+		{
+			 3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,
+			 3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+			 8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,
+			 3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+		};
+
+		const unsigned char g_anchors3Third[64] =
+		{
+			15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8,
+			15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+			15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8,
+			15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+		};
+
+		//Interpolation weights out of 64, by index size.
+		const int g_weights2[4] = {0, 21, 43, 64};
+		const int g_weights3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+		const int g_weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+		const int *GetWeights( int indexBits )
+		{
+			switch(indexBits)
+			{
+			case 2: return g_weights2;
+			case 3: return g_weights3;
+			default: return g_weights4;
+			}
+		}
+
+		int Interpolate( int end0, int end1, int weight )
+		{
+			return (end0 * (64 - weight) + end1 * weight + 32) >> 6;
+		}
+
+		//Sets subsets to each texel's subset, and returns which texel of each subset is its anchor.
+		void GetPartition( int subsetCount, int partition, unsigned char *subsets, int anchors[3] )
+		{
+			anchors[0] = 0;
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+			{
+				if(subsetCount == 1)
+					subsets[texelIx] = 0;
+				else if(subsetCount == 2)
+					subsets[texelIx] = (unsigned char)((g_partitions2[partition] >> texelIx) & 0x1);
+				else
+					subsets[texelIx] = g_partitions3[partition][texelIx];
+			}
+
+			if(subsetCount == 2)
+				anchors[1] = g_anchors2[partition];
+			else if(subsetCount == 3)
+			{
+				anchors[1] = g_anchors3Second[partition];
+				anchors[2] = g_anchors3Third[partition];
+			}
+		}
+
+		//Reads one index per texel; anchors have one bit fewer, as their top bit is always 0.
+		void ReadIndices( BlockBits &bits, int indexBits, const unsigned char *subsets,
+			const int anchors[3], unsigned char *indices )
+		{
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+			{
+				bool bAnchor = anchors[subsets[texelIx]] == texelIx;
+				indices[texelIx] = (unsigned char)bits.Read(bAnchor ? indexBits - 1 : indexBits);
+			}
+		}
+
+		struct Bc7Mode
+		{
+			int subsetCount;
+			int partitionBits;
+			int rotationBits;
+			int indexSelectionBits;
+			int colorBits;
+			int alphaBits;
+			int endpointPBits;		//One P-bit per endpoint.
+			int sharedPBits;		//One P-bit per subset.
+			int indexBits;
+			int secondaryIndexBits;
+		};
+
+		const Bc7Mode g_bc7Modes[8] =
+		{
+			{3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+			{2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+			{3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+			{2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+			{1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+			{1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+			{1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+			{2, 6, 0, 0, 5, 5, 1, 0, 2, 0},
+		};
+
+		void DecodeBlockBC7( const unsigned char *pBlock, unsigned char *pTexels )
+		{
+			int modeIx = 0;
+			while(modeIx < 8 && !(pBlock[0] & (1 << modeIx)))
+				++modeIx;
+
+			//Reserved; decodes to transparent black.
+			if(modeIx == 8)
+			{
+				memset(pTexels, 0, BLOCK_TEXELS * 4);
+				return;
+			}
+
+			const Bc7Mode &mode = g_bc7Modes[modeIx];
+			BlockBits bits(pBlock);
+			bits.Read(modeIx + 1);
+			int partition = bits.Read(mode.partitionBits);
+			int rotation = bits.Read(mode.rotationBits);
+			int indexSelection = bits.Read(mode.indexSelectionBits);
+
+			//Indexed by subset, endpoint, component.
+			int endpoints[3][2][4];
+			int compCount = mode.alphaBits ? 4 : 3;
+			for(int compIx = 0; compIx < compCount; ++compIx)
+			{
+				for(int subsetIx = 0; subsetIx < mode.subsetCount; ++subsetIx)
+				{
+					for(int endIx = 0; endIx < 2; ++endIx)
+						endpoints[subsetIx][endIx][compIx] = bits.Read(compIx < 3 ? mode.colorBits : mode.alphaBits);
+				}
+			}
+
+			int colorPrecision = mode.colorBits;
+			int alphaPrecision = mode.alphaBits;
+			if(mode.endpointPBits || mode.sharedPBits)
+			{
+				int pBits[3][2];
+				for(int subsetIx = 0; subsetIx < mode.subsetCount; ++subsetIx)
+				{
+					pBits[subsetIx][0] = bits.Read(1);
+					pBits[subsetIx][1] = mode.endpointPBits ? bits.Read(1) : pBits[subsetIx][0];
+				}
+
+				for(int subsetIx = 0; subsetIx < mode.subsetCount; ++subsetIx)
+				{
+					for(int endIx = 0; endIx < 2; ++endIx)
+					{
+						for(int compIx = 0; compIx < compCount; ++compIx)
+						{
+							endpoints[subsetIx][endIx][compIx] =
+								(endpoints[subsetIx][endIx][compIx] << 1) | pBits[subsetIx][endIx];
+						}
+					}
+				}
+
+				++colorPrecision;
+				if(mode.alphaBits)
+					++alphaPrecision;
+			}
+
+			//Widen to 8 bits by repeating the top bits.
+			for(int subsetIx = 0; subsetIx < mode.subsetCount; ++subsetIx)
+			{
+				for(int endIx = 0; endIx < 2; ++endIx)
+				{
+					for(int compIx = 0; compIx < 4; ++compIx)
+					{
+						int &value = endpoints[subsetIx][endIx][compIx];
+						if(compIx == 3 && !mode.alphaBits)
+							value = 255;
+						else
+						{
+							int precision = compIx < 3 ? colorPrecision : alphaPrecision;
+							value = (value << (8 - precision)) | (value >> (2 * precision - 8));
+						}
+					}
+				}
+			}
+
+			unsigned char subsets[BLOCK_TEXELS];
+			int anchors[3];
+			GetPartition(mode.subsetCount, partition, subsets, anchors);
+
+			unsigned char indices[BLOCK_TEXELS];
+			unsigned char secondaryIndices[BLOCK_TEXELS];
+			ReadIndices(bits, mode.indexBits, subsets, anchors, indices);
+			if(mode.secondaryIndexBits)
+			{
+				const int firstAnchor[3] = {0, 0, 0};
+				ReadIndices(bits, mode.secondaryIndexBits, subsets, firstAnchor, secondaryIndices);
+			}
+
+			//Normally color takes the first indices and alpha the second; the selection bit swaps them.
+			const unsigned char *colorIndices = indices;
+			const unsigned char *alphaIndices = indices;
+			int colorIndexBits = mode.indexBits;
+			int alphaIndexBits = mode.indexBits;
+			if(mode.secondaryIndexBits)
+			{
+				alphaIndices = secondaryIndices;
+				alphaIndexBits = mode.secondaryIndexBits;
+				if(indexSelection)
+				{
+					std::swap(colorIndices, alphaIndices);
+					std::swap(colorIndexBits, alphaIndexBits);
+				}
+			}
+
+			const int *colorWeights = GetWeights(colorIndexBits);
+			const int *alphaWeights = GetWeights(alphaIndexBits);
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+			{
+				const int (&ends)[2][4] = endpoints[subsets[texelIx]];
+				unsigned char *pTexel = pTexels + texelIx * 4;
+				for(int compIx = 0; compIx < 3; ++compIx)
+				{
+					pTexel[compIx] = (unsigned char)Interpolate(ends[0][compIx], ends[1][compIx],
+						colorWeights[colorIndices[texelIx]]);
+				}
+				pTexel[3] = (unsigned char)Interpolate(ends[0][3], ends[1][3],
+					alphaWeights[alphaIndices[texelIx]]);
+
+				if(rotation)
+					std::swap(pTexel[3], pTexel[rotation - 1]);
+			}
+		}
+
+		//BC6H endpoint components. W and X are the first subset's endpoints; Y and Z the second's.
+		enum Bc6hField
+		{
+			RW, GW, BW,
+			RX, GX, BX,
+			RY, GY, BY,
+			RZ, GZ, BZ,
+		};
+
+		//Bits of a field, read from firstBit to lastBit; a few modes store them high bit first.
+		struct Bc6hBits
+		{
+			unsigned char field;
+			unsigned char firstBit;
+			unsigned char lastBit;
+		};
+
+		struct Bc6hMode
+		{
+			int modeBits;
+			int subsetCount;
+			bool bTransformed;		//The other endpoints are stored as differences from W.
+			int endpointBits;
+			int deltaBits[3];
+			Bc6hBits layout[24];
+		};
+
+		//The fourteen modes, in the order the specification numbers them.
+		const Bc6hMode g_bc6hModes[14] =
+		{
+			{2, 2, true, 10, {5, 5, 5}, {{GY,4,4},{BY,4,4},{BZ,4,4},{RW,0,9},{GW,0,9},{BW,0,9},{RX,0,4},
+				{GZ,4,4},{GY,0,3},{GX,0,4},{BZ,0,0},{GZ,0,3},{BX,0,4},{BZ,1,1},{BY,0,3},{RY,0,4},
+				{BZ,2,2},{RZ,0,4},{BZ,3,3}}},
+			{2, 2, true, 7, {6, 6, 6}, {{GY,5,5},{GZ,4,4},{GZ,5,5},{RW,0,6},{BZ,0,0},{BZ,1,1},{BY,4,4},
+				{GW,0,6},{BY,5,5},{BZ,2,2},{GY,4,4},{BW,0,6},{BZ,3,3},{BZ,5,5},{BZ,4,4},{RX,0,5},
+				{GY,0,3},{GX,0,5},{GZ,0,3},{BX,0,5},{BY,0,3},{RY,0,5},{RZ,0,5}}},
+			{5, 2, true, 11, {5, 4, 4}, {{RW,0,9},{GW,0,9},{BW,0,9},{RX,0,4},{RW,10,10},{GY,0,3},
+				{GX,0,3},{GW,10,10},{BZ,0,0},{GZ,0,3},{BX,0,3},{BW,10,10},{BZ,1,1},{BY,0,3},{RY,0,4},
+				{BZ,2,2},{RZ,0,4},{BZ,3,3}}},
+			{5, 2, true, 11, {4, 5, 4}, {{RW,0,9},{GW,0,9},{BW,0,9},{RX,0,3},{RW,10,10},{GZ,4,4},
+				{GY,0,3},{GX,0,4},{GW,10,10},{GZ,0,3},{BX,0,3},{BW,10,10},{BZ,1,1},{BY,0,3},{RY,0,3},
+				{BZ,0,0},{BZ,2,2},{RZ,0,3},{GY,4,4},{BZ,3,3}}},
+			{5, 2, true, 11, {4, 4, 5}, {{RW,0,9},{GW,0,9},{BW,0,9},{RX,0,3},{RW,10,10},{BY,4,4},
+				{GY,0,3},{GX,0,3},{GW,10,10},{BZ,0,0},{GZ,0,3},{BX,0,4},{BW,10,10},{BY,0,3},{RY,0,3},
+				{BZ,1,1},{BZ,2,2},{RZ,0,3},{BZ,4,4},{BZ,3,3}}},
+			{5, 2, true, 9, {5, 5, 5}, {{RW,0,8},{BY,4,4},{GW,0,8},{GY,4,4},{BW,0,8},{BZ,4,4},{RX,0,4},
+				{GZ,4,4},{GY,0,3},{GX,0,4},{BZ,0,0},{GZ,0,3},{BX,0,4},{BZ,1,1},{BY,0,3},{RY,0,4},
+				{BZ,2,2},{RZ,0,4},{BZ,3,3}}},
+			{5, 2, true, 8, {6, 5, 5}, {{RW,0,7},{GZ,4,4},{BY,4,4},{GW,0,7},{BZ,2,2},{GY,4,4},{BW,0,7},
+				{BZ,3,3},{BZ,4,4},{RX,0,5},{GY,0,3},{GX,0,4},{BZ,0,0},{GZ,0,3},{BX,0,4},{BZ,1,1},
+				{BY,0,3},{RY,0,5},{RZ,0,5}}},
+			{5, 2, true, 8, {5, 6, 5}, {{RW,0,7},{BZ,0,0},{BY,4,4},{GW,0,7},{GY,5,5},{GY,4,4},{BW,0,7},
+				{GZ,5,5},{BZ,4,4},{RX,0,4},{GZ,4,4},{GY,0,3},{GX,0,5},{GZ,0,3},{BX,0,4},{BZ,1,1},
+				{BY,0,3},{RY,0,4},{BZ,2,2},{RZ,0,4},{BZ,3,3}}},
+			{5, 2, true, 8, {5, 5, 6}, {{RW,0,7},{BZ,1,1},{BY,4,4},{GW,0,7},{BY,5,5},{GY,4,4},{BW,0,7},
+				{BZ,5,5},{BZ,4,4},{RX,0,4},{GZ,4,4},{GY,0,3},{GX,0,4},{BZ,0,0},{GZ,0,3},{BX,0,5},
+				{BY,0,3},{RY,0,4},{BZ,2,2},{RZ,0,4},{BZ,3,3}}},
+			{5, 2, false, 6, {6, 6, 6}, {{RW,0,5},{GZ,4,4},{BZ,0,0},{BZ,1,1},{BY,4,4},{GW,0,5},{GY,5,5},
+				{BY,5,5},{BZ,2,2},{GY,4,4},{BW,0,5},{GZ,5,5},{BZ,3,3},{BZ,5,5},{BZ,4,4},{RX,0,5},
+				{GY,0,3},{GX,0,5},{GZ,0,3},{BX,0,5},{BY,0,3},{RY,0,5},{RZ,0,5}}},
+			{5, 1, false, 10, {10, 10, 10}, {{RW,0,9},{GW,0,9},{BW,0,9},{RX,0,9},{GX,0,9},{BX,0,9}}},
+			{5, 1, true, 11, {9, 9, 9}, {{RW,0,9},{GW,0,9},{BW,0,9},{RX,0,8},{RW,10,10},{GX,0,8},
+				{GW,10,10},{BX,0,8},{BW,10,10}}},
+			{5, 1, true, 12, {8, 8, 8}, {{RW,0,9},{GW,0,9},{BW,0,9},{RX,0,7},{RW,11,10},{GX,0,7},
+				{GW,11,10},{BX,0,7},{BW,11,10}}},
+			{5, 1, true, 16, {4, 4, 4}, {{RW,0,9},{GW,0,9},{BW,0,9},{RX,0,3},{RW,15,10},{GX,0,3},
+				{GW,15,10},{BX,0,3},{BW,15,10}}},
+		};
+
+		//The five-bit mode values of the third mode on; the first two use two bits, 00 and 01.
+		const int g_bc6hModeValues[12] = {0x02, 0x06, 0x0A, 0x0E, 0x12, 0x16, 0x1A, 0x1E,
+			0x03, 0x07, 0x0B, 0x0F};
+
+		int SignExtend( int value, int bitCount )
+		{
+			int shift = 32 - bitCount;
+			return (int)((unsigned int)value << shift) >> shift;
+		}
+
+		//Widens an endpoint component to 16 bits, or 15 and a sign.
+		int Unquantize( int value, int bitCount, bool bSigned )
+		{
+			if(!bSigned)
+			{
+				if(bitCount >= 15 || value == 0)
+					return value;
+				if(value == (1 << bitCount) - 1)
+					return 0xFFFF;
+				return ((value << 16) + 0x8000) >> bitCount;
+			}
+
+			if(bitCount >= 16 || value == 0)
+				return value;
+
+			bool bNegative = value < 0;
+			int magnitude = bNegative ? -value : value;
+			if(magnitude >= (1 << (bitCount - 1)) - 1)
+				magnitude = 0x7FFF;
+			else
+				magnitude = ((magnitude << 15) + 0x4000) >> (bitCount - 1);
+			return bNegative ? -magnitude : magnitude;
+		}
+
+		//Turns an interpolated value into the bits of a half float.
+		unsigned short FinishUnquantize( int value, bool bSigned )
+		{
+			if(!bSigned)
+				return (unsigned short)((value * 31) >> 6);
+
+			if(value < 0)
+				return (unsigned short)(((-value * 31) >> 5) | 0x8000);
+			return (unsigned short)((value * 31) >> 5);
+		}
+
+		//Decodes into 16 texels of three half floats.
+		void DecodeBlockBC6H( const unsigned char *pBlock, bool bSigned, unsigned short *pTexels )
+		{
+			int modeIx = -1;
+			if((pBlock[0] & 0x3) < 2)
+				modeIx = pBlock[0] & 0x3;
+			else
+			{
+				for(int valueIx = 0; valueIx < 12; ++valueIx)
+				{
+					if((pBlock[0] & 0x1F) == g_bc6hModeValues[valueIx])
+						modeIx = valueIx + 2;
+				}
+			}
+
+			//Reserved; decodes to black.
+			if(modeIx < 0)
+			{
+				memset(pTexels, 0, BLOCK_TEXELS * 3 * sizeof(unsigned short));
+				return;
+			}
+
+			const Bc6hMode &mode = g_bc6hModes[modeIx];
+			BlockBits bits(pBlock);
+			bits.Read(mode.modeBits);
+
+			int fields[12] = {0};
+			for(size_t segmentIx = 0; segmentIx < ARRAY_COUNT(mode.layout); ++segmentIx)
+			{
+				//Unused entries are zero, which no real segment is.
+				const Bc6hBits &segment = mode.layout[segmentIx];
+				if(segment.field == RW && segment.firstBit == 0 && segment.lastBit == 0)
+					break;
+
+				int step = segment.firstBit <= segment.lastBit ? 1 : -1;
+				for(int bitIx = segment.firstBit; ; bitIx += step)
+				{
+					fields[segment.field] |= bits.Read(1) << bitIx;
+					if(bitIx == segment.lastBit)
+						break;
+				}
+			}
+
+			int partition = mode.subsetCount == 2 ? bits.Read(5) : 0;
+
+			int endpointCount = mode.subsetCount * 2;
+			for(int compIx = 0; compIx < 3; ++compIx)
+			{
+				int &base = fields[RW + compIx];
+				if(bSigned)
+					base = SignExtend(base, mode.endpointBits);
+
+				for(int endIx = 1; endIx < endpointCount; ++endIx)
+				{
+					int &value = fields[endIx * 3 + compIx];
+					if(mode.bTransformed || bSigned)
+						value = SignExtend(value, mode.deltaBits[compIx]);
+
+					if(mode.bTransformed)
+					{
+						value = (base + value) & ((1 << mode.endpointBits) - 1);
+						if(bSigned)
+							value = SignExtend(value, mode.endpointBits);
+					}
+				}
+
+				for(int endIx = 0; endIx < endpointCount; ++endIx)
+				{
+					int &value = fields[endIx * 3 + compIx];
+					value = Unquantize(value, mode.endpointBits, bSigned);
+				}
+			}
+
+			unsigned char subsets[BLOCK_TEXELS];
+			int anchors[3];
+			GetPartition(mode.subsetCount, partition, subsets, anchors);
+
+			int indexBits = mode.subsetCount == 2 ? 3 : 4;
+			unsigned char indices[BLOCK_TEXELS];
+			ReadIndices(bits, indexBits, subsets, anchors, indices);
+
+			const int *weights = GetWeights(indexBits);
+			for(int texelIx = 0; texelIx < BLOCK_TEXELS; ++texelIx)
+			{
+				const int *pEnds = &fields[subsets[texelIx] * 6];
+				for(int compIx = 0; compIx < 3; ++compIx)
+				{
+					int value = Interpolate(pEnds[compIx], pEnds[3 + compIx], weights[indices[texelIx]]);
+					pTexels[texelIx * 3 + compIx] = FinishUnquantize(value, bSigned);
+				}
+			}
+		}
+
+		////////////////////////////////////////////////////////
+
+		//The format each compressed type decodes to.
+		ImageFormat GetDecodedFormat( const ImageFormat &fmt )
+		{
+			bool bIsSRGB = fmt.Components() == FMT_COLOR_RGB_sRGB || fmt.Components() == FMT_COLOR_RGBA_sRGB;
+
+			switch(fmt.Type())
+			{
+			case DT_COMPRESSED_BC1:
+				if(fmt.Components() == FMT_COLOR_RGB || fmt.Components() == FMT_COLOR_RGB_sRGB)
+				{
+					return ImageFormat(DT_NORM_UNSIGNED_INTEGER, bIsSRGB ? FMT_COLOR_RGBX_sRGB : FMT_COLOR_RGBX,
+						ORDER_RGBA, BD_PER_COMP_8, 1);
+				}
+				//Fall through.
+			case DT_COMPRESSED_BC2:
+			case DT_COMPRESSED_BC3:
+			case DT_COMPRESSED_BC7:
+				return ImageFormat(DT_NORM_UNSIGNED_INTEGER, bIsSRGB ? FMT_COLOR_RGBA_sRGB : FMT_COLOR_RGBA,
+					ORDER_RGBA, BD_PER_COMP_8, 1);
+			case DT_COMPRESSED_UNSIGNED_BC4:
+				return ImageFormat(DT_NORM_UNSIGNED_INTEGER, FMT_COLOR_RED, ORDER_RGBA, BD_PER_COMP_8, 1);
+			case DT_COMPRESSED_SIGNED_BC4:
+				return ImageFormat(DT_NORM_SIGNED_INTEGER, FMT_COLOR_RED, ORDER_RGBA, BD_PER_COMP_8, 1);
+			case DT_COMPRESSED_UNSIGNED_BC5:
+				return ImageFormat(DT_NORM_UNSIGNED_INTEGER, FMT_COLOR_RG, ORDER_RGBA, BD_PER_COMP_8, 1);
+			case DT_COMPRESSED_SIGNED_BC5:
+				return ImageFormat(DT_NORM_SIGNED_INTEGER, FMT_COLOR_RG, ORDER_RGBA, BD_PER_COMP_8, 1);
+			case DT_COMPRESSED_UNSIGNED_BC6H:
+			case DT_COMPRESSED_SIGNED_BC6H:
+				return ImageFormat(DT_FLOAT, FMT_COLOR_RGB, ORDER_RGBA, BD_PER_COMP_16, 1);
+			default:
+				throw DecompressionSourceUnsupportedException();
+			}
+		}
+
+		//Decodes one block into a 4x4 array of texels in the decoded format.
+		void DecodeBlock( const unsigned char *pBlock, const ImageFormat &fmt, unsigned char *pTexels )
+		{
+			switch(fmt.Type())
+			{
+			case DT_COMPRESSED_BC1:
+				DecodeBlockBC1(pBlock, fmt.Components() == FMT_COLOR_RGBA ||
+					fmt.Components() == FMT_COLOR_RGBA_sRGB, pTexels);
+				break;
+			case DT_COMPRESSED_BC2:
+				DecodeBlockBC2(pBlock, pTexels);
+				break;
+			case DT_COMPRESSED_BC3:
+				DecodeBlockBC3(pBlock, pTexels);
+				break;
+			case DT_COMPRESSED_UNSIGNED_BC4:
+			case DT_COMPRESSED_SIGNED_BC4:
+				DecodeValueBlock(pBlock, fmt.Type() == DT_COMPRESSED_SIGNED_BC4, pTexels);
+				break;
+			case DT_COMPRESSED_UNSIGNED_BC5:
+			case DT_COMPRESSED_SIGNED_BC5:
+				DecodeBlockBC5(pBlock, fmt.Type() == DT_COMPRESSED_SIGNED_BC5, pTexels);
+				break;
+			case DT_COMPRESSED_UNSIGNED_BC6H:
+			case DT_COMPRESSED_SIGNED_BC6H:
+				DecodeBlockBC6H(pBlock, fmt.Type() == DT_COMPRESSED_SIGNED_BC6H, (unsigned short *)pTexels);
+				break;
+			case DT_COMPRESSED_BC7:
+				DecodeBlockBC7(pBlock, pTexels);
+				break;
+			default:
+				break;
+			}
+		}
+
+		//One source image and where its texels go.
+		struct ImageJob
+		{
+			const unsigned char *pSource;
+			unsigned char *pDest;
+			size_t lineSize;
+			int width;
+			int height;
+			int blocksWide;
+			size_t firstBlock;		//Of all the images' blocks, the index of this one's first.
+		};
+
+		bool CompareFirstBlock( size_t blockIx, const ImageJob &job )
+		{
+			return blockIx < job.firstBlock;
+		}
+	}
+
+	ImageSet *DecompressImageSet( const ImageSet *pSource )
+	{
+		ImageFormat sourceFmt = pSource->GetFormat();
+		Dimensions dims = pSource->GetDimensions();
+		if(dims.numDimensions != 2)
+			throw DecompressionSourceUnsupportedException();
+
+		ImageFormat decodedFmt = GetDecodedFormat(sourceFmt);
+		size_t texelSize = CalcBytesPerPixel(decodedFmt);
+		size_t blockByteCount = GetBlockCompressionData(sourceFmt.Type()).byteCount;
+
+		int mipmapCount = pSource->GetMipmapCount();
+		int arrayCount = pSource->GetArrayCount();
+		int faceCount = pSource->GetFaceCount();
+
+		std::vector<ImageBuffer> imageData(mipmapCount);
+		std::vector<size_t> imageSizes(mipmapCount);
+		std::vector<ImageJob> jobs;
+		size_t blockCount = 0;
+		for(int mipmapLevel = 0; mipmapLevel < mipmapCount; ++mipmapLevel)
+		{
+			Dimensions mipmapDims = ModifySizeForMipmap(dims, mipmapLevel);
+			imageSizes[mipmapLevel] = CalcImageByteSize(decodedFmt, mipmapDims);
+			imageData[mipmapLevel].resize(imageSizes[mipmapLevel] * arrayCount * faceCount);
+
+			for(int arrayIx = 0; arrayIx < arrayCount; ++arrayIx)
+			{
+				for(int faceIx = 0; faceIx < faceCount; ++faceIx)
+				{
+					ImageJob job;
+					job.pSource = (const unsigned char *)pSource->GetImage(mipmapLevel, arrayIx, faceIx).GetImageData();
+					job.pDest = &imageData[mipmapLevel][0] +
+						((arrayIx * faceCount) + faceIx) * imageSizes[mipmapLevel];
+					job.lineSize = decodedFmt.AlignByteCount(texelSize * mipmapDims.width);
+					job.width = mipmapDims.width;
+					job.height = mipmapDims.height;
+					job.blocksWide = (mipmapDims.width + 3) / 4;
+					job.firstBlock = blockCount;
+					jobs.push_back(job);
+
+					blockCount += job.blocksWide * ((mipmapDims.height + 3) / 4);
+				}
+			}
+		}
+
+		detail::ParallelFor(GetExecutor(), blockCount, MIN_BLOCKS_PER_TASK,
+			[&](size_t beginBlock, size_t endBlock)
+		{
+			unsigned char texels[MAX_DECODED_BLOCK_SIZE];
+			std::vector<ImageJob>::const_iterator jobIt =
+				std::upper_bound(jobs.begin(), jobs.end(), beginBlock, CompareFirstBlock) - 1;
+			for(size_t blockIx = beginBlock; blockIx < endBlock; ++blockIx)
+			{
+				while((jobIt + 1) != jobs.end() && (jobIt + 1)->firstBlock <= blockIx)
+					++jobIt;
+
+				size_t imageBlockIx = blockIx - jobIt->firstBlock;
+				DecodeBlock(jobIt->pSource + imageBlockIx * blockByteCount, sourceFmt, texels);
+
+				//Blocks past the image's edge only write the texels inside it.
+				int x = (int)(imageBlockIx % jobIt->blocksWide) * 4;
+				int y = (int)(imageBlockIx / jobIt->blocksWide) * 4;
+				size_t rowSize = std::min(4, jobIt->width - x) * texelSize;
+				int rowCount = std::min(4, jobIt->height - y);
+				for(int rowIx = 0; rowIx < rowCount; ++rowIx)
+				{
+					memcpy(jobIt->pDest + (y + rowIx) * jobIt->lineSize + x * texelSize,
+						texels + rowIx * 4 * texelSize, rowSize);
+				}
+			}
+		});
+
+		detail::ImageSetImpl *pImageData = new detail::ImageSetImpl(decodedFmt, dims,
+			mipmapCount, arrayCount, faceCount, pSource->IsTopLeft(), imageData, imageSizes);
+		return detail::MakeImageSet(pImageData);
+	}
+}
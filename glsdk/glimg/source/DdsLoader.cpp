@@ -4,6 +4,10 @@
 
 
 #include <vector>
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <stdio.h>
 #include <string.h>
 #include "glimg/ImageSet.h"
@@ -12,6 +16,7 @@
 #include "glimg/DdsLoader.h"
 #include "DdsLoaderInt.h"
 #include "Util.h"
+#include "FileMapping.h"
 
 #define ARRAY_COUNT( array ) (sizeof( array ) / (sizeof( array[0] ) * (sizeof( array ) != sizeof(void*) || sizeof( array[0] ) <= sizeof(void*))))
 
@@ -25,21 +30,107 @@ namespace dds
 	{
 		typedef std::vector<unsigned char> FileBuffer;
 
-		void ThrowIfHeaderInvalid(const ddsHeader &header)
+		//Larger sizes than these are not textures any OpenGL implementation can make. They also
+		//keep the byte size computations from overflowing.
+		const DWORD MAX_IMAGE_SIZE = 65536;
+		const DWORD MAX_ARRAY_SIZE = 2048;
+
+		bool HasDX10Header(const ddsHeader &header)
+		{
+			return (header.ddspf.dwFlags & DDPF_FOURCC) && (header.ddspf.dwFourCC == DDS10_FOUR_CC);
+		}
+
+		void ThrowIfHeaderInvalid(const ddsHeader &header, const std::string &filename)
 		{
-			//TODO: Implement;
+			if(header.dwSize != sizeof(ddsHeader))
+				throw DdsFileMalformedException(filename, "The header has the wrong size.");
+
+			if(header.ddspf.dwSize != sizeof(ddsPixelFormat))
+				throw DdsFileMalformedException(filename, "The pixel format has the wrong size.");
+
+			if(header.dwWidth == 0 || header.dwWidth > MAX_IMAGE_SIZE)
+				throw DdsFileMalformedException(filename, "The width is zero or too large.");
+
+			DWORD largestSize = header.dwWidth;
+			if(header.dwFlags & DDSD_HEIGHT)
+			{
+				if(header.dwHeight == 0 || header.dwHeight > MAX_IMAGE_SIZE)
+					throw DdsFileMalformedException(filename, "The height is zero or too large.");
+				largestSize = std::max(largestSize, header.dwHeight);
+			}
+
+			if((header.dwFlags & DDSD_DEPTH) && (header.dwCaps2 & DDSCAPS2_VOLUME))
+			{
+				if(header.dwDepth == 0 || header.dwDepth > MAX_IMAGE_SIZE)
+					throw DdsFileMalformedException(filename, "The depth is zero or too large.");
+				largestSize = std::max(largestSize, header.dwDepth);
+			}
+
+			if(header.dwFlags & DDSD_MIPMAPCOUNT)
+			{
+				DWORD maxMipmapCount = 1;
+				for(; largestSize > 1; largestSize /= 2)
+					++maxMipmapCount;
+
+				if(header.dwMipMapCount > maxMipmapCount)
+					throw DdsFileMalformedException(filename, "There are more mipmaps than the size allows.");
+			}
+		}
+
+		void ThrowIfDX10HeaderInvalid(const ddsHeader &header, const dds10Header &header10,
+			const std::string &filename)
+		{
+			switch(header10.resourceDimension)
+			{
+			case DDS_DIMENSION_TEXTURE1D:
+			case DDS_DIMENSION_TEXTURE2D:
+			case DDS_DIMENSION_TEXTURE3D:
+				break;
+			default:
+				throw DdsFileMalformedException(filename, "The DX10 header's resource dimension is not a texture.");
+			}
+
+			if(header10.arraySize == 0)
+				throw DdsFileMalformedException(filename, "The DX10 header's array size is zero.");
+
+			if(header10.arraySize > MAX_ARRAY_SIZE)
+				throw DdsFileUnsupportedException(filename, "The array is too large.");
+
+			if((header10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) &&
+				header10.resourceDimension != DDS_DIMENSION_TEXTURE2D)
+				throw DdsFileMalformedException(filename, "Cubemaps must be 2D.");
+
+			if(header10.resourceDimension == DDS_DIMENSION_TEXTURE3D && header10.arraySize != 1)
+				throw DdsFileMalformedException(filename, "3D textures cannot be arrays.");
+
+			//The flags may not say there is a height or depth, so it was not checked yet.
+			if(header10.resourceDimension != DDS_DIMENSION_TEXTURE1D)
+			{
+				if(header.dwHeight == 0 || header.dwHeight > MAX_IMAGE_SIZE)
+					throw DdsFileMalformedException(filename, "The height is zero or too large.");
+			}
+
+			if(header10.resourceDimension == DDS_DIMENSION_TEXTURE3D)
+			{
+				if(header.dwDepth == 0 || header.dwDepth > MAX_IMAGE_SIZE)
+					throw DdsFileMalformedException(filename, "The depth is zero or too large.");
+			}
 		}
 
 		//Will either generate this or return the actual one.
-		dds10Header GetDDS10Header(const ddsHeader &header, const FileBuffer &ddsData)
+		dds10Header GetDDS10Header(const ddsHeader &header, const unsigned char *ddsData, size_t ddsSize,
+			const std::string &filename)
 		{
-			if(header.ddspf.dwFourCC == DDS10_FOUR_CC)
+			if(HasDX10Header(header))
 			{
 				dds10Header header10;
 				size_t offsetToNewHeader = 4 + sizeof(ddsHeader);
+				if(ddsSize < offsetToNewHeader + sizeof(dds10Header))
+					throw DdsFileMalformedException(filename, "The DX10 header is cut off.");
 
-				memcpy(&header10, &ddsData[offsetToNewHeader], sizeof(dds10Header));
+				memcpy(&header10, ddsData + offsetToNewHeader, sizeof(dds10Header));
 
+				ThrowIfDX10HeaderInvalid(header, header10, filename);
 				return header10;
 			}
 
@@ -51,6 +142,8 @@ namespace dds
 			header10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
 			if((header.dwCaps2 & DDSCAPS2_VOLUME) && (header.dwFlags & DDSD_DEPTH))
 				header10.resourceDimension = DDS_DIMENSION_TEXTURE3D;
+			else if(!(header.dwFlags & DDSD_HEIGHT))
+				header10.resourceDimension = DDS_DIMENSION_TEXTURE1D;
 
 			//Get cubemap.
 			DWORD cubemapTest = header.dwCaps2 & DDSCAPS2_CUBEMAP_ALL;
@@ -66,8 +159,8 @@ namespace dds
 				header10.miscFlag = DDS_RESOURCE_MISC_TEXTURECUBE;
 			}
 
-			//Array size is... zero?
-			header10.arraySize = 0;
+			//Only DX10 files have arrays.
+			header10.arraySize = 1;
 
 			//Use the old-style format.
 			header10.dxgiFormat = DXGI_FORMAT_UNKNOWN;
@@ -80,15 +173,20 @@ namespace dds
 			Dimensions dims;
 			dims.numDimensions = 1;
 			dims.width = header.dwWidth;
-			if(header.dwFlags & DDSD_HEIGHT)
+			dims.height = 1;
+			dims.depth = 1;
+
+			switch(header10.resourceDimension)
 			{
+			case DDS_DIMENSION_TEXTURE2D:
 				dims.numDimensions = 2;
 				dims.height = header.dwHeight;
-			}
-			if(header.dwFlags & DDSD_DEPTH)
-			{
+				break;
+			case DDS_DIMENSION_TEXTURE3D:
 				dims.numDimensions = 3;
+				dims.height = header.dwHeight;
 				dims.depth = header.dwDepth;
+				break;
 			}
 
 			return dims;
@@ -145,12 +243,34 @@ namespace dds
 #include "OldDdsFmtConv.inc"
 		};
 
-		UncheckedImageFormat GetImageFormat(const ddsHeader &header, const dds10Header &header10)
+		struct DxgiFormatConv
 		{
-			if(header10.dxgiFormat != DXGI_FORMAT_UNKNOWN)
+			UncheckedImageFormat fmt;
+			DWORD dxgiFormat;
+		};
+
+		//TYPELESS formats are left out; what their bits mean is up to the view made of them.
+		//So are the formats with no OpenGL equivalent, like D24_UNORM_S8_UINT (the stencil is in
+		//the high bits, where GL wants the depth) and A8_UNORM.
+		DxgiFormatConv g_dxgiFmtConvert[] =
+		{
+#include "DxgiFmtConv.inc"
+		};
+
+		UncheckedImageFormat GetImageFormat(const ddsHeader &header, const dds10Header &header10,
+			const std::string &filename)
+		{
+			if(HasDX10Header(header))
 			{
-				//TODO: implement.
-				return UncheckedImageFormat();
+				for(int convIx = 0; convIx < ARRAY_COUNT(g_dxgiFmtConvert); convIx++)
+				{
+					if(g_dxgiFmtConvert[convIx].dxgiFormat == header10.dxgiFormat)
+						return g_dxgiFmtConvert[convIx].fmt;
+				}
+
+				std::ostringstream msg;
+				msg << "Could not use the DXGI format " << header10.dxgiFormat << ".";
+				throw DdsFileUnsupportedException(filename, msg.str());
 			}
 
 			for(int convIx = 0; convIx < ARRAY_COUNT(g_oldFmtConvert); convIx++)
@@ -159,13 +279,13 @@ namespace dds
 					return g_oldFmtConvert[convIx].fmt;
 			}
 
-			throw DdsFileUnsupportedException(std::string(), "Could not use the DDS9's image format.");
+			throw DdsFileUnsupportedException(filename, "Could not use the DDS9's image format.");
 		}
 
 		void GetImageCounts(int &numArrays, int &numMipmaps, int &numFaces,
 			const ddsHeader &header, const dds10Header &header10)
 		{
-			if(header.dwFlags & DDSD_MIPMAPCOUNT)
+			if((header.dwFlags & DDSD_MIPMAPCOUNT) && header.dwMipMapCount > 0)
 				numMipmaps = header.dwMipMapCount;
 			else
 				numMipmaps = 1;
@@ -175,17 +295,15 @@ namespace dds
 			else
 				numFaces = 1;
 
-			if(header10.arraySize > 1)
-				numArrays = header10.arraySize;
-			else
-				numArrays = 1;
+			//For cubemaps, this is the number of cubes.
+			numArrays = header10.arraySize;
 		}
 
 		size_t GetByteOffsetToData(const ddsHeader &header)
 		{
 			size_t byteOffset = sizeof(ddsHeader) + 4;
 
-			if(header.ddspf.dwFourCC == DDS10_FOUR_CC)
+			if(HasDX10Header(header))
 			{
 				byteOffset += sizeof(dds10Header);
 			}
@@ -244,50 +362,135 @@ namespace dds
 			return numLines * lineSize;
 		}
 
-		//Takes ownership of ddsData;
-		ImageSet *ProcessDDSData(FileBuffer &ddsData, const std::string &filename = std::string())
+		//What the images in a DDS file are, and where they start.
+		struct DdsLayout
 		{
+			UncheckedImageFormat fmt;
+			glimg::Dimensions dims;
+			int numMipmaps;
+			int numArrays;
+			int numFaces;
+			size_t baseOffset;
+		};
+
+		DdsLayout ReadLayout(const unsigned char *ddsData, size_t ddsSize, const std::string &filename)
+		{
+			if(ddsSize < sizeof(ddsHeader) + 4)
+				throw DdsFileMalformedException(filename, "The data is way too small to store actual information.");
+
 			//Check the first 4 bytes.
 			unsigned int magicTest = 0;
-			memcpy(&magicTest, &ddsData[0], 4);
+			memcpy(&magicTest, ddsData, 4);
 			if(magicTest != DDS_MAGIC_NUMBER)
 				throw DdsFileMalformedException(filename, "The Magic number is missing from the file.");
 
-			if(ddsData.size() < sizeof(ddsHeader) + 4)
-				throw DdsFileMalformedException(filename, "The data is way too small to store actual information.");
-
 			//Now, get a DDS header.
 			ddsHeader header;
-			memcpy(&header, &ddsData[4], sizeof(ddsHeader));
+			memcpy(&header, ddsData + 4, sizeof(ddsHeader));
 
-			ThrowIfHeaderInvalid(header);
+			ThrowIfHeaderInvalid(header, filename);
 
 			//Collect info from the DDS file.
-			dds10Header header10 = GetDDS10Header(header, ddsData);
-			glimg::Dimensions dims = GetDimensions(header, header10);
-			UncheckedImageFormat fmt = GetImageFormat(header, header10);
+			DdsLayout layout;
+			dds10Header header10 = GetDDS10Header(header, ddsData, ddsSize, filename);
+			layout.dims = GetDimensions(header, header10);
+			layout.fmt = GetImageFormat(header, header10, filename);
+			GetImageCounts(layout.numArrays, layout.numMipmaps, layout.numFaces, header, header10);
+			layout.baseOffset = GetByteOffsetToData(header);
+
+			//Each slice of a compressed volume is compressed on its own, which neither the
+			//ImageCreator nor the upload handle.
+			if(layout.dims.numDimensions == 3 && layout.fmt.eBitdepth == BD_COMPRESSED)
+				throw DdsFileUnsupportedException(filename, "Compressed 3D textures are not supported.");
+
+			size_t imagesSize = 0;
+			for(int mipmapLevel = 0; mipmapLevel < layout.numMipmaps; mipmapLevel++)
+				imagesSize += CalcMipmapSize(layout.dims, mipmapLevel, layout.fmt);
+			imagesSize *= layout.numArrays * layout.numFaces;
+
+			if(ddsSize - layout.baseOffset < imagesSize)
+				throw DdsFileMalformedException(filename, "The data is too small to hold all of its images.");
+
+			return layout;
+		}
+
+		//The same checks the ImageCreator makes, for images that bypass it.
+		void ThrowIfLayoutUnsupported(const DdsLayout &layout, const std::string &filename)
+		{
+			if(layout.numFaces == 6 && layout.dims.numDimensions != 2)
+				throw DdsFileMalformedException(filename, "Cubemaps must be 2D.");
+
+			if(layout.dims.numDimensions == 3 && layout.numArrays != 1)
+				throw DdsFileMalformedException(filename, "3D textures cannot be arrays.");
+
+			if(layout.numMipmaps <= 0)
+				throw DdsFileMalformedException(filename, "There are no mipmaps.");
+		}
+
+		//The ImageCreator can only flip uncompressed images and BC1 through BC5 blocks.
+		bool CanFlipImages(const UncheckedImageFormat &fmt)
+		{
+			return fmt.eType < DT_COMPRESSED_UNSIGNED_BC6H;
+		}
+
+		//Copies the images as they are in the file, so they stay top-left.
+		ImageSet *CopyTopLeftImages(const unsigned char *ddsData, const DdsLayout &layout,
+			const std::string &filename)
+		{
+			ThrowIfLayoutUnsupported(layout, filename);
+
+			std::vector<ImageBuffer> imageData(layout.numMipmaps);
+			std::vector<size_t> imageSizes(layout.numMipmaps);
+			for(int mipmapLevel = 0; mipmapLevel < layout.numMipmaps; mipmapLevel++)
+			{
+				imageSizes[mipmapLevel] = CalcMipmapSize(layout.dims, mipmapLevel, layout.fmt);
+				imageData[mipmapLevel].resize(imageSizes[mipmapLevel] * layout.numArrays * layout.numFaces);
+			}
+
+			size_t cumulativeOffset = layout.baseOffset;
+			for(int arrayIx = 0; arrayIx < layout.numArrays; arrayIx++)
+			{
+				for(int faceIx = 0; faceIx < layout.numFaces; faceIx++)
+				{
+					for(int mipmapLevel = 0; mipmapLevel < layout.numMipmaps; mipmapLevel++)
+					{
+						size_t imageOffset = ((arrayIx * layout.numFaces) + faceIx) * imageSizes[mipmapLevel];
+						memcpy(&imageData[mipmapLevel][imageOffset], ddsData + cumulativeOffset,
+							imageSizes[mipmapLevel]);
+						cumulativeOffset += imageSizes[mipmapLevel];
+					}
+				}
+			}
 
-			int numMipmaps = 0;
-			int numArrays = 0;
-			int numFaces = 0;
-			GetImageCounts(numArrays, numMipmaps, numFaces, header, header10);
+			detail::ImageSetImpl *pImpl = new detail::ImageSetImpl(layout.fmt, layout.dims,
+				layout.numMipmaps, layout.numArrays, layout.numFaces, true, imageData, imageSizes);
+			return detail::MakeImageSet(pImpl);
+		}
+
+		ImageSet *ProcessDDSData(const unsigned char *ddsData, size_t ddsSize,
+			const std::string &filename = std::string())
+		{
+			DdsLayout layout = ReadLayout(ddsData, ddsSize, filename);
 
-			const size_t baseOffset = GetByteOffsetToData(header);
+			//The ImageCreator would copy BC6H and BC7 blocks unflipped, yet call them
+			//bottom-left.
+			if(!CanFlipImages(layout.fmt))
+				return CopyTopLeftImages(ddsData, layout, filename);
 
-			//TODO: support array textures
 			//Build the image creator. No more exceptions, except for those thrown by.
 			//the ImageCreator.
-			ImageCreator imgCreator(fmt, dims, numMipmaps, numArrays, numFaces);
-			size_t cumulativeOffset = baseOffset;
-			for(int arrayIx = 0; arrayIx < numArrays; arrayIx++)
+			ImageCreator imgCreator(layout.fmt, layout.dims, layout.numMipmaps,
+				layout.numArrays, layout.numFaces);
+			size_t cumulativeOffset = layout.baseOffset;
+			for(int arrayIx = 0; arrayIx < layout.numArrays; arrayIx++)
 			{
-				for(int faceIx = 0; faceIx < numFaces; faceIx++)
+				for(int faceIx = 0; faceIx < layout.numFaces; faceIx++)
 				{
-					for(int mipmapLevel = 0; mipmapLevel < numMipmaps; mipmapLevel++)
+					for(int mipmapLevel = 0; mipmapLevel < layout.numMipmaps; mipmapLevel++)
 					{
-						imgCreator.SetImageData(&ddsData[0] + cumulativeOffset,
+						imgCreator.SetImageData(ddsData + cumulativeOffset,
 							true, mipmapLevel, arrayIx, faceIx);
-						cumulativeOffset += CalcMipmapSize(dims, mipmapLevel, fmt);
+						cumulativeOffset += CalcMipmapSize(layout.dims, mipmapLevel, layout.fmt);
 					}
 				}
 			}
@@ -313,14 +516,58 @@ namespace dds
 		fread(&fileData[0], fileSize, 1, pFile);
 		fclose(pFile);
 
-		return ProcessDDSData(fileData, filename);
+		return ProcessDDSData(&fileData[0], fileData.size(), filename);
 	}
 
 	ImageSet * LoadFromMemory( const unsigned char *buffer, size_t bufSize )
 	{
-		FileBuffer fileData(buffer, buffer + bufSize);
+		return ProcessDDSData(buffer, bufSize);
+	}
+
+	ImageSet * MapFromFile( const std::string &filename )
+	{
+		std::auto_ptr<detail::FileMapping> pMapping;
+		try
+		{
+			pMapping.reset(new detail::FileMapping(filename));
+		}
+		catch(std::runtime_error &)
+		{
+			throw DdsFileNotFoundException(filename);
+		}
+
+		const unsigned char *ddsData = pMapping->GetData();
+		DdsLayout layout = ReadLayout(ddsData, pMapping->GetSize(), filename);
+		ThrowIfLayoutUnsupported(layout, filename);
+
+		std::vector<size_t> imageSizes(layout.numMipmaps);
+		for(int mipmapLevel = 0; mipmapLevel < layout.numMipmaps; mipmapLevel++)
+			imageSizes[mipmapLevel] = CalcMipmapSize(layout.dims, mipmapLevel, layout.fmt);
+
+		//The file stores each array image and face with all of its mipmaps; the views are
+		//indexed by mipmap first.
+		std::vector<const unsigned char *> imageViews(
+			layout.numMipmaps * layout.numArrays * layout.numFaces);
+		size_t cumulativeOffset = layout.baseOffset;
+		for(int arrayIx = 0; arrayIx < layout.numArrays; arrayIx++)
+		{
+			for(int faceIx = 0; faceIx < layout.numFaces; faceIx++)
+			{
+				for(int mipmapLevel = 0; mipmapLevel < layout.numMipmaps; mipmapLevel++)
+				{
+					size_t viewIx = ((mipmapLevel * layout.numArrays) + arrayIx) * layout.numFaces + faceIx;
+					imageViews[viewIx] = ddsData + cumulativeOffset;
+					cumulativeOffset += imageSizes[mipmapLevel];
+				}
+			}
+		}
+
+		detail::ImageSetImpl *pImpl = new detail::ImageSetImpl(layout.fmt, layout.dims,
+			layout.numMipmaps, layout.numArrays, layout.numFaces, true, imageViews, imageSizes,
+			pMapping.get());
+		pMapping.release();
 
-		return ProcessDDSData(fileData);
+		return new ImageSet(pImpl);
 	}
 }
 }
@@ -0,0 +1,208 @@
+//Copyright (C) 2011 by Jason L. McKesson
+//This file is licensed by the MIT License.
+
+
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <algorithm>
+#include "glimg/Executor.h"
+#include "ParallelFor.h"
+
+namespace glimg
+{
+	namespace
+	{
+		//glimg's own pool, for when the application does not give it an executor.
+		class ThreadPool : public Executor
+		{
+		public:
+			ThreadPool()
+				: m_stopping(false)
+			{
+				unsigned int numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+				m_threads.reserve(numThreads);
+				for(unsigned int threadIx = 0; threadIx < numThreads; ++threadIx)
+					m_threads.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+			}
+
+			//Finishes every queued task before returning.
+			virtual ~ThreadPool()
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_stopping = true;
+				}
+				m_taskReady.notify_all();
+
+				for(size_t threadIx = 0; threadIx < m_threads.size(); ++threadIx)
+					m_threads[threadIx].join();
+			}
+
+			virtual void Submit(const std::function<void()> &task)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_tasks.push_back(task);
+				}
+				m_taskReady.notify_one();
+			}
+
+			virtual unsigned int GetThreadCount() const {return (unsigned int)m_threads.size();}
+
+		private:
+			std::vector<std::thread> m_threads;
+			std::deque<std::function<void()> > m_tasks;
+			std::mutex m_mutex;
+			std::condition_variable m_taskReady;
+			bool m_stopping;
+
+			void WorkerLoop()
+			{
+				for(;;)
+				{
+					std::function<void()> task;
+					{
+						std::unique_lock<std::mutex> lock(m_mutex);
+						while(m_tasks.empty() && !m_stopping)
+							m_taskReady.wait(lock);
+
+						if(m_tasks.empty())
+							return;
+
+						task.swap(m_tasks.front());
+						m_tasks.pop_front();
+					}
+
+					task();
+				}
+			}
+		};
+
+		std::atomic<Executor *> g_pExecutor(NULL);
+
+		ThreadPool &GetOwnPool()
+		{
+			static ThreadPool pool;
+			return pool;
+		}
+
+		//Shared by the caller and its helper tasks. Helpers that start after every range has
+		//been claimed find nothing to do, so they may outlive the call.
+		struct ParallelForState
+		{
+			ParallelForState(size_t _count, size_t _rangeSize, size_t _numRanges,
+				const std::function<void(size_t, size_t)> &_func)
+				: count(_count)
+				, rangeSize(_rangeSize)
+				, numRanges(_numRanges)
+				, func(_func)
+				, nextRange(0)
+				, rangesDone(0)
+			{}
+
+			const size_t count;
+			const size_t rangeSize;
+			const size_t numRanges;
+			const std::function<void(size_t, size_t)> &func;	//Only used while ranges are left.
+
+			std::atomic<size_t> nextRange;
+
+			std::mutex mutex;
+			std::condition_variable allDone;
+			size_t rangesDone;
+			std::exception_ptr error;
+		};
+
+		void RunRanges(ParallelForState &state)
+		{
+			for(;;)
+			{
+				const size_t rangeIx = state.nextRange++;
+				if(rangeIx >= state.numRanges)
+					return;
+
+				std::exception_ptr error;
+				try
+				{
+					const size_t begin = rangeIx * state.rangeSize;
+					state.func(begin, std::min(begin + state.rangeSize, state.count));
+				}
+				catch(...)
+				{
+					error = std::current_exception();
+				}
+
+				std::lock_guard<std::mutex> lock(state.mutex);
+				if(error && !state.error)
+					state.error = error;
+
+				++state.rangesDone;
+				if(state.rangesDone == state.numRanges)
+					state.allDone.notify_all();
+			}
+		}
+	}
+
+	void SetExecutor( Executor *pExecutor )
+	{
+		g_pExecutor = pExecutor;
+	}
+
+	Executor &GetExecutor()
+	{
+		Executor *pExecutor = g_pExecutor;
+		if(pExecutor)
+			return *pExecutor;
+
+		return GetOwnPool();
+	}
+
+	namespace detail
+	{
+		void ParallelFor( Executor &executor, size_t count, size_t minRangeSize,
+			const std::function<void(size_t, size_t)> &func )
+		{
+			if(count == 0)
+				return;
+
+			//A few ranges per thread evens out uneven work.
+			const size_t numThreads = executor.GetThreadCount() + 1;
+			const size_t rangeSize = std::max((count + numThreads * 4 - 1) / (numThreads * 4),
+				std::max(minRangeSize, size_t(1)));
+
+			if(rangeSize >= count)
+			{
+				func(0, count);
+				return;
+			}
+
+			const size_t numRanges = (count + rangeSize - 1) / rangeSize;
+			std::shared_ptr<ParallelForState> pState(
+				new ParallelForState(count, rangeSize, numRanges, func));
+
+			const size_t numHelpers = std::min(numThreads - 1, numRanges - 1);
+			for(size_t helperIx = 0; helperIx < numHelpers; ++helperIx)
+				executor.Submit([pState]() {RunRanges(*pState);});
+
+			RunRanges(*pState);
+
+			std::exception_ptr error;
+			{
+				std::unique_lock<std::mutex> lock(pState->mutex);
+				while(pState->rangesDone != numRanges)
+					pState->allDone.wait(lock);
+				error = pState->error;
+			}
+
+			if(error)
+				std::rethrow_exception(error);
+		}
+	}
+}
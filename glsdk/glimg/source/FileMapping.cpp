@@ -0,0 +1,100 @@
+//Copyright (C) 2011 by Jason L. McKesson
+//This file is licensed by the MIT License.
+
+
+
+#include <string>
+#include <stdexcept>
+#include "FileMapping.h"
+
+#ifdef WIN32
+#include <windows.h>
+#endif //WIN32
+
+#ifdef LOAD_X11
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif //LOAD_X11
+
+namespace glimg
+{
+	namespace detail
+	{
+#ifdef WIN32
+		FileMapping::FileMapping( const std::string &filename )
+			: m_pData(NULL)
+			, m_size(0)
+			, m_hFile(INVALID_HANDLE_VALUE)
+			, m_hMapping(NULL)
+		{
+			m_hFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if(m_hFile == INVALID_HANDLE_VALUE)
+				throw std::runtime_error("Could not open the file " + filename);
+
+			LARGE_INTEGER fileSize;
+			if(!GetFileSizeEx(m_hFile, &fileSize) || fileSize.QuadPart == 0)
+			{
+				CloseHandle(m_hFile);
+				throw std::runtime_error("Could not map the empty file " + filename);
+			}
+			m_size = (size_t)fileSize.QuadPart;
+
+			m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+			if(m_hMapping)
+				m_pData = static_cast<const unsigned char *>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+
+			if(!m_pData)
+			{
+				if(m_hMapping)
+					CloseHandle(m_hMapping);
+				CloseHandle(m_hFile);
+				throw std::runtime_error("Could not map the file " + filename);
+			}
+		}
+
+		FileMapping::~FileMapping()
+		{
+			UnmapViewOfFile(m_pData);
+			CloseHandle(m_hMapping);
+			CloseHandle(m_hFile);
+		}
+#endif //WIN32
+
+#ifdef LOAD_X11
+		FileMapping::FileMapping( const std::string &filename )
+			: m_pData(NULL)
+			, m_size(0)
+		{
+			int fd = open(filename.c_str(), O_RDONLY);
+			if(fd == -1)
+				throw std::runtime_error("Could not open the file " + filename);
+
+			struct stat fileInfo;
+			if(fstat(fd, &fileInfo) == -1 || fileInfo.st_size == 0)
+			{
+				close(fd);
+				throw std::runtime_error("Could not map the empty file " + filename);
+			}
+			m_size = (size_t)fileInfo.st_size;
+
+			void *pMapping = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			//The mapping keeps its own reference to the file.
+			close(fd);
+
+			if(pMapping == MAP_FAILED)
+				throw std::runtime_error("Could not map the file " + filename);
+
+			m_pData = static_cast<const unsigned char *>(pMapping);
+		}
+
+		FileMapping::~FileMapping()
+		{
+			munmap(const_cast<unsigned char *>(m_pData), m_size);
+		}
+#endif //LOAD_X11
+	}
+}
@@ -0,0 +1,43 @@
+/** Copyright (C) 2011 by Jason L. McKesson **/
+/** This file is licensed by the MIT License. **/
+
+
+
+#ifndef GLIMG_FILE_MAPPING_H
+#define GLIMG_FILE_MAPPING_H
+
+#include <string>
+
+namespace glimg
+{
+	namespace detail
+	{
+		//A read-only view of an entire file, mapped into the address space.
+		//The data stays valid for as long as the object lives.
+		class FileMapping
+		{
+		public:
+			//Throws a std::runtime_error if the file cannot be opened or mapped.
+			explicit FileMapping(const std::string &filename);
+			~FileMapping();
+
+			const unsigned char *GetData() const {return m_pData;}
+			size_t GetSize() const {return m_size;}
+
+		private:
+			const unsigned char *m_pData;
+			size_t m_size;
+
+#ifdef WIN32
+			void *m_hFile;
+			void *m_hMapping;
+#endif //WIN32
+
+			//Prevent copying.
+			FileMapping(const FileMapping &);
+			FileMapping &operator=(const FileMapping &);
+		};
+	}
+}
+
+#endif //GLIMG_FILE_MAPPING_H
@@ -274,7 +274,7 @@ namespace glimg
 			throw ImageSetAlreadyCreatedException();
 
 		detail::ImageSetImpl *pImageData = new detail::ImageSetImpl(m_format, m_dims,
-			m_mipmapCount, m_arrayCount, m_faceCount, m_imageData, m_imageSizes);
+			m_mipmapCount, m_arrayCount, m_faceCount, false, m_imageData, m_imageSizes);
 
 		ImageSet *pImageSet = new ImageSet(pImageData);
 
@@ -76,9 +76,19 @@ namespace glimg
 		return SingleImage(m_pImpl, mipmapLevel, arrayIx, faceIx);
 	}
 
+	bool ImageSet::IsTopLeft() const
+	{
+		return m_pImpl->IsTopLeft();
+	}
+
 	const void * ImageSet::GetImageArray( int mipmapLevel ) const
 	{
-		return m_pImpl->GetImageData(mipmapLevel, 0, 0);
+		return m_pImpl->GetImageArray(mipmapLevel);
+	}
+
+	ImageSet * detail::MakeImageSet( ImageSetImpl *pImpl )
+	{
+		return new ImageSet(pImpl);
 	}
 }
 
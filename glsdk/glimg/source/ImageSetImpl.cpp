@@ -3,13 +3,15 @@
 
 
 
+#include <string.h>
 #include "ImageSetImpl.h"
 #include "Util.h"
+#include "FileMapping.h"
 
 namespace glimg
 {
 	detail::ImageSetImpl::ImageSetImpl( ImageFormat format, Dimensions dimensions,
-		int mipmapCount, int arrayCount, int faceCount,
+		int mipmapCount, int arrayCount, int faceCount, bool isTopLeft,
 		std::vector<ImageBuffer> &imageData,
 		std::vector<size_t> &imageSizes )
 		: m_format(format)
@@ -17,11 +19,34 @@ namespace glimg
 		, m_mipmapCount(mipmapCount)
 		, m_arrayCount(arrayCount)
 		, m_faceCount(faceCount)
+		, m_bTopLeft(isTopLeft)
+		, m_pMapping(NULL)
 	{
 		m_imageData.swap(imageData);
 		m_imageSizes.swap(imageSizes);
 	}
 
+	detail::ImageSetImpl::ImageSetImpl( ImageFormat format, Dimensions dimensions,
+		int mipmapCount, int arrayCount, int faceCount, bool isTopLeft,
+		std::vector<const unsigned char *> &imageViews,
+		std::vector<size_t> &imageSizes, FileMapping *pMapping )
+		: m_format(format)
+		, m_dimensions(dimensions)
+		, m_mipmapCount(mipmapCount)
+		, m_arrayCount(arrayCount)
+		, m_faceCount(faceCount)
+		, m_bTopLeft(isTopLeft)
+		, m_pMapping(pMapping)
+	{
+		m_imageViews.swap(imageViews);
+		m_imageSizes.swap(imageSizes);
+	}
+
+	detail::ImageSetImpl::~ImageSetImpl()
+	{
+		delete m_pMapping;
+	}
+
 	Dimensions detail::ImageSetImpl::GetDimensions( int mipmapLevel ) const
 	{
 		return ModifySizeForMipmap(m_dimensions, mipmapLevel);
@@ -29,10 +54,37 @@ namespace glimg
 
 	const void * detail::ImageSetImpl::GetImageData( int mipmapLevel, int arrayIx, int faceIx ) const
 	{
+		if(!m_imageViews.empty())
+			return m_imageViews[((mipmapLevel * m_arrayCount) + arrayIx) * m_faceCount + faceIx];
+
 		size_t imageOffset = ((arrayIx * m_faceCount) + faceIx) * m_imageSizes[mipmapLevel];
 		return &m_imageData[mipmapLevel][0] + imageOffset;
 	}
 
+	const void * detail::ImageSetImpl::GetImageArray( int mipmapLevel ) const
+	{
+		const int imageCount = m_arrayCount * m_faceCount;
+		if(m_imageViews.empty() || imageCount == 1)
+			return GetImageData(mipmapLevel, 0, 0);
+
+		if(m_gatheredLevels.empty())
+			m_gatheredLevels.resize(m_mipmapCount);
+
+		ImageBuffer &level = m_gatheredLevels[mipmapLevel];
+		if(level.empty())
+		{
+			const size_t imageSize = m_imageSizes[mipmapLevel];
+			level.resize(imageSize * imageCount);
+			for(int image = 0; image < imageCount; ++image)
+			{
+				memcpy(&level[0] + image * imageSize,
+					m_imageViews[mipmapLevel * imageCount + image], imageSize);
+			}
+		}
+
+		return &level[0];
+	}
+
 	size_t detail::ImageSetImpl::GetImageByteSize( int mipmapLevel ) const
 	{
 		return m_imageSizes[mipmapLevel];
@@ -9,16 +9,26 @@
 #include "glimg/ImageSet.h"
 #include "glimg/ImageCreator.h"
 
-
 namespace glimg
 {
 	namespace detail
 	{
+		class FileMapping;
+
 		class ImageSetImpl
 		{
 		public:
 			ImageSetImpl(ImageFormat format, Dimensions dimensions, int mipmapCount, int arrayCount,
-				int faceCount, std::vector<ImageBuffer> &imageData, std::vector<size_t> &imageSizes);
+				int faceCount, bool isTopLeft, std::vector<ImageBuffer> &imageData,
+				std::vector<size_t> &imageSizes);
+
+			//The images are views into a mapped file, which this object takes ownership of.
+			//imageViews has one pointer per image, indexed by mipmap, then array, then face.
+			ImageSetImpl(ImageFormat format, Dimensions dimensions, int mipmapCount, int arrayCount,
+				int faceCount, bool isTopLeft, std::vector<const unsigned char *> &imageViews,
+				std::vector<size_t> &imageSizes, FileMapping *pMapping);
+
+			~ImageSetImpl();
 
 			Dimensions GetDimensions() const {return m_dimensions;}
 			Dimensions GetDimensions(int mipmapLevel) const;
@@ -29,8 +39,14 @@ namespace glimg
 
 			ImageFormat GetFormat() const {return m_format;}
 
+			bool IsTopLeft() const {return m_bTopLeft;}
+
 			const void *GetImageData(int mipmapLevel, int arrayIx = 0, int faceIx = 0) const;
 
+			//All of the mipmap's images, one after the other. Views are not contiguous in the file,
+			//so for them the level is gathered into a buffer on first use.
+			const void *GetImageArray(int mipmapLevel) const;
+
 			//Returns the byte size for a single image of that mipmap's data.
 			//This is for a single array layer/cube face, not the data for the entire mipmap.
 			size_t GetImageByteSize(int mipmapLevel) const;
@@ -41,10 +57,20 @@ namespace glimg
 			int m_mipmapCount;
 			int m_arrayCount;
 			int m_faceCount;
+			bool m_bTopLeft;
 
 			//Indexed by mipmap.
 			std::vector<ImageBuffer> m_imageData;
 			std::vector<size_t> m_imageSizes;
+
+			//Only for views.
+			std::vector<const unsigned char *> m_imageViews;
+			FileMapping *m_pMapping;
+			mutable std::vector<ImageBuffer> m_gatheredLevels;
+
+			//Prevent copying.
+			ImageSetImpl(const ImageSetImpl &);
+			ImageSetImpl &operator=(const ImageSetImpl &);
 		};
 	}
 }
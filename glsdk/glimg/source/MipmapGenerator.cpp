@@ -0,0 +1,618 @@
+//Copyright (C) 2011 by Jason L. McKesson
+//This file is licensed by the MIT License.
+
+
+
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "glimg/MipmapGenerator.h"
+#include "glimg/Executor.h"
+#include "ImageSetImpl.h"
+#include "Util.h"
+#include "SimdOps.h"
+#include "ParallelFor.h"
+
+#define ARRAY_COUNT( array ) (sizeof( array ) / (sizeof( array[0] ) * (sizeof( array ) != sizeof(void*) || sizeof( array[0] ) <= sizeof(void*))))
+
+namespace glimg
+{
+	namespace
+	{
+		template<int arrayCount, typename TestType>
+		bool IsOneOfThese(TestType testValue, TestType *testArray)
+		{
+			for(int loop = 0; loop < arrayCount; loop++)
+			{
+				if(testValue == testArray[loop])
+					return true;
+			}
+
+			return false;
+		}
+
+		//Fewer rows per task would spend more time handing out tasks than filtering them.
+		const size_t MIN_ROWS_PER_TASK = 16;
+
+		const float PI = 3.14159265358979f;
+
+		//Half the width of the Kaiser and Lanczos filters, in destination texels.
+		const float WINDOWED_SINC_RADIUS = 3.0f;
+
+		//Trades the Kaiser window's sharpness against its ringing.
+		const float KAISER_ALPHA = 4.0f;
+
+		////////////////////////////////////////////////////////
+		//Filters.
+
+		float Sinc( float x )
+		{
+			if(fabsf(x) < 1.0e-5f)
+				return 1.0f;
+
+			x *= PI;
+			return sinf(x) / x;
+		}
+
+		//The modified Bessel function of the first kind, by its power series.
+		float BesselI0( float x )
+		{
+			float sum = 1.0f;
+			float term = 1.0f;
+			float halfX = x * 0.5f;
+			for(int k = 1; k < 32; ++k)
+			{
+				float factor = halfX / k;
+				term *= factor * factor;
+				sum += term;
+				if(term < sum * 1.0e-8f)
+					break;
+			}
+
+			return sum;
+		}
+
+		float BoxFilter( float x )
+		{
+			return fabsf(x) <= 0.5f ? 1.0f : 0.0f;
+		}
+
+		float KaiserFilter( float x )
+		{
+			float t = x / WINDOWED_SINC_RADIUS;
+			if(t <= -1.0f || t >= 1.0f)
+				return 0.0f;
+
+			return Sinc(x) * BesselI0(KAISER_ALPHA * sqrtf(1.0f - t * t)) / BesselI0(KAISER_ALPHA);
+		}
+
+		float LanczosFilter( float x )
+		{
+			if(fabsf(x) >= WINDOWED_SINC_RADIUS)
+				return 0.0f;
+
+			return Sinc(x) * Sinc(x / WINDOWED_SINC_RADIUS);
+		}
+
+		//The texels and weights each destination texel of one dimension is filtered from.
+		struct FilterTaps
+		{
+			int tapCount;
+			std::vector<int> sourceIndices;		//tapCount per destination texel, clamped to the source.
+			std::vector<float> weights;			//tapCount per destination texel, summing to 1.
+		};
+
+		FilterTaps BuildFilterTaps( int sourceSize, int destSize, MipmapFilter eFilter )
+		{
+			float (*Filter)(float) = KaiserFilter;
+			float radius = WINDOWED_SINC_RADIUS;
+			switch(eFilter)
+			{
+			case MIPMAP_FILTER_BOX:
+				Filter = BoxFilter;
+				radius = 0.5f;
+				break;
+			case MIPMAP_FILTER_LANCZOS:
+				Filter = LanczosFilter;
+				break;
+			default:
+				break;
+			}
+
+			//The filter is stretched over as many source texels as each destination texel covers.
+			float scale = sourceSize / (float)destSize;
+			float sourceRadius = radius * scale;
+
+			FilterTaps taps;
+			taps.tapCount = (int)ceilf(sourceRadius * 2.0f) + 1;
+			taps.sourceIndices.resize(destSize * taps.tapCount);
+			taps.weights.resize(destSize * taps.tapCount);
+			for(int destIx = 0; destIx < destSize; ++destIx)
+			{
+				float center = (destIx + 0.5f) * scale;
+				int firstIx = (int)floorf(center - sourceRadius);
+				int *pIndices = &taps.sourceIndices[destIx * taps.tapCount];
+				float *pWeights = &taps.weights[destIx * taps.tapCount];
+
+				float total = 0.0f;
+				for(int tapIx = 0; tapIx < taps.tapCount; ++tapIx)
+				{
+					int sourceIx = firstIx + tapIx;
+					pIndices[tapIx] = std::min(std::max(sourceIx, 0), sourceSize - 1);
+					pWeights[tapIx] = Filter((sourceIx + 0.5f - center) / scale);
+					total += pWeights[tapIx];
+				}
+
+				for(int tapIx = 0; tapIx < taps.tapCount; ++tapIx)
+					pWeights[tapIx] /= total;
+			}
+
+			return taps;
+		}
+
+		//Filters one row along its length. Texels are channelCount floats.
+		template<int channelCount>
+		void FilterRow( const float *pSource, const FilterTaps &taps, int destWidth, float *pDest )
+		{
+			for(int destIx = 0; destIx < destWidth; ++destIx)
+			{
+				const int *pIndices = &taps.sourceIndices[destIx * taps.tapCount];
+				const float *pWeights = &taps.weights[destIx * taps.tapCount];
+
+				float sums[channelCount] = {0.0f};
+				for(int tapIx = 0; tapIx < taps.tapCount; ++tapIx)
+				{
+					const float *pTexel = pSource + pIndices[tapIx] * channelCount;
+					for(int channelIx = 0; channelIx < channelCount; ++channelIx)
+						sums[channelIx] += pWeights[tapIx] * pTexel[channelIx];
+				}
+
+				for(int channelIx = 0; channelIx < channelCount; ++channelIx)
+					pDest[destIx * channelCount + channelIx] = sums[channelIx];
+			}
+		}
+
+#if defined(GLIMG_SIMD_AVX) || defined(GLIMG_SIMD_SSE2)
+		//A four channel texel fills an SSE register, so each tap is one multiply and add.
+		template<>
+		void FilterRow<4>( const float *pSource, const FilterTaps &taps, int destWidth, float *pDest )
+		{
+			for(int destIx = 0; destIx < destWidth; ++destIx)
+			{
+				const int *pIndices = &taps.sourceIndices[destIx * taps.tapCount];
+				const float *pWeights = &taps.weights[destIx * taps.tapCount];
+
+				__m128 sum = _mm_setzero_ps();
+				for(int tapIx = 0; tapIx < taps.tapCount; ++tapIx)
+				{
+					__m128 texel = _mm_loadu_ps(pSource + pIndices[tapIx] * 4);
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(pWeights[tapIx]), texel));
+				}
+
+				_mm_storeu_ps(pDest + destIx * 4, sum);
+			}
+		}
+#endif
+
+		typedef void (*RowFilterFunc)(const float *, const FilterTaps &, int, float *);
+
+		RowFilterFunc GetRowFilter( int channelCount )
+		{
+			switch(channelCount)
+			{
+			case 1: return FilterRow<1>;
+			case 2: return FilterRow<2>;
+			case 3: return FilterRow<3>;
+			default: return FilterRow<4>;
+			}
+		}
+
+		//Filters one destination row from rows of the source, a whole row of values at a time.
+		template<typename Ops>
+		void FilterColumns( const float *pSource, size_t rowValueCount, const int *pIndices,
+			const float *pWeights, int tapCount, bool bClamp, float *pDest )
+		{
+			typedef typename Ops::Floats Floats;
+
+			size_t valueIx = 0;
+			for(; valueIx + Ops::LANES <= rowValueCount; valueIx += Ops::LANES)
+			{
+				Floats sum = Ops::Set(0.0f);
+				for(int tapIx = 0; tapIx < tapCount; ++tapIx)
+				{
+					Floats values = Ops::Load(pSource + pIndices[tapIx] * rowValueCount + valueIx);
+					sum = Ops::Add(sum, Ops::Mul(Ops::Set(pWeights[tapIx]), values));
+				}
+
+				if(bClamp)
+					sum = Ops::Min(Ops::Max(sum, Ops::Set(0.0f)), Ops::Set(1.0f));
+				Ops::Store(pDest + valueIx, sum);
+			}
+
+			for(; valueIx < rowValueCount; ++valueIx)
+			{
+				float sum = 0.0f;
+				for(int tapIx = 0; tapIx < tapCount; ++tapIx)
+					sum += pWeights[tapIx] * pSource[pIndices[tapIx] * rowValueCount + valueIx];
+
+				if(bClamp)
+					sum = std::min(std::max(sum, 0.0f), 1.0f);
+				pDest[valueIx] = sum;
+			}
+		}
+
+		////////////////////////////////////////////////////////
+		//Conversion to and from floats.
+
+		float SRGBToLinear( float value )
+		{
+			if(value <= 0.04045f)
+				return value / 12.92f;
+			return powf((value + 0.055f) / 1.055f, 2.4f);
+		}
+
+		float LinearToSRGB( float value )
+		{
+			if(value <= 0.0031308f)
+				return value * 12.92f;
+			return 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+		}
+
+		const int SRGB_ENCODE_STEPS = 4096;
+
+		struct SRGBTables
+		{
+			float toLinear[256];
+
+			//The linear value halfway between each 8-bit sRGB value and the one below it.
+			float thresholds[257];
+
+			//The sRGB value of the bottom of each step of linear values. No step spans more
+			//than one threshold, so at most one more comparison finds the value.
+			unsigned char fromLinear[SRGB_ENCODE_STEPS + 1];
+
+			SRGBTables()
+			{
+				for(int value = 0; value < 256; ++value)
+				{
+					toLinear[value] = SRGBToLinear(value / 255.0f);
+					thresholds[value] = value == 0 ? -1.0f : SRGBToLinear((value - 0.5f) / 255.0f);
+				}
+				thresholds[256] = 2.0f;
+
+				int value = 0;
+				for(int stepIx = 0; stepIx <= SRGB_ENCODE_STEPS; ++stepIx)
+				{
+					while(thresholds[value + 1] <= stepIx / (float)SRGB_ENCODE_STEPS)
+						++value;
+					fromLinear[stepIx] = (unsigned char)value;
+				}
+			}
+		};
+
+		const SRGBTables &GetSRGBTables()
+		{
+			static SRGBTables tables;
+			return tables;
+		}
+
+		//Rounds in sRGB space, which the thresholds make exact without a pow per value.
+		//The value must already be clamped to [0, 1].
+		unsigned char LinearToSRGB8( float value, const SRGBTables &tables )
+		{
+			int encoded = tables.fromLinear[(int)(value * SRGB_ENCODE_STEPS)];
+			while(value >= tables.thresholds[encoded + 1])
+				++encoded;
+			return (unsigned char)encoded;
+		}
+
+		//How the texels of an image are stored.
+		struct TexelLayout
+		{
+			int channelCount;
+			Bitdepth eDepth;
+			bool bIsSRGB;			//The first three channels are sRGB.
+			int alphaChannel;		//-1 if there is no alpha.
+		};
+
+		PixelComponents g_sourceFormats[] = {FMT_COLOR_RED, FMT_COLOR_RG, FMT_COLOR_RGB,
+			FMT_COLOR_RGBX, FMT_COLOR_RGBA, FMT_COLOR_RGB_sRGB, FMT_COLOR_RGBX_sRGB, FMT_COLOR_RGBA_sRGB};
+		PixelComponents g_alphaFormats[] = {FMT_COLOR_RGBA, FMT_COLOR_RGBA_sRGB};
+		PixelComponents g_srgbFormats[] = {FMT_COLOR_RGB_sRGB, FMT_COLOR_RGBX_sRGB, FMT_COLOR_RGBA_sRGB};
+
+		TexelLayout GetTexelLayout( const ImageFormat &fmt, const Dimensions &dims )
+		{
+			if(dims.numDimensions != 1 && dims.numDimensions != 2)
+				throw MipmapSourceUnsupportedException();
+
+			bool bIsNormalized = fmt.Type() == DT_NORM_UNSIGNED_INTEGER &&
+				(fmt.Depth() == BD_PER_COMP_8 || fmt.Depth() == BD_PER_COMP_16);
+			bool bIsFloat = fmt.Type() == DT_FLOAT && fmt.Depth() == BD_PER_COMP_32;
+			if(!bIsNormalized && !bIsFloat)
+				throw MipmapSourceUnsupportedException();
+
+			if(fmt.Order() != ORDER_RGBA && fmt.Order() != ORDER_BGRA)
+				throw MipmapSourceUnsupportedException();
+
+			if(!IsOneOfThese<ARRAY_COUNT(g_sourceFormats)>(fmt.Components(), g_sourceFormats))
+				throw MipmapSourceUnsupportedException();
+
+			TexelLayout layout;
+			layout.channelCount = ComponentCount(fmt.Components());
+			layout.eDepth = fmt.Depth();
+			layout.bIsSRGB = IsOneOfThese<ARRAY_COUNT(g_srgbFormats)>(fmt.Components(), g_srgbFormats);
+			layout.alphaChannel =
+				IsOneOfThese<ARRAY_COUNT(g_alphaFormats)>(fmt.Components(), g_alphaFormats) ? 3 : -1;
+			return layout;
+		}
+
+		void LoadRow( const unsigned char *pRow, const TexelLayout &layout, int width, float *pValues )
+		{
+			const SRGBTables &tables = GetSRGBTables();
+			for(int channelIx = 0; channelIx < layout.channelCount; ++channelIx)
+			{
+				bool bIsSRGB = layout.bIsSRGB && channelIx < 3;
+				for(int valueIx = channelIx; valueIx < width * layout.channelCount; valueIx += layout.channelCount)
+				{
+					switch(layout.eDepth)
+					{
+					case BD_PER_COMP_8:
+						pValues[valueIx] = bIsSRGB ? tables.toLinear[pRow[valueIx]] : pRow[valueIx] / 255.0f;
+						break;
+					case BD_PER_COMP_16:
+						{
+							float value = ((const unsigned short *)pRow)[valueIx] / 65535.0f;
+							pValues[valueIx] = bIsSRGB ? SRGBToLinear(value) : value;
+						}
+						break;
+					default:
+						pValues[valueIx] = ((const float *)pRow)[valueIx];
+						break;
+					}
+				}
+			}
+		}
+
+		void StoreRow( const float *pValues, const TexelLayout &layout, int width, float alphaScale,
+			unsigned char *pRow )
+		{
+			const SRGBTables &tables = GetSRGBTables();
+			for(int channelIx = 0; channelIx < layout.channelCount; ++channelIx)
+			{
+				bool bIsSRGB = layout.bIsSRGB && channelIx < 3;
+				float scale = channelIx == layout.alphaChannel ? alphaScale : 1.0f;
+				for(int valueIx = channelIx; valueIx < width * layout.channelCount; valueIx += layout.channelCount)
+				{
+					float value = pValues[valueIx] * scale;
+					switch(layout.eDepth)
+					{
+					case BD_PER_COMP_8:
+						value = std::min(std::max(value, 0.0f), 1.0f);
+						if(bIsSRGB)
+							pRow[valueIx] = LinearToSRGB8(value, tables);
+						else
+							pRow[valueIx] = (unsigned char)(value * 255.0f + 0.5f);
+						break;
+					case BD_PER_COMP_16:
+						value = std::min(std::max(value, 0.0f), 1.0f);
+						if(bIsSRGB)
+							value = LinearToSRGB(value);
+						((unsigned short *)pRow)[valueIx] = (unsigned short)(value * 65535.0f + 0.5f);
+						break;
+					default:
+						((float *)pRow)[valueIx] = value;
+						break;
+					}
+				}
+			}
+		}
+
+		////////////////////////////////////////////////////////
+		//Alpha coverage.
+
+		size_t CountCoveredTexels( const float *pValues, size_t texelCount, const TexelLayout &layout,
+			float alphaReference )
+		{
+			size_t coveredCount = 0;
+			for(size_t texelIx = 0; texelIx < texelCount; ++texelIx)
+			{
+				if(pValues[texelIx * layout.channelCount + layout.alphaChannel] >= alphaReference)
+					++coveredCount;
+			}
+
+			return coveredCount;
+		}
+
+		//Finds the scale that gives alpha the coverage it has in the base level. The texel at
+		//that coverage's rank is scaled to exactly the reference, so it and those above pass.
+		float FindAlphaScale( const float *pValues, size_t texelCount, const TexelLayout &layout,
+			float alphaReference, float coverage )
+		{
+			std::vector<float> alphas(texelCount);
+			for(size_t texelIx = 0; texelIx < texelCount; ++texelIx)
+				alphas[texelIx] = pValues[texelIx * layout.channelCount + layout.alphaChannel];
+
+			size_t coveredCount = (size_t)(coverage * texelCount + 0.5f);
+			if(coveredCount == 0)
+				return *std::max_element(alphas.begin(), alphas.end()) >= alphaReference ? 0.0f : 1.0f;
+
+			std::nth_element(alphas.begin(), alphas.begin() + (coveredCount - 1), alphas.end(),
+				std::greater<float>());
+			float rankedAlpha = alphas[coveredCount - 1];
+			if(rankedAlpha <= 0.0f)
+				return 1.0f;
+
+			return alphaReference / rankedAlpha;
+		}
+
+		//The size of an image in texels, with one-dimensional images one row high.
+		struct ImageSize
+		{
+			int width;
+			int height;
+
+			ImageSize(const Dimensions &dims)
+				: width(dims.width)
+				, height(dims.numDimensions > 1 ? dims.height : 1)
+			{}
+		};
+	}
+
+	ImageSet *GenerateMipmaps( const ImageSet *pSource, MipmapFilter eFilter, float alphaReference )
+	{
+		ImageFormat fmt = pSource->GetFormat();
+		Dimensions dims = pSource->GetDimensions();
+		TexelLayout layout = GetTexelLayout(fmt, dims);
+		bool bClamp = fmt.Type() == DT_NORM_UNSIGNED_INTEGER;
+		bool bPreserveCoverage = alphaReference > 0.0f && layout.alphaChannel >= 0;
+		size_t texelSize = CalcBytesPerPixel(fmt);
+		int channelCount = layout.channelCount;
+		RowFilterFunc FilterRowFunc = GetRowFilter(channelCount);
+
+		int arrayCount = pSource->GetArrayCount();
+		int faceCount = pSource->GetFaceCount();
+		size_t imageCount = arrayCount * faceCount;
+
+		ImageSize baseSize(dims);
+		int mipmapCount = 1;
+		while((std::max(baseSize.width, baseSize.height) >> mipmapCount) > 0)
+			++mipmapCount;
+
+		std::vector<ImageBuffer> imageData(mipmapCount);
+		std::vector<size_t> imageSizes(mipmapCount);
+		for(int mipmapLevel = 0; mipmapLevel < mipmapCount; ++mipmapLevel)
+		{
+			imageSizes[mipmapLevel] = CalcImageByteSize(fmt, ModifySizeForMipmap(dims, mipmapLevel));
+			imageData[mipmapLevel].resize(imageSizes[mipmapLevel] * imageCount);
+		}
+
+		//The base level is copied as it is. Its rows are read into floats as they are filtered.
+		Executor &executor = GetExecutor();
+		size_t baseLineSize = fmt.AlignByteCount(texelSize * baseSize.width);
+		std::vector<const unsigned char *> baseImages(imageCount);
+		for(int arrayIx = 0; arrayIx < arrayCount; ++arrayIx)
+		{
+			for(int faceIx = 0; faceIx < faceCount; ++faceIx)
+			{
+				size_t imageIx = arrayIx * faceCount + faceIx;
+				baseImages[imageIx] = (const unsigned char *)pSource->GetImage(0, arrayIx, faceIx).GetImageData();
+				memcpy(&imageData[0][0] + imageIx * imageSizes[0], baseImages[imageIx], imageSizes[0]);
+			}
+		}
+
+		std::vector<float> baseCoverages(imageCount);
+		if(bPreserveCoverage)
+		{
+			detail::ParallelFor(executor, imageCount, 1, [&](size_t beginImage, size_t endImage)
+			{
+				std::vector<float> baseRow(baseSize.width * channelCount);
+				for(size_t imageIx = beginImage; imageIx < endImage; ++imageIx)
+				{
+					size_t coveredCount = 0;
+					for(int y = 0; y < baseSize.height; ++y)
+					{
+						LoadRow(baseImages[imageIx] + y * baseLineSize, layout, baseSize.width, &baseRow[0]);
+						coveredCount += CountCoveredTexels(&baseRow[0], baseSize.width, layout, alphaReference);
+					}
+					baseCoverages[imageIx] = coveredCount / (float)((size_t)baseSize.width * baseSize.height);
+				}
+			});
+		}
+
+		ImageSize sourceSize = baseSize;
+		std::vector<float> levelValues;
+		std::vector<float> rowFiltered;
+		std::vector<float> destValues;
+		std::vector<float> alphaScales(imageCount, 1.0f);
+		for(int mipmapLevel = 1; mipmapLevel < mipmapCount; ++mipmapLevel)
+		{
+			ImageSize destSize(ModifySizeForMipmap(dims, mipmapLevel));
+			FilterTaps columnTaps = BuildFilterTaps(sourceSize.width, destSize.width, eFilter);
+			FilterTaps rowTaps = BuildFilterTaps(sourceSize.height, destSize.height, eFilter);
+
+			//Filter along the rows, then down the columns of the narrowed rows.
+			size_t sourceImageValueCount = (size_t)sourceSize.width * sourceSize.height * channelCount;
+			size_t narrowRowValueCount = (size_t)destSize.width * channelCount;
+			size_t narrowImageValueCount = narrowRowValueCount * sourceSize.height;
+			rowFiltered.resize(narrowImageValueCount * imageCount);
+			detail::ParallelFor(executor, imageCount * sourceSize.height, MIN_ROWS_PER_TASK,
+				[&](size_t beginRow, size_t endRow)
+			{
+				std::vector<float> baseRow;
+				for(size_t rowIx = beginRow; rowIx < endRow; ++rowIx)
+				{
+					size_t imageIx = rowIx / sourceSize.height;
+					size_t y = rowIx % sourceSize.height;
+
+					const float *pSourceRow;
+					if(mipmapLevel == 1)
+					{
+						baseRow.resize(baseSize.width * channelCount);
+						LoadRow(baseImages[imageIx] + y * baseLineSize, layout, baseSize.width, &baseRow[0]);
+						pSourceRow = &baseRow[0];
+					}
+					else
+						pSourceRow = &levelValues[imageIx * sourceImageValueCount + y * sourceSize.width * channelCount];
+
+					FilterRowFunc(pSourceRow, columnTaps, destSize.width,
+						&rowFiltered[imageIx * narrowImageValueCount + y * narrowRowValueCount]);
+				}
+			});
+
+			size_t destImageValueCount = narrowRowValueCount * destSize.height;
+			destValues.resize(destImageValueCount * imageCount);
+			detail::ParallelFor(executor, imageCount * destSize.height, MIN_ROWS_PER_TASK,
+				[&](size_t beginRow, size_t endRow)
+			{
+				for(size_t rowIx = beginRow; rowIx < endRow; ++rowIx)
+				{
+					size_t imageIx = rowIx / destSize.height;
+					size_t y = rowIx % destSize.height;
+					FilterColumns<detail::SimdOps>(&rowFiltered[imageIx * narrowImageValueCount],
+						narrowRowValueCount, &rowTaps.sourceIndices[y * rowTaps.tapCount],
+						&rowTaps.weights[y * rowTaps.tapCount], rowTaps.tapCount, bClamp,
+						&destValues[imageIx * destImageValueCount + y * narrowRowValueCount]);
+				}
+			});
+
+			if(bPreserveCoverage)
+			{
+				detail::ParallelFor(executor, imageCount, 1, [&](size_t beginImage, size_t endImage)
+				{
+					for(size_t imageIx = beginImage; imageIx < endImage; ++imageIx)
+					{
+						alphaScales[imageIx] = FindAlphaScale(&destValues[imageIx * destImageValueCount],
+							(size_t)destSize.width * destSize.height, layout, alphaReference,
+							baseCoverages[imageIx]);
+					}
+				});
+			}
+
+			//The next level is filtered from these values, before their alpha is scaled.
+			unsigned char *pLevelData = &imageData[mipmapLevel][0];
+			size_t destLineSize = fmt.AlignByteCount(texelSize * destSize.width);
+			size_t destImageSize = imageSizes[mipmapLevel];
+			detail::ParallelFor(executor, imageCount * destSize.height, MIN_ROWS_PER_TASK,
+				[&](size_t beginRow, size_t endRow)
+			{
+				for(size_t rowIx = beginRow; rowIx < endRow; ++rowIx)
+				{
+					size_t imageIx = rowIx / destSize.height;
+					size_t y = rowIx % destSize.height;
+					StoreRow(&destValues[imageIx * destImageValueCount + y * narrowRowValueCount], layout,
+						destSize.width, alphaScales[imageIx],
+						pLevelData + imageIx * destImageSize + y * destLineSize);
+				}
+			});
+
+			levelValues.swap(destValues);
+			sourceSize = destSize;
+		}
+
+		detail::ImageSetImpl *pImageData = new detail::ImageSetImpl(fmt, dims,
+			mipmapCount, arrayCount, faceCount, pSource->IsTopLeft(), imageData, imageSizes);
+		return detail::MakeImageSet(pImageData);
+	}
+}
@@ -0,0 +1,26 @@
+/** Copyright (C) 2011 by Jason L. McKesson **/
+/** This file is licensed by the MIT License. **/
+
+
+
+#ifndef GLIMG_PARALLEL_FOR_H
+#define GLIMG_PARALLEL_FOR_H
+
+#include <functional>
+
+namespace glimg
+{
+	class Executor;
+
+	namespace detail
+	{
+		//Calls func(begin, end) over contiguous ranges covering [0, count), spread across the
+		//executor and the calling thread. Ranges are at least minRangeSize long, except for the
+		//last. Ranges are claimed as threads get to them, and the caller claims them too, so it
+		//only ever waits for ranges already running. The first exception thrown is rethrown.
+		void ParallelFor(Executor &executor, size_t count, size_t minRangeSize,
+			const std::function<void(size_t, size_t)> &func);
+	}
+}
+
+#endif //GLIMG_PARALLEL_FOR_H
@@ -0,0 +1,137 @@
+/** Copyright (C) 2011 by Jason L. McKesson **/
+/** This file is licensed by the MIT License. **/
+
+
+
+#ifndef GLIMG_SIMD_OPS_H
+#define GLIMG_SIMD_OPS_H
+
+#include <math.h>
+
+#if defined(__AVX__)
+#define GLIMG_SIMD_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLIMG_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace glimg
+{
+	namespace detail
+	{
+		//The operations the pixel kernels are written in, so each is written once for every
+		//vector width. SimdOps is the widest the compiler was allowed to use.
+		struct ScalarOps
+		{
+			typedef float Floats;
+			typedef bool Mask;
+			enum {LANES = 1};
+
+			static Floats Load(const float *pValues) {return *pValues;}
+			static void Store(float *pValues, Floats values) {*pValues = values;}
+			static Floats Set(float value) {return value;}
+			static Floats Add(Floats a, Floats b) {return a + b;}
+			static Floats Sub(Floats a, Floats b) {return a - b;}
+			static Floats Mul(Floats a, Floats b) {return a * b;}
+			static Floats Min(Floats a, Floats b) {return a < b ? a : b;}
+			static Floats Max(Floats a, Floats b) {return a > b ? a : b;}
+			static Mask Less(Floats a, Floats b) {return a < b;}
+			static Floats Select(Mask mask, Floats a, Floats b) {return mask ? a : b;}
+			static float Sum(Floats values) {return values;}
+			static float ReduceMin(Floats values) {return values;}
+			static float ReduceMax(Floats values) {return values;}
+		};
+
+#ifdef GLIMG_SIMD_AVX
+		struct SimdOps
+		{
+			typedef __m256 Floats;
+			typedef __m256 Mask;
+			enum {LANES = 8};
+
+			static Floats Load(const float *pValues) {return _mm256_loadu_ps(pValues);}
+			static void Store(float *pValues, Floats values) {_mm256_storeu_ps(pValues, values);}
+			static Floats Set(float value) {return _mm256_set1_ps(value);}
+			static Floats Add(Floats a, Floats b) {return _mm256_add_ps(a, b);}
+			static Floats Sub(Floats a, Floats b) {return _mm256_sub_ps(a, b);}
+			static Floats Mul(Floats a, Floats b) {return _mm256_mul_ps(a, b);}
+			static Floats Min(Floats a, Floats b) {return _mm256_min_ps(a, b);}
+			static Floats Max(Floats a, Floats b) {return _mm256_max_ps(a, b);}
+			static Mask Less(Floats a, Floats b) {return _mm256_cmp_ps(a, b, _CMP_LT_OQ);}
+
+			//Not blendv: compilers may rewrite it as a sign test, which AVX without AVX2 has to
+			//do a lane at a time.
+			static Floats Select(Mask mask, Floats a, Floats b)
+			{
+				return _mm256_or_ps(_mm256_and_ps(mask, a), _mm256_andnot_ps(mask, b));
+			}
+
+			static float Sum(Floats values)
+			{
+				__m128 half = _mm_add_ps(_mm256_castps256_ps128(values), _mm256_extractf128_ps(values, 1));
+				half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+				return _mm_cvtss_f32(_mm_add_ss(half, _mm_shuffle_ps(half, half, 1)));
+			}
+
+			static float ReduceMin(Floats values)
+			{
+				__m128 half = _mm_min_ps(_mm256_castps256_ps128(values), _mm256_extractf128_ps(values, 1));
+				half = _mm_min_ps(half, _mm_movehl_ps(half, half));
+				return _mm_cvtss_f32(_mm_min_ss(half, _mm_shuffle_ps(half, half, 1)));
+			}
+
+			static float ReduceMax(Floats values)
+			{
+				__m128 half = _mm_max_ps(_mm256_castps256_ps128(values), _mm256_extractf128_ps(values, 1));
+				half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+				return _mm_cvtss_f32(_mm_max_ss(half, _mm_shuffle_ps(half, half, 1)));
+			}
+		};
+#elif defined(GLIMG_SIMD_SSE2)
+		struct SimdOps
+		{
+			typedef __m128 Floats;
+			typedef __m128 Mask;
+			enum {LANES = 4};
+
+			static Floats Load(const float *pValues) {return _mm_loadu_ps(pValues);}
+			static void Store(float *pValues, Floats values) {_mm_storeu_ps(pValues, values);}
+			static Floats Set(float value) {return _mm_set1_ps(value);}
+			static Floats Add(Floats a, Floats b) {return _mm_add_ps(a, b);}
+			static Floats Sub(Floats a, Floats b) {return _mm_sub_ps(a, b);}
+			static Floats Mul(Floats a, Floats b) {return _mm_mul_ps(a, b);}
+			static Floats Min(Floats a, Floats b) {return _mm_min_ps(a, b);}
+			static Floats Max(Floats a, Floats b) {return _mm_max_ps(a, b);}
+			static Mask Less(Floats a, Floats b) {return _mm_cmplt_ps(a, b);}
+
+			static Floats Select(Mask mask, Floats a, Floats b)
+			{
+				return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+			}
+
+			static float Sum(Floats values)
+			{
+				values = _mm_add_ps(values, _mm_movehl_ps(values, values));
+				return _mm_cvtss_f32(_mm_add_ss(values, _mm_shuffle_ps(values, values, 1)));
+			}
+
+			static float ReduceMin(Floats values)
+			{
+				values = _mm_min_ps(values, _mm_movehl_ps(values, values));
+				return _mm_cvtss_f32(_mm_min_ss(values, _mm_shuffle_ps(values, values, 1)));
+			}
+
+			static float ReduceMax(Floats values)
+			{
+				values = _mm_max_ps(values, _mm_movehl_ps(values, values));
+				return _mm_cvtss_f32(_mm_max_ss(values, _mm_shuffle_ps(values, values, 1)));
+			}
+		};
+#else
+		typedef ScalarOps SimdOps;
+#endif
+	}
+}
+
+#endif //GLIMG_SIMD_OPS_H
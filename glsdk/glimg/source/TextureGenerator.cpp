@@ -4,10 +4,12 @@
 
 
 #include <assert.h>
+#include <memory>
 #include <glload/gl_all.hpp>
 #include <glload/gll.hpp>
 #include "glimg/TextureGeneratorExceptions.h"
 #include "glimg/TextureGenerator.h"
+#include "glimg/BlockDecompressor.h"
 #include "ImageSetImpl.h"
 #include "Util.h"
 
@@ -586,7 +588,7 @@ namespace glimg
 
 			case DT_COMPRESSED_SIGNED_BC6H:
 				ThrowIfBPTCNotSupported();
-				return gl::GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB;
+				return gl::GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT_ARB;
 
 			case DT_COMPRESSED_BC7:
 				ThrowIfBPTCNotSupported();
@@ -1106,6 +1108,39 @@ namespace glimg
 			}
 		}
 
+		//For 1D, 2D arrays, and array/cubemap. The layers are one more dimension.
+		//Texture must be bound to the target.
+		void TexStorageArray( GLenum texTarget, Dimensions dims, GLuint numMipmaps, GLuint layerCount,
+			GLenum internalFormat )
+		{
+			if(dims.numDimensions == 1)
+				gl::TexStorage2D(texTarget, numMipmaps, internalFormat, dims.width, layerCount);
+			else
+				gl::TexStorage3D(texTarget, numMipmaps, internalFormat, dims.width, dims.height, layerCount);
+		}
+
+		void TexStorageArray( GLuint texture, GLenum texTarget, Dimensions dims, GLuint numMipmaps,
+			GLuint layerCount, GLenum internalFormat )
+		{
+			//Zero means bound, so no DSA.
+			if(texture == 0)
+			{
+				TexStorageArray(texTarget, dims, numMipmaps, layerCount, internalFormat);
+				return;
+			}
+
+			if(dims.numDimensions == 1)
+			{
+				gl::TextureStorage2DEXT(texture, texTarget, numMipmaps, internalFormat,
+					dims.width, layerCount);
+			}
+			else
+			{
+				gl::TextureStorage3DEXT(texture, texTarget, numMipmaps, internalFormat,
+					dims.width, dims.height, layerCount);
+			}
+		}
+
 		//Only works for TEXTURE_1D, 2D, and 3D.
 		//Texture must be bound to the target.
 		void ManTexStorageBase(GLenum texTarget, Dimensions dims, GLuint numMipmaps, GLenum internalFormat,
@@ -1125,16 +1160,17 @@ namespace glimg
 						upload.format, upload.type, NULL);
 					break;
 				case 3:
-					gl::TexImage1D(texTarget, mipmap, internalFormat, levelDims.width, 0,
-						upload.format, upload.type, NULL);
+					gl::TexImage3D(texTarget, mipmap, internalFormat, levelDims.width, levelDims.height,
+						levelDims.depth, 0, upload.format, upload.type, NULL);
 					break;
 				}
 			}
 		}
 
 		//For 1D, 2D arrays, and array/cubemap
+		//The layer count includes the faces, so it is 6 times the array count for cubemap arrays.
 		//Texture must be bound to the target.
-		void ManTexStorageArray(GLenum texTarget, Dimensions dims, GLuint numMipmaps, GLuint arrayCount,
+		void ManTexStorageArray(GLenum texTarget, Dimensions dims, GLuint numMipmaps, GLuint layerCount,
 			GLenum internalFormat, const OpenGLPixelTransferParams &upload)
 		{
 			for(GLuint mipmap = 0; mipmap < numMipmaps; ++mipmap)
@@ -1143,14 +1179,11 @@ namespace glimg
 				switch(dims.numDimensions)
 				{
 				case 1:
-					gl::TexImage2D(texTarget, mipmap, internalFormat, levelDims.width, arrayCount, 0,
+					gl::TexImage2D(texTarget, mipmap, internalFormat, levelDims.width, layerCount, 0,
 						upload.format, upload.type, NULL);
 					break;
 				case 2:
-					if(texTarget == gl::GL_TEXTURE_CUBE_MAP_ARRAY)
-						arrayCount *= 6;
-
-					gl::TexImage3D(texTarget, mipmap, internalFormat, levelDims.width, levelDims.height, arrayCount,
+					gl::TexImage3D(texTarget, mipmap, internalFormat, levelDims.width, levelDims.height, layerCount,
 						0, upload.format, upload.type, NULL);
 					break;
 				}
@@ -1206,8 +1239,8 @@ namespace glimg
 						upload.format, upload.type, NULL);
 					break;
 				case 3:
-					gl::TextureImage1DEXT(texture, texTarget, mipmap, internalFormat, levelDims.width, 0,
-						upload.format, upload.type, NULL);
+					gl::TextureImage3DEXT(texture, texTarget, mipmap, internalFormat, levelDims.width,
+						levelDims.height, levelDims.depth, 0, upload.format, upload.type, NULL);
 					break;
 				}
 			}
@@ -1216,12 +1249,12 @@ namespace glimg
 		//For 1D, 2D arrays, and array/cubemap
 		//DSA-style
 		void ManTexStorageArray(GLuint texture, GLenum texTarget, Dimensions dims, GLuint numMipmaps,
-			GLuint arrayCount, GLenum internalFormat, const OpenGLPixelTransferParams &upload)
+			GLuint layerCount, GLenum internalFormat, const OpenGLPixelTransferParams &upload)
 		{
 			//Zero means bound, so no DSA.
 			if(texture == 0)
 			{
-				ManTexStorageArray(texTarget, dims, numMipmaps, arrayCount, internalFormat, upload);
+				ManTexStorageArray(texTarget, dims, numMipmaps, layerCount, internalFormat, upload);
 				return;
 			}
 
@@ -1231,12 +1264,12 @@ namespace glimg
 				switch(dims.numDimensions)
 				{
 				case 1:
-					gl::TextureImage2DEXT(texture, texTarget, mipmap, internalFormat, levelDims.width, arrayCount, 0,
+					gl::TextureImage2DEXT(texture, texTarget, mipmap, internalFormat, levelDims.width, layerCount, 0,
 						upload.format, upload.type, NULL);
 					break;
 				case 2:
 					gl::TextureImage3DEXT(texture, texTarget, mipmap, internalFormat, levelDims.width,
-						levelDims.height, arrayCount, 0, upload.format, upload.type, NULL);
+						levelDims.height, layerCount, 0, upload.format, upload.type, NULL);
 					break;
 				}
 			}
@@ -1358,6 +1391,72 @@ namespace glimg
 			}
 		}
 
+		//Uploads one layer of an array texture: a row of a 1D array, or a slice of the others.
+		//Texture must be bound to the target.
+		void TexSubImageLayer(GLenum texTarget, GLuint mipmap, GLuint internalFormat,
+			Dimensions dims, GLint layer, const OpenGLPixelTransferParams &upload,
+			const void *pPixelData, size_t pixelByteSize)
+		{
+			if(dims.numDimensions == 1)
+			{
+				if(upload.blockByteCount)
+					gl::CompressedTexSubImage2D(texTarget, mipmap, 0, layer,
+					dims.width, 1,
+					internalFormat, pixelByteSize, pPixelData);
+				else
+					gl::TexSubImage2D(texTarget, mipmap, 0, layer,
+					dims.width, 1,
+					upload.format, upload.type, pPixelData);
+			}
+			else
+			{
+				if(upload.blockByteCount)
+					gl::CompressedTexSubImage3D(texTarget, mipmap, 0, 0, layer,
+					dims.width, dims.height, 1,
+					internalFormat, pixelByteSize, pPixelData);
+				else
+					gl::TexSubImage3D(texTarget, mipmap, 0, 0, layer,
+					dims.width, dims.height, 1,
+					upload.format, upload.type, pPixelData);
+			}
+		}
+
+		void TexSubImageLayer(GLuint texture, GLenum texTarget, GLuint mipmap, GLuint internalFormat,
+			Dimensions dims, GLint layer, const OpenGLPixelTransferParams &upload,
+			const void *pPixelData, size_t pixelByteSize)
+		{
+			//Zero means bound, so no DSA.
+			if(texture == 0)
+			{
+				TexSubImageLayer(texTarget, mipmap, internalFormat, dims, layer, upload,
+					pPixelData, pixelByteSize);
+				return;
+			}
+
+			if(dims.numDimensions == 1)
+			{
+				if(upload.blockByteCount)
+					gl::CompressedTextureSubImage2DEXT(texture, texTarget, mipmap, 0, layer,
+					dims.width, 1,
+					internalFormat, pixelByteSize, pPixelData);
+				else
+					gl::TextureSubImage2DEXT(texture, texTarget, mipmap, 0, layer,
+					dims.width, 1,
+					upload.format, upload.type, pPixelData);
+			}
+			else
+			{
+				if(upload.blockByteCount)
+					gl::CompressedTextureSubImage3DEXT(texture, texTarget, mipmap, 0, 0, layer,
+					dims.width, dims.height, 1,
+					internalFormat, pixelByteSize, pPixelData);
+				else
+					gl::TextureSubImage3DEXT(texture, texTarget, mipmap, 0, 0, layer,
+					dims.width, dims.height, 1,
+					upload.format, upload.type, pPixelData);
+			}
+		}
+
 		enum
 		{
 			NO_DSA_NO_STORAGE,
@@ -1390,6 +1489,20 @@ namespace glimg
 			}
 		}
 
+		//For 1D, 2D arrays, and array/cubemap.
+		void TexStorageArrayLayers( GLenum texTarget, unsigned int forceConvertBits, Dimensions dims,
+			const int numMipmaps, GLuint layerCount, GLuint internalFormat,
+			const OpenGLPixelTransferParams & upload, GLuint textureName )
+		{
+			if(forceConvertBits & USE_TEXTURE_STORAGE)
+				TexStorageArray(textureName, texTarget, dims, numMipmaps, layerCount, internalFormat);
+			else
+			{
+				ManTexStorageArray(textureName, texTarget, dims, numMipmaps, layerCount,
+					internalFormat, upload);
+			}
+		}
+
 		void TexStorageCube( GLenum texTarget, unsigned int forceConvertBits, Dimensions dims,
 			const int numMipmaps, GLuint internalFormat, const OpenGLPixelTransferParams & upload,
 			GLuint textureName )
@@ -1420,11 +1533,51 @@ namespace glimg
 			GLenum texTarget;
 		};
 
+		//For 1D, 2D arrays, and array/cubemap. Each array image's faces are consecutive layers,
+		//as ARB_texture_cube_map_array lays them out.
+		void BuildArrayTexture(GLenum texTarget, unsigned int textureName, const detail::ImageSetImpl *pImage,
+			unsigned int forceConvertBits, GLuint internalFormat, const OpenGLPixelTransferParams &upload)
+		{
+			SetupUploadState(pImage->GetFormat(), forceConvertBits);
+			TextureBinder bind;
+			if(!(forceConvertBits & USE_DSA))
+			{
+				bind.Bind(texTarget, textureName);
+				textureName = 0;
+			}
+
+			const int numMipmaps = pImage->GetMipmapCount();
+			const int numArrays = pImage->GetArrayCount();
+			const int numFaces = pImage->GetFaceCount();
+			TexStorageArrayLayers(texTarget, forceConvertBits, pImage->GetDimensions(),
+				numMipmaps, numArrays * numFaces, internalFormat, upload, textureName);
+
+			for(int mipmap = 0; mipmap < numMipmaps; mipmap++)
+			{
+				Dimensions dims = pImage->GetDimensions(mipmap);
+
+				for(int arrayIx = 0; arrayIx < numArrays; ++arrayIx)
+				{
+					for(int faceIx = 0; faceIx < numFaces; ++faceIx)
+					{
+						const void *pPixelData = pImage->GetImageData(mipmap, arrayIx, faceIx);
+
+						TexSubImageLayer(textureName, texTarget, mipmap, internalFormat, dims,
+							(arrayIx * numFaces) + faceIx, upload,
+							pPixelData, pImage->GetImageByteSize(mipmap));
+					}
+				}
+			}
+
+			FinalizeTexture(textureName, texTarget, pImage);
+		}
+
 		void Build1DArrayTexture(unsigned int textureName, const detail::ImageSetImpl *pImage,
 			unsigned int forceConvertBits, GLuint internalFormat, const OpenGLPixelTransferParams &upload)
 		{
 			ThrowIfArrayTextureNotSupported();
-			throw TextureUnexpectedException();
+			BuildArrayTexture(gl::GL_TEXTURE_1D_ARRAY, textureName, pImage, forceConvertBits,
+				internalFormat, upload);
 		}
 
 		void Build1DTexture(unsigned int textureName, const detail::ImageSetImpl *pImage,
@@ -1459,14 +1612,16 @@ namespace glimg
 		{
 			ThrowIfArrayTextureNotSupported();
 			ThrowIfCubeArrayTextureNotSupported();
-			throw TextureUnexpectedException();
+			BuildArrayTexture(gl::GL_TEXTURE_CUBE_MAP_ARRAY, textureName, pImage, forceConvertBits,
+				internalFormat, upload);
 		}
 
 		void Build2DArrayTexture(unsigned int textureName, const detail::ImageSetImpl *pImage,
 			unsigned int forceConvertBits, GLuint internalFormat, const OpenGLPixelTransferParams &upload)
 		{
 			ThrowIfArrayTextureNotSupported();
-			throw TextureUnexpectedException();
+			BuildArrayTexture(gl::GL_TEXTURE_2D_ARRAY, textureName, pImage, forceConvertBits,
+				internalFormat, upload);
 		}
 
 		void Build2DCubeTexture(unsigned int textureName, const detail::ImageSetImpl *pImage,
@@ -1654,6 +1809,29 @@ namespace glimg
 		}
 
 		const ImageFormat &format = pImage->GetFormat();
+
+		//Block-compressed formats the implementation cannot take are decoded and uploaded as
+		//the uncompressed format they decode to.
+		if(format.Type() >= DT_NUM_UNCOMPRESSED_TYPES && pImage->GetDimensions().numDimensions == 2)
+		{
+			bool bIsSupported = true;
+			try
+			{
+				GetInternalFormat(format, forceConvertBits);
+			}
+			catch(ImageFormatUnsupportedException &)
+			{
+				bIsSupported = false;
+			}
+
+			if(!bIsSupported)
+			{
+				std::auto_ptr<ImageSet> pDecoded(DecompressImageSet(pImage));
+				CreateTexture(textureName, pDecoded.get(), forceConvertBits);
+				return;
+			}
+		}
+
 		GLuint internalFormat = GetInternalFormat(format, forceConvertBits);
 		OpenGLPixelTransferParams upload = GetUploadFormatType(format, forceConvertBits);
 
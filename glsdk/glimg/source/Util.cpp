@@ -4,6 +4,7 @@
 
 
 #include <assert.h>
+#include <algorithm>
 #include "ImageSetImpl.h"
 #include "Util.h"
 
@@ -47,11 +48,12 @@ namespace glimg
 
 	Dimensions ModifySizeForMipmap(Dimensions origDim, int mipmapLevel)
 	{
+		//No dimension goes below 1.
 		for(int iLoop = 0; iLoop < mipmapLevel; iLoop++)
 		{
-			origDim.width /= 2;
-			origDim.height /= 2;
-			origDim.depth /= 2;
+			origDim.width = std::max(origDim.width / 2, 1);
+			origDim.height = std::max(origDim.height / 2, 1);
+			origDim.depth = std::max(origDim.depth / 2, 1);
 		}
 
 		return origDim;
@@ -0,0 +1,357 @@
+//Copyright (C) 2011 by Jason L. McKesson
+//This file is licensed by the MIT License.
+
+
+
+//Checks the DDS loader against the files that MakeDdsCorpus.py writes. Every file in dds/good
+//must load through LoadFromFile, MapFromFile and LoadFromMemory as the table below says, with
+//its images where the file has them: as they are when the ImageSet is top-left, or with their
+//rows reversed when it is not. Every file in dds/bad must be rejected with the listed
+//exception. Needs no OpenGL context.
+//Usage: glimgDdsTest [corpus directory, default "dds"]
+//Prints each failure and exits with 1 if there were any.
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <exception>
+#include "glimg/ImageSet.h"
+#include "glimg/DdsLoader.h"
+
+#define ARRAY_COUNT( array ) (sizeof( array ) / (sizeof( array[0] ) * (sizeof( array ) != sizeof(void*) || sizeof( array[0] ) <= sizeof(void*))))
+
+using namespace glimg;
+
+namespace
+{
+	const size_t DDS_DATA_OFFSET = 4 + 124;
+	const size_t DX10_DATA_OFFSET = DDS_DATA_OFFSET + 20;
+
+	struct GoodFile
+	{
+		const char *filename;
+		int numDimensions;
+		int width;
+		int height;
+		int depth;
+		int arrayCount;
+		int faceCount;
+		int mipmapCount;
+		PixelDataType eType;
+		PixelComponents eFormat;
+		ComponentOrder eOrder;
+		Bitdepth eBitdepth;
+		size_t dataOffset;
+	};
+
+	const GoodFile g_goodFiles[] =
+	{
+		{"bc7_array.dds",		2, 16, 16, 1, 3, 1, 5, DT_COMPRESSED_BC7, FMT_COLOR_RGBA, ORDER_COMPRESSED, BD_COMPRESSED, DX10_DATA_OFFSET},
+		{"bc7_srgb.dds",		2, 16, 16, 1, 1, 1, 5, DT_COMPRESSED_BC7, FMT_COLOR_RGBA_sRGB, ORDER_COMPRESSED, BD_COMPRESSED, DX10_DATA_OFFSET},
+		{"bc6h_uf16.dds",		2, 16, 16, 1, 1, 1, 5, DT_COMPRESSED_UNSIGNED_BC6H, FMT_COLOR_RGB, ORDER_COMPRESSED, BD_COMPRESSED, DX10_DATA_OFFSET},
+		{"bc6h_sf16.dds",		2, 16, 16, 1, 1, 1, 5, DT_COMPRESSED_SIGNED_BC6H, FMT_COLOR_RGB, ORDER_COMPRESSED, BD_COMPRESSED, DX10_DATA_OFFSET},
+		{"bc1_npot.dds",		2, 33, 17, 1, 1, 1, 6, DT_COMPRESSED_BC1, FMT_COLOR_RGBA, ORDER_COMPRESSED, BD_COMPRESSED, DX10_DATA_OFFSET},
+		{"bc1_srgb.dds",		2, 16, 16, 1, 1, 1, 5, DT_COMPRESSED_BC1, FMT_COLOR_RGBA_sRGB, ORDER_COMPRESSED, BD_COMPRESSED, DX10_DATA_OFFSET},
+		{"bc3_srgb_array.dds",	2, 16, 16, 1, 2, 1, 5, DT_COMPRESSED_BC3, FMT_COLOR_RGBA_sRGB, ORDER_COMPRESSED, BD_COMPRESSED, DX10_DATA_OFFSET},
+		{"bc4_snorm.dds",		2, 16, 16, 1, 1, 1, 5, DT_COMPRESSED_SIGNED_BC4, FMT_COLOR_RED, ORDER_COMPRESSED, BD_COMPRESSED, DX10_DATA_OFFSET},
+		{"bc5_unorm.dds",		2, 16, 16, 1, 1, 1, 5, DT_COMPRESSED_UNSIGNED_BC5, FMT_COLOR_RG, ORDER_COMPRESSED, BD_COMPRESSED, DX10_DATA_OFFSET},
+		{"rgba8_cube_srgb.dds",	2, 8, 8, 1, 1, 6, 4, DT_NORM_UNSIGNED_INTEGER, FMT_COLOR_RGBA_sRGB, ORDER_RGBA, BD_PER_COMP_8, DX10_DATA_OFFSET},
+		{"rgba8_cube_array.dds",	2, 8, 8, 1, 2, 6, 4, DT_NORM_UNSIGNED_INTEGER, FMT_COLOR_RGBA, ORDER_RGBA, BD_PER_COMP_8, DX10_DATA_OFFSET},
+		{"rg16f_1d_array.dds",	1, 32, 1, 1, 4, 1, 6, DT_FLOAT, FMT_COLOR_RG, ORDER_RGBA, BD_PER_COMP_16, DX10_DATA_OFFSET},
+		{"bgra8_srgb.dds",		2, 16, 8, 1, 1, 1, 5, DT_NORM_UNSIGNED_INTEGER, FMT_COLOR_RGBA_sRGB, ORDER_BGRA, BD_PER_COMP_8, DX10_DATA_OFFSET},
+		{"r32f.dds",			2, 8, 8, 1, 1, 1, 4, DT_FLOAT, FMT_COLOR_RED, ORDER_RGBA, BD_PER_COMP_32, DX10_DATA_OFFSET},
+		{"rgba16_unorm.dds",	2, 8, 8, 1, 1, 1, 4, DT_NORM_UNSIGNED_INTEGER, FMT_COLOR_RGBA, ORDER_RGBA, BD_PER_COMP_16, DX10_DATA_OFFSET},
+		{"b5g6r5.dds",			2, 8, 8, 1, 1, 1, 4, DT_NORM_UNSIGNED_INTEGER, FMT_COLOR_RGB, ORDER_RGBA, BD_PACKED_16_BIT_565, DX10_DATA_OFFSET},
+		{"b5g5r5a1.dds",		2, 8, 8, 1, 1, 1, 4, DT_NORM_UNSIGNED_INTEGER, FMT_COLOR_RGBA, ORDER_BGRA, BD_PACKED_16_BIT_1555_REV, DX10_DATA_OFFSET},
+		{"rgb10a2.dds",			2, 8, 8, 1, 1, 1, 4, DT_NORM_UNSIGNED_INTEGER, FMT_COLOR_RGBA, ORDER_RGBA, BD_PACKED_32_BIT_2101010_REV, DX10_DATA_OFFSET},
+		{"r8_3d.dds",			3, 8, 8, 4, 1, 1, 4, DT_NORM_UNSIGNED_INTEGER, FMT_COLOR_RED, ORDER_RGBA, BD_PER_COMP_8, DX10_DATA_OFFSET},
+		{"legacy_dxt1.dds",		2, 64, 32, 1, 1, 1, 7, DT_COMPRESSED_BC1, FMT_COLOR_RGB, ORDER_COMPRESSED, BD_COMPRESSED, DDS_DATA_OFFSET},
+		{"legacy_rgba.dds",		2, 16, 8, 1, 1, 1, 5, DT_NORM_UNSIGNED_INTEGER, FMT_COLOR_RGBA, ORDER_RGBA, BD_PER_COMP_8, DDS_DATA_OFFSET},
+		{"legacy_cube.dds",		2, 8, 8, 1, 1, 6, 4, DT_NORM_UNSIGNED_INTEGER, FMT_COLOR_RGBA, ORDER_RGBA, BD_PER_COMP_8, DDS_DATA_OFFSET},
+	};
+
+	enum ExpectedError
+	{
+		MALFORMED,
+		UNSUPPORTED,
+	};
+
+	struct BadFile
+	{
+		const char *filename;
+		ExpectedError eError;
+		const char *message;
+	};
+
+	const BadFile g_badFiles[] =
+	{
+		{"header_size.dds",				MALFORMED,		"The header has the wrong size."},
+		{"pixel_format_size.dds",		MALFORMED,		"The pixel format has the wrong size."},
+		{"no_magic.dds",				MALFORMED,		"The Magic number is missing from the file."},
+		{"too_small.dds",				MALFORMED,		"The data is way too small to store actual information."},
+		{"zero_width.dds",				MALFORMED,		"The width is zero or too large."},
+		{"too_many_mipmaps.dds",		MALFORMED,		"There are more mipmaps than the size allows."},
+		{"dx10_cut.dds",				MALFORMED,		"The DX10 header is cut off."},
+		{"buffer_dimension.dds",		MALFORMED,		"The DX10 header's resource dimension is not a texture."},
+		{"array_zero.dds",				MALFORMED,		"The DX10 header's array size is zero."},
+		{"array_too_large.dds",			UNSUPPORTED,	"The array is too large."},
+		{"cube_3d.dds",					MALFORMED,		"Cubemaps must be 2D."},
+		{"volume_array.dds",			MALFORMED,		"3D textures cannot be arrays."},
+		{"typeless.dds",				UNSUPPORTED,	"Could not use the DXGI format 27."},
+		{"d24s8.dds",					UNSUPPORTED,	"Could not use the DXGI format 45."},
+		{"bc7_3d.dds",					UNSUPPORTED,	"Compressed 3D textures are not supported."},
+		{"legacy_partial_cube.dds",		UNSUPPORTED,	"All cubemap faces must be specified."},
+		{"legacy_unknown_format.dds",	UNSUPPORTED,	"Could not use the DDS9's image format."},
+		{"truncated_data.dds",			MALFORMED,		"The data is too small to hold all of its images."},
+	};
+
+	int g_failures = 0;
+
+	void Fail(const std::string &filename, const std::string &what)
+	{
+		printf("FAILED %s: %s\n", filename.c_str(), what.c_str());
+		++g_failures;
+	}
+
+	bool ReadFile(const std::string &filename, std::vector<unsigned char> &contents)
+	{
+		FILE *pFile = fopen(filename.c_str(), "rb");
+		if(!pFile)
+			return false;
+
+		contents.clear();
+		unsigned char buffer[4096];
+		size_t readCount = 0;
+		while((readCount = fread(buffer, 1, sizeof(buffer), pFile)) != 0)
+			contents.insert(contents.end(), buffer, buffer + readCount);
+
+		fclose(pFile);
+		return true;
+	}
+
+	//Mapped images are never flipped. Copied ones are flipped to bottom-left, except for BC6H and
+	//BC7 blocks, which the loader cannot flip.
+	bool IsTopLeftWhenCopied(const GoodFile &file)
+	{
+		return file.eType >= DT_COMPRESSED_UNSIGNED_BC6H;
+	}
+
+	bool DoesImageMatchFile(const SingleImage &image, const unsigned char *pFileImage)
+	{
+		size_t byteCount = image.GetImageByteSize();
+		return memcmp(image.GetImageData(), pFileImage, byteCount) == 0;
+	}
+
+	bool DoesImageMatchFlippedFile(const SingleImage &image, const unsigned char *pFileImage)
+	{
+		Dimensions dims = image.GetDimensions();
+		size_t numLines = dims.NumLines();
+		size_t lineByteSize = image.GetImageByteSize() / numLines;
+		const unsigned char *pImage = static_cast<const unsigned char *>(image.GetImageData());
+		for(size_t line = 0; line < numLines; ++line)
+		{
+			if(memcmp(pImage + line * lineByteSize,
+				pFileImage + (numLines - line - 1) * lineByteSize, lineByteSize) != 0)
+				return false;
+		}
+
+		return true;
+	}
+
+	void CheckGoodImageSet(const GoodFile &file, const std::string &loader, const ImageSet *pImageSet,
+		const std::vector<unsigned char> &contents, bool bTopLeft)
+	{
+		const std::string name = std::string(file.filename) + " (" + loader + ")";
+
+		Dimensions dims = pImageSet->GetDimensions();
+		if(dims.numDimensions != file.numDimensions || dims.width != file.width ||
+			(file.numDimensions > 1 && dims.height != file.height) ||
+			(file.numDimensions > 2 && dims.depth != file.depth))
+			Fail(name, "wrong dimensions");
+
+		if(pImageSet->GetArrayCount() != file.arrayCount)
+			Fail(name, "wrong array count");
+		if(pImageSet->GetFaceCount() != file.faceCount)
+			Fail(name, "wrong face count");
+		if(pImageSet->GetMipmapCount() != file.mipmapCount)
+			Fail(name, "wrong mipmap count");
+
+		ImageFormat fmt = pImageSet->GetFormat();
+		if(fmt.Type() != file.eType)
+			Fail(name, "wrong pixel data type");
+		if(fmt.Components() != file.eFormat)
+			Fail(name, "wrong components or sRGB-ness");
+		if(fmt.Order() != file.eOrder)
+			Fail(name, "wrong component order");
+		if(fmt.Depth() != file.eBitdepth)
+			Fail(name, "wrong bitdepth");
+
+		if(pImageSet->IsTopLeft() != bTopLeft)
+			Fail(name, "wrong orientation");
+
+		//Flipped blocks are not decoded, so only their sizes are checked.
+		const bool bCheckData = bTopLeft || file.eType < DT_NUM_UNCOMPRESSED_TYPES;
+
+		//DDS stores each array element's faces, each with its mipmaps, one after another.
+		size_t offset = file.dataOffset;
+		for(int arrayIx = 0; arrayIx < pImageSet->GetArrayCount(); ++arrayIx)
+		{
+			for(int faceIx = 0; faceIx < pImageSet->GetFaceCount(); ++faceIx)
+			{
+				for(int mipmapLevel = 0; mipmapLevel < pImageSet->GetMipmapCount(); ++mipmapLevel)
+				{
+					SingleImage image = pImageSet->GetImage(mipmapLevel, arrayIx, faceIx);
+					size_t byteCount = image.GetImageByteSize();
+					if(offset + byteCount > contents.size())
+					{
+						Fail(name, "the images are larger than the file's data");
+						return;
+					}
+
+					if(bCheckData && !(bTopLeft ? DoesImageMatchFile(image, &contents[offset]) :
+						DoesImageMatchFlippedFile(image, &contents[offset])))
+					{
+						Fail(name, "an image does not match the file's data");
+						return;
+					}
+
+					offset += byteCount;
+				}
+			}
+		}
+
+		if(offset != contents.size())
+			Fail(name, "the images do not cover the file's data");
+	}
+
+	void CheckGoodFile(const std::string &directory, const GoodFile &file)
+	{
+		const std::string filename = directory + "/" + file.filename;
+		std::vector<unsigned char> contents;
+		if(!ReadFile(filename, contents))
+		{
+			Fail(file.filename, "could not read the file");
+			return;
+		}
+
+		try
+		{
+			std::auto_ptr<ImageSet> pLoaded(loaders::dds::LoadFromFile(filename));
+			CheckGoodImageSet(file, "LoadFromFile", pLoaded.get(), contents, IsTopLeftWhenCopied(file));
+
+			std::auto_ptr<ImageSet> pMapped(loaders::dds::MapFromFile(filename));
+			CheckGoodImageSet(file, "MapFromFile", pMapped.get(), contents, true);
+
+			std::auto_ptr<ImageSet> pFromMemory(loaders::dds::LoadFromMemory(&contents[0], contents.size()));
+			CheckGoodImageSet(file, "LoadFromMemory", pFromMemory.get(), contents, IsTopLeftWhenCopied(file));
+		}
+		catch(std::exception &e)
+		{
+			Fail(file.filename, e.what());
+		}
+	}
+
+	typedef ImageSet *(*LoadFunc)(const std::string &filename, const std::vector<unsigned char> &contents);
+
+	ImageSet *LoadFromFile(const std::string &filename, const std::vector<unsigned char> &)
+	{
+		return loaders::dds::LoadFromFile(filename);
+	}
+
+	ImageSet *MapFromFile(const std::string &filename, const std::vector<unsigned char> &)
+	{
+		return loaders::dds::MapFromFile(filename);
+	}
+
+	ImageSet *LoadFromMemory(const std::string &, const std::vector<unsigned char> &contents)
+	{
+		return loaders::dds::LoadFromMemory(&contents[0], contents.size());
+	}
+
+	void CheckRejected(const BadFile &file, const std::string &loader, LoadFunc load,
+		const std::string &filename, const std::vector<unsigned char> &contents)
+	{
+		const std::string name = std::string(file.filename) + " (" + loader + ")";
+
+		bool bRightType = false;
+		std::string message;
+		try
+		{
+			delete load(filename, contents);
+			Fail(name, "loaded");
+			return;
+		}
+		catch(loaders::dds::DdsFileMalformedException &e)
+		{
+			bRightType = file.eError == MALFORMED;
+			message = e.what();
+		}
+		catch(loaders::dds::DdsFileUnsupportedException &e)
+		{
+			bRightType = file.eError == UNSUPPORTED;
+			message = e.what();
+		}
+		catch(std::exception &e)
+		{
+			message = e.what();
+		}
+
+		if(!bRightType || message.find(file.message) == std::string::npos)
+			Fail(name, "threw the wrong exception: " + message);
+	}
+
+	void CheckBadFile(const std::string &directory, const BadFile &file)
+	{
+		const std::string filename = directory + "/" + file.filename;
+		std::vector<unsigned char> contents;
+		if(!ReadFile(filename, contents))
+		{
+			Fail(file.filename, "could not read the file");
+			return;
+		}
+
+		CheckRejected(file, "LoadFromFile", LoadFromFile, filename, contents);
+		CheckRejected(file, "MapFromFile", MapFromFile, filename, contents);
+		CheckRejected(file, "LoadFromMemory", LoadFromMemory, filename, contents);
+	}
+
+	void CheckMissingFile(const std::string &directory)
+	{
+		const std::string filename = directory + "/missing.dds";
+		LoadFunc loads[] = {LoadFromFile, MapFromFile};
+		for(size_t loadIx = 0; loadIx < ARRAY_COUNT(loads); ++loadIx)
+		{
+			try
+			{
+				delete loads[loadIx](filename, std::vector<unsigned char>());
+				Fail("missing.dds", "loaded");
+			}
+			catch(loaders::dds::DdsFileNotFoundException &)
+			{
+			}
+			catch(std::exception &e)
+			{
+				Fail("missing.dds", std::string("threw the wrong exception: ") + e.what());
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const std::string corpus = argc > 1 ? argv[1] : "dds";
+
+	for(size_t fileIx = 0; fileIx < ARRAY_COUNT(g_goodFiles); ++fileIx)
+		CheckGoodFile(corpus + "/good", g_goodFiles[fileIx]);
+
+	for(size_t fileIx = 0; fileIx < ARRAY_COUNT(g_badFiles); ++fileIx)
+		CheckBadFile(corpus + "/bad", g_badFiles[fileIx]);
+
+	CheckMissingFile(corpus);
+
+	printf("%d good files, %d bad files, %d failures.\n", (int)ARRAY_COUNT(g_goodFiles),
+		(int)ARRAY_COUNT(g_badFiles), g_failures);
+	return g_failures == 0 ? 0 : 1;
+}
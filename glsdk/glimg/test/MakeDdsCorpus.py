@@ -0,0 +1,131 @@
+#Writes the DDS files that DdsCorpusTest checks, into dds/good and dds/bad.
+#The image data is random but seeded, so running this again writes the same files.
+#Usage: python3 MakeDdsCorpus.py [output directory, default "dds"]
+
+import os
+import random
+import struct
+import sys
+
+DDSD_CAPS, DDSD_HEIGHT, DDSD_WIDTH = 0x1, 0x2, 0x4
+DDSD_PIXELFORMAT, DDSD_MIPMAPCOUNT, DDSD_DEPTH = 0x1000, 0x20000, 0x800000
+DDPF_ALPHAPIXELS, DDPF_FOURCC, DDPF_RGB = 0x1, 0x4, 0x40
+DDSCAPS_TEXTURE = 0x1000
+DDSCAPS2_CUBEMAP_ALL, DDSCAPS2_VOLUME = 0xfe00, 0x200000
+DDS10_FOUR_CC, DXT1_FOUR_CC = 0x30314458, 0x31545844
+DDS_RESOURCE_MISC_TEXTURECUBE = 0x4
+
+BUFFER, TEX1D, TEX2D, TEX3D = 1, 2, 3, 4
+
+RGBA8_LEGACY_PF = (32, DDPF_RGB | DDPF_ALPHAPIXELS, 0, 32, 0xff, 0xff00, 0xff0000, 0xff000000)
+
+rng = random.Random(7)
+
+def ImageSize(width, height, depth, blockBytes, pixelBytes):
+	if blockBytes:
+		return ((width + 3) // 4) * ((height + 3) // 4) * blockBytes
+	return width * height * depth * pixelBytes
+
+def WriteDds(filename, width, height, mipmaps, dxgi=None, fourCC=None, legacyPf=None,
+	arraySize=1, cube=False, dimension=TEX2D, depth=1, pixelBytes=4, blockBytes=0,
+	headerSize=124, pfSize=32, caps2=None, imageData=True, cutTo=None, magic=b'DDS '):
+	flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT
+	if dimension == TEX3D:
+		flags |= DDSD_DEPTH
+
+	if dxgi is not None:
+		pf = (pfSize, DDPF_FOURCC, DDS10_FOUR_CC, 0, 0, 0, 0, 0)
+	elif fourCC is not None:
+		pf = (pfSize, DDPF_FOURCC, fourCC, 0, 0, 0, 0, 0)
+	else:
+		pf = legacyPf
+
+	if caps2 is None:
+		caps2 = (DDSCAPS2_CUBEMAP_ALL if cube and dxgi is None else 0) | \
+			(DDSCAPS2_VOLUME if dimension == TEX3D else 0)
+
+	header = struct.pack('<7I', headerSize, flags, height, width, 0, depth, mipmaps)
+	header += b'\0' * 44 + struct.pack('<8I', *pf)
+	header += struct.pack('<5I', DDSCAPS_TEXTURE, caps2, 0, 0, 0)
+	if dxgi is not None:
+		header += struct.pack('<5I', dxgi, dimension,
+			DDS_RESOURCE_MISC_TEXTURECUBE if cube else 0, arraySize, 0)
+
+	data = bytearray()
+	if imageData:
+		for arrayIx in range(arraySize):
+			for faceIx in range(6 if cube else 1):
+				for mipmapLevel in range(mipmaps):
+					mipWidth = max(1, width >> mipmapLevel)
+					mipHeight = 1 if dimension == TEX1D else max(1, height >> mipmapLevel)
+					mipDepth = max(1, depth >> mipmapLevel)
+					byteCount = ImageSize(mipWidth, mipHeight, mipDepth, blockBytes, pixelBytes)
+					data += bytes(rng.randrange(256) for byteIx in range(byteCount))
+
+	blob = magic + header + bytes(data)
+	if cutTo is not None:
+		blob = blob[:cutTo]
+
+	with open(filename, 'wb') as outFile:
+		outFile.write(blob)
+
+def main():
+	outDir = sys.argv[1] if len(sys.argv) > 1 else 'dds'
+	good = os.path.join(outDir, 'good')
+	bad = os.path.join(outDir, 'bad')
+	os.makedirs(good, exist_ok=True)
+	os.makedirs(bad, exist_ok=True)
+
+	#Each of these loads. DdsCorpusTest lists what each must load as.
+	WriteDds(os.path.join(good, 'bc7_array.dds'), 16, 16, 5, dxgi=98, arraySize=3, blockBytes=16)
+	WriteDds(os.path.join(good, 'bc7_srgb.dds'), 16, 16, 5, dxgi=99, blockBytes=16)
+	WriteDds(os.path.join(good, 'bc6h_uf16.dds'), 16, 16, 5, dxgi=95, blockBytes=16)
+	WriteDds(os.path.join(good, 'bc6h_sf16.dds'), 16, 16, 5, dxgi=96, blockBytes=16)
+	WriteDds(os.path.join(good, 'bc1_npot.dds'), 33, 17, 6, dxgi=71, blockBytes=8)
+	WriteDds(os.path.join(good, 'bc1_srgb.dds'), 16, 16, 5, dxgi=72, blockBytes=8)
+	WriteDds(os.path.join(good, 'bc3_srgb_array.dds'), 16, 16, 5, dxgi=78, arraySize=2, blockBytes=16)
+	WriteDds(os.path.join(good, 'bc4_snorm.dds'), 16, 16, 5, dxgi=81, blockBytes=8)
+	WriteDds(os.path.join(good, 'bc5_unorm.dds'), 16, 16, 5, dxgi=83, blockBytes=16)
+	WriteDds(os.path.join(good, 'rgba8_cube_srgb.dds'), 8, 8, 4, dxgi=29, cube=True)
+	WriteDds(os.path.join(good, 'rgba8_cube_array.dds'), 8, 8, 4, dxgi=28, arraySize=2, cube=True)
+	WriteDds(os.path.join(good, 'rg16f_1d_array.dds'), 32, 1, 6, dxgi=34, arraySize=4, dimension=TEX1D)
+	WriteDds(os.path.join(good, 'bgra8_srgb.dds'), 16, 8, 5, dxgi=91)
+	WriteDds(os.path.join(good, 'r32f.dds'), 8, 8, 4, dxgi=41)
+	WriteDds(os.path.join(good, 'rgba16_unorm.dds'), 8, 8, 4, dxgi=11, pixelBytes=8)
+	WriteDds(os.path.join(good, 'b5g6r5.dds'), 8, 8, 4, dxgi=85, pixelBytes=2)
+	WriteDds(os.path.join(good, 'b5g5r5a1.dds'), 8, 8, 4, dxgi=86, pixelBytes=2)
+	WriteDds(os.path.join(good, 'rgb10a2.dds'), 8, 8, 4, dxgi=24)
+	WriteDds(os.path.join(good, 'r8_3d.dds'), 8, 8, 4, dxgi=61, dimension=TEX3D, depth=4, pixelBytes=1)
+	WriteDds(os.path.join(good, 'legacy_dxt1.dds'), 64, 32, 7, fourCC=DXT1_FOUR_CC, blockBytes=8)
+	WriteDds(os.path.join(good, 'legacy_rgba.dds'), 16, 8, 5, legacyPf=RGBA8_LEGACY_PF)
+	WriteDds(os.path.join(good, 'legacy_cube.dds'), 8, 8, 4, legacyPf=RGBA8_LEGACY_PF, cube=True)
+
+	#Each of these is rejected. DdsCorpusTest lists the exception each must throw.
+	WriteDds(os.path.join(bad, 'header_size.dds'), 8, 8, 1, dxgi=28, headerSize=120)
+	WriteDds(os.path.join(bad, 'pixel_format_size.dds'), 8, 8, 1, dxgi=28, pfSize=24)
+	WriteDds(os.path.join(bad, 'no_magic.dds'), 8, 8, 1, dxgi=28, magic=b'DDX ')
+	WriteDds(os.path.join(bad, 'too_small.dds'), 8, 8, 1, dxgi=28, cutTo=64)
+	WriteDds(os.path.join(bad, 'zero_width.dds'), 0, 8, 1, dxgi=28)
+	WriteDds(os.path.join(bad, 'too_many_mipmaps.dds'), 8, 8, 6, dxgi=28)
+	WriteDds(os.path.join(bad, 'dx10_cut.dds'), 8, 8, 1, dxgi=28, cutTo=4 + 124 + 10)
+	WriteDds(os.path.join(bad, 'buffer_dimension.dds'), 8, 8, 1, dxgi=28, dimension=BUFFER)
+	WriteDds(os.path.join(bad, 'array_zero.dds'), 8, 8, 1, dxgi=28, arraySize=0)
+	WriteDds(os.path.join(bad, 'array_too_large.dds'), 8, 8, 1, dxgi=28, arraySize=4096,
+		imageData=False)
+	WriteDds(os.path.join(bad, 'cube_3d.dds'), 8, 8, 1, dxgi=28, dimension=TEX3D, depth=4,
+		cube=True)
+	WriteDds(os.path.join(bad, 'volume_array.dds'), 8, 8, 1, dxgi=28, dimension=TEX3D, depth=4,
+		arraySize=2)
+	WriteDds(os.path.join(bad, 'typeless.dds'), 8, 8, 1, dxgi=27)
+	WriteDds(os.path.join(bad, 'd24s8.dds'), 8, 8, 1, dxgi=45)
+	WriteDds(os.path.join(bad, 'bc7_3d.dds'), 8, 8, 1, dxgi=98, dimension=TEX3D, depth=4,
+		blockBytes=16)
+	WriteDds(os.path.join(bad, 'legacy_partial_cube.dds'), 8, 8, 1, legacyPf=RGBA8_LEGACY_PF,
+		caps2=0x0600)
+	WriteDds(os.path.join(bad, 'legacy_unknown_format.dds'), 8, 8, 1,
+		legacyPf=(32, DDPF_RGB, 0, 24, 0x7, 0x38, 0x1c0, 0))
+	WriteDds(os.path.join(bad, 'truncated_data.dds'), 16, 16, 5, dxgi=98, arraySize=3,
+		blockBytes=16, cutTo=1000)
+
+if __name__ == '__main__':
+	main()
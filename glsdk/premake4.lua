@@ -1,7 +1,24 @@
+newoption
+{
+	trigger = "profile",
+	description = "Compile in the scoped CPU profiler, for the framework's PROFILE_SCOPE markers.",
+}
+
+newoption
+{
+	trigger = "avx",
+	description = "Compile for CPUs with AVX, which glimg's block compressor uses eight texels at a time.",
+}
+
 solution "glsdk"
 	configurations {"Debug", "Release"}
 	defines {"_CRT_SECURE_NO_WARNINGS", "_SCL_SECURE_NO_WARNINGS"}
 
+	configuration "profile"
+		defines {"FRAMEWORK_PROFILE"}
+
+	configuration {}
+
 
 local libPremakes = 
 {